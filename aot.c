@@ -0,0 +1,66 @@
+#include <dlfcn.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "util.h"
+#include "class.h"
+#include "frame.h"
+#include "jit.h"
+#include "aot.h"
+
+static AotMethod *methods = NULL;       /* table of the loaded library */
+
+/* compute checksum of method code, so that a library is not bound to a class changed after it was compiled */
+U4
+aot_checksum(Code_attribute *code)
+{
+	U4 h = 2166136261u;             /* FNV-1a */
+	U4 i;
+
+	for (i = 0; i < code->code_length; i++)
+		h = (h ^ code->code[i]) * 16777619u;
+	return h ^ code->code_length;
+}
+
+/* open library of methods compiled by jaotc and give it the routines it calls */
+void
+aot_load(char *path, AotRuntime *runtime)
+{
+	AotRuntime **rt;
+	void *lib;
+
+	if ((lib = dlopen(path, RTLD_NOW | RTLD_LOCAL)) == NULL)
+		errx(EXIT_FAILURE, "%s", dlerror());
+	methods = dlsym(lib, AOT_METHODS);
+	rt = dlsym(lib, AOT_RUNTIME);
+	if (methods == NULL || rt == NULL)
+		errx(EXIT_FAILURE, "%s: not a library of compiled classes", path);
+	*rt = runtime;
+}
+
+/* use compiled code of the loaded library for the methods of class whose code it was compiled from */
+void
+aot_bind(ClassFile *class)
+{
+	AotMethod *m;
+	Attribute *cattr;
+	Code_attribute *code;
+	Method *method;
+	char *classname;
+
+	if (methods == NULL)
+		return;
+	classname = class_getclassname(class, class->this_class);
+	for (m = methods; m->fn != NULL; m++) {
+		if (strcmp(m->classname, classname) != 0)
+			continue;
+		if ((method = class_getmethod(class, m->name, m->descriptor)) == NULL)
+			continue;
+		if ((cattr = class_getattr(method->attributes, method->attributes_count, Code)) == NULL)
+			continue;
+		code = &cattr->info.code;
+		if (aot_checksum(code) == m->checksum) {
+			code->jit = m->fn;
+		}
+	}
+}
@@ -0,0 +1,22 @@
+#define AOT_METHODS     "aot_methods"   /* symbol of the table of methods of a compiled library */
+#define AOT_RUNTIME     "aot_runtime"   /* symbol of the pointer to the routines of the virtual machine */
+
+/* routines of the virtual machine called by methods compiled ahead of time */
+typedef struct AotRuntime {
+	Handler       **handlers;       /* interpreter routine of each instruction */
+	int           (*needcollect)(void);
+	void          (*safepoint)(void);
+} AotRuntime;
+
+/* method of a compiled library; the table ends with an entry whose fn is NULL */
+typedef struct AotMethod {
+	char           *classname;
+	char           *name;
+	char           *descriptor;
+	U4              checksum;       /* of the code it was compiled from */
+	JitCode        *fn;
+} AotMethod;
+
+U4 aot_checksum(Code_attribute *code);
+void aot_load(char *path, AotRuntime *runtime);
+void aot_bind(ClassFile *class);
@@ -207,6 +207,22 @@ static int noperands[] = {
 	[IFNONNULL]       = 2,
 	[GOTO_W]          = 4,
 	[JSR_W]           = 4,
+	[IALOAD_QUICK]    = 0,
+	[LALOAD_QUICK]    = 0,
+	[FALOAD_QUICK]    = 0,
+	[DALOAD_QUICK]    = 0,
+	[AALOAD_QUICK]    = 0,
+	[BALOAD_QUICK]    = 0,
+	[CALOAD_QUICK]    = 0,
+	[SALOAD_QUICK]    = 0,
+	[IASTORE_QUICK]   = 0,
+	[LASTORE_QUICK]   = 0,
+	[FASTORE_QUICK]   = 0,
+	[DASTORE_QUICK]   = 0,
+	[AASTORE_QUICK]   = 0,
+	[BASTORE_QUICK]   = 0,
+	[CASTORE_QUICK]   = 0,
+	[SASTORE_QUICK]   = 0,
 };
 
 /* get number of operands of a given instruction */
@@ -216,6 +232,64 @@ class_getnoperands(U1 instruction)
 	return noperands[instruction];
 }
 
+/* get array access instruction that a quick one skips the checks of, or the instruction itself */
+U1
+class_getchecked(U1 instruction)
+{
+	if (instruction >= IALOAD_QUICK && instruction <= SALOAD_QUICK)
+		return IALOAD + (instruction - IALOAD_QUICK);
+	if (instruction >= IASTORE_QUICK && instruction <= SASTORE_QUICK)
+		return IASTORE + (instruction - IASTORE_QUICK);
+	return instruction;
+}
+
+/* get signed 16-bit operand at p */
+int32_t
+class_get16(U1 *p)
+{
+	return (int16_t)(p[0] << 8 | p[1]);
+}
+
+/* get signed 32-bit operand at p */
+int32_t
+class_get32(U1 *p)
+{
+	return (int32_t)((uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3]);
+}
+
+/* get length of instruction at pc of code */
+U4
+class_getinslen(U1 *code, U4 pc)
+{
+	U4 p;
+
+	p = pc + 1 + (3 - pc % 4);
+	switch (class_getnoperands(code[pc])) {
+	case OP_WIDE:
+		return (code[pc + 1] == IINC) ? 6 : 4;
+	case OP_TABLESWITCH:
+		return p + 12 + 4 * (U4)(class_get32(&code[p + 8]) - class_get32(&code[p + 4]) + 1) - pc;
+	case OP_LOOKUPSWITCH:
+		return p + 8 + 8 * (U4)class_get32(&code[p + 4]) - pc;
+	default:
+		return 1 + class_getnoperands(code[pc]);
+	}
+}
+
+/* get name and type index of method reference, interface method reference or call site */
+U2
+class_getnameandtypeindex(ClassFile *class, U2 index)
+{
+	switch (class->constant_pool[index].tag) {
+	case CONSTANT_InterfaceMethodref:
+		return class->constant_pool[index].info.interfacemethodref_info.name_and_type_index;
+	case CONSTANT_InvokeDynamic:
+		return class->constant_pool[index].info.invokedynamic_info.name_and_type_index;
+	default:
+		return class->constant_pool[index].info.methodref_info.name_and_type_index;
+	}
+}
+
 /* get attribute with given tag in list of attributes */
 Attribute *
 class_getattr(Attribute *attrs, U2 count, AttributeTag tag)
@@ -300,6 +374,22 @@ class_getmethod(ClassFile *class, char *name, char *descr)
 	return NULL;
 }
 
+/* get method of class whose Code attribute is code */
+Method *
+class_getcodemethod(ClassFile *class, Code_attribute *code)
+{
+	Attribute *cattr;
+	U2 i;
+
+	for (i = 0; i < class->methods_count; i++) {
+		cattr = class_getattr(class->methods[i].attributes, class->methods[i].attributes_count, Code);
+		if (cattr != NULL && &cattr->info.code == code) {
+			return &class->methods[i];
+		}
+	}
+	return NULL;
+}
+
 /* get field matching name and descriptor from class */
 Field *
 class_getfield(ClassFile *class, char *name, char *descr)
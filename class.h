@@ -7,12 +7,38 @@ typedef uint16_t U2;
 typedef uint32_t U4;
 typedef uint64_t U8;
 
-/* heap object structure */
+/* element type of array (atype of newarray for primitive types) */
+typedef enum ArrayType {
+	T_NONE      = 0,        /* not an array */
+	T_REFERENCE = 1,
+	T_BOOLEAN   = 4,
+	T_CHAR      = 5,
+	T_FLOAT     = 6,
+	T_DOUBLE    = 7,
+	T_BYTE      = 8,
+	T_SHORT     = 9,
+	T_INT       = 10,
+	T_LONG      = 11,
+	T_LAST      = 12
+} ArrayType;
+
+/* class of heap object */
+typedef enum HeapKind {
+	K_FILLER    = 0,        /* free space, or the unused end of an allocation buffer */
+	K_ARRAY     = 1,
+	K_STRING    = 2,        /* java.lang.String, with inline characters */
+	K_NATIVE    = 3,        /* holder of a native object, such as System.out */
+} HeapKind;
+
+/* compact heap object header; the payload follows it in the heap */
 typedef struct Heap {
-	struct Heap *prev, *next;
-	void  *obj;
-	int32_t nmemb;
-	size_t count;
+	U4      size;           /* size of object in units of 8 bytes, header included */
+	U1      kind;           /* class of object */
+	U1      type;           /* element type of arrays */
+	U1      mark;           /* whether object was reached by the collector, or was moved */
+	U1      age;            /* number of young collections survived */
+	int32_t nmemb;          /* number of elements of arrays */
+	int32_t hash;           /* identity hash code, 0 until computed */
 } Heap;
 
 /* local variable or operand structure */
@@ -252,7 +278,25 @@ typedef enum Instruction {
 	CodeLast        = 0xCA,
 	BREAKPOINT      = 0xCA,
 	IMPDEP1         = 0xFE,
-	IMPDEP2         = 0xFF
+	IMPDEP2         = 0xFF,
+
+	/* quick: array accesses the optimizer proved in bounds, which check neither null nor index */
+	IALOAD_QUICK    = 0xCB,
+	LALOAD_QUICK    = 0xCC,
+	FALOAD_QUICK    = 0xCD,
+	DALOAD_QUICK    = 0xCE,
+	AALOAD_QUICK    = 0xCF,
+	BALOAD_QUICK    = 0xD0,
+	CALOAD_QUICK    = 0xD1,
+	SALOAD_QUICK    = 0xD2,
+	IASTORE_QUICK   = 0xD3,
+	LASTORE_QUICK   = 0xD4,
+	FASTORE_QUICK   = 0xD5,
+	DASTORE_QUICK   = 0xD6,
+	AASTORE_QUICK   = 0xD7,
+	BASTORE_QUICK   = 0xD8,
+	CASTORE_QUICK   = 0xD9,
+	SASTORE_QUICK   = 0xDA
 } Instruction;
 
 typedef enum ConstantTag {
@@ -315,7 +359,8 @@ typedef enum AttributeTag {
 	SourceFile,
 	Synthetic,
 	LineNumberTable,
-	LocalVariableTable
+	LocalVariableTable,
+	BootstrapMethods
 } AttributeTag;
 
 typedef enum ReferenceKind {
@@ -410,6 +455,11 @@ typedef struct Code_attribute {
 	struct Exception       *exception_table;
 	U2                      attributes_count;
 	struct Attribute       *attributes;
+	void                   *refmap;         /* reference maps, computed on first collection */
+	void                   *jit;            /* compiled code, or NULL */
+	U4                      backedges;      /* backward branches counted towards compilation */
+	void                   *traces;         /* compiled traces of loops, or NULL */
+	int                     tracefails;     /* recordings of traces of loops that failed */
 } Code_attribute;
 
 typedef struct Exceptions_attribute {
@@ -436,6 +486,11 @@ typedef struct LocalVariableTable_attribute {
 	struct LocalVariable   *local_variable_table;
 } LocalVariableTable_attribute;
 
+typedef struct BootstrapMethods_attribute {
+	U2                      num_bootstrap_methods;
+	struct BootstrapMethod *bootstrap_methods;
+} BootstrapMethods_attribute;
+
 typedef struct CP {
 	U1      tag;
 	union {
@@ -466,6 +521,7 @@ typedef struct Attribute {
 		struct SourceFile_attribute             sourcefile;
 		struct LineNumberTable_attribute        linenumbertable;
 		struct LocalVariableTable_attribute     localvariabletable;
+		struct BootstrapMethods_attribute       bootstrapmethods;
 	}       info;
 } Attribute;
 
@@ -475,6 +531,7 @@ typedef struct Field {
 	U2                      descriptor_index;
 	U2                      attributes_count;
 	struct Attribute       *attributes;
+	union Value             value;          /* value of static field */
 } Field;
 
 typedef struct Method {
@@ -483,6 +540,7 @@ typedef struct Method {
 	U2                      descriptor_index;
 	U2                      attributes_count;
 	struct Attribute       *attributes;
+	U4                      invocations;    /* calls counted towards compilation */
 } Method;
 
 typedef struct Exception {
@@ -512,9 +570,16 @@ typedef struct LocalVariable {
 	U2      index;
 } LocalVariable;
 
+typedef struct BootstrapMethod {
+	U2      bootstrap_method_ref;
+	U2      num_bootstrap_arguments;
+	U2     *bootstrap_arguments;
+} BootstrapMethod;
+
 typedef struct ClassFile {
 	int               init;
 	struct ClassFile *next, *super;
+	void            **cache;        /* run-time resolution of constant pool entries */
 	U2                minor_version;
 	U2                major_version;
 	U2                constant_pool_count;
@@ -533,6 +598,11 @@ typedef struct ClassFile {
 } ClassFile;
 
 int class_getnoperands(U1 instruction);
+U1 class_getchecked(U1 instruction);
+int32_t class_get16(U1 *p);
+int32_t class_get32(U1 *p);
+U4 class_getinslen(U1 *code, U4 pc);
+U2 class_getnameandtypeindex(ClassFile *class, U2 index);
 Attribute *class_getattr(Attribute *attrs, U2 count, AttributeTag tag);
 char *class_getutf8(ClassFile *class, U2 index);
 char *class_getclassname(ClassFile *class, U2 index);
@@ -543,5 +613,6 @@ int64_t class_getlong(ClassFile *class, U2 index);
 double class_getdouble(ClassFile *class, U2 index);
 void class_getnameandtype(ClassFile *class, U2 index, char **name, char **type);
 Method *class_getmethod(ClassFile *class, char *name, char *descr);
+Method *class_getcodemethod(ClassFile *class, Code_attribute *code);
 Field *class_getfield(ClassFile *class, char *name, char *descr);
 int class_istopclass(ClassFile *class);
@@ -0,0 +1,343 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "util.h"
+#include "class.h"
+#include "memory.h"
+#include "output.h"
+#include "concat.h"
+
+#define CONCATFACTORY   "java/lang/invoke/StringConcatFactory"
+#define TAG_ARG         '\1'            /* recipe tag for an ordinary argument */
+#define TAG_CONST       '\2'            /* recipe tag for a bootstrap constant */
+
+/* get part kind of argument in descriptor; advance *s past it; return -1 if not supported */
+static int
+argkind(char **s)
+{
+	char *p = *s;
+	int kind = -1;
+
+	switch (*p) {
+	case 'B': case 'S': case 'I':
+		kind = PART_INT;
+		break;
+	case 'J':
+		kind = PART_LONG;
+		break;
+	case 'C':
+		kind = PART_CHAR;
+		break;
+	case 'Z':
+		kind = PART_BOOL;
+		break;
+	case 'F':
+		kind = PART_FLOAT;
+		break;
+	case 'D':
+		kind = PART_DOUBLE;
+		break;
+	case '[':
+		/* arrays are not supported, even of strings; skip the element type */
+		while (*p == '[')
+			p++;
+		if (*p == 'L')
+			while (*p && *p != ';')
+				p++;
+		break;
+	case 'L':
+		if (strncmp(p, "Ljava/lang/String;", 18) == 0)
+			kind = PART_STRING;
+		while (*p && *p != ';')
+			p++;
+		break;
+	}
+	if (*p)
+		p++;
+	*s = p;
+	return kind;
+}
+
+/* get loadable constant used as bootstrap argument as interned string */
+static Heap *
+conststring(ClassFile *class, U2 index)
+{
+	char buf[OUTPUT_NUMSIZE + 1];
+	size_t n;
+	Heap *h;
+
+	switch (class->constant_pool[index].tag) {
+	case CONSTANT_String:
+		h = string_fromutf8(class_getstring(class, index));
+		return h ? string_intern(h) : NULL;
+	case CONSTANT_Integer:
+		n = output_fmtint(buf, class_getinteger(class, index));
+		break;
+	case CONSTANT_Long:
+		n = output_fmtlong(buf, class_getlong(class, index));
+		break;
+	case CONSTANT_Float:
+		n = output_fmtfloat(buf, class_getfloat(class, index));
+		break;
+	case CONSTANT_Double:
+		n = output_fmtdouble(buf, class_getdouble(class, index));
+		break;
+	default:
+		return NULL;
+	}
+	buf[n] = '\0';
+	h = string_fromutf8(buf);
+	return h ? string_intern(h) : NULL;
+}
+
+/* append constant part with the n bytes of modified UTF-8 at s to recipe */
+static int
+addconst(Recipe *recipe, char *s, size_t n)
+{
+	String *str;
+	Heap *h;
+	char *tmp;
+
+	if (n == 0)
+		return 0;
+	tmp = emalloc(n + 1);
+	memcpy(tmp, s, n);
+	tmp[n] = '\0';
+	h = string_fromutf8(tmp);
+	free(tmp);
+	if (h == NULL || (h = string_intern(h)) == NULL)
+		return -1;
+	str = STRING_OBJ(h);
+	recipe->parts[recipe->nparts].kind = PART_CONST;
+	recipe->parts[recipe->nparts].s = h;
+	recipe->nparts++;
+	recipe->constlen += str->length;
+	recipe->utf16 |= (str->coder == STRING_UTF16);
+	return 0;
+}
+
+/*
+ * Link invokedynamic call site at constant pool index to a compiled
+ * string concatenation recipe.  Only StringConcatFactory.makeConcat and
+ * makeConcatWithConstants are supported as bootstrap methods; return
+ * NULL for any other bootstrap method or for unsupported argument types.
+ */
+Recipe *
+concat_compile(ClassFile *class, U2 index)
+{
+	CONSTANT_InvokeDynamic_info *indy;
+	CONSTANT_MethodHandle_info *handle;
+	CONSTANT_Methodref_info *methodref;
+	BootstrapMethods_attribute *bsmattr;
+	BootstrapMethod *bsm;
+	Attribute *attr;
+	Recipe *recipe;
+	Heap *h;
+	char *classname, *name, *type, *descr, *rs, *seg, *p, *d;
+	U2 nconst;
+	int kind;
+
+	indy = &class->constant_pool[index].info.invokedynamic_info;
+	if ((attr = class_getattr(class->attributes, class->attributes_count, BootstrapMethods)) == NULL)
+		return NULL;
+	bsmattr = &attr->info.bootstrapmethods;
+	if (indy->bootstrap_method_attr_index >= bsmattr->num_bootstrap_methods)
+		return NULL;
+	bsm = &bsmattr->bootstrap_methods[indy->bootstrap_method_attr_index];
+	handle = &class->constant_pool[bsm->bootstrap_method_ref].info.methodhandle_info;
+	if (handle->reference_kind != REF_invokeStatic)
+		return NULL;
+	methodref = &class->constant_pool[handle->reference_index].info.methodref_info;
+	classname = class_getclassname(class, methodref->class_index);
+	class_getnameandtype(class, methodref->name_and_type_index, &name, &type);
+	if (strcmp(classname, CONCATFACTORY) != 0)
+		return NULL;
+	nconst = 0;
+	if (strcmp(name, "makeConcatWithConstants") == 0) {
+		if (bsm->num_bootstrap_arguments < 1 ||
+		    class->constant_pool[bsm->bootstrap_arguments[0]].tag != CONSTANT_String)
+			return NULL;
+		rs = class_getstring(class, bsm->bootstrap_arguments[nconst++]);
+	} else if (strcmp(name, "makeConcat") == 0) {
+		rs = NULL;
+	} else {
+		return NULL;
+	}
+	class_getnameandtype(class, indy->name_and_type_index, &name, &descr);
+	recipe = emalloc(sizeof *recipe);
+	recipe->nargs = 0;
+	recipe->nparts = 0;
+	recipe->constlen = 0;
+	recipe->utf16 = 0;
+	recipe->parts = ecalloc(strlen(descr) + (rs ? strlen(rs) : 0) + 1, sizeof *recipe->parts);
+	d = descr + 1;
+	for (seg = p = rs; p && *p; p++) {
+		if (*p != TAG_ARG && *p != TAG_CONST)
+			continue;
+		if (addconst(recipe, seg, p - seg) == -1)
+			goto error;
+		seg = p + 1;
+		if (*p == TAG_CONST) {
+			if (nconst >= bsm->num_bootstrap_arguments ||
+			    (h = conststring(class, bsm->bootstrap_arguments[nconst++])) == NULL)
+				goto error;
+			recipe->parts[recipe->nparts].kind = PART_CONST;
+			recipe->parts[recipe->nparts].s = h;
+			recipe->nparts++;
+			recipe->constlen += STRING_OBJ(h)->length;
+			recipe->utf16 |= (STRING_OBJ(h)->coder == STRING_UTF16);
+			continue;
+		}
+		if (*d == ')' || (kind = argkind(&d)) == -1)
+			goto error;
+		recipe->parts[recipe->nparts].kind = kind;
+		recipe->parts[recipe->nparts].s = NULL;
+		recipe->nparts++;
+		recipe->nargs++;
+	}
+	if (rs != NULL && addconst(recipe, seg, p - seg) == -1)
+		goto error;
+	while (rs == NULL && *d != ')') {
+		if ((kind = argkind(&d)) == -1)
+			goto error;
+		recipe->parts[recipe->nparts].kind = kind;
+		recipe->parts[recipe->nparts].s = NULL;
+		recipe->nparts++;
+		recipe->nargs++;
+	}
+	if (*d != ')')
+		goto error;
+	return recipe;
+error:
+	free(recipe->parts);
+	free(recipe);
+	return NULL;
+}
+
+/* copy n ascii characters from s into string at *pos */
+static void
+putascii(String *dst, int32_t *pos, const char *s, size_t n)
+{
+	size_t i;
+
+	if (dst->coder == STRING_LATIN1) {
+		memcpy(dst->value + *pos, s, n);
+	} else {
+		for (i = 0; i < n; i++) {
+			((U2 *)dst->value)[*pos + i] = (unsigned char)s[i];
+		}
+	}
+	*pos += n;
+}
+
+/* copy characters of string src into string at *pos */
+static void
+putstring(String *dst, int32_t *pos, String *src)
+{
+	int32_t i;
+
+	if (dst->coder == src->coder) {
+		memcpy(dst->value + (size_t)*pos * (dst->coder == STRING_UTF16 ? sizeof (U2) : 1),
+		       src->value, (size_t)src->length * (src->coder == STRING_UTF16 ? sizeof (U2) : 1));
+	} else {
+		for (i = 0; i < src->length; i++) {
+			((U2 *)dst->value)[*pos + i] = src->value[i];
+		}
+	}
+	*pos += src->length;
+}
+
+/*
+ * Run recipe on its arguments, which are in stack order at args.  The
+ * size and coder of the result are computed from the arguments before
+ * the string is allocated, so the result takes a single allocation.
+ */
+Heap *
+concat_run(Recipe *recipe, Value *args)
+{
+	char nums[recipe->nargs + 1][OUTPUT_NUMSIZE];   /* formatted numeric arguments */
+	int32_t lens[recipe->nargs + 1];
+	struct Part *part;
+	String *s, *str;
+	Heap *h;
+	int64_t length;
+	int32_t i, j, pos;
+	int utf16;
+
+	length = recipe->constlen;
+	utf16 = recipe->utf16;
+	for (i = j = 0; i < recipe->nparts; i++) {
+		part = &recipe->parts[i];
+		switch (part->kind) {
+		case PART_CONST:
+			continue;
+		case PART_INT:
+			lens[j] = output_fmtint(nums[j], args[j].i);
+			break;
+		case PART_LONG:
+			lens[j] = output_fmtlong(nums[j], args[j].l);
+			break;
+		case PART_FLOAT:
+			lens[j] = output_fmtfloat(nums[j], args[j].f);
+			break;
+		case PART_DOUBLE:
+			lens[j] = output_fmtdouble(nums[j], args[j].d);
+			break;
+		case PART_CHAR:
+			lens[j] = 1;
+			utf16 |= (U2)args[j].i > 0xFF;
+			break;
+		case PART_BOOL:
+			lens[j] = args[j].i ? 4 : 5;
+			break;
+		case PART_STRING:
+			if (args[j].v == NULL) {
+				lens[j] = 4;
+			} else {
+				str = STRING_OBJ(args[j].v);
+				lens[j] = str->length;
+				utf16 |= (str->coder == STRING_UTF16);
+			}
+			break;
+		}
+		length += lens[j++];
+	}
+	if (length > INT32_MAX)
+		errx(EXIT_FAILURE, "string concatenation too long");
+	if ((h = string_new(utf16 ? STRING_UTF16 : STRING_LATIN1, length)) == NULL)
+		errx(EXIT_FAILURE, "out of memory");
+	s = STRING_OBJ(h);
+	pos = 0;
+	for (i = j = 0; i < recipe->nparts; i++) {
+		part = &recipe->parts[i];
+		switch (part->kind) {
+		case PART_CONST:
+			putstring(s, &pos, STRING_OBJ(part->s));
+			continue;
+		case PART_INT:
+		case PART_LONG:
+		case PART_FLOAT:
+		case PART_DOUBLE:
+			putascii(s, &pos, nums[j], lens[j]);
+			break;
+		case PART_CHAR:
+			if (utf16)
+				((U2 *)s->value)[pos++] = args[j].i;
+			else
+				s->value[pos++] = args[j].i;
+			break;
+		case PART_BOOL:
+			putascii(s, &pos, args[j].i ? "true" : "false", lens[j]);
+			break;
+		case PART_STRING:
+			if (args[j].v == NULL)
+				putascii(s, &pos, "null", 4);
+			else
+				putstring(s, &pos, STRING_OBJ(args[j].v));
+			break;
+		}
+		j++;
+	}
+	return h;
+}
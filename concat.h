@@ -0,0 +1,26 @@
+/* kind of a part of a string concatenation recipe */
+typedef enum PartKind {
+	PART_CONST,             /* constant string */
+	PART_INT,               /* int, short or byte argument */
+	PART_LONG,
+	PART_CHAR,
+	PART_BOOL,
+	PART_FLOAT,
+	PART_DOUBLE,
+	PART_STRING,
+} PartKind;
+
+/* compiled StringConcatFactory recipe, bound to an invokedynamic call site */
+typedef struct Recipe {
+	int32_t         nargs;          /* number of operands consumed from the stack */
+	int32_t         nparts;
+	int32_t         constlen;       /* total length of constant parts */
+	int             utf16;          /* whether some constant part needs UTF-16 */
+	struct Part {
+		PartKind        kind;
+		Heap           *s;      /* constant string, for PART_CONST */
+	}              *parts;
+} Recipe;
+
+Recipe *concat_compile(ClassFile *class, U2 index);
+Heap *concat_run(Recipe *recipe, Value *args);
@@ -137,6 +137,7 @@ getattributetag(char *tagstr)
 		{Synthetic,          "Synthetic"},
 		{LineNumberTable,    "LineNumberTable"},
 		{LocalVariableTable, "LocalVariableTable"},
+		{BootstrapMethods,   "BootstrapMethods"},
 		{UnknownAttribute,   NULL},
 	};
 	int i;
@@ -723,6 +724,25 @@ readlocalvariable(FILE *fp, ClassFile *class, U2 count)
 	return p;
 }
 
+/* read bootstrap method table, return point to BootstrapMethod array */
+static BootstrapMethod *
+readbootstrapmethods(FILE *fp, ClassFile *class, U2 count)
+{
+	BootstrapMethod *p;
+	U2 i;
+
+	if (count == 0)
+		return NULL;
+	p = fcalloc(count, sizeof *p);
+	for (i = 0; i < count; i++) {
+		p[i].bootstrap_method_ref = readindex(fp, 0, class, CONSTANT_MethodHandle);
+		p[i].num_bootstrap_arguments = readu(fp, 2);
+		p[i].bootstrap_arguments = readindices(fp, p[i].num_bootstrap_arguments);
+	}
+	popfreestack();
+	return p;
+}
+
 /* read attribute list, longjmp to class_read on error */
 static Attribute *
 readattributes(FILE *fp, ClassFile *class, U2 count)
@@ -777,6 +797,10 @@ readattributes(FILE *fp, ClassFile *class, U2 count)
 			p[i].info.localvariabletable.local_variable_table_length = readu(fp, 2);
 			p[i].info.localvariabletable.local_variable_table = readlocalvariable(fp, class, p[i].info.localvariabletable.local_variable_table_length);
 			break;
+		case BootstrapMethods:
+			p[i].info.bootstrapmethods.num_bootstrap_methods = readu(fp, 2);
+			p[i].info.bootstrapmethods.bootstrap_methods = readbootstrapmethods(fp, class, p[i].info.bootstrapmethods.num_bootstrap_methods);
+			break;
 		case UnknownAttribute:
 			while (length-- > 0)
 				readb(fp, &b, 1);
@@ -833,7 +857,7 @@ readmethods(FILE *fp, ClassFile *class, U2 count)
 static void
 attributefree(Attribute *attr, U2 count)
 {
-	U2 i;
+	U2 i, j;
 
 	if (attr == NULL)
 		return;
@@ -848,6 +872,7 @@ attributefree(Attribute *attr, U2 count)
 		case Code:
 			free(attr[i].info.code.code);
 			free(attr[i].info.code.exception_table);
+			free(attr[i].info.code.refmap);
 			attributefree(attr[i].info.code.attributes, attr[i].info.code.attributes_count);
 			break;
 		case Exceptions:
@@ -862,6 +887,11 @@ attributefree(Attribute *attr, U2 count)
 		case LocalVariableTable:
 			free(attr[i].info.localvariabletable.local_variable_table);
 			break;
+		case BootstrapMethods:
+			for (j = 0; j < attr[i].info.bootstrapmethods.num_bootstrap_methods; j++)
+				free(attr[i].info.bootstrapmethods.bootstrap_methods[j].bootstrap_arguments);
+			free(attr[i].info.bootstrapmethods.bootstrap_methods);
+			break;
 		}
 	}
 	free(attr);
@@ -905,6 +935,7 @@ file_read(FILE *fp, ClassFile *class)
 	class->init = 0;
 	class->next = NULL;
 	class->super = NULL;
+	class->cache = NULL;
 	class->minor_version = readu(fp, 2);
 	class->major_version = readu(fp, 2);
 	class->constant_pool_count = readu(fp, 2);
@@ -1,5 +1,6 @@
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include "class.h"
 #include "frame.h"
 
@@ -28,6 +29,8 @@ frame_push(Code_attribute *code, ClassFile *class)
 	frame->local = local;
 	frame->stack = stack;
 	frame->nstack = 0;
+	frame->obj = NULL;
+	frame->nobj = 0;
 	frame->next = framestack;
 	framestack = frame;
 	return frame;
@@ -43,6 +46,9 @@ frame_pop(void)
 		return -1;
 	frame = framestack;
 	framestack = frame->next;
+	while (frame->nobj > 0)
+		free(frame->obj[--frame->nobj].p);
+	free(frame->obj);
 	free(frame->local);
 	free(frame->stack);
 	free(frame);
@@ -58,6 +64,13 @@ frame_del(void)
 	}
 }
 
+/* get frame on top of framestack, the one being executed */
+Frame *
+frame_top(void)
+{
+	return framestack;
+}
+
 /* push value onto frame's operand stack */
 void
 frame_stackpush(Frame *frame, Value value)
@@ -92,3 +105,32 @@ frame_localload4(Frame *frame, U4 a)
 {
 	return frame->local[a];
 }
+
+/*
+ * Get storage of size bytes for an array allocated at the given site
+ * of the frame's method.  The storage of a site is reused by its next
+ * allocation, and freed when the frame is popped.  Return NULL on error.
+ */
+void *
+frame_alloc(Frame *frame, int site, size_t size)
+{
+	FrameObj *obj;
+	void *p;
+
+	if (site >= frame->nobj) {
+		if ((obj = realloc(frame->obj, (site + 1) * sizeof *obj)) == NULL)
+			return NULL;
+		memset(obj + frame->nobj, 0, (site + 1 - frame->nobj) * sizeof *obj);
+		frame->obj = obj;
+		frame->nobj = site + 1;
+	}
+	obj = &frame->obj[site];
+	if (obj->size < size) {
+		if ((p = malloc(size)) == NULL)
+			return NULL;
+		free(obj->p);
+		obj->p = p;
+		obj->size = size;
+	}
+	return obj->p;
+}
@@ -1,16 +1,18 @@
-/* local variable or operand structure */
-typedef union Value {
-	U2      u;
-	int32_t i;
-	char **a;
-	char ***mat;
-	int64_t l;
-	float   f;
-	double  d;
-	void   *v;
-	int   *in;
-	char *a1;
-} Value;
+/* result of executing an instruction or a whole method */
+enum {
+	NO_RETURN = 0,
+	RETURN_VOID = 1,
+	RETURN_OPERAND = 2,
+	RETURN_ERROR = 3,
+	HOT_LOOP = 4,                   /* instruction only: a loop became hot, continue compiled */
+	HOT_TRACE = 5                   /* instruction only: a loop with a compiled trace is entered */
+};
+
+/* storage of an array allocated in its frame, because it never escapes the method */
+typedef struct FrameObj {
+	void   *p;
+	size_t  size;                   /* bytes allocated at p */
+} FrameObj;
 
 /* virtual machine frame structure */
 typedef struct Frame {
@@ -21,13 +23,17 @@ typedef struct Frame {
 	size_t                  nstack; /* number of values on operand stack */
 	struct Code_attribute  *code;   /* array of instructions */
 	U2                      pc;     /* program counter */
+	struct FrameObj        *obj;    /* arrays allocated in frame, by allocation site */
+	U2                      nobj;
 } Frame;
 
 Frame *frame_push(Code_attribute *code, ClassFile *class);
 int frame_pop(void);
 void frame_del(void);
+Frame *frame_top(void);
 void frame_stackpush(Frame *frame, Value value);
 Value frame_stackpop(Frame *frame);
 void frame_localstore(Frame *frame, U2 i, Value v);
 Value frame_localload(Frame *frame, U2 i);
 Value frame_localload4(Frame *frame, U4 i);
+void *frame_alloc(Frame *frame, int site, size_t size);
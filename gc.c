@@ -0,0 +1,258 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include "util.h"
+#include "class.h"
+#include "frame.h"
+#include "memory.h"
+#include "output.h"
+#include "concat.h"
+#include "refmap.h"
+#include "gc.h"
+
+#define MAXINSLEN       5               /* length of the longest invoke instruction */
+
+static size_t initsize = HEAP_INITSIZE;
+static int verbose = 0;
+static int ncollections = 0;
+static struct timespec start;
+
+/* get seconds elapsed since t */
+static double
+elapsed(struct timespec *t)
+{
+	struct timespec now;
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - t->tv_sec) + (now.tv_nsec - t->tv_nsec) / 1e9;
+}
+
+/* get default number of collector threads: one per processor up to 8, then 5 per 8 processors */
+static int
+defaultthreads(void)
+{
+	long n;
+
+	if ((n = sysconf(_SC_NPROCESSORS_ONLN)) < 1)
+		return 1;
+	if (n > GC_MAXTHREADS)
+		n = GC_MAXTHREADS;
+	return (n <= 8) ? n : 8 + (n - 8) * 5 / 8;
+}
+
+/*
+ * Set bytes in use before the first collection and start nthreads
+ * collector threads, or a number fit for the machine if nthreads is 0;
+ * log collections if log is set.
+ */
+void
+gc_init(size_t size, int nthreads, int log)
+{
+	heap_setworkers(nthreads > 0 ? nthreads : defaultthreads());
+	initsize = size;
+	verbose = log;
+	(void)clock_gettime(CLOCK_MONOTONIC, &start);
+	heap_settrigger(initsize);
+}
+
+/* get reference map of frame; the top frame is stopped before the instruction at pc, the others are inside the instruction that ends at pc */
+static U1 *
+framemap(Frame *frame, int top)
+{
+	U1 *map;
+	int32_t pc;
+
+	if (top)
+		return refmap_get(frame->class, frame->code, frame->pc);
+	map = NULL;
+	for (pc = frame->pc - 1; map == NULL && pc >= 0 && pc >= frame->pc - MAXINSLEN; pc--)
+		map = refmap_get(frame->class, frame->code, pc);
+	return map;
+}
+
+/*
+ * Visit reference slots among local variables and operand stack of
+ * frame.  A frame that is inside an instruction has only popped the
+ * operands of that instruction so far, so the map of that instruction
+ * covers its stack.  A frame without a map has all its slots visited,
+ * which is only good for marking, as the visitor checks them against
+ * object starts.
+ */
+static void
+visitframe(Frame *frame, int top, void (*visit)(Heap **))
+{
+	U1 *map;
+	size_t i;
+
+	map = framemap(frame, top);
+	for (i = 0; i < frame->code->max_locals; i++)
+		if (map == NULL || map[i])
+			visit(&frame->local[i].v);
+	for (i = 0; i < frame->nstack; i++)
+		if (map == NULL || map[frame->code->max_locals + i])
+			visit(&frame->stack[i].v);
+}
+
+/* visit static fields of class and objects cached in its constant pool */
+static void
+visitclass(ClassFile *class, void (*visit)(Heap **))
+{
+	Recipe *recipe;
+	char *name, *type;
+	int32_t j;
+	U2 i;
+
+	for (i = 0; i < class->fields_count; i++) {
+		type = class_getutf8(class, class->fields[i].descriptor_index);
+		if ((class->fields[i].access_flags & ACC_STATIC) && (*type == 'L' || *type == '['))
+			visit(&class->fields[i].value.v);
+	}
+	if (class->cache == NULL)
+		return;
+	for (i = 1; i < class->constant_pool_count; i++) {
+		if (class->cache[i] == NULL)
+			continue;
+		switch (class->constant_pool[i].tag) {
+		case CONSTANT_String:
+			visit((Heap **)&class->cache[i]);
+			break;
+		case CONSTANT_Fieldref:
+			class_getnameandtype(class, class->constant_pool[i].info.fieldref_info.name_and_type_index, &name, &type);
+			if (*type == 'L' || *type == '[')
+				visit(&((Value *)class->cache[i])->v);
+			break;
+		case CONSTANT_InvokeDynamic:
+			recipe = class->cache[i];
+			for (j = 0; j < recipe->nparts; j++)
+				if (recipe->parts[j].kind == PART_CONST)
+					visit(&recipe->parts[j].s);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+/* visit the roots: the frame stack and the loaded classes */
+static void
+visitroots(ClassFile *classes, void (*visit)(Heap **))
+{
+	Frame *frame;
+
+	for (frame = frame_top(); frame; frame = frame->next)
+		visitframe(frame, frame == frame_top(), visit);
+	for (; classes; classes = classes->next)
+		visitclass(classes, visit);
+}
+
+/* mark object referenced at p */
+static void
+markslot(Heap **p)
+{
+	heap_mark(*p);
+}
+
+/* check whether every frame has a reference map, so its references can be moved */
+static int
+framesmapped(void)
+{
+	Frame *frame;
+
+	for (frame = frame_top(); frame; frame = frame->next)
+		if (framemap(frame, frame == frame_top()) == NULL)
+			return 0;
+	return 1;
+}
+
+/* write log line of collection, whose pause t is split into the given phases */
+static void
+logcollection(char *kind, size_t before, size_t after, double t, char *phases)
+{
+	char buf[256];
+	Output *out;
+
+	out = output_get(1);
+	(void)snprintf(buf, sizeof buf,
+	               "[%.3fs][info][gc] GC(%d) Pause %s %zuK->%zuK(%zuK) %.3fms (%s)",
+	               elapsed(&start), ncollections, kind, before / 1024, after / 1024, heap_committed() / 1024,
+	               t * 1e3, phases);
+	output_string(out, buf);
+	output_newline(out);
+}
+
+/* copy live objects out of the nursery */
+static void
+collectyoung(ClassFile *classes)
+{
+	struct timespec t;
+	size_t before;
+	double copy;
+	char phases[64];
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &t);
+	before = heap_young() + heap_old();
+	heap_youngbegin();
+	visitroots(classes, heap_evacuate);
+	string_evacuateinterned();
+	heap_youngend();
+	copy = elapsed(&t);
+	if (verbose) {
+		(void)snprintf(phases, sizeof phases, "copy %.3fms", copy * 1e3);
+		logcollection("Young", before, heap_young() + heap_old(), copy, phases);
+	}
+	ncollections++;
+}
+
+/* mark objects reachable from the roots in the whole heap and sweep old generation */
+static void
+collectfull(ClassFile *classes)
+{
+	struct timespec t;
+	size_t before, after, next, max;
+	double mark, sweep;
+	char phases[64];
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &t);
+	before = heap_young() + heap_old();
+	heap_markbegin();
+	visitroots(classes, markslot);
+	string_markinterned();
+	heap_marktrace();
+	mark = elapsed(&t);
+	(void)clock_gettime(CLOCK_MONOTONIC, &t);
+	after = heap_sweep();
+	sweep = elapsed(&t);
+	max = heap_maxsize();
+	next = (2 * after > initsize) ? 2 * after : initsize;
+	if (next > after + (max - after) / 2)
+		next = after + (max - after) / 2;
+	heap_settrigger(next);
+	if (verbose) {
+		(void)snprintf(phases, sizeof phases, "mark %.3fms, sweep %.3fms", mark * 1e3, sweep * 1e3);
+		logcollection("Full", before, heap_young() + after, mark + sweep, phases);
+	}
+	ncollections++;
+}
+
+/*
+ * Collect garbage.  Must be called between instructions.  Objects are
+ * reachable from the frame stack, the static fields and resolved
+ * constants of the loaded classes, and the interned strings.  When eden
+ * is exhausted, its live objects are copied out; this needs a map of
+ * every frame, otherwise the nursery is left alone and allocation goes
+ * on in old generation.  A full collection is due when the bytes in old
+ * generation double, but before the heap is exhausted.
+ */
+void
+gc_collect(ClassFile *classes)
+{
+	if (heap_youngpending()) {
+		if (framesmapped())
+			collectyoung(classes);
+		else
+			heap_youngskip();
+	}
+	if (heap_needfull())
+		collectfull(classes);
+}
@@ -0,0 +1,4 @@
+#define GC_MAXTHREADS   256             /* largest number of collector threads */
+
+void gc_init(size_t initsize, int nthreads, int log);
+void gc_collect(ClassFile *classes);
@@ -0,0 +1,884 @@
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "util.h"
+#include "class.h"
+#include "file.h"
+#include "frame.h"
+#include "refmap.h"
+#include "jit.h"
+#include "aot.h"
+#include "opt.h"
+
+/* state of the translation of a method */
+typedef struct Gen {
+	FILE           *fp;
+	ClassFile      *class;
+	Code_attribute *code;
+	U1             *label;          /* nonzero at instructions that are branch targets */
+	U1             *entry;          /* nonzero at loop heads, where the interpreter may hand a frame over */
+} Gen;
+
+/* beginning of the output: declarations and the conversions of floating-point to integer, which saturate */
+static char *prologue =
+"#include <math.h>\n"
+"#include <stddef.h>\n"
+"#include <stdint.h>\n"
+"#include \"util.h\"\n"
+"#include \"class.h\"\n"
+"#include \"frame.h\"\n"
+"#include \"memory.h\"\n"
+"#include \"jit.h\"\n"
+"#include \"aot.h\"\n"
+"\n"
+"AotRuntime *aot_runtime;\n"
+"\n"
+"static inline int32_t\n"
+"f2i(float f)\n"
+"{\n"
+"\treturn (f != f) ? 0 : (f >= 2147483648.0f) ? INT32_MAX : (f <= -2147483648.0f) ? INT32_MIN : (int32_t)f;\n"
+"}\n"
+"\n"
+"static inline int64_t\n"
+"f2l(float f)\n"
+"{\n"
+"\treturn (f != f) ? 0 : (f >= 9223372036854775808.0f) ? INT64_MAX : (f <= -9223372036854775808.0f) ? INT64_MIN : (int64_t)f;\n"
+"}\n"
+"\n"
+"static inline int32_t\n"
+"d2i(double d)\n"
+"{\n"
+"\treturn (d != d) ? 0 : (d >= 2147483647.0) ? INT32_MAX : (d <= -2147483648.0) ? INT32_MIN : (int32_t)d;\n"
+"}\n"
+"\n"
+"static inline int64_t\n"
+"d2l(double d)\n"
+"{\n"
+"\treturn (d != d) ? 0 : (d >= 9223372036854775808.0) ? INT64_MAX : (d <= -9223372036854775808.0) ? INT64_MIN : (int64_t)d;\n"
+"}\n";
+
+/* C operators of ifeq to ifle, and of if_icmpeq to if_icmple */
+static char *ifop[] = {"==", "!=", "<", ">=", ">", "<="};
+
+/* show usage */
+static void
+usage(void)
+{
+	(void)fprintf(stderr, "usage: jaotc classfile...\n");
+	exit(EXIT_FAILURE);
+}
+
+/* get operand stack depth before instruction at pc, or -1 if it is not reachable */
+static int
+depth(Gen *g, U4 pc)
+{
+	return refmap_depth(g->class, g->code, pc);
+}
+
+/* get next reachable instruction after pc, or code_length */
+static U4
+next(Gen *g, U4 pc)
+{
+	while (++pc < g->code->code_length && depth(g, pc) == -1)
+		;
+	return pc;
+}
+
+/* write copy of local variables and sp operand stack slots into the frame */
+static void
+spill(Gen *g, int sp)
+{
+	int i;
+
+	for (i = 0; i < g->code->max_locals; i++)
+		fprintf(g->fp, "\tlocal[%d] = l%d;\n", i, i);
+	for (i = 0; i < sp; i++)
+		fprintf(g->fp, "\tstack[%d] = s%d;\n", i, i);
+}
+
+/* write copy of local variables and sp operand stack slots from the frame, where the collector may have moved them */
+static void
+reload(Gen *g, int sp)
+{
+	int i;
+
+	for (i = 0; i < g->code->max_locals; i++)
+		fprintf(g->fp, "\tl%d = local[%d];\n", i, i);
+	for (i = 0; i < sp; i++)
+		fprintf(g->fp, "\ts%d = stack[%d];\n", i, i);
+}
+
+/* write call of the interpreter routine of the instruction at pc, leaving the method if it returns */
+static void
+interpret(Gen *g, U4 pc, int sp)
+{
+	U4 n;
+
+	spill(g, sp);
+	fprintf(g->fp, "\tframe->pc = %lu;\n", (unsigned long)pc + 1);
+	fprintf(g->fp, "\tframe->nstack = %d;\n", sp);
+	fprintf(g->fp, "\tif ((ret = aot_runtime->handlers[%d](frame)) != NO_RETURN)\n", g->code->code[pc]);
+	fprintf(g->fp, "\t\treturn ret;\n");
+	if ((n = next(g, pc)) < g->code->code_length)
+		reload(g, depth(g, n));
+	else
+		fprintf(g->fp, "\treturn RETURN_ERROR;\n");
+}
+
+/* write safepoint before the instruction at pc, where the collector sees the frame as the interpreter leaves it */
+static void
+poll(Gen *g, U4 pc, int sp)
+{
+	fprintf(g->fp, "\tif (aot_runtime->needcollect()) {\n");
+	spill(g, sp);
+	fprintf(g->fp, "\tframe->pc = %lu;\n", (unsigned long)pc);
+	fprintf(g->fp, "\tframe->nstack = %d;\n", sp);
+	fprintf(g->fp, "\taot_runtime->safepoint();\n");
+	reload(g, sp);
+	fprintf(g->fp, "\t}\n");
+}
+
+/* write push of constant pool entry; return -1 if it is not a number */
+static int
+ldc(Gen *g, int sp, U2 index)
+{
+	int64_t l;
+	double d;
+	float f;
+	uint32_t u;
+
+	switch (g->class->constant_pool[index].tag) {
+	case CONSTANT_Integer:
+		fprintf(g->fp, "\ts%d.i = (int32_t)UINT32_C(%lu);\n", sp, (unsigned long)(uint32_t)class_getinteger(g->class, index));
+		return 0;
+	case CONSTANT_Float:
+		f = class_getfloat(g->class, index);
+		memcpy(&u, &f, sizeof u);
+		fprintf(g->fp, "\ts%d.i = (int32_t)UINT32_C(%lu);\n", sp, (unsigned long)u);
+		return 0;
+	case CONSTANT_Long:
+		l = class_getlong(g->class, index);
+		fprintf(g->fp, "\ts%d.l = (int64_t)UINT64_C(%llu);\n", sp, (unsigned long long)l);
+		return 0;
+	case CONSTANT_Double:
+		d = class_getdouble(g->class, index);
+		memcpy(&l, &d, sizeof l);
+		fprintf(g->fp, "\ts%d.l = (int64_t)UINT64_C(%llu);\n", sp, (unsigned long long)l);
+		return 0;
+	}
+	return -1;
+}
+
+/* write load or store of local variable i; long and double stores fill two variables, as in the interpreter */
+static void
+local(Gen *g, U1 op, U4 i, int sp)
+{
+	switch (op) {
+	case ILOAD: case LLOAD: case FLOAD: case DLOAD: case ALOAD:
+		fprintf(g->fp, "\ts%d = l%lu;\n", sp, (unsigned long)i);
+		break;
+	case LSTORE: case DSTORE:
+		fprintf(g->fp, "\tl%lu = l%lu = s%d;\n", (unsigned long)i + 1, (unsigned long)i, sp - 1);
+		break;
+	default:
+		fprintf(g->fp, "\tl%lu = s%d;\n", (unsigned long)i, sp - 1);
+		break;
+	}
+}
+
+/* write operation on the two top slots of member m; integers wrap around through unsigned type u */
+static void
+binary(Gen *g, int sp, char *m, char *t, char *u, char *op)
+{
+	if (u != NULL)
+		fprintf(g->fp, "\ts%d.%s = (%s)((%s)s%d.%s %s (%s)s%d.%s);\n",
+		        sp - 2, m, t, u, sp - 2, m, op, u, sp - 1, m);
+	else
+		fprintf(g->fp, "\ts%d.%s = s%d.%s %s s%d.%s;\n", sp - 2, m, sp - 2, m, op, sp - 1, m);
+}
+
+/* write shift of second slot of member m by the top one, masked by mask; logical if u is given */
+static void
+shift(Gen *g, int sp, char *m, char *t, char *u, char *op, int mask)
+{
+	if (u != NULL)
+		fprintf(g->fp, "\ts%d.%s = (%s)((%s)s%d.%s %s (s%d.i & %d));\n",
+		        sp - 2, m, t, u, sp - 2, m, op, sp - 1, mask);
+	else
+		fprintf(g->fp, "\ts%d.%s = s%d.%s %s (s%d.i & %d);\n", sp - 2, m, sp - 2, m, op, sp - 1, mask);
+}
+
+/*
+ * Write division or remainder of the two top slots of member m.  The
+ * quotient of the most negative value by -1 overflows, and division by
+ * zero is left to the interpreter.
+ */
+static void
+divide(Gen *g, U4 pc, int sp, char *m, char *t, char *u, int rem)
+{
+	fprintf(g->fp, "\tif (s%d.%s == 0) {\n", sp - 1, m);
+	interpret(g, pc, sp);
+	fprintf(g->fp, "\t} else if (s%d.%s == -1) {\n", sp - 1, m);
+	if (rem)
+		fprintf(g->fp, "\ts%d.%s = 0;\n", sp - 2, m);
+	else
+		fprintf(g->fp, "\ts%d.%s = (%s)-(%s)s%d.%s;\n", sp - 2, m, t, u, sp - 2, m);
+	fprintf(g->fp, "\t} else {\n");
+	fprintf(g->fp, "\ts%d.%s = s%d.%s %s s%d.%s;\n", sp - 2, m, sp - 2, m, rem ? "%" : "/", sp - 1, m);
+	fprintf(g->fp, "\t}\n");
+}
+
+/* write three-way comparison of the two top slots of member m: -1, 0 or 1, or nan when unordered */
+static void
+compare(Gen *g, int sp, char *m, int nan)
+{
+	fprintf(g->fp, "\ts%d.i = (s%d.%s > s%d.%s) ? 1 : (s%d.%s == s%d.%s) ? 0 : (s%d.%s < s%d.%s) ? -1 : %d;\n",
+	        sp - 2, sp - 2, m, sp - 1, m, sp - 2, m, sp - 1, m, sp - 2, m, sp - 1, m, nan);
+}
+
+/* write load of array element of C type t into member m of the second slot */
+static void
+arrayload(Gen *g, int sp, char *m, char *t)
+{
+	fprintf(g->fp, "\ts%d.%s = ARRAY_ELEM(s%d.v, %s, s%d.i);\n", sp - 2, m, sp - 2, t, sp - 1);
+}
+
+/* write store of member m of the top slot into array element of C type t */
+static void
+arraystore(Gen *g, int sp, char *m, char *t)
+{
+	fprintf(g->fp, "\tARRAY_ELEM(s%d.v, %s, s%d.i) = s%d.%s;\n", sp - 3, t, sp - 2, sp - 1, m);
+}
+
+/* write access of array element by instruction op without checks */
+static void
+arrayaccess(Gen *g, U1 op, int sp)
+{
+	switch (op) {
+	case IALOAD:
+		arrayload(g, sp, "i", "int32_t");
+		break;
+	case LALOAD:
+		arrayload(g, sp, "l", "int64_t");
+		break;
+	case FALOAD:
+		arrayload(g, sp, "f", "float");
+		break;
+	case DALOAD:
+		arrayload(g, sp, "d", "double");
+		break;
+	case BALOAD:
+		arrayload(g, sp, "i", "int8_t");
+		break;
+	case CALOAD:
+		arrayload(g, sp, "i", "U2");
+		break;
+	case SALOAD:
+		arrayload(g, sp, "i", "int16_t");
+		break;
+	case IASTORE:
+		arraystore(g, sp, "i", "int32_t");
+		break;
+	case LASTORE:
+		arraystore(g, sp, "l", "int64_t");
+		break;
+	case FASTORE:
+		arraystore(g, sp, "f", "float");
+		break;
+	case DASTORE:
+		arraystore(g, sp, "d", "double");
+		break;
+	case BASTORE:
+		/* boolean arrays keep only the low bit */
+		fprintf(g->fp, "\tARRAY_ELEM(s%d.v, int8_t, s%d.i) = (ARRAY_TYPE(s%d.v) == T_BOOLEAN) ? (s%d.i & 1) : s%d.i;\n",
+		        sp - 3, sp - 2, sp - 3, sp - 1, sp - 1);
+		break;
+	case CASTORE: case SASTORE:
+		arraystore(g, sp, "i", "U2");
+		break;
+	}
+}
+
+/*
+ * Write array access at pc, which checks first that the array is not
+ * null and the index in bounds; otherwise the interpreter routine runs
+ * and reports the error.
+ */
+static void
+checkedaccess(Gen *g, U4 pc, int sp)
+{
+	U1 op = g->code->code[pc];
+	int n;
+
+	n = (op >= IASTORE) ? 1 : 0;
+	fprintf(g->fp, "\tif (s%d.v == NULL || (uint32_t)s%d.i >= (uint32_t)ARRAY_LENGTH(s%d.v)) {\n",
+	        sp - n - 2, sp - n - 1, sp - n - 2);
+	interpret(g, pc, sp);
+	fprintf(g->fp, "\t} else {\n");
+	arrayaccess(g, op, sp);
+	fprintf(g->fp, "\t}\n");
+}
+
+/* write operand stack shuffle: pop n slots, push them in the order of perm (1 is the top) */
+static void
+shuffle(Gen *g, int sp, int n, const char *perm)
+{
+	int i;
+
+	fprintf(g->fp, "\t{\n");
+	for (i = 0; i < n; i++)
+		fprintf(g->fp, "\tValue t%d = s%d;\n", i + 1, sp - 1 - i);
+	for (i = 0; perm[i]; i++)
+		fprintf(g->fp, "\ts%d = t%c;\n", sp - n + i, perm[i]);
+	fprintf(g->fp, "\t}\n");
+}
+
+/* write switch on the top slot; return -1 if a target is out of the code */
+static int
+switchcase(Gen *g, U4 pc, int sp)
+{
+	U1 *code = g->code->code;
+	U4 p;
+	int32_t i, n, low;
+	int64_t target;
+	int backward = 0;
+
+	p = pc + 1 + (3 - pc % 4);
+	if (code[pc] == TABLESWITCH) {
+		low = class_get32(&code[p + 4]);
+		n = class_get32(&code[p + 8]) - low + 1;
+	} else {
+		low = 0;
+		n = class_get32(&code[p + 4]);
+	}
+	for (i = -1; i < n; i++) {
+		if (i < 0)
+			target = (int64_t)pc + class_get32(&code[p]);
+		else if (code[pc] == TABLESWITCH)
+			target = (int64_t)pc + class_get32(&code[p + 12 + 4 * i]);
+		else
+			target = (int64_t)pc + class_get32(&code[p + 12 + 8 * i]);
+		if (target < 0 || target >= g->code->code_length)
+			return -1;
+		if (target <= pc) {
+			backward = 1;
+		}
+	}
+	if (backward)
+		poll(g, pc, sp);
+	fprintf(g->fp, "\tswitch (s%d.i) {\n", sp - 1);
+	for (i = 0; i < n; i++) {
+		if (code[pc] == TABLESWITCH)
+			fprintf(g->fp, "\tcase %ld: goto L%ld;\n", (long)low + i,
+			        (long)pc + class_get32(&code[p + 12 + 4 * i]));
+		else
+			fprintf(g->fp, "\tcase %ld: goto L%ld;\n", (long)class_get32(&code[p + 8 + 8 * i]),
+			        (long)pc + class_get32(&code[p + 12 + 8 * i]));
+	}
+	fprintf(g->fp, "\tdefault: goto L%ld;\n", (long)pc + class_get32(&code[p]));
+	fprintf(g->fp, "\t}\n");
+	return 0;
+}
+
+/* write branch at pc to target */
+static void
+branch(Gen *g, U4 pc, int sp, U4 target)
+{
+	U1 op = g->code->code[pc];
+
+	if (target <= pc)
+		poll(g, pc, sp);
+	if (op >= IFEQ && op <= IFLE)
+		fprintf(g->fp, "\tif (s%d.i %s 0)\n\t", sp - 1, ifop[op - IFEQ]);
+	else if (op >= IF_ICMPEQ && op <= IF_ICMPLE)
+		fprintf(g->fp, "\tif (s%d.i %s s%d.i)\n\t", sp - 2, ifop[op - IF_ICMPEQ], sp - 1);
+	else if (op == IF_ACMPEQ || op == IF_ACMPNE)
+		fprintf(g->fp, "\tif (s%d.v %s s%d.v)\n\t", sp - 2, (op == IF_ACMPEQ) ? "==" : "!=", sp - 1);
+	else if (op == IFNULL || op == IFNONNULL)
+		fprintf(g->fp, "\tif (s%d.v %s NULL)\n\t", sp - 1, (op == IFNULL) ? "==" : "!=");
+	fprintf(g->fp, "\tgoto L%lu;\n", (unsigned long)target);
+}
+
+/* get target of branch at pc, or -1 if it is not a branch or its target is out of the code */
+static int64_t
+target(Code_attribute *code, U4 pc)
+{
+	U1 op = code->code[pc];
+	int64_t t;
+
+	if ((op >= IFEQ && op <= IF_ACMPNE) || op == GOTO || op == IFNULL || op == IFNONNULL)
+		t = (int64_t)pc + class_get16(&code->code[pc + 1]);
+	else if (op == GOTO_W)
+		t = (int64_t)pc + class_get32(&code->code[pc + 1]);
+	else
+		return -1;
+	if (t < 0 || t >= code->code_length)
+		return -1;
+	return t;
+}
+
+/* mark targets of branches and switches, and loop heads among them; return -1 if the method cannot be compiled */
+static int
+marklabels(Gen *g)
+{
+	U1 *code = g->code->code;
+	U4 pc, p;
+	int64_t t;
+	int32_t i, n;
+
+	g->label[0] = g->entry[0] = 1;
+	for (pc = 0; pc < g->code->code_length; pc++) {
+		if (depth(g, pc) == -1)
+			continue;
+		switch (code[pc]) {
+		case JSR: case JSR_W: case RET: case ATHROW:
+			return -1;
+		case WIDE:
+			if (code[pc + 1] == RET)
+				return -1;
+			break;
+		case TABLESWITCH: case LOOKUPSWITCH:
+			p = pc + 1 + (3 - pc % 4);
+			n = (code[pc] == TABLESWITCH) ? class_get32(&code[p + 8]) - class_get32(&code[p + 4]) + 1 : class_get32(&code[p + 4]);
+			for (i = -1; i < n; i++) {
+				if (i < 0)
+					t = (int64_t)pc + class_get32(&code[p]);
+				else if (code[pc] == TABLESWITCH)
+					t = (int64_t)pc + class_get32(&code[p + 12 + 4 * i]);
+				else
+					t = (int64_t)pc + class_get32(&code[p + 12 + 8 * i]);
+				if (t < 0 || t >= g->code->code_length)
+					return -1;
+				g->label[t] = 1;
+			}
+			break;
+		default:
+			if ((t = target(g->code, pc)) != -1) {
+				g->label[t] = 1;
+				if (t <= pc) {
+					g->entry[t] = 1;
+				}
+			} else if (code[pc] >= IFEQ && (code[pc] <= GOTO || code[pc] == IFNULL ||
+			           code[pc] == IFNONNULL || code[pc] == GOTO_W)) {
+				return -1;
+			}
+			break;
+		}
+	}
+	return 0;
+}
+
+/* write code of instruction at pc, which starts with sp operand stack slots; return -1 if it is not supported */
+static int
+instruction(Gen *g, U4 pc, int sp)
+{
+	U1 *code = g->code->code;
+	U1 op = code[pc];
+
+	switch (op) {
+	case NOP:
+		break;
+	case ACONST_NULL:
+		fprintf(g->fp, "\ts%d.v = NULL;\n", sp);
+		break;
+	case ICONST_M1: case ICONST_0: case ICONST_1: case ICONST_2:
+	case ICONST_3: case ICONST_4: case ICONST_5:
+		fprintf(g->fp, "\ts%d.i = %d;\n", sp, op - ICONST_0);
+		break;
+	case LCONST_0: case LCONST_1:
+		fprintf(g->fp, "\ts%d.l = %d;\n", sp, op - LCONST_0);
+		break;
+	case FCONST_0: case FCONST_1: case FCONST_2:
+		fprintf(g->fp, "\ts%d.f = %d.0f;\n", sp, op - FCONST_0);
+		break;
+	case DCONST_0: case DCONST_1:
+		fprintf(g->fp, "\ts%d.d = %d.0;\n", sp, op - DCONST_0);
+		break;
+	case BIPUSH:
+		fprintf(g->fp, "\ts%d.i = %d;\n", sp, (int8_t)code[pc + 1]);
+		break;
+	case SIPUSH:
+		fprintf(g->fp, "\ts%d.i = %ld;\n", sp, (long)class_get16(&code[pc + 1]));
+		break;
+	case LDC:
+		if (ldc(g, sp, code[pc + 1]) == -1)
+			interpret(g, pc, sp);
+		break;
+	case LDC_W: case LDC2_W:
+		if (ldc(g, sp, class_get16(&code[pc + 1]) & 0xFFFF) == -1)
+			interpret(g, pc, sp);
+		break;
+	case ILOAD: case LLOAD: case FLOAD: case DLOAD: case ALOAD:
+	case ISTORE: case LSTORE: case FSTORE: case DSTORE: case ASTORE:
+		local(g, op, code[pc + 1], sp);
+		break;
+	case ILOAD_0: case ILOAD_1: case ILOAD_2: case ILOAD_3:
+	case LLOAD_0: case LLOAD_1: case LLOAD_2: case LLOAD_3:
+	case FLOAD_0: case FLOAD_1: case FLOAD_2: case FLOAD_3:
+	case DLOAD_0: case DLOAD_1: case DLOAD_2: case DLOAD_3:
+	case ALOAD_0: case ALOAD_1: case ALOAD_2: case ALOAD_3:
+		local(g, ILOAD + (op - ILOAD_0) / 4, (op - ILOAD_0) % 4, sp);
+		break;
+	case ISTORE_0: case ISTORE_1: case ISTORE_2: case ISTORE_3:
+	case LSTORE_0: case LSTORE_1: case LSTORE_2: case LSTORE_3:
+	case FSTORE_0: case FSTORE_1: case FSTORE_2: case FSTORE_3:
+	case DSTORE_0: case DSTORE_1: case DSTORE_2: case DSTORE_3:
+	case ASTORE_0: case ASTORE_1: case ASTORE_2: case ASTORE_3:
+		local(g, ISTORE + (op - ISTORE_0) / 4, (op - ISTORE_0) % 4, sp);
+		break;
+	case IINC:
+		fprintf(g->fp, "\tl%d.i = (int32_t)((uint32_t)l%d.i + %d);\n",
+		        code[pc + 1], code[pc + 1], (int8_t)code[pc + 2]);
+		break;
+	case WIDE:
+		if (code[pc + 1] == IINC)
+			fprintf(g->fp, "\tl%ld.i = (int32_t)((uint32_t)l%ld.i + %ld);\n",
+			        (long)class_get16(&code[pc + 2]) & 0xFFFF, (long)class_get16(&code[pc + 2]) & 0xFFFF,
+			        (long)class_get16(&code[pc + 4]));
+		else
+			local(g, code[pc + 1], class_get16(&code[pc + 2]) & 0xFFFF, sp);
+		break;
+	case IALOAD: case LALOAD: case FALOAD: case DALOAD: case BALOAD: case CALOAD: case SALOAD:
+	case IASTORE: case LASTORE: case FASTORE: case DASTORE: case BASTORE: case CASTORE: case SASTORE:
+		checkedaccess(g, pc, sp);
+		break;
+	case IALOAD_QUICK: case LALOAD_QUICK: case FALOAD_QUICK: case DALOAD_QUICK:
+	case BALOAD_QUICK: case CALOAD_QUICK: case SALOAD_QUICK:
+	case IASTORE_QUICK: case LASTORE_QUICK: case FASTORE_QUICK: case DASTORE_QUICK:
+	case BASTORE_QUICK: case CASTORE_QUICK: case SASTORE_QUICK:
+		arrayaccess(g, class_getchecked(op), sp);
+		break;
+	case ARRAYLENGTH:
+		fprintf(g->fp, "\ts%d.i = ARRAY_LENGTH(s%d.v);\n", sp - 1, sp - 1);
+		break;
+	case POP: case POP2:
+		break;
+	case DUP:
+		shuffle(g, sp, 1, "11");
+		break;
+	case DUP_X1:
+		shuffle(g, sp, 2, "121");
+		break;
+	case DUP_X2:
+		shuffle(g, sp, 3, "1321");
+		break;
+	case DUP2:
+		shuffle(g, sp, 2, "2121");
+		break;
+	case DUP2_X1:
+		shuffle(g, sp, 3, "21321");
+		break;
+	case DUP2_X2:
+		shuffle(g, sp, 4, "214321");
+		break;
+	case SWAP:
+		shuffle(g, sp, 2, "12");
+		break;
+	case IADD: case ISUB: case IMUL: case IAND: case IOR: case IXOR:
+		binary(g, sp, "i", "int32_t", "uint32_t",
+		       (op == IADD) ? "+" : (op == ISUB) ? "-" : (op == IMUL) ? "*" : (op == IAND) ? "&" : (op == IOR) ? "|" : "^");
+		break;
+	case LADD: case LSUB: case LMUL: case LAND: case LOR: case LXOR:
+		binary(g, sp, "l", "int64_t", "uint64_t",
+		       (op == LADD) ? "+" : (op == LSUB) ? "-" : (op == LMUL) ? "*" : (op == LAND) ? "&" : (op == LOR) ? "|" : "^");
+		break;
+	case FADD: case FSUB: case FMUL: case FDIV:
+		binary(g, sp, "f", NULL, NULL, (op == FADD) ? "+" : (op == FSUB) ? "-" : (op == FMUL) ? "*" : "/");
+		break;
+	case DADD: case DSUB: case DMUL: case DDIV:
+		binary(g, sp, "d", NULL, NULL, (op == DADD) ? "+" : (op == DSUB) ? "-" : (op == DMUL) ? "*" : "/");
+		break;
+	case IDIV: case IREM:
+		divide(g, pc, sp, "i", "int32_t", "uint32_t", op == IREM);
+		break;
+	case LDIV: case LREM:
+		divide(g, pc, sp, "l", "int64_t", "uint64_t", op == LREM);
+		break;
+	case FREM:
+		fprintf(g->fp, "\ts%d.f = fmodf(s%d.f, s%d.f);\n", sp - 2, sp - 2, sp - 1);
+		break;
+	case DREM:
+		fprintf(g->fp, "\ts%d.d = fmod(s%d.d, s%d.d);\n", sp - 2, sp - 2, sp - 1);
+		break;
+	case INEG:
+		fprintf(g->fp, "\ts%d.i = (int32_t)-(uint32_t)s%d.i;\n", sp - 1, sp - 1);
+		break;
+	case LNEG:
+		fprintf(g->fp, "\ts%d.l = (int64_t)-(uint64_t)s%d.l;\n", sp - 1, sp - 1);
+		break;
+	case FNEG:
+		fprintf(g->fp, "\ts%d.f = -s%d.f;\n", sp - 1, sp - 1);
+		break;
+	case DNEG:
+		fprintf(g->fp, "\ts%d.d = -s%d.d;\n", sp - 1, sp - 1);
+		break;
+	case ISHL:
+		shift(g, sp, "i", "int32_t", "uint32_t", "<<", 31);
+		break;
+	case ISHR:
+		shift(g, sp, "i", NULL, NULL, ">>", 31);
+		break;
+	case IUSHR:
+		shift(g, sp, "i", "int32_t", "uint32_t", ">>", 31);
+		break;
+	case LSHL:
+		shift(g, sp, "l", "int64_t", "uint64_t", "<<", 63);
+		break;
+	case LSHR:
+		shift(g, sp, "l", NULL, NULL, ">>", 63);
+		break;
+	case LUSHR:
+		shift(g, sp, "l", "int64_t", "uint64_t", ">>", 63);
+		break;
+	case I2L:
+		fprintf(g->fp, "\ts%d.l = s%d.i;\n", sp - 1, sp - 1);
+		break;
+	case I2F:
+		fprintf(g->fp, "\ts%d.f = (float)s%d.i;\n", sp - 1, sp - 1);
+		break;
+	case I2D:
+		fprintf(g->fp, "\ts%d.d = s%d.i;\n", sp - 1, sp - 1);
+		break;
+	case L2I:
+		fprintf(g->fp, "\ts%d.i = (int32_t)s%d.l;\n", sp - 1, sp - 1);
+		break;
+	case L2F:
+		fprintf(g->fp, "\ts%d.f = (float)s%d.l;\n", sp - 1, sp - 1);
+		break;
+	case L2D:
+		fprintf(g->fp, "\ts%d.d = (double)s%d.l;\n", sp - 1, sp - 1);
+		break;
+	case F2I:
+		fprintf(g->fp, "\ts%d.i = f2i(s%d.f);\n", sp - 1, sp - 1);
+		break;
+	case F2L:
+		fprintf(g->fp, "\ts%d.l = f2l(s%d.f);\n", sp - 1, sp - 1);
+		break;
+	case F2D:
+		fprintf(g->fp, "\ts%d.d = s%d.f;\n", sp - 1, sp - 1);
+		break;
+	case D2I:
+		fprintf(g->fp, "\ts%d.i = d2i(s%d.d);\n", sp - 1, sp - 1);
+		break;
+	case D2L:
+		fprintf(g->fp, "\ts%d.l = d2l(s%d.d);\n", sp - 1, sp - 1);
+		break;
+	case D2F:
+		fprintf(g->fp, "\ts%d.f = (float)s%d.d;\n", sp - 1, sp - 1);
+		break;
+	case I2B:
+		fprintf(g->fp, "\ts%d.i = (int8_t)s%d.i;\n", sp - 1, sp - 1);
+		break;
+	case I2C:
+		fprintf(g->fp, "\ts%d.i = (U2)s%d.i;\n", sp - 1, sp - 1);
+		break;
+	case I2S:
+		fprintf(g->fp, "\ts%d.i = (int16_t)s%d.i;\n", sp - 1, sp - 1);
+		break;
+	case LCMP:
+		compare(g, sp, "l", 0);
+		break;
+	case FCMPL: case FCMPG:
+		compare(g, sp, "f", (op == FCMPL) ? -1 : 1);
+		break;
+	case DCMPL: case DCMPG:
+		compare(g, sp, "d", (op == DCMPL) ? -1 : 1);
+		break;
+	case IFEQ: case IFNE: case IFLT: case IFGE: case IFGT: case IFLE:
+	case IF_ICMPEQ: case IF_ICMPNE: case IF_ICMPLT: case IF_ICMPGE: case IF_ICMPGT: case IF_ICMPLE:
+	case IF_ACMPEQ: case IF_ACMPNE: case IFNULL: case IFNONNULL: case GOTO: case GOTO_W:
+		branch(g, pc, sp, target(g->code, pc));
+		break;
+	case TABLESWITCH: case LOOKUPSWITCH:
+		return switchcase(g, pc, sp);
+	case IRETURN: case LRETURN: case FRETURN: case DRETURN: case ARETURN:
+		fprintf(g->fp, "\tstack[%d] = s%d;\n", sp - 1, sp - 1);
+		fprintf(g->fp, "\tframe->nstack = %d;\n", sp);
+		fprintf(g->fp, "\treturn RETURN_OPERAND;\n");
+		break;
+	case RETURN:
+		fprintf(g->fp, "\tframe->nstack = %d;\n", sp);
+		fprintf(g->fp, "\treturn RETURN_VOID;\n");
+		break;
+	default:
+		interpret(g, pc, sp);
+		break;
+	}
+	return 0;
+}
+
+/* check if code in buf uses variable named by letter c and number i */
+static int
+uses(char *buf, int c, int i)
+{
+	char name[16];
+	char *p;
+	size_t len;
+
+	len = snprintf(name, sizeof name, "%c%d", c, i);
+	for (p = buf; (p = strstr(p, name)) != NULL; p++)
+		if ((p == buf || !(isalnum((unsigned char)p[-1]) || p[-1] == '_')) && !isdigit((unsigned char)p[len]))
+			return 1;
+	return 0;
+}
+
+/*
+ * Translate method into a C function named m followed by number n.
+ * Local variables and operand stack slots become variables of the
+ * function, which are copied into the frame only where the interpreter
+ * routine of an instruction is called or the collector may run, and
+ * copied back afterwards.  The function starts at the pc of the frame:
+ * 0 for a new frame, or a loop head for a frame handed over by the
+ * interpreter.  Return -1 if the method cannot be translated.
+ */
+static int
+translate(FILE *fp, ClassFile *class, Method *method, int n)
+{
+	Attribute *cattr;
+	Gen g;
+	char *buf = NULL;
+	size_t len = 0;
+	U4 pc;
+	int i, sp, error = 0;
+
+	if ((cattr = class_getattr(method->attributes, method->attributes_count, Code)) == NULL)
+		return -1;
+	g.class = class;
+	g.code = &cattr->info.code;
+	if (g.code->code_length == 0 || depth(&g, 0) == -1)
+		return -1;
+	g.label = ecalloc(g.code->code_length, 1);
+	g.entry = ecalloc(g.code->code_length, 1);
+	if (marklabels(&g) == -1) {
+		free(g.label);
+		free(g.entry);
+		return -1;
+	}
+	if ((g.fp = open_memstream(&buf, &len)) == NULL)
+		err(EXIT_FAILURE, "open_memstream");
+	fprintf(g.fp, "\tswitch (frame->pc) {\n");
+	for (pc = 0; pc < g.code->code_length; pc++) {
+		if (!g.entry[pc])
+			continue;
+		fprintf(g.fp, "\tcase %lu:\n", (unsigned long)pc);
+		for (i = 0; i < depth(&g, pc); i++)
+			fprintf(g.fp, "\t\ts%d = stack[%d];\n", i, i);
+		fprintf(g.fp, "\t\tgoto L%lu;\n", (unsigned long)pc);
+	}
+	fprintf(g.fp, "\t}\n\treturn RETURN_ERROR;\n");
+	for (pc = 0; !error && pc < g.code->code_length; pc++) {
+		if ((sp = depth(&g, pc)) == -1)
+			continue;
+		if (g.label[pc])
+			fprintf(g.fp, "L%lu: ;\n", (unsigned long)pc);
+		if (instruction(&g, pc, sp) == -1) {
+			error = 1;
+		}
+	}
+	fclose(g.fp);
+	if (!error) {
+		fprintf(fp, "\n/* %s.%s%s */\n", class_getclassname(class, class->this_class),
+		        class_getutf8(class, method->name_index), class_getutf8(class, method->descriptor_index));
+		fprintf(fp, "static int\nm%d(Frame *frame)\n{\n", n);
+		fprintf(fp, "\tValue *local = frame->local;\n");
+		if (strstr(buf, "stack[") != NULL)
+			fprintf(fp, "\tValue *stack = frame->stack;\n");
+		for (i = 0; i < g.code->max_locals; i++)
+			if (uses(buf, 'l', i))
+				fprintf(fp, "\tValue l%d = local[%d];\n", i, i);
+		for (i = 0; i < g.code->max_stack; i++)
+			if (uses(buf, 's', i))
+				fprintf(fp, "\tValue s%d;\n", i);
+		if (strstr(buf, "ret = ") != NULL)
+			fprintf(fp, "\tint ret;\n");
+		fprintf(fp, "\n\t(void)local;\n");
+		fwrite(buf, 1, len, fp);
+		fprintf(fp, "}\n");
+	}
+	free(buf);
+	free(g.label);
+	free(g.entry);
+	return error ? -1 : 0;
+}
+
+/* write string as a C string literal */
+static void
+putstring(FILE *fp, char *s)
+{
+	putc('"', fp);
+	for (; *s != '\0'; s++) {
+		if (*s == '"' || *s == '\\' || *s == '?' || *s < ' ' || *s > '~')
+			fprintf(fp, "\\%03o", (unsigned char)*s);
+		else
+			putc(*s, fp);
+	}
+	putc('"', fp);
+}
+
+/* jaotc: compile methods of class files into C code of a library loaded by java -XX:AOTLibrary= */
+int
+main(int argc, char *argv[])
+{
+	ClassFile *classes, *class;
+	Code_attribute *code;
+	FILE *fp, *out = stdout, *table;
+	char *buf = NULL;
+	size_t len = 0;
+	int exitval = EXIT_SUCCESS;
+	int status, ch, i, n = 0;
+	U2 m;
+
+	setprogname(argv[0]);
+	while ((ch = getopt(argc, argv, "")) != -1)
+		usage();
+	argc -= optind;
+	argv += optind;
+	if (argc == 0)
+		usage();
+	if ((table = open_memstream(&buf, &len)) == NULL)
+		err(EXIT_FAILURE, "open_memstream");
+	fputs(prologue, out);
+	classes = ecalloc(argc, sizeof *classes);
+	for (i = 0; i < argc; i++) {
+		class = &classes[i];
+		if ((fp = fopen(argv[i], "rb")) == NULL) {
+			warn("%s", argv[i]);
+			exitval = EXIT_FAILURE;
+			continue;
+		}
+		if ((status = file_read(fp, class)) != 0) {
+			warnx("%s: %s", argv[i], file_errstr(status));
+			exitval = EXIT_FAILURE;
+			fclose(fp);
+			continue;
+		}
+		fclose(fp);
+		opt_class(class);
+		for (m = 0; m < class->methods_count; m++) {
+			if (translate(out, class, &class->methods[m], n) == -1)
+				continue;
+			code = &class_getattr(class->methods[m].attributes, class->methods[m].attributes_count,
+			                      Code)->info.code;
+			fprintf(table, "\t{");
+			putstring(table, class_getclassname(class, class->this_class));
+			fprintf(table, ", ");
+			putstring(table, class_getutf8(class, class->methods[m].name_index));
+			fprintf(table, ", ");
+			putstring(table, class_getutf8(class, class->methods[m].descriptor_index));
+			fprintf(table, ", %luu, m%d},\n", (unsigned long)aot_checksum(code), n);
+			n++;
+		}
+		file_free(class);
+	}
+	fclose(table);
+	fprintf(out, "\nAotMethod aot_methods[] = {\n");
+	fwrite(buf, 1, len, out);
+	fprintf(out, "\t{NULL, NULL, NULL, 0, NULL},\n};\n");
+	free(buf);
+	free(classes);
+	if (fflush(out) == EOF)
+		err(EXIT_FAILURE, "stdout");
+	return exitval;
+}
@@ -11,8 +11,18 @@
 #include "util.h"
 #include "class.h"
 #include "file.h"
+#include "frame.h"
 #include "memory.h"
 #include "native.h"
+#include "output.h"
+#include "concat.h"
+#include "refmap.h"
+#include "trace.h"
+#include "jit.h"
+#include "aot.h"
+#include "opt.h"
+#include "gc.h"
+#include "perf.h"
 
 /* path separator */
 #ifdef _WIN32
@@ -21,23 +31,40 @@
 #define PATHSEP ':'
 #endif
 
-enum {
-	NO_RETURN = 0,
-	RETURN_VOID = 1,
-	RETURN_OPERAND = 2,
-	RETURN_ERROR = 3
-};
-
 int methodcall(ClassFile *class, Frame *frame, char *name, char *descr, U2 flags);
+static Value resolveconstant(ClassFile *class, U2 index);
 
 static char **classpath = NULL;         /* NULL-terminated array of path strings */
 static ClassFile *classes = NULL;       /* list of loaded classes */
+static Native nonative;                 /* bound to call sites of non-native methods */
+static FlushMode flushmode = FLUSH_LINE;
+static size_t outputbufsize = OUTPUT_BUFSIZE;
+static size_t maxheapsize = HEAP_MAXSIZE;
+static size_t tlabsize = HEAP_TLABSIZE;
+static size_t initheapsize = HEAP_INITSIZE;
+static size_t newsize = HEAP_NEWSIZE;
+static long tenure = HEAP_TENURE;
+static long gcthreads = 0;
+static size_t largesize = HEAP_LARGESIZE;
+static int compressedoops = 0;
+static long compilethreshold = JIT_THRESHOLD;
+static long backedgethreshold = JIT_BACKEDGES;
+static int usejit = 1;
+static int usetraces = 1;
+static int optimizebytecode = 1;
+static long maxinlinesize = OPT_INLINESIZE;
+static long maxinlinelevel = OPT_INLINELEVEL;
+static char *aotlibrary = NULL;
+static AotRuntime aotruntime;
+static int gclog = 0;
+static int perfmap = 0;
+static int perfjitdump = 0;
 
 /* show usage */
 static void
 usage(void)
 {
-	(void)fprintf(stderr, "usage: java [-cp classpath] class\n");
+	(void)fprintf(stderr, "usage: java [-cp classpath] [-Xint] [-Xlog:gc] [-XX:[+-]option] [-XX:option=value] class\n");
 	exit(EXIT_FAILURE);
 }
 
@@ -76,6 +103,126 @@ setclasspath(char *cpath)
 	}
 }
 
+/* parse size with optional k, m or g suffix; return 0 on error */
+static size_t
+getsize(char *s)
+{
+	unsigned long long n;
+	char *ep;
+
+	n = strtoull(s, &ep, 10);
+	switch (*ep) {
+	case 'g': case 'G':
+		n *= 1024;
+		/* FALLTHROUGH */
+	case 'm': case 'M':
+		n *= 1024;
+		/* FALLTHROUGH */
+	case 'k': case 'K':
+		n *= 1024;
+		ep++;
+		break;
+	}
+	if (ep == s || *ep != '\0')
+		return 0;
+	return n;
+}
+
+/* set virtual machine option given as name=value, +name or -name; return -1 on error */
+static int
+setoption(char *opt)
+{
+	char *val;
+
+	if (opt[0] == '+' || opt[0] == '-') {
+		if (strcmp(opt + 1, "UseCompressedOops") == 0)
+			compressedoops = (opt[0] == '+');
+		else if (strcmp(opt + 1, "OptimizeBytecode") == 0)
+			optimizebytecode = (opt[0] == '+');
+		else if (strcmp(opt + 1, "UseLoopTraces") == 0)
+			usetraces = (opt[0] == '+');
+		else if (strcmp(opt + 1, "PerfMap") == 0)
+			perfmap = (opt[0] == '+');
+		else if (strcmp(opt + 1, "PerfJitDump") == 0)
+			perfjitdump = (opt[0] == '+');
+		else
+			return -1;
+		return 0;
+	}
+	if ((val = strchr(opt, '=')) == NULL)
+		return -1;
+	*val++ = '\0';
+	if (strcmp(opt, "OutputFlush") == 0) {
+		if (strcmp(val, "line") == 0)
+			flushmode = FLUSH_LINE;
+		else if (strcmp(val, "size") == 0)
+			flushmode = FLUSH_SIZE;
+		else if (strcmp(val, "exit") == 0)
+			flushmode = FLUSH_EXIT;
+		else
+			return -1;
+	} else if (strcmp(opt, "OutputBufferSize") == 0) {
+		if ((outputbufsize = getsize(val)) == 0) {
+			return -1;
+		}
+	} else if (strcmp(opt, "MaxHeapSize") == 0) {
+		if ((maxheapsize = getsize(val)) == 0) {
+			return -1;
+		}
+	} else if (strcmp(opt, "InitialHeapSize") == 0) {
+		if ((initheapsize = getsize(val)) == 0) {
+			return -1;
+		}
+	} else if (strcmp(opt, "NewSize") == 0) {
+		if ((newsize = getsize(val)) == 0) {
+			return -1;
+		}
+	} else if (strcmp(opt, "MaxTenuringThreshold") == 0) {
+		tenure = strtol(val, &val, 10);
+		if (*val != '\0' || tenure < 0 || tenure > HEAP_MAXTENURE) {
+			return -1;
+		}
+	} else if (strcmp(opt, "ParallelGCThreads") == 0) {
+		gcthreads = strtol(val, &val, 10);
+		if (*val != '\0' || gcthreads < 1 || gcthreads > GC_MAXTHREADS) {
+			return -1;
+		}
+	} else if (strcmp(opt, "LargeArraySize") == 0) {
+		if ((largesize = getsize(val)) == 0) {
+			return -1;
+		}
+	} else if (strcmp(opt, "CompileThreshold") == 0) {
+		compilethreshold = strtol(val, &val, 10);
+		if (*val != '\0' || compilethreshold < 1) {
+			return -1;
+		}
+	} else if (strcmp(opt, "AOTLibrary") == 0) {
+		aotlibrary = val;
+	} else if (strcmp(opt, "BackEdgeThreshold") == 0) {
+		backedgethreshold = strtol(val, &val, 10);
+		if (*val != '\0' || backedgethreshold < 1) {
+			return -1;
+		}
+	} else if (strcmp(opt, "MaxInlineSize") == 0) {
+		maxinlinesize = strtol(val, &val, 10);
+		if (*val != '\0' || maxinlinesize < 0) {
+			return -1;
+		}
+	} else if (strcmp(opt, "MaxInlineLevel") == 0) {
+		maxinlinelevel = strtol(val, &val, 10);
+		if (*val != '\0' || maxinlinelevel < 0) {
+			return -1;
+		}
+	} else if (strcmp(opt, "TLABSize") == 0) {
+		if ((tlabsize = getsize(val)) == 0) {
+			return -1;
+		}
+	} else {
+		return -1;
+	}
+	return 0;
+}
+
 /* free all the classes in the list of loaded classes */
 static void
 classfree(void)
@@ -85,6 +232,7 @@ classfree(void)
 	while (classes) {
 		tmp = classes;
 		classes = classes->next;
+		free(tmp->cache);
 		file_free(tmp);
 		free(tmp);
 	}
@@ -145,6 +293,11 @@ classload(char *classname)
 			}
 		}
 	}
+	if (optimizebytecode)
+		opt_class(class);
+	/* after the optimizer, which may add entries to the constant pool */
+	class->cache = ecalloc(class->constant_pool_count, sizeof *class->cache);
+	aot_bind(class);
 	return class;
 }
 
@@ -154,11 +307,24 @@ classinit(ClassFile *class)
 {
 	Method *method;
 
+	Attribute *attr;
+	Field *field;
+	U2 i;
+
 	if (class->init)
 		return;
 	class->init = 1;
 	if (class->super)
 		classinit(class->super);
+	for (i = 0; i < class->fields_count; i++) {
+		field = &class->fields[i];
+		if (!(field->access_flags & ACC_STATIC))
+			continue;
+		attr = class_getattr(field->attributes, field->attributes_count, ConstantValue);
+		if (attr != NULL) {
+			field->value = resolveconstant(class, attr->info.constantvalue.constantvalue_index);
+		}
+	}
 	if ((method = class_getmethod(class, "<clinit>", "()V")) != NULL)
 	(void)methodcall(class, NULL, "<clinit>", "()V", (class->major_version >= 51 ? ACC_STATIC : ACC_NONE));
 }
@@ -168,7 +334,7 @@ static Value
 resolveconstant(ClassFile *class, U2 index)
 {
 	Value v;
-	char *s;
+	Heap *h;
 
 	v.i = 0;
 	switch (class->constant_pool[index].tag) {
@@ -185,68 +351,132 @@ resolveconstant(ClassFile *class, U2 index)
 		v.d = class_getdouble(class, index);
 		break;
 	case CONSTANT_String:
-		s = class_getstring(class, index);
-		v.v = heap_alloc(1, sizeof (char *));
-		v.v->obj = s;
+		if (class->cache[index] == NULL) {
+			if ((h = string_fromutf8(class_getstring(class, index))) == NULL ||
+			    (h = string_intern(h)) == NULL)
+				errx(EXIT_FAILURE, "out of memory");
+			class->cache[index] = h;
+		}
+		v.v = class->cache[index];
 		break;
 	}
 	return v;
 }
 
-/* resolve field reference */
-static Value
+/* resolve field reference to the storage of a static field */
+static Value *
 resolvefield(ClassFile *class, CONSTANT_Fieldref_info *fieldref)
 {
-	Value v;
 	enum JavaClass jclass;
+	ClassFile *fclass;
+	Field *field;
+	Value *p;
 	char *classname, *name, *type;
 
-	v.v = NULL;
 	classname = class_getclassname(class, fieldref->class_index);
 	class_getnameandtype(class, fieldref->name_and_type_index, &name, &type);
 	if ((jclass = native_javaclass(classname)) != 0) {
-		v.v = heap_alloc(1, sizeof (void *));
-		v.v->obj = native_javaobj(jclass, name, type);
-	} else {
-		// TODO
+		p = emalloc(sizeof *p);
+		if ((p->v = heap_alloc(K_NATIVE, sizeof (void *))) == NULL)
+			errx(EXIT_FAILURE, "out of memory");
+		NATIVE_OBJ(p->v) = native_javaobj(jclass, name, type);
+		return p;
 	}
-	if (v.v == NULL)
-		errx(EXIT_FAILURE, "could not resolve field");
-	return v;
+	if ((fclass = classload(classname)) == NULL)
+		errx(EXIT_FAILURE, "could not load class %s", classname);
+	classinit(fclass);
+	for (; fclass; fclass = fclass->super)
+		if ((field = class_getfield(fclass, name, type)) != NULL && (field->access_flags & ACC_STATIC))
+			return &field->value;
+	errx(EXIT_FAILURE, "could not resolve field %s", name);
+	return NULL;
 }
 
-/* aaload: load reference from array */
+/* resolve method reference to native method; bind call site to it on first use */
+static Native *
+resolvenative(ClassFile *class, U2 index)
+{
+	CONSTANT_Methodref_info *methodref;
+	Native *native;
+	char *classname, *name, *type;
+
+	if ((native = class->cache[index]) == NULL) {
+		methodref = &class->constant_pool[index].info.methodref_info;
+		classname = class_getclassname(class, methodref->class_index);
+		class_getnameandtype(class, methodref->name_and_type_index, &name, &type);
+		if ((native = native_getmethod(classname, name, type)) == NULL) {
+			if (native_javaclass(classname) != NONE_CLASS)
+				errx(EXIT_FAILURE, "could not find native method %s.%s%s", classname, name, type);
+			native = &nonative;
+		}
+		class->cache[index] = native;
+	}
+	return (native != &nonative) ? native : NULL;
+}
+
+/*
+ * Check the array and the index n slots below the top of the operand
+ * stack of an array access.  Exceptions are not thrown yet, so a bad one
+ * ends the program as the uncaught exception would.
+ */
+static void
+checkindex(Frame *frame, size_t n)
+{
+	Heap *array;
+	int32_t i;
+
+	array = frame->stack[frame->nstack - n - 2].v;
+	i = frame->stack[frame->nstack - n - 1].i;
+	if (array == NULL)
+		errx(EXIT_FAILURE, "java.lang.NullPointerException");
+	if (i < 0 || i >= ARRAY_LENGTH(array))
+		errx(EXIT_FAILURE, "java.lang.ArrayIndexOutOfBoundsException: Index %ld out of bounds for length %ld",
+		     (long)i, (long)ARRAY_LENGTH(array));
+}
+
+/* aaload_quick: load reference from array at an index in bounds */
 static int
-opaaload(Frame *frame)
+opaaload_quick(Frame *frame)
 {
 	Value va, vi, v;
 
 	vi = frame_stackpop(frame);
 	va = frame_stackpop(frame);
-	v.v = ((void **)va.v->obj)[vi.i];
+	v.v = ARRAY_GETREF(va.v, vi.i);
 	frame_stackpush(frame, v);
 	return NO_RETURN;
 }
 
-/* aastore: store into reference array */
+/* aaload: load reference from array */
 static int
-opaastore(Frame *frame)
+opaaload(Frame *frame)
+{
+	checkindex(frame, 0);
+	return opaaload_quick(frame);
+}
+
+/* aastore_quick: store into reference array at an index in bounds */
+static int
+opaastore_quick(Frame *frame)
 {
 	Value va, vi, vv;
 
 	vv = frame_stackpop(frame);
 	vi = frame_stackpop(frame);
 	va = frame_stackpop(frame);
-	if (va.v->obj == NULL) {
-		// TODO: throw NullPointerException
-	}
-	if (vi.i < 0 || vi.i >= va.v->nmemb) {
-		// TODO: throw ArrayIndexOutOfBoundsException
-	}
-	((void **)va.v->obj)[vi.i] = vv.v;
+	ARRAY_SETREF(va.v, vi.i, vv.v);
+	heap_barrier(va.v);
 	return NO_RETURN;
 }
 
+/* aastore: store into reference array */
+static int
+opaastore(Frame *frame)
+{
+	checkindex(frame, 1);
+	return opaastore_quick(frame);
+}
+
 /* dadd: add double */
 static int
 opdadd(Frame *frame)
@@ -334,12 +564,32 @@ opgetstatic(Frame *frame)
 
 	i = frame->code->code[frame->pc++] << 8;
 	i |= frame->code->code[frame->pc++];
-	fieldref = &frame->class->constant_pool[i].info.fieldref_info;
-	v = resolvefield(frame->class, fieldref);
+	if (frame->class->cache[i] == NULL) {
+		fieldref = &frame->class->constant_pool[i].info.fieldref_info;
+		frame->class->cache[i] = resolvefield(frame->class, fieldref);
+	}
+	v = *(Value *)frame->class->cache[i];
 	frame_stackpush(frame, v);
 	return NO_RETURN;
 }
 
+/* putstatic: set static field in class */
+static int
+opputstatic(Frame *frame)
+{
+	CONSTANT_Fieldref_info *fieldref;
+	U2 i;
+
+	i = frame->code->code[frame->pc++] << 8;
+	i |= frame->code->code[frame->pc++];
+	if (frame->class->cache[i] == NULL) {
+		fieldref = &frame->class->constant_pool[i].info.fieldref_info;
+		frame->class->cache[i] = resolvefield(frame->class, fieldref);
+	}
+	*(Value *)frame->class->cache[i] = frame_stackpop(frame);
+	return NO_RETURN;
+}
+
 /* iadd: add int */
 static int
 opiadd(Frame *frame)
@@ -685,305 +935,717 @@ oplsub(Frame *frame)
 	return NO_RETURN;
 }
 
-/* lload: load long from local variable */
+/* ishl: shift int left */
 static int
-oplload(Frame *frame)
+opishl(Frame *frame)
 {
-	Value v;
-	U2 i;
+	Value v1, v2;
 
-	i = frame->code->code[frame->pc++];
-	v = frame_localload(frame, i);
-	frame_stackpush(frame, v);
+	v2 = frame_stackpop(frame);
+	v1 = frame_stackpop(frame);
+	v1.i = (int32_t)((uint32_t)v1.i << (v2.i & 0x1F));
+	frame_stackpush(frame, v1);
 	return NO_RETURN;
 }
 
-/* lload_0: load long from local variable */
+/* lshl: shift long left */
 static int
-oplload_0(Frame *frame)
+oplshl(Frame *frame)
 {
-	Value v;
+	Value v1, v2;
 
-	v = frame_localload(frame, 0);
-	frame_stackpush(frame, v);
+	v2 = frame_stackpop(frame);
+	v1 = frame_stackpop(frame);
+	v1.l = (int64_t)((uint64_t)v1.l << (v2.i & 0x3F));
+	frame_stackpush(frame, v1);
 	return NO_RETURN;
 }
 
-/* lload_1: load long from local variable */
+/* ishr: arithmetic shift int right */
 static int
-oplload_1(Frame *frame)
+opishr(Frame *frame)
 {
-	Value v;
+	Value v1, v2;
 
-	v = frame_localload(frame, 1);
-	frame_stackpush(frame, v);
+	v2 = frame_stackpop(frame);
+	v1 = frame_stackpop(frame);
+	v1.i >>= v2.i & 0x1F;
+	frame_stackpush(frame, v1);
 	return NO_RETURN;
 }
 
-/* lload_2: load long from local variable */
+/* lshr: arithmetic shift long right */
 static int
-oplload_2(Frame *frame)
+oplshr(Frame *frame)
 {
-	Value v;
+	Value v1, v2;
 
-	v = frame_localload(frame, 2);
-	frame_stackpush(frame, v);
+	v2 = frame_stackpop(frame);
+	v1 = frame_stackpop(frame);
+	v1.l >>= v2.i & 0x3F;
+	frame_stackpush(frame, v1);
 	return NO_RETURN;
 }
 
-/* lload_3: load long from local variable */
+/* iushr: logical shift int right */
 static int
-oplload_3(Frame *frame)
+opiushr(Frame *frame)
 {
-	Value v;
+	Value v1, v2;
 
-	v = frame_localload(frame, 3);
-	frame_stackpush(frame, v);
+	v2 = frame_stackpop(frame);
+	v1 = frame_stackpop(frame);
+	v1.i = (int32_t)((uint32_t)v1.i >> (v2.i & 0x1F));
+	frame_stackpush(frame, v1);
 	return NO_RETURN;
 }
 
-/* lstore: store long into local variable */
+/* lushr: logical shift long right */
 static int
-oplstore(Frame *frame)
+oplushr(Frame *frame)
 {
-	Value v;
-	U2 i;
+	Value v1, v2;
 
-	i = frame->code->code[frame->pc++];
-	v = frame_stackpop(frame);
-	frame_localstore(frame, i, v);
-	frame_localstore(frame, i + 1, v);
+	v2 = frame_stackpop(frame);
+	v1 = frame_stackpop(frame);
+	v1.l = (int64_t)((uint64_t)v1.l >> (v2.i & 0x3F));
+	frame_stackpush(frame, v1);
 	return NO_RETURN;
 }
 
-/* lstore_0: store long into local variable */
+/* iand: boolean and int */
 static int
-oplstore_0(Frame *frame)
+opiand(Frame *frame)
 {
-	Value v;
+	Value v1, v2;
 
-	v = frame_stackpop(frame);
-	frame_localstore(frame, 0, v);
-	frame_localstore(frame, 1, v);
+	v2 = frame_stackpop(frame);
+	v1 = frame_stackpop(frame);
+	v1.i &= v2.i;
+	frame_stackpush(frame, v1);
 	return NO_RETURN;
 }
 
-/* lstore_1: store long into local variable */
+/* land: boolean and long */
 static int
-oplstore_1(Frame *frame)
+opland(Frame *frame)
 {
-	Value v;
+	Value v1, v2;
 
-	v = frame_stackpop(frame);
-	frame_localstore(frame, 1, v);
-	frame_localstore(frame, 2, v);
+	v2 = frame_stackpop(frame);
+	v1 = frame_stackpop(frame);
+	v1.l &= v2.l;
+	frame_stackpush(frame, v1);
 	return NO_RETURN;
 }
 
-/* lstore_2: store long into local variable */
+/* ior: boolean or int */
 static int
-oplstore_2(Frame *frame)
+opior(Frame *frame)
 {
-	Value v;
+	Value v1, v2;
 
-	v = frame_stackpop(frame);
-	frame_localstore(frame, 2, v);
-	frame_localstore(frame, 3, v);
+	v2 = frame_stackpop(frame);
+	v1 = frame_stackpop(frame);
+	v1.i |= v2.i;
+	frame_stackpush(frame, v1);
 	return NO_RETURN;
 }
 
-/* lstore_3: store long into local variable */
+/* lor: boolean or long */
 static int
-oplstore_3(Frame *frame)
+oplor(Frame *frame)
 {
-	Value v;
+	Value v1, v2;
 
-	v = frame_stackpop(frame);
-	frame_localstore(frame, 3, v);
-	frame_localstore(frame, 4, v);
+	v2 = frame_stackpop(frame);
+	v1 = frame_stackpop(frame);
+	v1.l |= v2.l;
+	frame_stackpush(frame, v1);
 	return NO_RETURN;
 }
 
-/* iconst_m1: push int -1 into stack */
+/* ixor: boolean xor int */
 static int
-opiconst_m1(Frame *frame)
+opixor(Frame *frame)
 {
-	Value v;
+	Value v1, v2;
 
-	v.i = -1;
-	frame_stackpush(frame, v);
+	v2 = frame_stackpop(frame);
+	v1 = frame_stackpop(frame);
+	v1.i ^= v2.i;
+	frame_stackpush(frame, v1);
 	return NO_RETURN;
 }
 
-/* iconst_0: push int 0 into stack */
+/* lxor: boolean xor long */
 static int
-opiconst_0(Frame *frame)
+oplxor(Frame *frame)
 {
-	Value v;
+	Value v1, v2;
 
-	v.i = 0;
-	frame_stackpush(frame, v);
+	v2 = frame_stackpop(frame);
+	v1 = frame_stackpop(frame);
+	v1.l ^= v2.l;
+	frame_stackpush(frame, v1);
 	return NO_RETURN;
 }
 
-/* iconst_1: push int 1 into stack */
+/* i2l: convert int to long */
 static int
-opiconst_1(Frame *frame)
+opi2l(Frame *frame)
 {
 	Value v;
 
-	v.i = 1;
+	v = frame_stackpop(frame);
+	v.l = v.i;
 	frame_stackpush(frame, v);
 	return NO_RETURN;
 }
 
-/* iconst_2: push int 2 into stack */
+/* i2f: convert int to float */
 static int
-opiconst_2(Frame *frame)
+opi2f(Frame *frame)
 {
 	Value v;
 
-	v.i = 2;
+	v = frame_stackpop(frame);
+	v.f = v.i;
 	frame_stackpush(frame, v);
 	return NO_RETURN;
 }
 
-/* iconst_3: push int 3 into stack */
+/* i2d: convert int to double */
 static int
-opiconst_3(Frame *frame)
+opi2d(Frame *frame)
 {
 	Value v;
 
-	v.i = 3;
+	v = frame_stackpop(frame);
+	v.d = v.i;
 	frame_stackpush(frame, v);
 	return NO_RETURN;
 }
 
-/* iconst_4: push int 4 into stack */
+/* l2i: convert long to int */
 static int
-opiconst_4(Frame *frame)
+opl2i(Frame *frame)
 {
 	Value v;
 
-	v.i = 4;
+	v = frame_stackpop(frame);
+	v.i = (int32_t)v.l;
 	frame_stackpush(frame, v);
 	return NO_RETURN;
 }
 
-/* iconst_5: push int 5 into stack */
+/* l2f: convert long to float */
 static int
-opiconst_5(Frame *frame)
+opl2f(Frame *frame)
 {
 	Value v;
 
-	v.i = 5;
+	v = frame_stackpop(frame);
+	v.f = v.l;
 	frame_stackpush(frame, v);
 	return NO_RETURN;
 }
 
-/* lconst_0: push long 0 into stack */
+/* l2d: convert long to double */
 static int
-oplconst_0(Frame *frame)
+opl2d(Frame *frame)
 {
 	Value v;
 
-	v.l = 0;
+	v = frame_stackpop(frame);
+	v.d = v.l;
 	frame_stackpush(frame, v);
 	return NO_RETURN;
 }
 
-/* lconst_1: push long 1 into stack */
+/*
+ * f2i, f2l, d2i, d2l: convert floating-point value to integer, rounding
+ * toward zero; values out of range saturate and NaN converts to zero
+ */
 static int
-oplconst_1(Frame *frame)
+opf2i(Frame *frame)
 {
 	Value v;
 
-	v.l = 1;
+	v = frame_stackpop(frame);
+	v.i = (v.f != v.f) ? 0 : (v.f >= 2147483648.0f) ? INT32_MAX : (v.f <= -2147483648.0f) ? INT32_MIN : (int32_t)v.f;
 	frame_stackpush(frame, v);
 	return NO_RETURN;
 }
 
-/* fconst_0: push float 0 into stack */
 static int
-opfconst_0(Frame *frame)
+opf2l(Frame *frame)
 {
 	Value v;
 
-	v.f = 0.0;
+	v = frame_stackpop(frame);
+	v.l = (v.f != v.f) ? 0 : (v.f >= 9223372036854775808.0f) ? INT64_MAX : (v.f <= -9223372036854775808.0f) ? INT64_MIN : (int64_t)v.f;
 	frame_stackpush(frame, v);
 	return NO_RETURN;
 }
 
-/* fconst_1: push float 1 into stack */
 static int
-opfconst_1(Frame *frame)
+opd2i(Frame *frame)
 {
 	Value v;
 
-	v.f = 1.0;
+	v = frame_stackpop(frame);
+	v.i = (v.d != v.d) ? 0 : (v.d >= 2147483647.0) ? INT32_MAX : (v.d <= -2147483648.0) ? INT32_MIN : (int32_t)v.d;
 	frame_stackpush(frame, v);
 	return NO_RETURN;
 }
 
-/* fconst_2: push float 2 into stack */
 static int
-opfconst_2(Frame *frame)
+opd2l(Frame *frame)
 {
 	Value v;
 
-	v.f = 2.0;
+	v = frame_stackpop(frame);
+	v.l = (v.d != v.d) ? 0 : (v.d >= 9223372036854775808.0) ? INT64_MAX : (v.d <= -9223372036854775808.0) ? INT64_MIN : (int64_t)v.d;
 	frame_stackpush(frame, v);
 	return NO_RETURN;
 }
 
-/* dconst_0: push double 0 into stack */
+/* f2d: convert float to double */
 static int
-opdconst_0(Frame *frame)
+opf2d(Frame *frame)
 {
 	Value v;
 
-	v.d = 0.0;
+	v = frame_stackpop(frame);
+	v.d = v.f;
 	frame_stackpush(frame, v);
 	return NO_RETURN;
 }
 
-/* dconst_1: push double 1 into stack */
+/* d2f: convert double to float */
 static int
-opdconst_1(Frame *frame)
+opd2f(Frame *frame)
 {
 	Value v;
 
-	v.d = 1.0;
+	v = frame_stackpop(frame);
+	v.f = (float)v.d;
 	frame_stackpush(frame, v);
 	return NO_RETURN;
 }
 
-/* bipush: push byte */
+/* i2b: convert int to byte */
 static int
-opbipush(Frame *frame)
+opi2b(Frame *frame)
 {
 	Value v;
 
-	v.i = frame->code->code[frame->pc++];
+	v = frame_stackpop(frame);
+	v.i = (int8_t)v.i;
 	frame_stackpush(frame, v);
 	return NO_RETURN;
 }
 
-/* sipush: push short */
+/* i2c: convert int to char */
 static int
-opsipush(Frame *frame)
+opi2c(Frame *frame)
 {
 	Value v;
-	U2
 
-	i = frame->code->code[frame->pc++] << 8;
-	i |= frame->code->code[frame->pc++];
-	v.i = i;
+	v = frame_stackpop(frame);
+	v.i = (U2)v.i;
 	frame_stackpush(frame, v);
 	return NO_RETURN;
 }
 
-/* pop: pop the top operand stack value */
+/* i2s: convert int to short */
+static int
+opi2s(Frame *frame)
+{
+	Value v;
+
+	v = frame_stackpop(frame);
+	v.i = (int16_t)v.i;
+	frame_stackpush(frame, v);
+	return NO_RETURN;
+}
+
+/* lcmp: compare long */
+static int
+oplcmp(Frame *frame)
+{
+	Value v1, v2;
+
+	v2 = frame_stackpop(frame);
+	v1 = frame_stackpop(frame);
+	v1.i = (v1.l > v2.l) ? 1 : (v1.l < v2.l) ? -1 : (v1.l == v2.l) ? 0 : 0;
+	frame_stackpush(frame, v1);
+	return NO_RETURN;
+}
+
+/* fcmpl: compare float; -1 if either is NaN */
+static int
+opfcmpl(Frame *frame)
+{
+	Value v1, v2;
+
+	v2 = frame_stackpop(frame);
+	v1 = frame_stackpop(frame);
+	v1.i = (v1.f > v2.f) ? 1 : (v1.f < v2.f) ? -1 : (v1.f == v2.f) ? 0 : -1;
+	frame_stackpush(frame, v1);
+	return NO_RETURN;
+}
+
+/* fcmpg: compare float; 1 if either is NaN */
+static int
+opfcmpg(Frame *frame)
+{
+	Value v1, v2;
+
+	v2 = frame_stackpop(frame);
+	v1 = frame_stackpop(frame);
+	v1.i = (v1.f > v2.f) ? 1 : (v1.f < v2.f) ? -1 : (v1.f == v2.f) ? 0 : 1;
+	frame_stackpush(frame, v1);
+	return NO_RETURN;
+}
+
+/* dcmpl: compare double; -1 if either is NaN */
+static int
+opdcmpl(Frame *frame)
+{
+	Value v1, v2;
+
+	v2 = frame_stackpop(frame);
+	v1 = frame_stackpop(frame);
+	v1.i = (v1.d > v2.d) ? 1 : (v1.d < v2.d) ? -1 : (v1.d == v2.d) ? 0 : -1;
+	frame_stackpush(frame, v1);
+	return NO_RETURN;
+}
+
+/* dcmpg: compare double; 1 if either is NaN */
+static int
+opdcmpg(Frame *frame)
+{
+	Value v1, v2;
+
+	v2 = frame_stackpop(frame);
+	v1 = frame_stackpop(frame);
+	v1.i = (v1.d > v2.d) ? 1 : (v1.d < v2.d) ? -1 : (v1.d == v2.d) ? 0 : 1;
+	frame_stackpush(frame, v1);
+	return NO_RETURN;
+}
+
+/* lload: load long from local variable */
+static int
+oplload(Frame *frame)
+{
+	Value v;
+	U2 i;
+
+	i = frame->code->code[frame->pc++];
+	v = frame_localload(frame, i);
+	frame_stackpush(frame, v);
+	return NO_RETURN;
+}
+
+/* lload_0: load long from local variable */
+static int
+oplload_0(Frame *frame)
+{
+	Value v;
+
+	v = frame_localload(frame, 0);
+	frame_stackpush(frame, v);
+	return NO_RETURN;
+}
+
+/* lload_1: load long from local variable */
+static int
+oplload_1(Frame *frame)
+{
+	Value v;
+
+	v = frame_localload(frame, 1);
+	frame_stackpush(frame, v);
+	return NO_RETURN;
+}
+
+/* lload_2: load long from local variable */
+static int
+oplload_2(Frame *frame)
+{
+	Value v;
+
+	v = frame_localload(frame, 2);
+	frame_stackpush(frame, v);
+	return NO_RETURN;
+}
+
+/* lload_3: load long from local variable */
+static int
+oplload_3(Frame *frame)
+{
+	Value v;
+
+	v = frame_localload(frame, 3);
+	frame_stackpush(frame, v);
+	return NO_RETURN;
+}
+
+/* lstore: store long into local variable */
+static int
+oplstore(Frame *frame)
+{
+	Value v;
+	U2 i;
+
+	i = frame->code->code[frame->pc++];
+	v = frame_stackpop(frame);
+	frame_localstore(frame, i, v);
+	frame_localstore(frame, i + 1, v);
+	return NO_RETURN;
+}
+
+/* lstore_0: store long into local variable */
+static int
+oplstore_0(Frame *frame)
+{
+	Value v;
+
+	v = frame_stackpop(frame);
+	frame_localstore(frame, 0, v);
+	frame_localstore(frame, 1, v);
+	return NO_RETURN;
+}
+
+/* lstore_1: store long into local variable */
+static int
+oplstore_1(Frame *frame)
+{
+	Value v;
+
+	v = frame_stackpop(frame);
+	frame_localstore(frame, 1, v);
+	frame_localstore(frame, 2, v);
+	return NO_RETURN;
+}
+
+/* lstore_2: store long into local variable */
+static int
+oplstore_2(Frame *frame)
+{
+	Value v;
+
+	v = frame_stackpop(frame);
+	frame_localstore(frame, 2, v);
+	frame_localstore(frame, 3, v);
+	return NO_RETURN;
+}
+
+/* lstore_3: store long into local variable */
+static int
+oplstore_3(Frame *frame)
+{
+	Value v;
+
+	v = frame_stackpop(frame);
+	frame_localstore(frame, 3, v);
+	frame_localstore(frame, 4, v);
+	return NO_RETURN;
+}
+
+/* aconst_null: push null reference into stack */
+static int
+opaconst_null(Frame *frame)
+{
+	Value v;
+
+	v.v = NULL;
+	frame_stackpush(frame, v);
+	return NO_RETURN;
+}
+
+/* iconst_m1: push int -1 into stack */
+static int
+opiconst_m1(Frame *frame)
+{
+	Value v;
+
+	v.i = -1;
+	frame_stackpush(frame, v);
+	return NO_RETURN;
+}
+
+/* iconst_0: push int 0 into stack */
+static int
+opiconst_0(Frame *frame)
+{
+	Value v;
+
+	v.i = 0;
+	frame_stackpush(frame, v);
+	return NO_RETURN;
+}
+
+/* iconst_1: push int 1 into stack */
+static int
+opiconst_1(Frame *frame)
+{
+	Value v;
+
+	v.i = 1;
+	frame_stackpush(frame, v);
+	return NO_RETURN;
+}
+
+/* iconst_2: push int 2 into stack */
+static int
+opiconst_2(Frame *frame)
+{
+	Value v;
+
+	v.i = 2;
+	frame_stackpush(frame, v);
+	return NO_RETURN;
+}
+
+/* iconst_3: push int 3 into stack */
+static int
+opiconst_3(Frame *frame)
+{
+	Value v;
+
+	v.i = 3;
+	frame_stackpush(frame, v);
+	return NO_RETURN;
+}
+
+/* iconst_4: push int 4 into stack */
+static int
+opiconst_4(Frame *frame)
+{
+	Value v;
+
+	v.i = 4;
+	frame_stackpush(frame, v);
+	return NO_RETURN;
+}
+
+/* iconst_5: push int 5 into stack */
+static int
+opiconst_5(Frame *frame)
+{
+	Value v;
+
+	v.i = 5;
+	frame_stackpush(frame, v);
+	return NO_RETURN;
+}
+
+/* lconst_0: push long 0 into stack */
+static int
+oplconst_0(Frame *frame)
+{
+	Value v;
+
+	v.l = 0;
+	frame_stackpush(frame, v);
+	return NO_RETURN;
+}
+
+/* lconst_1: push long 1 into stack */
+static int
+oplconst_1(Frame *frame)
+{
+	Value v;
+
+	v.l = 1;
+	frame_stackpush(frame, v);
+	return NO_RETURN;
+}
+
+/* fconst_0: push float 0 into stack */
+static int
+opfconst_0(Frame *frame)
+{
+	Value v;
+
+	v.f = 0.0;
+	frame_stackpush(frame, v);
+	return NO_RETURN;
+}
+
+/* fconst_1: push float 1 into stack */
+static int
+opfconst_1(Frame *frame)
+{
+	Value v;
+
+	v.f = 1.0;
+	frame_stackpush(frame, v);
+	return NO_RETURN;
+}
+
+/* fconst_2: push float 2 into stack */
+static int
+opfconst_2(Frame *frame)
+{
+	Value v;
+
+	v.f = 2.0;
+	frame_stackpush(frame, v);
+	return NO_RETURN;
+}
+
+/* dconst_0: push double 0 into stack */
+static int
+opdconst_0(Frame *frame)
+{
+	Value v;
+
+	v.d = 0.0;
+	frame_stackpush(frame, v);
+	return NO_RETURN;
+}
+
+/* dconst_1: push double 1 into stack */
+static int
+opdconst_1(Frame *frame)
+{
+	Value v;
+
+	v.d = 1.0;
+	frame_stackpush(frame, v);
+	return NO_RETURN;
+}
+
+/* bipush: push byte */
+static int
+opbipush(Frame *frame)
+{
+	Value v;
+
+	v.i = (int8_t)frame->code->code[frame->pc++];
+	frame_stackpush(frame, v);
+	return NO_RETURN;
+}
+
+/* sipush: push short */
+static int
+opsipush(Frame *frame)
+{
+	Value v;
+	int16_t
+
+	i = frame->code->code[frame->pc++] << 8;
+	i |= frame->code->code[frame->pc++];
+	v.i = i;
+	frame_stackpush(frame, v);
+	return NO_RETURN;
+}
+
+/* pop: pop the top operand stack value */
 static int
 oppop(Frame *frame)
 {
@@ -1094,13 +1756,26 @@ opdup2_x2(Frame *frame)
 	return NO_RETURN;
 }
 
+/* swap: swap the top two operand stack values */
+static int
+opswap(Frame *frame)
+{
+	Value v1, v2;
+
+	v1 = frame_stackpop(frame);
+	v2 = frame_stackpop(frame);
+	frame_stackpush(frame, v1);
+	frame_stackpush(frame, v2);
+	return NO_RETURN;
+}
+
 /* invokestatic: invoke a class (static) method */
 static int
 opinvokestatic(Frame *frame)
 {
 	CONSTANT_Methodref_info *methodref;
 	ClassFile *class;
-	enum JavaClass jclass;
+	Native *native;
 	char *classname, *name, *type;
 	U2 i;
 
@@ -1108,12 +1783,14 @@ opinvokestatic(Frame *frame)
 	//       or the class or interface initialization method.
 	i = frame->code->code[frame->pc++] << 8;
 	i |= frame->code->code[frame->pc++];
+	if ((native = resolvenative(frame->class, i)) != NULL) {
+		(*native->method)(frame);
+		return NO_RETURN;
+	}
 	methodref = &frame->class->constant_pool[i].info.methodref_info;
 	classname = class_getclassname(frame->class, methodref->class_index);
 	class_getnameandtype(frame->class, methodref->name_and_type_index, &name, &type);
-	if ((jclass = native_javaclass(classname)) != 0) {
-		native_javamethod(frame, jclass, name, type);
-	} else if ((class = classload(classname)) != NULL) {
+	if ((class = classload(classname)) != NULL) {
 		classinit(class);
 		if (methodcall(class, frame, name, type, ACC_STATIC) == -1) {
 			errx(EXIT_FAILURE, "could not find method %s", name);
@@ -1124,26 +1801,50 @@ opinvokestatic(Frame *frame)
 	return NO_RETURN;
 }
 
+/* invokedynamic: invoke dynamically-computed call site */
+static int
+opinvokedynamic(Frame *frame)
+{
+	Recipe *recipe;
+	Value v;
+	U2 i;
+
+	i = frame->code->code[frame->pc++] << 8;
+	i |= frame->code->code[frame->pc++];
+	frame->pc += 2;
+	if ((recipe = frame->class->cache[i]) == NULL) {
+		if ((recipe = concat_compile(frame->class, i)) == NULL)
+			errx(EXIT_FAILURE, "could not link invokedynamic call site");
+		frame->class->cache[i] = recipe;
+	}
+	frame->nstack -= recipe->nargs;
+	v.v = concat_run(recipe, &frame->stack[frame->nstack]);
+	frame_stackpush(frame, v);
+	return NO_RETURN;
+}
+
 /* invokevirtual: invoke instance method; dispatch based on class */
 static int
 opinvokevirtual(Frame *frame)
 {
 	CONSTANT_Methodref_info *methodref;
 	ClassFile *class;
-	enum JavaClass jclass;
+	Native *native;
 	char *classname, *name, *type;
 	U2 i;
 
 	i = frame->code->code[frame->pc++] << 8;
 	i |= frame->code->code[frame->pc++];
+	if ((native = resolvenative(frame->class, i)) != NULL) {
+		(*native->method)(frame);
+		return NO_RETURN;
+	}
 	methodref = &frame->class->constant_pool[i].info.methodref_info;
 	classname = class_getclassname(frame->class, methodref->class_index);
 	class_getnameandtype(frame->class, methodref->name_and_type_index, &name, &type);
-	if ((jclass = native_javaclass(classname)) != 0) {
-		native_javamethod(frame, jclass, name, type);
-	} else if ((class = classload(classname)) != NULL) {
+	if ((class = classload(classname)) != NULL) {
 		classinit(class);
-		if (methodcall(class, NULL, name, type, ACC_STATIC) == -1) {
+		if (methodcall(class, frame, name, type, ACC_NONE) == -1) {
 			errx(EXIT_FAILURE, "could not find method %s", name);
 		}
 	} else {
@@ -1193,6 +1894,23 @@ opldc2_w(Frame *frame)
 	return NO_RETURN;
 }
 
+/* get array element type from field descriptor character */
+static U1
+arraytype(char c)
+{
+	switch (c) {
+	case 'Z': return T_BOOLEAN;
+	case 'C': return T_CHAR;
+	case 'F': return T_FLOAT;
+	case 'D': return T_DOUBLE;
+	case 'B': return T_BYTE;
+	case 'S': return T_SHORT;
+	case 'I': return T_INT;
+	case 'J': return T_LONG;
+	default:  return T_REFERENCE;
+	}
+}
+
 /* multianewarray: create new multidimensional array */
 int
 opmultianewarray(Frame *frame)
@@ -1201,344 +1919,665 @@ opmultianewarray(Frame *frame)
 	Heap *h;
 	char *type;
 	int32_t *sizes;
-	U1 i, dimension;
+	U1 i, dimension, atype;
 	U2 index;
-	size_t s;
 
 	index = frame->code->code[frame->pc++] << 8;
-	index = frame->code->code[frame->pc++];
+	index |= frame->code->code[frame->pc++];
 	dimension = frame->code->code[frame->pc++];
 	sizes = ecalloc(dimension, sizeof *sizes);
 	type = class_getclassname(frame->class, index);
-	switch (*type) {
-	case 'L':
-	case '[':
-		s = sizeof (void *);
-		break;
-	case 'D':
-	case 'J':
-		s = sizeof (int64_t);
-		break;
-	default:
-		s = sizeof (int32_t);
-		break;
-	}
+	/* arrays of the innermost dimension created hold references if the type has more dimensions */
+	atype = (strspn(type, "[") > dimension) ? T_REFERENCE : arraytype(type[dimension]);
 	for (i = 0; i < dimension; i++) {
 		v = frame_stackpop(frame);
-		if (v.i < 0) {
-			// TODO: throw NegativeArraySizeException
-		}
+		if (v.i < 0)
+			errx(EXIT_FAILURE, "java.lang.NegativeArraySizeException: %d", v.i);
 		if (v.i == 0) {
 			// TODO: handle zero size
 		}
 		sizes[dimension - i - 1] = v.i;
 	}
-	h = array_multinew(sizes, dimension, s);
+	h = array_multinew(sizes, dimension, atype, type);
+	free(sizes);
 	if (h == NULL) {
-		// TODO: throw error
+		// TODO: throw OutOfMemoryError
+		errx(EXIT_FAILURE, "out of memory");
 	}
 	v.v = h;
 	frame_stackpush(frame, v);
 	return NO_RETURN;
 }
 
+/* newarray: create new array of primitive type; small arrays that never escape live in the frame */
 int
 opnewarray(Frame *frame)
 {
 	Value v;
-	Heap *h;
-	char *type;
-	int32_t *size;
+	Heap *h = NULL;
+	void *p;
+	int site;
 	U1 atype;
-	U2 index;
-	size_t s;
 
+	site = refmap_site(frame->class, frame->code, frame->pc - 1);
 	atype = frame->code->code[frame->pc++];
-	size = emalloc(sizeof *size);
-	switch (atype) {
-	case 4:
-		s = sizeof (U1);
-		break;
-	case 5:
-		s = sizeof (U1);
-		break;
-	case 8:
-		s = sizeof (U1);
-		break;
-	case 7:
-		s = sizeof (int64_t);
-		break;
-	case 6:
-		s = sizeof (int32_t);
-		break;
-	case 10:
-		s = sizeof (int32_t);
-		break;
-	case 11:
-		s = sizeof (int64_t);
-		break;
-	case 9:
-		s = sizeof (U2);
-		break;
-	default:
-		s = sizeof (int32_t);
-		break;
+	v = frame_stackpop(frame);
+	if (v.i < 0)
+		errx(EXIT_FAILURE, "java.lang.NegativeArraySizeException: %d", v.i);
+	if (site >= 0 && (size_t)v.i * array_elemsize(atype) <= HEAP_LOCALMAX &&
+	    (p = frame_alloc(frame, site, sizeof *h + (size_t)v.i * array_elemsize(atype))) != NULL)
+		h = array_local(p, v.i, atype);
+	if (h == NULL)
+		h = array_new(v.i, atype);
+	if (h == NULL) {
+		// TODO: throw OutOfMemoryError
+		errx(EXIT_FAILURE, "out of memory");
 	}
+	v.v = h;
+	frame_stackpush(frame, v);
+	return NO_RETURN;
+}
+
+/* anewarray: create new array of references */
+static int
+opanewarray(Frame *frame)
+{
+	Value v;
+	Heap *h;
+	U2 index;
 
-	h = array_multinew(size, 1, s);
+	index = frame->code->code[frame->pc++] << 8;
+	index |= frame->code->code[frame->pc++];
+	v = frame_stackpop(frame);
+	if (v.i < 0)
+		errx(EXIT_FAILURE, "java.lang.NegativeArraySizeException: %d", v.i);
+	h = array_new(v.i, T_REFERENCE);
 	if (h == NULL) {
-		// TODO: throw error
+		// TODO: throw OutOfMemoryError
+		errx(EXIT_FAILURE, "out of memory");
 	}
+	array_setclass(h, class_getclassname(frame->class, index));
 	v.v = h;
 	frame_stackpush(frame, v);
 	return NO_RETURN;
 }
 
 static int
-oparraylength(Frame *frame)
+oparraylength(Frame *frame)
+{
+	Value v, length;
+	
+	v = frame_stackpop(frame);
+	length.i = ARRAY_LENGTH(v.v);
+	frame_stackpush(frame, length);
+	
+	return NO_RETURN;
+}
+
+
+/* access jump table by index and jump */
+static int
+optableswitch(Frame *frame)
+{
+	int32_t def, high, low, j, n;
+	U4 a, b, c, d, baseaddr, targetaddr;
+	Value v;
+
+	baseaddr = frame->pc - 1;
+	while (frame->pc % 4)
+		frame->pc++;
+	v = frame_stackpop(frame);
+	a = frame->code->code[frame->pc++];
+	b = frame->code->code[frame->pc++];
+	c = frame->code->code[frame->pc++];
+	d = frame->code->code[frame->pc++];
+	def = (a << 24) | (b << 16) | (c << 8) | d;
+	a = frame->code->code[frame->pc++];
+	b = frame->code->code[frame->pc++];
+	c = frame->code->code[frame->pc++];
+	d = frame->code->code[frame->pc++];
+	low = (a << 24) | (b << 16) | (c << 8) | d;
+	a = frame->code->code[frame->pc++];
+	b = frame->code->code[frame->pc++];
+	c = frame->code->code[frame->pc++];
+	d = frame->code->code[frame->pc++];
+	high = (a << 24) | (b << 16) | (c << 8) | d;
+	targetaddr = baseaddr + def;
+	for (j = low; j <= high; j++) {
+		a = frame->code->code[frame->pc++];
+		b = frame->code->code[frame->pc++];
+		c = frame->code->code[frame->pc++];
+		d = frame->code->code[frame->pc++];
+		n = (a << 24) | (b << 16) | (c << 8) | d;
+		if (v.i == j) {
+			targetaddr = baseaddr + n;
+			break;
+		}
+	}
+	frame->pc = targetaddr;
+	return NO_RETURN;
+}
+
+/* access jump table by key match and jump */
+static int
+oplookupswitch(Frame *frame)
+{
+	int32_t def, key, n, npairs, j;
+	U4 baseaddr, targetaddr;
+	U1 *p;
+	Value v;
+
+	baseaddr = frame->pc - 1;
+	while (frame->pc % 4)
+		frame->pc++;
+	v = frame_stackpop(frame);
+	p = &frame->code->code[frame->pc];
+	def = class_get32(&p[0]);
+	npairs = class_get32(&p[4]);
+	targetaddr = baseaddr + def;
+	for (j = 0, p += 8; j < npairs; j++, p += 8) {
+		key = class_get32(&p[0]);
+		n = class_get32(&p[4]);
+		if (v.i == key) {
+			targetaddr = baseaddr + n;
+			break;
+		}
+	}
+	frame->pc = targetaddr;
+	return NO_RETURN;
+}
+
+/* branch from the instruction at base by off; report a loop that has a trace or became hot */
+static int
+branch(Frame *frame, U2 base, int32_t off)
+{
+	Code_attribute *code;
+
+	code = frame->code;
+	frame->pc = base + off;
+	if (off <= 0 && code->traces != NULL && trace_find(code, frame->pc) != NULL)
+		return HOT_TRACE;
+	if (off <= 0 && usejit && code->backedges < backedgethreshold &&
+	    ++code->backedges == backedgethreshold)
+		return HOT_LOOP;
+	return NO_RETURN;
+}
+
+/* read 16-bit branch offset and branch if cond is true */
+static int
+branchif(Frame *frame, int cond)
+{
+	int16_t off;
+	U2 base;
+
+	base = frame->pc - 1;
+	off = frame->code->code[frame->pc++] << 8;
+	off |= frame->code->code[frame->pc++];
+	if (cond)
+		return branch(frame, base, off);
+	return NO_RETURN;
+}
+
+/* ifeq: branch if int comparison with zero succeeds */
+static int
+opifeq(Frame *frame)
+{
+	return branchif(frame, frame_stackpop(frame).i == 0);
+}
+
+/* ifne: branch if int comparison with zero succeeds */
+static int
+opifne(Frame *frame)
+{
+	return branchif(frame, frame_stackpop(frame).i != 0);
+}
+
+/* iflt: branch if int comparison with zero succeeds */
+static int
+opiflt(Frame *frame)
+{
+	return branchif(frame, frame_stackpop(frame).i < 0);
+}
+
+/* ifge: branch if int comparison with zero succeeds */
+static int
+opifge(Frame *frame)
+{
+	return branchif(frame, frame_stackpop(frame).i >= 0);
+}
+
+/* ifgt: branch if int comparison with zero succeeds */
+static int
+opifgt(Frame *frame)
+{
+	return branchif(frame, frame_stackpop(frame).i > 0);
+}
+
+/* ifle: branch if int comparison with zero succeeds */
+static int
+opifle(Frame *frame)
+{
+	return branchif(frame, frame_stackpop(frame).i <= 0);
+}
+
+/* if_icmpeq: branch if int comparison succeeds */
+static int
+opif_icmpeq(Frame *frame)
+{
+	Value v1, v2;
+
+	v2 = frame_stackpop(frame);
+	v1 = frame_stackpop(frame);
+	return branchif(frame, v1.i == v2.i);
+}
+
+/* if_icmpne: branch if int comparison succeeds */
+static int
+opif_icmpne(Frame *frame)
+{
+	Value v1, v2;
+
+	v2 = frame_stackpop(frame);
+	v1 = frame_stackpop(frame);
+	return branchif(frame, v1.i != v2.i);
+}
+
+/* if_icmplt: branch if int comparison succeeds */
+static int
+opif_icmplt(Frame *frame)
+{
+	Value v1, v2;
+
+	v2 = frame_stackpop(frame);
+	v1 = frame_stackpop(frame);
+	return branchif(frame, v1.i < v2.i);
+}
+
+/* if_icmpge: branch if int comparison succeeds */
+static int
+opif_icmpge(Frame *frame)
+{
+	Value v1, v2;
+
+	v2 = frame_stackpop(frame);
+	v1 = frame_stackpop(frame);
+	return branchif(frame, v1.i >= v2.i);
+}
+
+/* if_icmpgt: branch if int comparison succeeds */
+static int
+opif_icmpgt(Frame *frame)
+{
+	Value v1, v2;
+
+	v2 = frame_stackpop(frame);
+	v1 = frame_stackpop(frame);
+	return branchif(frame, v1.i > v2.i);
+}
+
+/* if_icmple: branch if int comparison succeeds */
+static int
+opif_icmple(Frame *frame)
+{
+	Value v1, v2;
+
+	v2 = frame_stackpop(frame);
+	v1 = frame_stackpop(frame);
+	return branchif(frame, v1.i <= v2.i);
+}
+
+/* if_acmpeq: branch if reference comparison succeeds */
+static int
+opif_acmpeq(Frame *frame)
+{
+	Value v1, v2;
+
+	v2 = frame_stackpop(frame);
+	v1 = frame_stackpop(frame);
+	return branchif(frame, v1.v == v2.v);
+}
+
+/* if_acmpne: branch if reference comparison does not succeed */
+static int
+opif_acmpne(Frame *frame)
+{
+	Value v1, v2;
+
+	v2 = frame_stackpop(frame);
+	v1 = frame_stackpop(frame);
+	return branchif(frame, v1.v != v2.v);
+}
+
+/* ifnull: branch if reference is null */
+static int
+opifnull(Frame *frame)
+{
+	return branchif(frame, frame_stackpop(frame).v == NULL);
+}
+
+/* ifnonnull: branch if reference is not null */
+static int
+opifnonnull(Frame *frame)
+{
+	return branchif(frame, frame_stackpop(frame).v != NULL);
+}
+
+/* saload_quick: load short from array at an index in bounds */
+static int
+opsaload_quick(Frame *frame)
+{
+	Value va, vi, v;
+
+	vi = frame_stackpop(frame);
+	va = frame_stackpop(frame);
+	v.i = ARRAY_ELEM(va.v, int16_t, vi.i);
+	frame_stackpush(frame, v);
+	return NO_RETURN;
+}
+
+/* saload: load short from array */
+static int
+opsaload(Frame *frame)
+{
+	checkindex(frame, 0);
+	return opsaload_quick(frame);
+}
+
+/* sastore_quick: store into short array at an index in bounds */
+static int
+opsastore_quick(Frame *frame)
+{
+	Value va, vi, vv;
+
+	vv = frame_stackpop(frame);
+	vi = frame_stackpop(frame);
+	va = frame_stackpop(frame);
+	ARRAY_ELEM(va.v, int16_t, vi.i) = vv.i;
+	return NO_RETURN;
+}
+
+/* sastore: store into short array */
+static int
+opsastore(Frame *frame)
 {
-	Value v, length;
-	
-	v = frame_stackpop(frame);
-	length.i = (v.v)->nmemb;
-	frame_stackpush(frame, length);
-	
-	return NO_RETURN;
+	checkindex(frame, 1);
+	return opsastore_quick(frame);
 }
 
-
-/* access jump table by index and jump */
+/* baload_quick: load byte or boolean from array at an index in bounds */
 static int
-optableswitch(Frame *frame)
+opbaload_quick(Frame *frame)
 {
-	int32_t def, high, low, j, n;
-	U4 a, b, c, d, baseaddr, targetaddr;
-	Value v;
+	Value va, vi, v;
 
-	baseaddr = frame->pc - 1;
-	while (frame->pc % 4)
-		frame->pc++;
-	v = frame_stackpop(frame);
-	a = frame->code->code[frame->pc++];
-	b = frame->code->code[frame->pc++];
-	c = frame->code->code[frame->pc++];
-	d = frame->code->code[frame->pc++];
-	def = (a << 24) | (b << 16) | (c << 8) | d;
-	a = frame->code->code[frame->pc++];
-	b = frame->code->code[frame->pc++];
-	c = frame->code->code[frame->pc++];
-	d = frame->code->code[frame->pc++];
-	low = (a << 24) | (b << 16) | (c << 8) | d;
-	a = frame->code->code[frame->pc++];
-	b = frame->code->code[frame->pc++];
-	c = frame->code->code[frame->pc++];
-	d = frame->code->code[frame->pc++];
-	high = (a << 24) | (b << 16) | (c << 8) | d;
-	targetaddr = baseaddr + def;
-	for (j = low; j <= high; j++) {
-		a = frame->code->code[frame->pc++];
-		b = frame->code->code[frame->pc++];
-		c = frame->code->code[frame->pc++];
-		d = frame->code->code[frame->pc++];
-		n = (a << 24) | (b << 16) | (c << 8) | d;
-		if (v.i == j) {
-			targetaddr = baseaddr + n;
-			break;
-		}
-	}
-	frame->pc = targetaddr;
+	vi = frame_stackpop(frame);
+	va = frame_stackpop(frame);
+	v.i = ARRAY_ELEM(va.v, int8_t, vi.i);
+	frame_stackpush(frame, v);
 	return NO_RETURN;
 }
 
+/* baload: load byte or boolean from array */
 static int
-opif_icmpge(Frame *frame)
+opbaload(Frame *frame)
 {
-	Value v1, v2;
-	U2 i;
+	checkindex(frame, 0);
+	return opbaload_quick(frame);
+}
 
-	i = frame->code->code[frame->pc++] << 8;
-	i |= frame->code->code[frame->pc++];
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	if (v1.i >= v2.i){
-		frame->pc = frame->pc + i;
-	} else{ 
+/* bastore_quick: store into byte or boolean array at an index in bounds; booleans keep only the low bit */
+static int
+opbastore_quick(Frame *frame)
+{
+	Value va, vi, vv;
 
-	}
+	vv = frame_stackpop(frame);
+	vi = frame_stackpop(frame);
+	va = frame_stackpop(frame);
+	ARRAY_ELEM(va.v, int8_t, vi.i) = (ARRAY_TYPE(va.v) == T_BOOLEAN) ? (vv.i & 1) : vv.i;
 	return NO_RETURN;
 }
 
-static int 
-opsaload(Frame *frame)
+/* bastore: store into byte or boolean array; booleans keep only the low bit */
+static int
+opbastore(Frame *frame)
+{
+	checkindex(frame, 1);
+	return opbastore_quick(frame);
+}
+
+/* caload_quick: load char from array at an index in bounds */
+static int
+opcaload_quick(Frame *frame)
 {
 	Value va, vi, v;
 
 	vi = frame_stackpop(frame);
 	va = frame_stackpop(frame);
-	v.u = ((U2 *)va.v->obj)[vi.i];
+	v.i = ARRAY_ELEM(va.v, U2, vi.i);
 	frame_stackpush(frame, v);
-	
-	return NO_RETURN; 
+	return NO_RETURN;
 }
 
+/* caload: load char from array */
 static int
-opsastore(Frame *frame)
+opcaload(Frame *frame)
 {
-	Value va, vi, vv, i;
+	checkindex(frame, 0);
+	return opcaload_quick(frame);
+}
+
+/* castore_quick: store into char array at an index in bounds */
+static int
+opcastore_quick(Frame *frame)
+{
+	Value va, vi, vv;
 
 	vv = frame_stackpop(frame);
 	vi = frame_stackpop(frame);
-	i.u = vv.i;
 	va = frame_stackpop(frame);
-	if (va.v->obj == NULL) {
-		// TODO: throw NullPointerException
-	}
-	if (vi.i < 0 || vi.i >= va.v->nmemb) {
-		// TODO: throw ArrayIndexOutOfBoundsException
-	}
-	((U2 *)va.v->obj)[vi.i] = i.u;
+	ARRAY_ELEM(va.v, U2, vi.i) = vv.i;
 	return NO_RETURN;
 }
 
-static int 
-opbaload(Frame *frame)
+/* castore: store into char array */
+static int
+opcastore(Frame *frame)
+{
+	checkindex(frame, 1);
+	return opcastore_quick(frame);
+}
+
+/* faload_quick: load float from array at an index in bounds */
+static int
+opfaload_quick(Frame *frame)
 {
 	Value va, vi, v;
 
 	vi = frame_stackpop(frame);
 	va = frame_stackpop(frame);
-
-	v.u = ((U2 *)va.v->obj)[vi.i];
+	v.f = ARRAY_ELEM(va.v, float, vi.i);
 	frame_stackpush(frame, v);
-	
-	return NO_RETURN; 
+	return NO_RETURN;
 }
 
+/* faload: load float from array */
 static int
-opbastore(Frame *frame)
+opfaload(Frame *frame)
+{
+	checkindex(frame, 0);
+	return opfaload_quick(frame);
+}
+
+/* fastore_quick: store into float array at an index in bounds */
+static int
+opfastore_quick(Frame *frame)
 {
-	Value va, vi, vv, i;
+	Value va, vi, vv;
 
 	vv = frame_stackpop(frame);
 	vi = frame_stackpop(frame);
-	i.u = vv.i;
 	va = frame_stackpop(frame);
-	if (va.v->obj == NULL) {
-		// TODO: throw NullPointerException
-	}
-	if (vi.i < 0 || vi.i >= va.v->nmemb) {
-		// TODO: throw ArrayIndexOutOfBoundsException
-	}
-	((U2 *)va.v->obj)[vi.i] = i.u;
+	ARRAY_ELEM(va.v, float, vi.i) = vv.f;
 	return NO_RETURN;
 }
 
-static int 
-opcaload(Frame *frame)
+/* fastore: store into float array */
+static int
+opfastore(Frame *frame)
+{
+	checkindex(frame, 1);
+	return opfastore_quick(frame);
+}
+
+/* iaload_quick: load int from array at an index in bounds */
+static int
+opiaload_quick(Frame *frame)
 {
 	Value va, vi, v;
 
 	vi = frame_stackpop(frame);
 	va = frame_stackpop(frame);
-	v.u = ((U2 *)va.v->obj)[vi.i];
+	v.i = ARRAY_ELEM(va.v, int32_t, vi.i);
 	frame_stackpush(frame, v);
-	
-	return NO_RETURN; 
+	return NO_RETURN;
 }
 
+/* iaload: load int from array */
 static int
-opcastore(Frame *frame)
+opiaload(Frame *frame)
+{
+	checkindex(frame, 0);
+	return opiaload_quick(frame);
+}
+
+/* iastore_quick: store into int array at an index in bounds */
+static int
+opiastore_quick(Frame *frame)
 {
-	Value va, vi, vv, i;
+	Value va, vi, vv;
 
 	vv = frame_stackpop(frame);
 	vi = frame_stackpop(frame);
-	i.u = vv.i;
 	va = frame_stackpop(frame);
-	if (va.v->obj == NULL) {
-		// TODO: throw NullPointerException
-	}
-	if (vi.i < 0 || vi.i >= va.v->nmemb) {
-		// TODO: throw ArrayIndexOutOfBoundsException
-	}
-	((U2 *)va.v->obj)[vi.i] = i.u;
+	ARRAY_ELEM(va.v, int32_t, vi.i) = vv.i;
 	return NO_RETURN;
 }
 
-static int 
-opfaload(Frame *frame)
+/* iastore: store into int array */
+static int
+opiastore(Frame *frame)
+{
+	checkindex(frame, 1);
+	return opiastore_quick(frame);
+}
+
+/* laload_quick: load long from array at an index in bounds */
+static int
+oplaload_quick(Frame *frame)
 {
 	Value va, vi, v;
 
 	vi = frame_stackpop(frame);
 	va = frame_stackpop(frame);
-	v.f = ((float *)va.v->obj)[vi.i];
+	v.l = ARRAY_ELEM(va.v, int64_t, vi.i);
 	frame_stackpush(frame, v);
-	
-	return NO_RETURN; 
+	return NO_RETURN;
 }
 
+/* laload: load long from array */
 static int
-opfastore(Frame *frame)
+oplaload(Frame *frame)
+{
+	checkindex(frame, 0);
+	return oplaload_quick(frame);
+}
+
+/* lastore_quick: store into long array at an index in bounds */
+static int
+oplastore_quick(Frame *frame)
 {
-	Value va, vi, vv, i;
+	Value va, vi, vv;
 
 	vv = frame_stackpop(frame);
 	vi = frame_stackpop(frame);
-	i.f = vv.i;
 	va = frame_stackpop(frame);
-	if (va.v->obj == NULL) {
-		// TODO: throw NullPointerException
-	}
-	if (vi.i < 0 || vi.i >= va.v->nmemb) {
-		// TODO: throw ArrayIndexOutOfBoundsException
-	}
-	((float *)va.v->obj)[vi.i] = i.f;
+	ARRAY_ELEM(va.v, int64_t, vi.i) = vv.l;
 	return NO_RETURN;
 }
 
-static int 
-opiaload(Frame *frame)
+/* lastore: store into long array */
+static int
+oplastore(Frame *frame)
+{
+	checkindex(frame, 1);
+	return oplastore_quick(frame);
+}
+
+/* daload_quick: load double from array at an index in bounds */
+static int
+opdaload_quick(Frame *frame)
 {
 	Value va, vi, v;
 
 	vi = frame_stackpop(frame);
 	va = frame_stackpop(frame);
-	v.i = ((int *)va.v->obj)[vi.i];
+	v.d = ARRAY_ELEM(va.v, double, vi.i);
 	frame_stackpush(frame, v);
-	
-	return NO_RETURN; 
+	return NO_RETURN;
 }
 
+/* daload: load double from array */
 static int
-opiastore(Frame *frame)
+opdaload(Frame *frame)
+{
+	checkindex(frame, 0);
+	return opdaload_quick(frame);
+}
+
+/* dastore_quick: store into double array at an index in bounds */
+static int
+opdastore_quick(Frame *frame)
 {
 	Value va, vi, vv;
 
 	vv = frame_stackpop(frame);
 	vi = frame_stackpop(frame);
 	va = frame_stackpop(frame);
-	if (va.v->obj == NULL) {
-		// TODO: throw NullPointerException
-	}
-	if (vi.i < 0 || vi.i >= va.v->nmemb) {
-		// TODO: throw ArrayIndexOutOfBoundsException
-	}
-	((int*)va.v->obj)[vi.i] = vv.i;
+	ARRAY_ELEM(va.v, double, vi.i) = vv.d;
 	return NO_RETURN;
 }
 
+/* dastore: store into double array */
+static int
+opdastore(Frame *frame)
+{
+	checkindex(frame, 1);
+	return opdastore_quick(frame);
+}
 
+/* goto: branch always */
 static int
 opgoto(Frame *frame)
 {
-	U2 i;
+	return branchif(frame, 1);
+}
 
-	i = frame->code->code[frame->pc++] << 8;
-	i |= frame->code->code[frame->pc++];
-	frame->pc = frame->pc + i;
+/* goto_w: branch always (wide index) */
+static int
+opgoto_w(Frame *frame)
+{
+	int32_t off;
+	U2 base;
+	U1 a, b, c, d;
 
-	return NO_RETURN;
+	base = frame->pc - 1;
+	a = frame->code->code[frame->pc++];
+	b = frame->code->code[frame->pc++];
+	c = frame->code->code[frame->pc++];
+	d = frame->code->code[frame->pc++];
+	off = ((U4)a << 24) | (b << 16) | (c << 8) | d;
+	return branch(frame, base, off);
 }
 
 static int
@@ -1546,7 +2585,8 @@ opiinc(Frame *frame)
 {
 
 	Value v1, v2;
-	U1 index, cons;
+	U1 index;
+	int8_t cons;
 
 	index = frame->code->code[frame->pc++];
 	cons = frame->code->code[frame->pc++];
@@ -1557,6 +2597,40 @@ opiinc(Frame *frame)
 
 	return NO_RETURN;
 }
+
+/* wide: access local variable by 16-bit index, or increment it by 16-bit constant */
+static int
+opwide(Frame *frame)
+{
+	Value v;
+	U1 op;
+	U2 i;
+
+	op = frame->code->code[frame->pc++];
+	i = frame->code->code[frame->pc++] << 8;
+	i |= frame->code->code[frame->pc++];
+	switch (op) {
+	case ILOAD: case LLOAD: case FLOAD: case DLOAD: case ALOAD:
+		frame_stackpush(frame, frame_localload(frame, i));
+		break;
+	case ISTORE: case FSTORE: case ASTORE:
+		frame_localstore(frame, i, frame_stackpop(frame));
+		break;
+	case LSTORE: case DSTORE:
+		v = frame_stackpop(frame);
+		frame_localstore(frame, i, v);
+		frame_localstore(frame, i + 1, v);
+		break;
+	case IINC:
+		v = frame_localload(frame, i);
+		v.i += class_get16(&frame->code->code[frame->pc]);
+		frame->pc += 2;
+		frame_localstore(frame, i, v);
+		break;
+	}
+	return NO_RETURN;
+}
+
 /* ireturn: return something from method */
 static int
 opireturn(Frame *frame)
@@ -1581,227 +2655,412 @@ opnop(Frame *frame)
 	return NO_RETURN;
 }
 
+/* pop arguments of method from operand stack of frame into local variables of newframe */
+static void
+passargs(Frame *frame, Frame *newframe, Method *method, char *descriptor)
+{
+	U2 local[256];          /* local variable of each argument */
+	U1 wide[256];
+	Value v;
+	char *s;
+	U2 i;
+	int n;
+
+	n = 0;
+	i = 0;
+	if (!(method->access_flags & ACC_STATIC)) {
+		local[n] = i++;
+		wide[n++] = 0;
+	}
+	for (s = descriptor + 1; *s && *s != ')' && n < 256; s++) {
+		local[n] = i;
+		wide[n] = (*s == 'J' || *s == 'D');
+		i += wide[n++] ? 2 : 1;
+		while (*s == '[')
+			s++;
+		if (*s == 'L') {
+			while (*s && *s != ';') {
+				s++;
+			}
+		}
+	}
+	while (n-- > 0) {
+		v = frame_stackpop(frame);
+		frame_localstore(newframe, local[n], v);
+		if (wide[n]) {
+			frame_localstore(newframe, local[n] + 1, v);
+		}
+	}
+}
+
+/* collect garbage if the heap needs it; frames must be stopped where their maps apply */
+static void
+safepoint(void)
+{
+	if (heap_needcollect()) {
+		gc_collect(classes);
+	}
+}
+
+/* interpreter routine of each instruction */
+static Handler *instrtab[] = {
+	/*
+	 * some functions are used in more than one instructions,
+	 * for example, there is no opareturn, opdreturn or oplreturn,
+	 * there is only opireturn, that implements all function that
+	 * return something.
+	 */
+	[NOP]             = opnop,
+	[ACONST_NULL]     = opaconst_null,
+	[ICONST_M1]       = opiconst_m1,
+	[ICONST_0]        = opiconst_0,
+	[ICONST_1]        = opiconst_1,
+	[ICONST_2]        = opiconst_2,
+	[ICONST_3]        = opiconst_3,
+	[ICONST_4]        = opiconst_4,
+	[ICONST_5]        = opiconst_5,
+	[LCONST_0]        = oplconst_0,
+	[LCONST_1]        = oplconst_1,
+	[FCONST_0]        = opfconst_0,
+	[FCONST_1]        = opfconst_1,
+	[FCONST_2]        = opfconst_2,
+	[DCONST_0]        = opdconst_0,
+	[DCONST_1]        = opdconst_1,
+	[BIPUSH]          = opbipush,
+	[SIPUSH]          = opsipush,
+	[LDC]             = opldc,
+	[LDC_W]           = opldc_w,
+	[LDC2_W]          = opldc2_w,
+	[ILOAD]           = opiload,
+	[LLOAD]           = oplload,
+	[FLOAD]           = opiload,
+	[DLOAD]           = oplload,
+	[ALOAD]           = opiload,
+	[ILOAD_0]         = opiload_0,
+	[ILOAD_1]         = opiload_1,
+	[ILOAD_2]         = opiload_2,
+	[ILOAD_3]         = opiload_3,
+	[LLOAD_0]         = oplload_0,
+	[LLOAD_1]         = oplload_1,
+	[LLOAD_2]         = oplload_2,
+	[LLOAD_3]         = oplload_3,
+	[FLOAD_0]         = opiload_0,
+	[FLOAD_1]         = opiload_1,
+	[FLOAD_2]         = opiload_2,
+	[FLOAD_3]         = opiload_3,
+	[DLOAD_0]         = oplload_0,
+	[DLOAD_1]         = oplload_1,
+	[DLOAD_2]         = oplload_2,
+	[DLOAD_3]         = oplload_3,
+	[ALOAD_0]         = opiload_0,
+	[ALOAD_1]         = opiload_1,
+	[ALOAD_2]         = opiload_2,
+	[ALOAD_3]         = opiload_3,
+	[IALOAD]          = opiaload,
+	[LALOAD]          = oplaload,
+	[FALOAD]          = opfaload,
+	[DALOAD]          = opdaload,
+	[AALOAD]          = opaaload,
+	[BALOAD]          = opbaload,
+	[CALOAD]          = opcaload,
+	[SALOAD]          = opsaload,
+	[ISTORE]          = opistore,
+	[LSTORE]          = oplstore,
+	[FSTORE]          = opistore,
+	[DSTORE]          = oplstore,
+	[ASTORE]          = opistore,
+	[ISTORE_0]        = opistore_0,
+	[ISTORE_1]        = opistore_1,
+	[ISTORE_2]        = opistore_2,
+	[ISTORE_3]        = opistore_3,
+	[LSTORE_0]        = oplstore_0,
+	[LSTORE_1]        = oplstore_1,
+	[LSTORE_2]        = oplstore_2,
+	[LSTORE_3]        = oplstore_3,
+	[FSTORE_0]        = opistore_0,
+	[FSTORE_1]        = opistore_1,
+	[FSTORE_2]        = opistore_2,
+	[FSTORE_3]        = opistore_3,
+	[DSTORE_0]        = oplstore_0,
+	[DSTORE_1]        = oplstore_1,
+	[DSTORE_2]        = oplstore_2,
+	[DSTORE_3]        = oplstore_3,
+	[ASTORE_0]        = opistore_0,
+	[ASTORE_1]        = opistore_1,
+	[ASTORE_2]        = opistore_2,
+	[ASTORE_3]        = opistore_3,
+	[IASTORE]         = opiastore,
+	[LASTORE]         = oplastore,
+	[FASTORE]         = opfastore,
+	[DASTORE]         = opdastore,
+	[AASTORE]         = opaastore,
+	[BASTORE]         = opbastore,
+	[CASTORE]         = opcastore,
+	[SASTORE]         = opsastore,
+	[POP]             = oppop,
+	[POP2]            = oppop2,
+	[DUP]             = opdup,
+	[DUP_X1]          = opdup_x1,
+	[DUP_X2]          = opdup_x2,
+	[DUP2]            = opdup2,
+	[DUP2_X1]         = opdup2_x1,
+	[DUP2_X2]         = opdup2_x2,
+	[SWAP]            = opswap,
+	[IADD]            = opiadd,
+	[LADD]            = opladd,
+	[FADD]            = opfadd,
+	[DADD]            = opdadd,
+	[ISUB]            = opisub,
+	[LSUB]            = oplsub,
+	[FSUB]            = opfsub,
+	[DSUB]            = opdsub,
+	[IMUL]            = opimul,
+	[LMUL]            = oplmul,
+	[FMUL]            = opfmul,
+	[DMUL]            = opdmul,
+	[IDIV]            = opidiv,
+	[LDIV]            = opldiv,
+	[FDIV]            = opfdiv,
+	[DDIV]            = opddiv,
+	[IREM]            = opirem,
+	[LREM]            = oplrem,
+	[FREM]            = opfrem,
+	[DREM]            = opdrem,
+	[INEG]            = opineg,
+	[LNEG]            = oplneg,
+	[FNEG]            = opfneg,
+	[DNEG]            = opdneg,
+	[ISHL]            = opishl,
+	[LSHL]            = oplshl,
+	[ISHR]            = opishr,
+	[LSHR]            = oplshr,
+	[IUSHR]           = opiushr,
+	[LUSHR]           = oplushr,
+	[IAND]            = opiand,
+	[LAND]            = opland,
+	[IOR]             = opior,
+	[LOR]             = oplor,
+	[IXOR]            = opixor,
+	[LXOR]            = oplxor,
+	[IINC]            = opiinc,
+	[I2L]             = opi2l,
+	[I2F]             = opi2f,
+	[I2D]             = opi2d,
+	[L2I]             = opl2i,
+	[L2F]             = opl2f,
+	[L2D]             = opl2d,
+	[F2I]             = opf2i,
+	[F2L]             = opf2l,
+	[F2D]             = opf2d,
+	[D2I]             = opd2i,
+	[D2L]             = opd2l,
+	[D2F]             = opd2f,
+	[I2B]             = opi2b,
+	[I2C]             = opi2c,
+	[I2S]             = opi2s,
+	[LCMP]            = oplcmp,
+	[FCMPL]           = opfcmpl,
+	[FCMPG]           = opfcmpg,
+	[DCMPL]           = opdcmpl,
+	[DCMPG]           = opdcmpg,
+	[IFEQ]            = opifeq,
+	[IFNE]            = opifne,
+	[IFLT]            = opiflt,
+	[IFGE]            = opifge,
+	[IFGT]            = opifgt,
+	[IFLE]            = opifle,
+	[IF_ICMPEQ]       = opif_icmpeq,
+	[IF_ICMPNE]       = opif_icmpne,
+	[IF_ICMPLT]       = opif_icmplt,
+	[IF_ICMPGE]       = opif_icmpge,
+	[IF_ICMPGT]       = opif_icmpgt,
+	[IF_ICMPLE]       = opif_icmple,
+	[IF_ACMPEQ]       = opif_acmpeq,
+	[IF_ACMPNE]       = opif_acmpne,
+	[GOTO]            = opgoto,
+	[JSR]             = opnop,
+	[RET]             = opnop,
+	[TABLESWITCH]     = optableswitch,
+	[LOOKUPSWITCH]    = oplookupswitch,
+	[IRETURN]         = opireturn,
+	[LRETURN]         = opireturn,
+	[FRETURN]         = opireturn,
+	[DRETURN]         = opireturn,
+	[ARETURN]         = opireturn,
+	[RETURN]          = opreturn,
+	[GETSTATIC]       = opgetstatic,
+	[PUTSTATIC]       = opputstatic,
+	[GETFIELD]        = opnop,
+	[PUTFIELD]        = opnop,
+	[INVOKEVIRTUAL]   = opinvokevirtual,
+	[INVOKESPECIAL]   = opnop,
+	[INVOKESTATIC]    = opinvokestatic,
+	[INVOKEINTERFACE] = opnop,
+	[INVOKEDYNAMIC]   = opinvokedynamic,
+	[NEW]             = opnop,
+	[NEWARRAY]        = opnewarray,
+	[ANEWARRAY]       = opanewarray,
+	[ARRAYLENGTH]     = oparraylength,
+	[ATHROW]          = opnop,
+	[CHECKCAST]       = opnop,
+	[INSTANCEOF]      = opnop,
+	[MONITORENTER]    = opnop,
+	[MONITOREXIT]     = opnop,
+	[WIDE]            = opwide,
+	[MULTIANEWARRAY]  = opmultianewarray,
+	[IFNULL]          = opifnull,
+	[IFNONNULL]       = opifnonnull,
+	[GOTO_W]          = opgoto_w,
+	[JSR_W]           = opnop,
+	[IALOAD_QUICK]    = opiaload_quick,
+	[LALOAD_QUICK]    = oplaload_quick,
+	[FALOAD_QUICK]    = opfaload_quick,
+	[DALOAD_QUICK]    = opdaload_quick,
+	[AALOAD_QUICK]    = opaaload_quick,
+	[BALOAD_QUICK]    = opbaload_quick,
+	[CALOAD_QUICK]    = opcaload_quick,
+	[SALOAD_QUICK]    = opsaload_quick,
+	[IASTORE_QUICK]   = opiastore_quick,
+	[LASTORE_QUICK]   = oplastore_quick,
+	[FASTORE_QUICK]   = opfastore_quick,
+	[DASTORE_QUICK]   = opdastore_quick,
+	[AASTORE_QUICK]   = opaastore_quick,
+	[BASTORE_QUICK]   = opbastore_quick,
+	[CASTORE_QUICK]   = opcastore_quick,
+	[SASTORE_QUICK]   = opsastore_quick,
+};
+
+static int run(Frame *frame);
+
+/* compile trace recorded; return HOT_TRACE to run it, or HOT_LOOP to compile the method of its loop instead */
+static int
+compiletrace(Trace *trace)
+{
+	if (trace->root != NULL) {
+		/* the side exit keeps returning to the interpreter if its path cannot be compiled */
+		if ((trace->fn = jit_trace(trace, instrtab)) != NULL)
+			trace->root->nsides++;
+		return HOT_TRACE;
+	}
+	if ((trace->fn = jit_trace(trace, instrtab)) == NULL) {
+		trace->code->tracefails = TRACE_MAXFAILS;
+		return HOT_LOOP;
+	}
+	trace_add(trace);
+	trace->code->backedges = 0;
+	return HOT_TRACE;
+}
+
+/* rebuild frames of the calls a trace left in the middle of, innermost on top; return the innermost */
+static Frame *
+resume(Frame *frame, TraceCall *call)
+{
+	Frame *caller, *newframe;
+
+	caller = (call->caller != NULL) ? resume(frame, call->caller) : frame;
+	caller->pc = call->pc + 3;
+	caller->nstack = call->sp;
+	if ((newframe = frame_push(call->frame.code, call->frame.class)) == NULL)
+		err(EXIT_FAILURE, "out of memory");
+	memcpy(newframe->local, call->frame.local, call->frame.code->max_locals * sizeof *newframe->local);
+	memcpy(newframe->stack, call->frame.stack, call->frame.nstack * sizeof *newframe->stack);
+	newframe->nstack = call->frame.nstack;
+	newframe->pc = call->frame.pc;
+	return newframe;
+}
+
+/*
+ * Run compiled trace of the loop at the pc of frame until it takes a
+ * side exit.  If it leaves inside a call, the interpreter finishes the
+ * calls from frames rebuilt for them.  Either way, frame is left at the
+ * instruction of the loop's method where the interpreter resumes.  The
+ * path from an exit taken often is recorded as a side trace.  Return -1
+ * if the trace leaves its path too often to be kept.
+ */
+static int
+runtrace(Frame *frame, Trace *trace)
+{
+	Frame *f, *caller;
+	TraceExit *e;
+	int i;
+
+	i = ((JitCode *)trace->fn)(frame);
+	if (i < 0 || (size_t)i >= trace->nexits)
+		errx(EXIT_FAILURE, "trace left its loop unexpectedly");
+	trace->exited++;
+	e = &trace->exits[i];
+	f = (e->call != NULL) ? resume(frame, e->call) : frame;
+	if (++e->taken == TRACE_HOTEXIT && trace->nsides < TRACE_MAXSIDES && trace_recording == NULL)
+		trace_beginside(trace, i, f);
+	if (e->call != NULL) {
+		for (; f != frame; f = caller) {
+			caller = f->next;
+			if (run(f) == RETURN_OPERAND)
+				frame_stackpush(caller, frame_stackpop(f));
+			frame_pop();
+		}
+	}
+	if (trace->exited >= TRACE_MINEXITS && trace->iterations < trace->exited * TRACE_MINRUN) {
+		trace_remove(trace);
+		trace->code->tracefails = TRACE_MAXFAILS;
+		return -1;
+	}
+	return 0;
+}
+
+/* run frame in the interpreter from its pc, recording and running traces of hot loops or compiling them whole */
+static int
+run(Frame *frame)
+{
+	Code_attribute *code = frame->code;
+	Trace *trace;
+	int ret = NO_RETURN;
+
+	while (frame->pc < code->code_length) {
+		if (heap_needcollect())
+			gc_collect(classes);
+		ret = NO_RETURN;
+		if (trace_recording != NULL && (trace = trace_step(frame)) != NULL)
+			ret = compiletrace(trace);
+		if (ret == NO_RETURN && (ret = (*instrtab[code->code[frame->pc++]])(frame)) == NO_RETURN)
+			continue;
+		if (ret == HOT_TRACE) {
+			/* a side trace being recorded ends at the loop head */
+			if (trace_recording != NULL && (trace = trace_step(frame)) != NULL)
+				compiletrace(trace);
+			trace_abort();
+			if (runtrace(frame, trace_find(code, frame->pc)) == 0)
+				continue;
+			ret = HOT_LOOP;
+		}
+		if (ret != HOT_LOOP)
+			break;
+		trace_abort();
+		if (usetraces && code->tracefails < TRACE_MAXFAILS) {
+			/* record the path of an iteration; meanwhile, calls run in the interpreter */
+			trace_begin(frame);
+			continue;
+		}
+		/* on-stack replacement: the frame continues at the loop head in compiled code */
+		if (code->jit == NULL)
+			code->jit = jit_compile(frame->class, code, instrtab);
+		if (code->jit != NULL) {
+			ret = ((JitCode *)code->jit)(frame);
+			break;
+		}
+	}
+	return ret;
+}
+
 /* call method */
 int
 methodcall(ClassFile *class, Frame *frame, char *name, char *descriptor, U2 flags)
 {
-	static int(*instrtab[])(Frame *) = {
-		/*
-		 * some functions are used in more than one instructions,
-		 * for example, there is no opareturn, opdreturn or oplreturn,
-		 * there is only opireturn, that implements all function that
-		 * return something.
-		 */
-		[NOP]             = opnop,
-		[ACONST_NULL]     = opnop,
-		[ICONST_M1]       = opiconst_m1,
-		[ICONST_0]        = opiconst_0,
-		[ICONST_1]        = opiconst_1,
-		[ICONST_2]        = opiconst_2,
-		[ICONST_3]        = opiconst_3,
-		[ICONST_4]        = opiconst_4,
-		[ICONST_5]        = opiconst_5,
-		[LCONST_0]        = oplconst_0,
-		[LCONST_1]        = oplconst_1,
-		[FCONST_0]        = opfconst_0,
-		[FCONST_1]        = opfconst_1,
-		[FCONST_2]        = opfconst_2,
-		[DCONST_0]        = opdconst_0,
-		[DCONST_1]        = opdconst_1,
-		[BIPUSH]          = opbipush,
-		[SIPUSH]          = opsipush,
-		[LDC]             = opldc,
-		[LDC_W]           = opldc_w,
-		[LDC2_W]          = opldc2_w,
-		[ILOAD]           = opiload,
-		[LLOAD]           = oplload,
-		[FLOAD]           = opiload,
-		[DLOAD]           = oplload,
-		[ALOAD]           = opiload,
-		[ILOAD_0]         = opiload_0,
-		[ILOAD_1]         = opiload_1,
-		[ILOAD_2]         = opiload_2,
-		[ILOAD_3]         = opiload_3,
-		[LLOAD_0]         = oplload_0,
-		[LLOAD_1]         = oplload_1,
-		[LLOAD_2]         = oplload_2,
-		[LLOAD_3]         = oplload_3,
-		[FLOAD_0]         = opiload_0,
-		[FLOAD_1]         = opiload_1,
-		[FLOAD_2]         = opiload_2,
-		[FLOAD_3]         = opiload_3,
-		[DLOAD_0]         = oplload_0,
-		[DLOAD_1]         = oplload_1,
-		[DLOAD_2]         = oplload_2,
-		[DLOAD_3]         = oplload_3,
-		[ALOAD_0]         = opiload_0,
-		[ALOAD_1]         = opiload_1,
-		[ALOAD_2]         = opiload_2,
-		[ALOAD_3]         = opiload_3,
-		[IALOAD]          = opiaload,
-		[LALOAD]          = opnop,
-		[FALOAD]          = opfaload,
-		[DALOAD]          = opnop,
-		[AALOAD]          = opaaload,
-		[BALOAD]          = opbaload,
-		[CALOAD]          = opcaload,
-		[SALOAD]          = opsaload,
-		[ISTORE]          = opistore,
-		[LSTORE]          = oplstore,
-		[FSTORE]          = opistore,
-		[DSTORE]          = oplstore,
-		[ASTORE]          = opistore,
-		[ISTORE_0]        = opistore_0,
-		[ISTORE_1]        = opistore_1,
-		[ISTORE_2]        = opistore_2,
-		[ISTORE_3]        = opistore_3,
-		[LSTORE_0]        = oplstore_0,
-		[LSTORE_1]        = oplstore_1,
-		[LSTORE_2]        = oplstore_2,
-		[LSTORE_3]        = oplstore_3,
-		[FSTORE_0]        = opistore_0,
-		[FSTORE_1]        = opistore_1,
-		[FSTORE_2]        = opistore_2,
-		[FSTORE_3]        = opistore_3,
-		[DSTORE_0]        = oplstore_0,
-		[DSTORE_1]        = oplstore_1,
-		[DSTORE_2]        = oplstore_2,
-		[DSTORE_3]        = oplstore_3,
-		[ASTORE_0]        = opistore_0,
-		[ASTORE_1]        = opistore_1,
-		[ASTORE_2]        = opistore_2,
-		[ASTORE_3]        = opistore_3,
-		[IASTORE]         = opiastore,
-		[LASTORE]         = opnop,
-		[FASTORE]         = opfastore,
-		[DASTORE]         = opnop,
-		[AASTORE]         = opaastore,
-		[BASTORE]         = opbastore,
-		[CASTORE]         = opcastore,
-		[SASTORE]         = opsastore,
-		[POP]             = oppop,
-		[POP2]            = oppop2,
-		[DUP]             = opdup,
-		[DUP_X1]          = opdup_x1,
-		[DUP_X2]          = opdup_x2,
-		[DUP2]            = opdup2,
-		[DUP2_X1]         = opdup2_x1,
-		[DUP2_X2]         = opdup2_x2,
-		[SWAP]            = opnop,
-		[IADD]            = opiadd,
-		[LADD]            = opladd,
-		[FADD]            = opfadd,
-		[DADD]            = opdadd,
-		[ISUB]            = opisub,
-		[LSUB]            = oplsub,
-		[FSUB]            = opfsub,
-		[DSUB]            = opdsub,
-		[IMUL]            = opimul,
-		[LMUL]            = oplmul,
-		[FMUL]            = opfmul,
-		[DMUL]            = opdmul,
-		[IDIV]            = opidiv,
-		[LDIV]            = opldiv,
-		[FDIV]            = opfdiv,
-		[DDIV]            = opddiv,
-		[IREM]            = opirem,
-		[LREM]            = oplrem,
-		[FREM]            = opfrem,
-		[DREM]            = opdrem,
-		[INEG]            = opineg,
-		[LNEG]            = oplneg,
-		[FNEG]            = opfneg,
-		[DNEG]            = opdneg,
-		[ISHL]            = opnop,
-		[LSHL]            = opnop,
-		[ISHR]            = opnop,
-		[LSHR]            = opnop,
-		[IUSHR]           = opnop,
-		[LUSHR]           = opnop,
-		[IAND]            = opnop,
-		[LAND]            = opnop,
-		[IOR]             = opnop,
-		[LOR]             = opnop,
-		[IXOR]            = opnop,
-		[LXOR]            = opnop,
-		[IINC]            = opiinc,
-		[I2L]             = opnop,
-		[I2F]             = opnop,
-		[I2D]             = opnop,
-		[L2I]             = opnop,
-		[L2F]             = opnop,
-		[L2D]             = opnop,
-		[F2I]             = opnop,
-		[F2L]             = opnop,
-		[F2D]             = opnop,
-		[D2I]             = opnop,
-		[D2L]             = opnop,
-		[D2F]             = opnop,
-		[I2B]             = opnop,
-		[I2C]             = opnop,
-		[I2S]             = opnop,
-		[LCMP]            = opnop,
-		[FCMPL]           = opnop,
-		[FCMPG]           = opnop,
-		[DCMPL]           = opnop,
-		[DCMPG]           = opnop,
-		[IFEQ]            = opnop,
-		[IFNE]            = opnop,
-		[IFLT]            = opnop,
-		[IFGE]            = opnop,
-		[IFGT]            = opnop,
-		[IFLE]            = opnop,
-		[IF_ICMPEQ]       = opnop,
-		[IF_ICMPNE]       = opnop,
-		[IF_ICMPLT]       = opnop,
-		[IF_ICMPGE]       = opif_icmpge,
-		[IF_ICMPGT]       = opnop,
-		[IF_ICMPLE]       = opnop,
-		[IF_ACMPEQ]       = opnop,
-		[IF_ACMPNE]       = opnop,
-		[GOTO]            = opgoto,
-		[JSR]             = opnop,
-		[RET]             = opnop,
-		[TABLESWITCH]     = optableswitch,
-		[LOOKUPSWITCH]    = opnop,
-		[IRETURN]         = opireturn,
-		[LRETURN]         = opireturn,
-		[FRETURN]         = opireturn,
-		[DRETURN]         = opireturn,
-		[ARETURN]         = opireturn,
-		[RETURN]          = opreturn,
-		[GETSTATIC]       = opgetstatic,
-		[PUTSTATIC]       = opnop,
-		[GETFIELD]        = opnop,
-		[PUTFIELD]        = opnop,
-		[INVOKEVIRTUAL]   = opinvokevirtual,
-		[INVOKESPECIAL]   = opnop,
-		[INVOKESTATIC]    = opinvokestatic,
-		[INVOKEINTERFACE] = opnop,
-		[INVOKEDYNAMIC]   = opnop,
-		[NEW]             = opnop,
-		[NEWARRAY]        = opnewarray,
-		[ANEWARRAY]       = opnop,
-		[ARRAYLENGTH]     = oparraylength,
-		[ATHROW]          = opnop,
-		[CHECKCAST]       = opnop,
-		[INSTANCEOF]      = opnop,
-		[MONITORENTER]    = opnop,
-		[MONITOREXIT]     = opnop,
-		[WIDE]            = opnop,
-		[MULTIANEWARRAY]  = opmultianewarray,
-		[IFNULL]          = opnop,
-		[IFNONNULL]       = opnop,
-		[GOTO_W]          = opnop,
-		[JSR_W]           = opnop,
-	};
 	Attribute *cattr;       /* Code_attribute */
 	Code_attribute *code;
 	Frame *newframe;
 	Method *method;
 	Value v;
-	char *s;
-	U2 i, n;
 	int ret = NO_RETURN;
 
 	if ((method = class_getmethod(class, name, descriptor)) == NULL)
@@ -1811,47 +3070,18 @@ methodcall(ClassFile *class, Frame *frame, char *name, char *descriptor, U2 flag
 	if ((cattr = class_getattr(method->attributes, method->attributes_count, Code)) == NULL)
 		err(EXIT_FAILURE, "could not find code for method %s", name);
 	code = &cattr->info.code;
-	if ((newframe = frame_push(code, class, code->max_locals, code->max_stack)) == NULL)
+	if (usejit && code->jit == NULL && method->invocations < compilethreshold &&
+	    ++method->invocations == compilethreshold)
+		code->jit = jit_compile(class, code, instrtab);
+	if ((newframe = frame_push(code, class)) == NULL)
 		err(EXIT_FAILURE, "out of memory");
-	if (frame) {
-		s = descriptor;
-		i = 0;
-		while (*s && *s != ')') {
-			v = frame_stackpop(frame);
-			frame_localstore(newframe, i++, v);
-			switch (*(s++)) {
-			case 'L':
-				while (*s && *s != ';') {
-					s++;
-				}
-				break;
-			case '[':
-				n = 0;
-				while (*s == '[') {
-					s++;
-				}
-				if (*s == 'L') {
-					while (*s && *s != ';') {
-						s++;
-					}
-				} else {
-					s++;
-				}
-				break;
-			case 'D':
-			case 'J':
-				frame_localstore(newframe, i++, v);
-				/* FALLTHROUGH */
-			default:
-				s++;
-				break;
-			}
-		}
-	}
-	while (newframe->pc < code->code_length) {
-		if ((ret = (*instrtab[code->code[newframe->pc++]])(newframe)) != NO_RETURN) {
-			break;
-		}
+	if (frame)
+		passargs(frame, newframe, method, descriptor);
+	if (code->jit != NULL && trace_recording == NULL) {
+		safepoint();
+		ret = ((JitCode *)code->jit)(newframe);
+	} else {
+		ret = run(newframe);
 	}
 	if (ret == RETURN_OPERAND) {
 		v = frame_stackpop(newframe);
@@ -1889,6 +3119,14 @@ main(int argc, char *argv[])
 			if (++i >= argc)
 				usage();
 			cpath = argv[i];
+		} else if (strcmp(argv[i], "-Xint") == 0) {
+			usejit = 0;
+		} else if (strcmp(argv[i], "-Xlog:gc") == 0) {
+			gclog = 1;
+		} else if (strncmp(argv[i], "-XX:", 4) == 0) {
+			if (setoption(argv[i] + 4) == -1) {
+				usage();
+			}
 		} else {
 			usage();
 		}
@@ -1900,6 +3138,20 @@ main(int argc, char *argv[])
 	if (cpath == NULL)
 		cpath = ".";
 	setclasspath(cpath);
+	output_init(flushmode, outputbufsize);
+	heap_init(maxheapsize, newsize, tlabsize, tenure, largesize, compressedoops);
+	gc_init(initheapsize, gcthreads, gclog);
+	jit_init(safepoint);
+	perf_init(perfmap, perfjitdump);
+	atexit(perf_exit);
+	atexit(trace_del);
+	opt_init(maxinlinesize, maxinlinelevel);
+	if (aotlibrary != NULL && usejit) {
+		aotruntime.handlers = instrtab;
+		aotruntime.needcollect = heap_needcollect;
+		aotruntime.safepoint = safepoint;
+		aot_load(aotlibrary, &aotruntime);
+	}
 	atexit(classfree);
 	java(argc, argv);
 	return 0;
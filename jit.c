@@ -0,0 +1,1487 @@
+#define _DEFAULT_SOURCE         /* for MAP_ANONYMOUS and MAP_NORESERVE */
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "util.h"
+#include "class.h"
+#include "frame.h"
+#include "memory.h"
+#include "native.h"
+#include "refmap.h"
+#include "simd.h"
+#include "trace.h"
+#include "jit.h"
+#include "perf.h"
+
+static void (*safepoint)(void) = NULL;  /* called at backward branches to let the collector run */
+
+#if defined(__GNUC__) && defined(__x86_64__)
+
+/* general purpose registers; rbx holds the frame, r12 its local variables and r13 its operand stack */
+enum {
+	RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RSI = 6, RDI = 7, R12 = 12, R13 = 13,
+};
+
+/* condition codes of jcc and setcc */
+enum {
+	CC_ALWAYS = -1,
+	CC_B = 0x2, CC_AE = 0x3, CC_E = 0x4, CC_NE = 0x5, CC_A = 0x7, CC_P = 0xA,
+	CC_L = 0xC, CC_GE = 0xD, CC_LE = 0xE, CC_G = 0xF,
+};
+
+/* prefixes selecting operand size or scalar SSE type */
+enum {
+	P16 = 0x66,             /* 16-bit operand; double for ucomisd */
+	PSD = 0xF2,             /* scalar double */
+	PSS = 0xF3,             /* scalar single */
+};
+
+/* opcodes; those beginning with 0F are given with the escape bytes */
+enum {
+	OP_ADD     = 0x03,      /* add r, r/m */
+	OP_OR      = 0x0B,
+	OP_AND     = 0x23,
+	OP_SUB8    = 0x28,      /* sub r/m8, r8 */
+	OP_SUB     = 0x2B,
+	OP_XOR     = 0x33,
+	OP_CMP     = 0x3B,
+	OP_MOVSXD  = 0x63,
+	OP_GRP32   = 0x81,      /* add, or, and, sub, xor, cmp r/m, imm32, by opcode extension */
+	OP_GRP8    = 0x83,      /* the same with sign-extended imm8 */
+	OP_TEST    = 0x85,
+	OP_STORE8  = 0x88,      /* mov r/m8, r8 */
+	OP_STORE   = 0x89,      /* mov r/m, r */
+	OP_LOAD    = 0x8B,      /* mov r, r/m */
+	OP_MOVIMM  = 0xC7,      /* mov r/m, imm32 */
+	OP_SHIFT   = 0xD3,      /* shl, shr, sar r/m, cl, by opcode extension */
+	OP_UNARY   = 0xF7,      /* neg, idiv r/m, by opcode extension */
+	OP_MOVSSE  = 0x0F10,    /* movss, movsd xmm, m */
+	OP_STSSE   = 0x0F11,    /* movss, movsd m, xmm */
+	OP_CVTSI   = 0x0F2A,    /* cvtsi2ss, cvtsi2sd xmm, r/m */
+	OP_UCOMI   = 0x0F2E,
+	OP_CMOV    = 0x0F40,    /* cmovcc r, r/m, plus condition code */
+	OP_SQRTSSE = 0x0F51,
+	OP_ADDSSE  = 0x0F58,
+	OP_MULSSE  = 0x0F59,
+	OP_CVTFP   = 0x0F5A,    /* cvtss2sd, cvtsd2ss xmm, m */
+	OP_SUBSSE  = 0x0F5C,
+	OP_DIVSSE  = 0x0F5E,
+	OP_SETCC   = 0x0F90,    /* setcc r/m8, plus condition code */
+	OP_IMUL    = 0x0FAF,
+	OP_MOVZX16 = 0x0FB7,
+	OP_POPCNT  = 0x0FB8,    /* with prefix F3 */
+	OP_BT      = 0x0FBA,    /* bt, btc r/m, imm8, by opcode extension */
+	OP_MOVSX8  = 0x0FBE,
+	OP_LZCNT   = 0x0FBD,    /* with prefix F3; bsr without it */
+	OP_MOVSX16 = 0x0FBF,
+	OP_ROUNDSD = 0x0F3A0B,  /* with prefix 66 and imm8 rounding mode */
+};
+
+/* operands of local variable i, operand stack slot i and frame member m */
+#define LOCAL(i)        R12, 8 * (int32_t)(i)
+#define STACK(i)        R13, 8 * (int32_t)(i)
+#define FRAME(m)        RBX, (int32_t)offsetof(Frame, m)
+
+/* offset of the first element of an array from its header */
+#define ELEMS           ((int8_t)sizeof (Heap))
+
+/* jump to an instruction, patched once every instruction has been emitted */
+typedef struct Fixup {
+	size_t  at;             /* offset of 32-bit displacement */
+	U4      pc;             /* target instruction; code_length for the epilogue */
+} Fixup;
+
+/* side exit of a trace, whose code follows the loop */
+typedef struct Exit {
+	size_t          at;             /* offset of 32-bit displacement of the guard taking it */
+	TraceCall      *call;           /* call the guard is in, whose frame is in rbx */
+	U2              pc;             /* instruction the interpreter resumes at */
+	int             sp;
+} Exit;
+
+/* state of the compilation of a method or trace */
+typedef struct Jit {
+	ClassFile      *class;
+	Code_attribute *code;
+	Handler       **handlers;
+	U1             *buf;            /* machine code */
+	size_t          len;
+	size_t          cap;
+	size_t         *addr;           /* offset of the code of each instruction, then of the epilogue */
+	Fixup          *fixups;
+	size_t          nfixups;
+	size_t          fixupcap;
+	Exit           *exits;
+	size_t          nexits;
+	size_t          exitcap;
+} Jit;
+
+static char *cache = NULL;              /* reserved code memory */
+static size_t cacheused = 0;            /* bytes of code memory in use */
+
+/* conditions of ifeq to ifle, and of if_icmpeq to if_icmple */
+static const int ifcc[] = {CC_E, CC_NE, CC_L, CC_GE, CC_G, CC_LE};
+
+/* conversions of floating-point to integer values, which saturate and take NaN to zero */
+static int32_t
+f2i(float f)
+{
+	return (f != f) ? 0 : (f >= 2147483648.0f) ? INT32_MAX : (f <= -2147483648.0f) ? INT32_MIN : (int32_t)f;
+}
+
+static int64_t
+f2l(float f)
+{
+	return (f != f) ? 0 : (f >= 9223372036854775808.0f) ? INT64_MAX : (f <= -9223372036854775808.0f) ? INT64_MIN : (int64_t)f;
+}
+
+static int32_t
+d2i(double d)
+{
+	return (d != d) ? 0 : (d >= 2147483647.0) ? INT32_MAX : (d <= -2147483648.0) ? INT32_MIN : (int32_t)d;
+}
+
+static int64_t
+d2l(double d)
+{
+	return (d != d) ? 0 : (d >= 9223372036854775808.0) ? INT64_MAX : (d <= -9223372036854775808.0) ? INT64_MIN : (int64_t)d;
+}
+
+/* emit byte of code */
+static void
+byte(Jit *j, int b)
+{
+	U1 *p;
+
+	if (j->len == j->cap) {
+		j->cap = j->cap ? 2 * j->cap : 1024;
+		if ((p = realloc(j->buf, j->cap)) == NULL)
+			err(EXIT_FAILURE, "realloc");
+		j->buf = p;
+	}
+	j->buf[j->len++] = b;
+}
+
+/* emit little-endian immediate of n bytes */
+static void
+imm(Jit *j, int64_t v, int n)
+{
+	uint64_t u = v;
+
+	while (n-- > 0) {
+		byte(j, u & 0xFF);
+		u >>= 8;
+	}
+}
+
+/* emit prefix, REX prefix for 64-bit operand w or high registers r, x and b, and opcode */
+static void
+opcode(Jit *j, int pfx, int w, U4 op, int r, int x, int b)
+{
+	int rex;
+
+	if (pfx)
+		byte(j, pfx);
+	rex = 0x40 | w << 3 | (r & 8) >> 1 | (x & 8) >> 2 | (b & 8) >> 3;
+	if (rex != 0x40)
+		byte(j, rex);
+	if (op > 0xFFFF)
+		byte(j, op >> 16);
+	if (op > 0xFF)
+		byte(j, (op >> 8) & 0xFF);
+	byte(j, op & 0xFF);
+}
+
+/* emit instruction on register or opcode extension r and memory at base + disp */
+static void
+mem(Jit *j, int pfx, int w, U4 op, int r, int base, int32_t disp)
+{
+	opcode(j, pfx, w, op, r, 0, base);
+	byte(j, 0x80 | (r & 7) << 3 | (base & 7));
+	if ((base & 7) == RSP)
+		byte(j, 0x24);
+	imm(j, disp, 4);
+}
+
+/* emit instruction on register or opcode extension r and register rm */
+static void
+reg(Jit *j, int pfx, int w, U4 op, int r, int rm)
+{
+	opcode(j, pfx, w, op, r, 0, rm);
+	byte(j, 0xC0 | (r & 7) << 3 | (rm & 7));
+}
+
+/* emit instruction on register r and element at index of given size of the array at base */
+static void
+elem(Jit *j, int pfx, int w, U4 op, int r, int base, int index, int size)
+{
+	int scale;
+
+	for (scale = 0; 1 << scale < size; scale++)
+		;
+	opcode(j, pfx, w, op, r, index, base);
+	byte(j, 0x40 | (r & 7) << 3 | RSP);
+	byte(j, scale << 6 | (index & 7) << 3 | (base & 7));
+	byte(j, ELEMS);
+}
+
+/* emit jump, unconditional if cc is CC_ALWAYS; return offset of its displacement */
+static size_t
+jump(Jit *j, int cc)
+{
+	if (cc == CC_ALWAYS) {
+		byte(j, 0xE9);
+	} else {
+		byte(j, 0x0F);
+		byte(j, 0x80 | cc);
+	}
+	imm(j, 0, 4);
+	return j->len - 4;
+}
+
+/* make jump whose displacement is at offset at land at the current end of code */
+static void
+land(Jit *j, size_t at)
+{
+	int32_t d;
+
+	d = j->len - (at + 4);
+	memcpy(&j->buf[at], &d, sizeof d);
+}
+
+/* emit jump to instruction pc */
+static void
+jumpto(Jit *j, int cc, U4 pc)
+{
+	Fixup *p;
+
+	if (j->nfixups == j->fixupcap) {
+		j->fixupcap = j->fixupcap ? 2 * j->fixupcap : 64;
+		if ((p = realloc(j->fixups, j->fixupcap * sizeof *p)) == NULL)
+			err(EXIT_FAILURE, "realloc");
+		j->fixups = p;
+	}
+	j->fixups[j->nfixups].at = jump(j, cc);
+	j->fixups[j->nfixups++].pc = pc;
+}
+
+/* emit call of C function */
+static void
+call(Jit *j, uintptr_t fn)
+{
+	byte(j, 0x48);                          /* mov rax, imm64 */
+	byte(j, 0xB8);
+	imm(j, fn, 8);
+	byte(j, 0xFF);                          /* call rax */
+	byte(j, 0xD0);
+}
+
+/* emit store of frame state: the instruction at pc is next, with sp operand stack slots */
+static void
+saveframe(Jit *j, U4 pc, int sp)
+{
+	mem(j, P16, 0, OP_MOVIMM, 0, FRAME(pc));
+	imm(j, pc, 2);
+	mem(j, 0, 1, OP_MOVIMM, 0, FRAME(nstack));
+	imm(j, sp, 4);
+}
+
+/* emit call of the interpreter routine of the instruction at pc, leaving the method if it returns */
+static void
+interpret(Jit *j, U4 pc, int sp)
+{
+	saveframe(j, pc + 1, sp);
+	reg(j, 0, 1, OP_STORE, RBX, RDI);
+	call(j, (uintptr_t)j->handlers[j->code->code[pc]]);
+	reg(j, 0, 0, OP_TEST, RAX, RAX);
+	jumpto(j, CC_NE, j->code->code_length);
+}
+
+/* emit safepoint before the instruction at pc, where the collector sees the frame as the interpreter leaves it */
+static void
+poll(Jit *j, U4 pc, int sp)
+{
+	saveframe(j, pc, sp);
+	call(j, (uintptr_t)safepoint);
+}
+
+/* emit return of method with given result */
+static void
+leave(Jit *j, int ret, int sp)
+{
+	mem(j, 0, 1, OP_MOVIMM, 0, FRAME(nstack));
+	imm(j, sp, 4);
+	byte(j, 0xB8);                          /* mov eax, imm32 */
+	imm(j, ret, 4);
+	jumpto(j, CC_ALWAYS, j->code->code_length);
+}
+
+/* emit push of constant bits */
+static void
+constant(Jit *j, int sp, int64_t v)
+{
+	if (v >= INT32_MIN && v <= INT32_MAX) {
+		mem(j, 0, 1, OP_MOVIMM, 0, STACK(sp));
+		imm(j, v, 4);
+	} else {
+		byte(j, 0x48);                  /* mov rax, imm64 */
+		byte(j, 0xB8);
+		imm(j, v, 8);
+		mem(j, 0, 1, OP_STORE, RAX, STACK(sp));
+	}
+}
+
+/* emit push of constant pool entry; return -1 if it is not a number */
+static int
+ldc(Jit *j, int sp, U2 index)
+{
+	int64_t l;
+	double d;
+	float f;
+	uint32_t u;
+
+	switch (j->class->constant_pool[index].tag) {
+	case CONSTANT_Integer:
+		constant(j, sp, class_getinteger(j->class, index));
+		return 0;
+	case CONSTANT_Float:
+		f = class_getfloat(j->class, index);
+		memcpy(&u, &f, sizeof u);
+		constant(j, sp, u);
+		return 0;
+	case CONSTANT_Long:
+		constant(j, sp, class_getlong(j->class, index));
+		return 0;
+	case CONSTANT_Double:
+		d = class_getdouble(j->class, index);
+		memcpy(&l, &d, sizeof l);
+		constant(j, sp, l);
+		return 0;
+	}
+	return -1;
+}
+
+/* emit load or store of local variable i; long and double stores fill two variables, as in the interpreter */
+static void
+local(Jit *j, U1 op, U4 i, int sp)
+{
+	switch (op) {
+	case ILOAD: case LLOAD: case FLOAD: case DLOAD: case ALOAD:
+		mem(j, 0, 1, OP_LOAD, RAX, LOCAL(i));
+		mem(j, 0, 1, OP_STORE, RAX, STACK(sp));
+		break;
+	case LSTORE: case DSTORE:
+		mem(j, 0, 1, OP_LOAD, RAX, STACK(sp - 1));
+		mem(j, 0, 1, OP_STORE, RAX, LOCAL(i));
+		mem(j, 0, 1, OP_STORE, RAX, LOCAL(i + 1));
+		break;
+	default:
+		mem(j, 0, 1, OP_LOAD, RAX, STACK(sp - 1));
+		mem(j, 0, 1, OP_STORE, RAX, LOCAL(i));
+		break;
+	}
+}
+
+/* emit integer operation on the two top slots, 64-bit if w */
+static void
+binary(Jit *j, int sp, int w, U4 op)
+{
+	mem(j, 0, w, OP_LOAD, RAX, STACK(sp - 2));
+	mem(j, 0, w, op, RAX, STACK(sp - 1));
+	mem(j, 0, 1, OP_STORE, RAX, STACK(sp - 2));
+}
+
+/* emit floating-point operation on the two top slots */
+static void
+floating(Jit *j, int sp, int pfx, U4 op)
+{
+	mem(j, pfx, 0, OP_MOVSSE, 0, STACK(sp - 2));
+	mem(j, pfx, 0, op, 0, STACK(sp - 1));
+	mem(j, pfx, 0, OP_STSSE, 0, STACK(sp - 2));
+}
+
+/* emit shift of second slot by the top one, with opcode extension ext */
+static void
+shift(Jit *j, int sp, int w, int ext)
+{
+	mem(j, 0, w, OP_LOAD, RAX, STACK(sp - 2));
+	mem(j, 0, 0, OP_LOAD, RCX, STACK(sp - 1));
+	reg(j, 0, w, OP_SHIFT, ext, RAX);
+	mem(j, 0, 1, OP_STORE, RAX, STACK(sp - 2));
+}
+
+/*
+ * Emit division or remainder of the two top slots.  The quotient of
+ * the most negative value by -1 overflows, and the remainder is in rdx;
+ * division by zero is left to the interpreter.
+ */
+static void
+divide(Jit *j, U4 pc, int sp, int w, int rem)
+{
+	size_t zero, minus, done, done2;
+
+	mem(j, 0, w, OP_LOAD, RAX, STACK(sp - 2));
+	mem(j, 0, w, OP_LOAD, RCX, STACK(sp - 1));
+	reg(j, 0, w, OP_TEST, RCX, RCX);
+	zero = jump(j, CC_E);
+	reg(j, 0, w, OP_GRP8, 7, RCX);          /* cmp rcx, -1 */
+	byte(j, 0xFF);
+	minus = jump(j, CC_E);
+	opcode(j, 0, w, 0x99, 0, 0, 0);         /* cdq, cqo */
+	reg(j, 0, w, OP_UNARY, 7, RCX);         /* idiv rcx */
+	mem(j, 0, 1, OP_STORE, rem ? RDX : RAX, STACK(sp - 2));
+	done = jump(j, CC_ALWAYS);
+	land(j, minus);
+	if (rem)
+		reg(j, 0, 0, OP_XOR, RAX, RAX);
+	else
+		reg(j, 0, w, OP_UNARY, 3, RAX); /* neg rax */
+	mem(j, 0, 1, OP_STORE, RAX, STACK(sp - 2));
+	done2 = jump(j, CC_ALWAYS);
+	land(j, zero);
+	interpret(j, pc, sp);
+	land(j, done);
+	land(j, done2);
+}
+
+/* emit three-way comparison of the two top slots: -1, 0 or 1, or nan when unordered */
+static void
+compare(Jit *j, int sp, int pfx, int nan)
+{
+	size_t unordered = 0;
+
+	if (pfx == 0) {
+		mem(j, 0, 1, OP_LOAD, RAX, STACK(sp - 2));
+		mem(j, 0, 1, OP_CMP, RAX, STACK(sp - 1));
+		reg(j, 0, 0, OP_SETCC | CC_G, 0, RAX);
+		reg(j, 0, 0, OP_SETCC | CC_L, 0, RCX);
+	} else {
+		mem(j, pfx, 0, OP_MOVSSE, 0, STACK(sp - 2));
+		mem(j, (pfx == PSD) ? P16 : 0, 0, OP_UCOMI, 0, STACK(sp - 1));
+		byte(j, 0xB8);                  /* mov eax, imm32 */
+		imm(j, nan, 4);
+		unordered = jump(j, CC_P);
+		reg(j, 0, 0, OP_SETCC | CC_A, 0, RAX);
+		reg(j, 0, 0, OP_SETCC | CC_B, 0, RCX);
+	}
+	reg(j, 0, 0, OP_SUB8, RCX, RAX);
+	reg(j, 0, 0, OP_MOVSX8, RAX, RAX);
+	if (pfx != 0)
+		land(j, unordered);
+	mem(j, 0, 1, OP_STORE, RAX, STACK(sp - 2));
+}
+
+/* emit conversion of floating-point top slot to integer by C function fn */
+static void
+convert(Jit *j, int sp, int pfx, uintptr_t fn)
+{
+	mem(j, pfx, 0, OP_MOVSSE, 0, STACK(sp - 1));
+	call(j, fn);
+	mem(j, 0, 1, OP_STORE, RAX, STACK(sp - 1));
+}
+
+/* emit call of C function fn on the arguments of method descriptor type in the slots from sp, whose result replaces them */
+static void
+callout(Jit *j, int sp, char *type, void *fn)
+{
+	static const int regs[] = {RDI, RSI, RDX, RCX};
+	int i, x, g;
+	char *s;
+
+	x = g = 0;
+	for (i = sp, s = type + 1; *s != ')'; s++, i++) {
+		if (*s == 'D' || *s == 'F')
+			mem(j, (*s == 'D') ? PSD : PSS, 0, OP_MOVSSE, x++, STACK(i));
+		else
+			mem(j, 0, *s == 'J', OP_LOAD, regs[g++], STACK(i));
+	}
+	call(j, (uintptr_t)fn);
+	if (s[1] == 'D' || s[1] == 'F')
+		mem(j, (s[1] == 'D') ? PSD : PSS, 0, OP_STSSE, 0, STACK(sp));
+	else
+		mem(j, 0, 1, OP_STORE, RAX, STACK(sp));
+}
+
+/* emit vfmadd213sd, or vfmadd213ss if not w, of xmm0 = xmm1 * xmm0 + memory at base + disp */
+static void
+fmadd(Jit *j, int w, int base, int32_t disp)
+{
+	byte(j, 0xC4);                          /* VEX prefix of map 0F38 */
+	byte(j, (base & 8) ? 0xC2 : 0xE2);
+	byte(j, w << 7 | 0x71);                 /* xmm1, prefix 66 */
+	byte(j, 0xA9);
+	byte(j, 0x80 | (base & 7));
+	if ((base & 7) == RSP)
+		byte(j, 0x24);
+	imm(j, disp, 4);
+}
+
+/*
+ * Emit invocation at pc of a native method compiled code does in place,
+ * with one instruction where the cpu has it and a direct call of its C
+ * function otherwise.  Return -1 if the method is not an intrinsic.
+ */
+static int
+intrinsic(Jit *j, U4 pc, int sp)
+{
+	static const int round[] = {
+		[INTRINSIC_FLOOR] = 0x09, [INTRINSIC_CEIL] = 0x0A, [INTRINSIC_RINT] = 0x08,
+	};
+	CONSTANT_Methodref_info *methodref;
+	Native *native;
+	char *classname, *name, *type, *s;
+	int pfx, w;
+
+	methodref = &j->class->constant_pool[class_get16(&j->code->code[pc + 1]) & 0xFFFF].info.methodref_info;
+	classname = class_getclassname(j->class, methodref->class_index);
+	class_getnameandtype(j->class, methodref->name_and_type_index, &name, &type);
+	if ((native = native_getmethod(classname, name, type)) == NULL || native->intrinsic == INTRINSIC_NONE)
+		return -1;
+	for (s = type + 1; *s != ')'; s++)
+		sp--;
+	pfx = (s[1] == 'F') ? PSS : PSD;
+	w = (type[1] == 'J');
+	switch (native->intrinsic) {
+	case INTRINSIC_SQRT:
+		mem(j, PSD, 0, OP_SQRTSSE, 0, STACK(sp));
+		mem(j, PSD, 0, OP_STSSE, 0, STACK(sp));
+		break;
+	case INTRINSIC_ABS:
+		if (s[1] == 'D') {
+			mem(j, 0, 1, OP_BT, 6, STACK(sp));         /* btr of the sign bit */
+			byte(j, 63);
+		} else if (s[1] == 'F') {
+			mem(j, 0, 0, OP_GRP32, 4, STACK(sp));      /* and without the sign bit */
+			imm(j, 0x7FFFFFFF, 4);
+		} else {
+			mem(j, 0, w, OP_LOAD, RAX, STACK(sp));
+			opcode(j, 0, w, 0x99, 0, 0, 0); /* cdq, cqo */
+			reg(j, 0, w, OP_XOR, RAX, RDX);
+			reg(j, 0, w, OP_SUB, RAX, RDX);
+			mem(j, 0, 1, OP_STORE, RAX, STACK(sp));
+		}
+		break;
+	case INTRINSIC_MIN: case INTRINSIC_MAX:
+		mem(j, 0, w, OP_LOAD, RAX, STACK(sp));
+		mem(j, 0, w, OP_CMP, RAX, STACK(sp + 1));
+		mem(j, 0, w, OP_CMOV | ((native->intrinsic == INTRINSIC_MIN) ? CC_G : CC_L), RAX, STACK(sp + 1));
+		mem(j, 0, 1, OP_STORE, RAX, STACK(sp));
+		break;
+	case INTRINSIC_FLOOR: case INTRINSIC_CEIL: case INTRINSIC_RINT:
+		if (!simd_has(SIMD_SSE41)) {
+			callout(j, sp, type, native->fn);
+			break;
+		}
+		mem(j, P16, 0, OP_ROUNDSD, 0, STACK(sp));
+		byte(j, round[native->intrinsic]);
+		mem(j, PSD, 0, OP_STSSE, 0, STACK(sp));
+		break;
+	case INTRINSIC_FMA:
+		if (!simd_has(SIMD_FMA)) {
+			callout(j, sp, type, native->fn);
+			break;
+		}
+		mem(j, pfx, 0, OP_MOVSSE, 0, STACK(sp));
+		mem(j, pfx, 0, OP_MOVSSE, 1, STACK(sp + 1));
+		fmadd(j, pfx == PSD, STACK(sp + 2));
+		mem(j, pfx, 0, OP_STSSE, 0, STACK(sp));
+		break;
+	case INTRINSIC_BITCOUNT: case INTRINSIC_NLZ:
+		if (!simd_has((native->intrinsic == INTRINSIC_BITCOUNT) ? SIMD_POPCNT : SIMD_LZCNT)) {
+			callout(j, sp, type, native->fn);
+			break;
+		}
+		mem(j, PSS, w, (native->intrinsic == INTRINSIC_BITCOUNT) ? OP_POPCNT : OP_LZCNT, RAX, STACK(sp));
+		mem(j, 0, 1, OP_STORE, RAX, STACK(sp));
+		break;
+	default:
+		callout(j, sp, type, native->fn);
+		break;
+	}
+	return 0;
+}
+
+/* emit load of array element of given size by instruction op into the second slot */
+static void
+arrayload(Jit *j, int sp, int w, U4 op, int size)
+{
+	mem(j, 0, 1, OP_LOAD, RAX, STACK(sp - 2));
+	mem(j, 0, 1, OP_MOVSXD, RCX, STACK(sp - 1));
+	elem(j, 0, w, op, RAX, RAX, RCX, size);
+	mem(j, 0, 1, OP_STORE, RAX, STACK(sp - 2));
+}
+
+/* emit store of the top slot into array element of given size by instruction op */
+static void
+arraystore(Jit *j, int sp, int pfx, int w, U4 op, int size, int boolean)
+{
+	size_t other;
+
+	mem(j, 0, 1, OP_LOAD, RDX, STACK(sp - 1));
+	mem(j, 0, 1, OP_LOAD, RAX, STACK(sp - 3));
+	mem(j, 0, 1, OP_MOVSXD, RCX, STACK(sp - 2));
+	if (boolean) {
+		/* boolean arrays keep only the low bit */
+		mem(j, 0, 0, 0x80, 7, RAX, offsetof(Heap, type));  /* cmp byte, imm8 */
+		byte(j, T_BOOLEAN);
+		other = jump(j, CC_NE);
+		reg(j, 0, 0, OP_GRP8, 4, RDX);  /* and edx, 1 */
+		byte(j, 1);
+		land(j, other);
+	}
+	elem(j, pfx, w, op, RDX, RAX, RCX, size);
+}
+
+/* emit access of array element by instruction op without checks */
+static void
+arrayaccess(Jit *j, U1 op, int sp)
+{
+	switch (op) {
+	case IALOAD:
+		arrayload(j, sp, 0, OP_LOAD, sizeof (int32_t));
+		break;
+	case LALOAD: case DALOAD:
+		arrayload(j, sp, 1, OP_LOAD, sizeof (int64_t));
+		break;
+	case FALOAD:
+		arrayload(j, sp, 0, OP_LOAD, sizeof (float));
+		break;
+	case BALOAD:
+		arrayload(j, sp, 0, OP_MOVSX8, sizeof (int8_t));
+		break;
+	case CALOAD:
+		arrayload(j, sp, 0, OP_MOVZX16, sizeof (U2));
+		break;
+	case SALOAD:
+		arrayload(j, sp, 0, OP_MOVSX16, sizeof (int16_t));
+		break;
+	case IASTORE: case FASTORE:
+		arraystore(j, sp, 0, 0, OP_STORE, sizeof (int32_t), 0);
+		break;
+	case LASTORE: case DASTORE:
+		arraystore(j, sp, 0, 1, OP_STORE, sizeof (int64_t), 0);
+		break;
+	case BASTORE:
+		arraystore(j, sp, 0, 0, OP_STORE8, sizeof (int8_t), 1);
+		break;
+	case CASTORE: case SASTORE:
+		arraystore(j, sp, P16, 0, OP_STORE, sizeof (U2), 0);
+		break;
+	}
+}
+
+/*
+ * Emit array access at pc, which checks first that the array is not
+ * null and the index in bounds; otherwise the interpreter routine runs
+ * and reports the error.
+ */
+static void
+checkedaccess(Jit *j, U4 pc, int sp)
+{
+	U1 op = j->code->code[pc];
+	size_t null, bounds, done;
+	int n;
+
+	n = (op >= IASTORE) ? 1 : 0;
+	mem(j, 0, 1, OP_LOAD, RAX, STACK(sp - n - 2));
+	reg(j, 0, 1, OP_TEST, RAX, RAX);
+	null = jump(j, CC_E);
+	mem(j, 0, 0, OP_LOAD, RCX, STACK(sp - n - 1));
+	mem(j, 0, 0, OP_CMP, RCX, RAX, offsetof(Heap, nmemb));
+	bounds = jump(j, CC_AE);
+	arrayaccess(j, op, sp);
+	done = jump(j, CC_ALWAYS);
+	land(j, null);
+	land(j, bounds);
+	interpret(j, pc, sp);
+	land(j, done);
+}
+
+/* emit operand stack shuffle: pop n slots, push them in the order of perm (1 is the top) */
+static void
+shuffle(Jit *j, int sp, int n, const char *perm)
+{
+	static const int regs[] = {RAX, RCX, RDX, RDI};
+	int i;
+
+	for (i = 0; i < n; i++)
+		mem(j, 0, 1, OP_LOAD, regs[i], STACK(sp - 1 - i));
+	for (i = 0; perm[i]; i++)
+		mem(j, 0, 1, OP_STORE, regs[perm[i] - '1'], STACK(sp - n + i));
+}
+
+/* emit switch on the top slot; return -1 if a target is out of the code */
+static int
+switchcase(Jit *j, U4 pc, int sp)
+{
+	U1 *code = j->code->code;
+	U4 p;
+	int32_t i, n, low;
+	int64_t target;
+	int backward = 0;
+
+	p = pc + 1 + (3 - pc % 4);
+	if (code[pc] == TABLESWITCH) {
+		low = class_get32(&code[p + 4]);
+		n = class_get32(&code[p + 8]) - low + 1;
+	} else {
+		low = 0;
+		n = class_get32(&code[p + 4]);
+	}
+	for (i = -1; i < n; i++) {
+		if (i < 0)
+			target = (int64_t)pc + class_get32(&code[p]);
+		else if (code[pc] == TABLESWITCH)
+			target = (int64_t)pc + class_get32(&code[p + 12 + 4 * i]);
+		else
+			target = (int64_t)pc + class_get32(&code[p + 12 + 8 * i]);
+		if (target < 0 || target >= j->code->code_length)
+			return -1;
+		if (target <= pc) {
+			backward = 1;
+		}
+	}
+	if (backward)
+		poll(j, pc, sp);
+	mem(j, 0, 0, OP_LOAD, RAX, STACK(sp - 1));
+	for (i = 0; i < n; i++) {
+		reg(j, 0, 0, OP_GRP32, 7, RAX); /* cmp eax, imm32 */
+		if (code[pc] == TABLESWITCH) {
+			imm(j, low + i, 4);
+			jumpto(j, CC_E, pc + class_get32(&code[p + 12 + 4 * i]));
+		} else {
+			imm(j, class_get32(&code[p + 8 + 8 * i]), 4);
+			jumpto(j, CC_E, pc + class_get32(&code[p + 12 + 8 * i]));
+		}
+	}
+	jumpto(j, CC_ALWAYS, pc + class_get32(&code[p]));
+	return 0;
+}
+
+/* emit test of branch instruction op on the top slots; return the condition of taking it */
+static int
+condition(Jit *j, U1 op, int sp)
+{
+	if (op >= IFEQ && op <= IFLE) {
+		mem(j, 0, 0, OP_GRP8, 7, STACK(sp - 1));
+		byte(j, 0);
+		return ifcc[op - IFEQ];
+	} else if (op >= IF_ICMPEQ && op <= IF_ICMPLE) {
+		mem(j, 0, 0, OP_LOAD, RAX, STACK(sp - 2));
+		mem(j, 0, 0, OP_CMP, RAX, STACK(sp - 1));
+		return ifcc[op - IF_ICMPEQ];
+	} else if (op == IF_ACMPEQ || op == IF_ACMPNE) {
+		mem(j, 0, 1, OP_LOAD, RAX, STACK(sp - 2));
+		mem(j, 0, 1, OP_CMP, RAX, STACK(sp - 1));
+		return (op == IF_ACMPEQ) ? CC_E : CC_NE;
+	} else if (op == IFNULL || op == IFNONNULL) {
+		mem(j, 0, 1, OP_GRP8, 7, STACK(sp - 1));
+		byte(j, 0);
+		return (op == IFNULL) ? CC_E : CC_NE;
+	}
+	return CC_ALWAYS;
+}
+
+/* emit branch at pc by offset; return -1 if the target is out of the code */
+static int
+branch(Jit *j, U4 pc, int sp, int32_t off)
+{
+	int64_t target;
+
+	target = (int64_t)pc + off;
+	if (target < 0 || target >= j->code->code_length)
+		return -1;
+	if (target <= pc)
+		poll(j, pc, sp);
+	jumpto(j, condition(j, j->code->code[pc], sp), target);
+	return 0;
+}
+
+/* emit code of instruction at pc, which starts with sp operand stack slots; return -1 if it is not supported */
+static int
+instruction(Jit *j, U4 pc, int sp)
+{
+	U1 *code = j->code->code;
+	U1 op = code[pc];
+
+	switch (op) {
+	case NOP:
+		break;
+	case ACONST_NULL:
+		constant(j, sp, 0);
+		break;
+	case ICONST_M1: case ICONST_0: case ICONST_1: case ICONST_2:
+	case ICONST_3: case ICONST_4: case ICONST_5:
+		constant(j, sp, op - ICONST_0);
+		break;
+	case LCONST_0: case LCONST_1:
+		constant(j, sp, op - LCONST_0);
+		break;
+	case FCONST_0:
+		constant(j, sp, 0);
+		break;
+	case FCONST_1:
+		constant(j, sp, 0x3F800000);
+		break;
+	case FCONST_2:
+		constant(j, sp, 0x40000000);
+		break;
+	case DCONST_0:
+		constant(j, sp, 0);
+		break;
+	case DCONST_1:
+		constant(j, sp, INT64_C(0x3FF0000000000000));
+		break;
+	case BIPUSH:
+		constant(j, sp, (int8_t)code[pc + 1]);
+		break;
+	case SIPUSH:
+		constant(j, sp, class_get16(&code[pc + 1]));
+		break;
+	case LDC:
+		if (ldc(j, sp, code[pc + 1]) == -1)
+			interpret(j, pc, sp);
+		break;
+	case LDC_W: case LDC2_W:
+		if (ldc(j, sp, class_get16(&code[pc + 1]) & 0xFFFF) == -1)
+			interpret(j, pc, sp);
+		break;
+	case ILOAD: case LLOAD: case FLOAD: case DLOAD: case ALOAD:
+	case ISTORE: case LSTORE: case FSTORE: case DSTORE: case ASTORE:
+		local(j, op, code[pc + 1], sp);
+		break;
+	case ILOAD_0: case ILOAD_1: case ILOAD_2: case ILOAD_3:
+	case LLOAD_0: case LLOAD_1: case LLOAD_2: case LLOAD_3:
+	case FLOAD_0: case FLOAD_1: case FLOAD_2: case FLOAD_3:
+	case DLOAD_0: case DLOAD_1: case DLOAD_2: case DLOAD_3:
+	case ALOAD_0: case ALOAD_1: case ALOAD_2: case ALOAD_3:
+		local(j, ILOAD + (op - ILOAD_0) / 4, (op - ILOAD_0) % 4, sp);
+		break;
+	case ISTORE_0: case ISTORE_1: case ISTORE_2: case ISTORE_3:
+	case LSTORE_0: case LSTORE_1: case LSTORE_2: case LSTORE_3:
+	case FSTORE_0: case FSTORE_1: case FSTORE_2: case FSTORE_3:
+	case DSTORE_0: case DSTORE_1: case DSTORE_2: case DSTORE_3:
+	case ASTORE_0: case ASTORE_1: case ASTORE_2: case ASTORE_3:
+		local(j, ISTORE + (op - ISTORE_0) / 4, (op - ISTORE_0) % 4, sp);
+		break;
+	case IINC:
+		mem(j, 0, 0, OP_GRP8, 0, LOCAL(code[pc + 1]));
+		byte(j, code[pc + 2]);
+		break;
+	case WIDE:
+		if (code[pc + 1] == RET)
+			return -1;
+		if (code[pc + 1] == IINC) {
+			mem(j, 0, 0, OP_GRP32, 0, LOCAL(class_get16(&code[pc + 2]) & 0xFFFF));
+			imm(j, class_get16(&code[pc + 4]), 4);
+		} else {
+			local(j, code[pc + 1], class_get16(&code[pc + 2]) & 0xFFFF, sp);
+		}
+		break;
+	case IALOAD: case LALOAD: case FALOAD: case DALOAD: case BALOAD: case CALOAD: case SALOAD:
+	case IASTORE: case LASTORE: case FASTORE: case DASTORE: case BASTORE: case CASTORE: case SASTORE:
+		checkedaccess(j, pc, sp);
+		break;
+	case IALOAD_QUICK: case LALOAD_QUICK: case FALOAD_QUICK: case DALOAD_QUICK:
+	case BALOAD_QUICK: case CALOAD_QUICK: case SALOAD_QUICK:
+	case IASTORE_QUICK: case LASTORE_QUICK: case FASTORE_QUICK: case DASTORE_QUICK:
+	case BASTORE_QUICK: case CASTORE_QUICK: case SASTORE_QUICK:
+		arrayaccess(j, class_getchecked(op), sp);
+		break;
+	case ARRAYLENGTH:
+		mem(j, 0, 1, OP_LOAD, RAX, STACK(sp - 1));
+		mem(j, 0, 0, OP_LOAD, RAX, RAX, offsetof(Heap, nmemb));
+		mem(j, 0, 1, OP_STORE, RAX, STACK(sp - 1));
+		break;
+	case POP: case POP2:
+		break;
+	case DUP:
+		shuffle(j, sp, 1, "11");
+		break;
+	case DUP_X1:
+		shuffle(j, sp, 2, "121");
+		break;
+	case DUP_X2:
+		shuffle(j, sp, 3, "1321");
+		break;
+	case DUP2:
+		shuffle(j, sp, 2, "2121");
+		break;
+	case DUP2_X1:
+		shuffle(j, sp, 3, "21321");
+		break;
+	case DUP2_X2:
+		shuffle(j, sp, 4, "214321");
+		break;
+	case SWAP:
+		shuffle(j, sp, 2, "12");
+		break;
+	case IADD: case LADD:
+		binary(j, sp, op == LADD, OP_ADD);
+		break;
+	case ISUB: case LSUB:
+		binary(j, sp, op == LSUB, OP_SUB);
+		break;
+	case IMUL: case LMUL:
+		binary(j, sp, op == LMUL, OP_IMUL);
+		break;
+	case IAND: case LAND:
+		binary(j, sp, op == LAND, OP_AND);
+		break;
+	case IOR: case LOR:
+		binary(j, sp, op == LOR, OP_OR);
+		break;
+	case IXOR: case LXOR:
+		binary(j, sp, op == LXOR, OP_XOR);
+		break;
+	case IDIV: case LDIV:
+		divide(j, pc, sp, op == LDIV, 0);
+		break;
+	case IREM: case LREM:
+		divide(j, pc, sp, op == LREM, 1);
+		break;
+	case INEG: case LNEG:
+		mem(j, 0, op == LNEG, OP_UNARY, 3, STACK(sp - 1));
+		break;
+	case ISHL: case LSHL:
+		shift(j, sp, op == LSHL, 4);
+		break;
+	case ISHR: case LSHR:
+		shift(j, sp, op == LSHR, 7);
+		break;
+	case IUSHR: case LUSHR:
+		shift(j, sp, op == LUSHR, 5);
+		break;
+	case FADD: case DADD:
+		floating(j, sp, (op == FADD) ? PSS : PSD, OP_ADDSSE);
+		break;
+	case FSUB: case DSUB:
+		floating(j, sp, (op == FSUB) ? PSS : PSD, OP_SUBSSE);
+		break;
+	case FMUL: case DMUL:
+		floating(j, sp, (op == FMUL) ? PSS : PSD, OP_MULSSE);
+		break;
+	case FDIV: case DDIV:
+		floating(j, sp, (op == FDIV) ? PSS : PSD, OP_DIVSSE);
+		break;
+	case FNEG:
+		mem(j, 0, 0, OP_GRP32, 6, STACK(sp - 1));  /* xor with the sign bit */
+		imm(j, 0x80000000, 4);
+		break;
+	case DNEG:
+		mem(j, 0, 1, OP_BT, 7, STACK(sp - 1));     /* btc of the sign bit */
+		byte(j, 63);
+		break;
+	case I2L:
+		mem(j, 0, 1, OP_MOVSXD, RAX, STACK(sp - 1));
+		mem(j, 0, 1, OP_STORE, RAX, STACK(sp - 1));
+		break;
+	case L2I:
+		/* the low half of a long is its int value */
+		break;
+	case I2F: case I2D: case L2F: case L2D:
+		mem(j, (op == I2F || op == L2F) ? PSS : PSD, op == L2F || op == L2D, OP_CVTSI, 0, STACK(sp - 1));
+		mem(j, (op == I2F || op == L2F) ? PSS : PSD, 0, OP_STSSE, 0, STACK(sp - 1));
+		break;
+	case F2D:
+		mem(j, PSS, 0, OP_CVTFP, 0, STACK(sp - 1));
+		mem(j, PSD, 0, OP_STSSE, 0, STACK(sp - 1));
+		break;
+	case D2F:
+		mem(j, PSD, 0, OP_CVTFP, 0, STACK(sp - 1));
+		mem(j, PSS, 0, OP_STSSE, 0, STACK(sp - 1));
+		break;
+	case F2I:
+		convert(j, sp, PSS, (uintptr_t)f2i);
+		break;
+	case F2L:
+		convert(j, sp, PSS, (uintptr_t)f2l);
+		break;
+	case D2I:
+		convert(j, sp, PSD, (uintptr_t)d2i);
+		break;
+	case D2L:
+		convert(j, sp, PSD, (uintptr_t)d2l);
+		break;
+	case I2B: case I2C: case I2S:
+		mem(j, 0, 0, (op == I2B) ? OP_MOVSX8 : (op == I2C) ? OP_MOVZX16 : OP_MOVSX16, RAX, STACK(sp - 1));
+		mem(j, 0, 1, OP_STORE, RAX, STACK(sp - 1));
+		break;
+	case LCMP:
+		compare(j, sp, 0, 0);
+		break;
+	case FCMPL: case FCMPG:
+		compare(j, sp, PSS, (op == FCMPL) ? -1 : 1);
+		break;
+	case DCMPL: case DCMPG:
+		compare(j, sp, PSD, (op == DCMPL) ? -1 : 1);
+		break;
+	case IFEQ: case IFNE: case IFLT: case IFGE: case IFGT: case IFLE:
+	case IF_ICMPEQ: case IF_ICMPNE: case IF_ICMPLT: case IF_ICMPGE: case IF_ICMPGT: case IF_ICMPLE:
+	case IF_ACMPEQ: case IF_ACMPNE: case IFNULL: case IFNONNULL: case GOTO:
+		return branch(j, pc, sp, class_get16(&code[pc + 1]));
+	case GOTO_W:
+		return branch(j, pc, sp, class_get32(&code[pc + 1]));
+	case TABLESWITCH: case LOOKUPSWITCH:
+		return switchcase(j, pc, sp);
+	case IRETURN: case LRETURN: case FRETURN: case DRETURN: case ARETURN:
+		leave(j, RETURN_OPERAND, sp);
+		break;
+	case RETURN:
+		leave(j, RETURN_VOID, sp);
+		break;
+	case JSR: case JSR_W: case RET: case ATHROW:
+		return -1;
+	case INVOKESTATIC:
+		if (intrinsic(j, pc, sp) == -1)
+			interpret(j, pc, sp);
+		break;
+	default:
+		interpret(j, pc, sp);
+		break;
+	}
+	return 0;
+}
+
+/* copy code into code memory and make it executable; return NULL if there is no room */
+static void *
+install(U1 *buf, size_t len)
+{
+	long pagesize;
+	size_t begin, end;
+	char *p;
+
+	if ((pagesize = sysconf(_SC_PAGESIZE)) <= 0)
+		pagesize = 4096;
+	if (cache == NULL) {
+		p = mmap(NULL, JIT_CACHESIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if (p == MAP_FAILED)
+			return NULL;
+		cache = p;
+	}
+	if (len > JIT_CACHESIZE - cacheused)
+		return NULL;
+	/* pages are never writable and executable at once; a page shared with older code is briefly not executable */
+	begin = cacheused / pagesize * pagesize;
+	end = (cacheused + len + pagesize - 1) / pagesize * pagesize;
+	if (end > JIT_CACHESIZE || mprotect(cache + begin, end - begin, PROT_READ | PROT_WRITE) == -1)
+		return NULL;
+	p = cache + cacheused;
+	memcpy(p, buf, len);
+	if (mprotect(cache + begin, end - begin, PROT_READ | PROT_EXEC) == -1)
+		err(EXIT_FAILURE, "mprotect");
+	cacheused = (cacheused + len + 15) & ~(size_t)15;
+	return p;
+}
+
+/* make the jump whose displacement is at p, in installed code, land at target */
+static void
+patch(U1 *p, void *target)
+{
+	long pagesize;
+	uintptr_t begin, end;
+	int32_t d;
+
+	if ((pagesize = sysconf(_SC_PAGESIZE)) <= 0)
+		pagesize = 4096;
+	begin = (uintptr_t)p / pagesize * pagesize;
+	end = ((uintptr_t)p + sizeof d + pagesize - 1) / pagesize * pagesize;
+	if (mprotect((void *)begin, end - begin, PROT_READ | PROT_WRITE) == -1)
+		err(EXIT_FAILURE, "mprotect");
+	d = (U1 *)target - (p + sizeof d);
+	memcpy(p, &d, sizeof d);
+	if (mprotect((void *)begin, end - begin, PROT_READ | PROT_EXEC) == -1)
+		err(EXIT_FAILURE, "mprotect");
+}
+
+/* report code installed for method code, or for the trace of its loop at head if head is not negative, to profilers */
+static void
+report(ClassFile *class, Code_attribute *code, long head, void *fn, size_t len)
+{
+	Method *method;
+	char *classname, *name, *descriptor, *s;
+	size_t n;
+
+	if ((method = class_getcodemethod(class, code)) == NULL)
+		return;
+	classname = class_getclassname(class, class->this_class);
+	s = class_getutf8(class, method->name_index);
+	descriptor = class_getutf8(class, method->descriptor_index);
+	n = strlen(classname) + strlen(s) + strlen(descriptor) + 32;
+	name = emalloc(n);
+	if (head < 0)
+		(void)snprintf(name, n, "%s.%s%s", classname, s, descriptor);
+	else
+		(void)snprintf(name, n, "%s.%s%s@%ld", classname, s, descriptor, head);
+	for (s = name; *s != '\0' && *s != '.'; s++)
+		if (*s == '/')
+			*s = '.';
+	perf_code(name, fn, len);
+	free(name);
+}
+
+/*
+ * Compile method code into machine code, one template per instruction.
+ * Local variables and operand stack stay in the frame, where the
+ * collector and the interpreter routines expect them; since the depth
+ * of the operand stack before each instruction is known, its slots are
+ * addressed directly and no stack pointer is kept.  Instructions
+ * without a template call their interpreter routine.  The code starts
+ * with a jump through a table to the instruction at the pc of the
+ * frame, so it can take over a frame the interpreter left at a loop
+ * head as well as run a new one.  Return NULL if the method cannot be
+ * compiled.
+ */
+JitCode *
+jit_compile(ClassFile *class, Code_attribute *code, Handler **handlers)
+{
+	Jit j;
+	JitCode *fn = NULL;
+	size_t i, table;
+	int32_t d;
+	U4 pc;
+	int sp, error = 0;
+
+	if (code->code_length == 0 || refmap_depth(class, code, 0) == -1)
+		return NULL;
+	memset(&j, 0, sizeof j);
+	j.class = class;
+	j.code = code;
+	j.handlers = handlers;
+	j.addr = ecalloc(code->code_length + 1, sizeof *j.addr);
+	byte(&j, 0x53);                         /* push rbx */
+	byte(&j, 0x41);                         /* push r12 */
+	byte(&j, 0x54);
+	byte(&j, 0x41);                         /* push r13 */
+	byte(&j, 0x55);
+	reg(&j, 0, 1, OP_STORE, RDI, RBX);
+	mem(&j, 0, 1, OP_LOAD, R12, FRAME(local));
+	mem(&j, 0, 1, OP_LOAD, R13, FRAME(stack));
+	mem(&j, 0, 0, OP_MOVZX16, RAX, FRAME(pc));
+	byte(&j, 0x48);                         /* lea rcx, [rip + table] */
+	byte(&j, 0x8D);
+	byte(&j, 0x0D);
+	imm(&j, 0, 4);
+	table = j.len - 4;
+	byte(&j, 0x48);                         /* movsxd rax, [rcx + 4 * rax] */
+	byte(&j, 0x63);
+	byte(&j, 0x04);
+	byte(&j, 0x81);
+	reg(&j, 0, 1, OP_ADD, RAX, RCX);
+	byte(&j, 0xFF);                         /* jmp rax */
+	byte(&j, 0xE0);
+	for (pc = 0; !error && pc < code->code_length; pc++) {
+		j.addr[pc] = j.len;
+		if ((sp = refmap_depth(class, code, pc)) != -1 && instruction(&j, pc, sp) == -1) {
+			error = 1;
+		}
+	}
+	j.addr[code->code_length] = j.len;
+	byte(&j, 0x41);                         /* pop r13 */
+	byte(&j, 0x5D);
+	byte(&j, 0x41);                         /* pop r12 */
+	byte(&j, 0x5C);
+	byte(&j, 0x5B);                         /* pop rbx */
+	byte(&j, 0xC3);                         /* ret */
+	while (j.len % 4 != 0)
+		byte(&j, 0xCC);
+	land(&j, table);
+	table = j.len;
+	for (pc = 0; pc < code->code_length; pc++) {
+		imm(&j, j.addr[pc] - table, 4);
+	}
+	for (i = 0; !error && i < j.nfixups; i++) {
+		d = j.addr[j.fixups[i].pc] - (j.fixups[i].at + 4);
+		memcpy(&j.buf[j.fixups[i].at], &d, sizeof d);
+	}
+	if (!error)
+		fn = (JitCode *)install(j.buf, j.len);
+	if (fn != NULL)
+		report(class, code, -1, (void *)fn, j.len);
+	free(j.buf);
+	free(j.addr);
+	free(j.fixups);
+	return fn;
+}
+
+/* emit load of rbx, r12 and r13 for the frame of call; the frame of the loop is kept on the machine stack */
+static void
+enter(Jit *j, TraceCall *call)
+{
+	if (call == NULL) {
+		mem(j, 0, 1, OP_LOAD, RBX, RSP, 0);
+	} else {
+		byte(j, 0x48);                  /* mov rbx, imm64 */
+		byte(j, 0xBB);
+		imm(j, (uintptr_t)&call->frame, 8);
+	}
+	mem(j, 0, 1, OP_LOAD, R12, FRAME(local));
+	mem(j, 0, 1, OP_LOAD, R13, FRAME(stack));
+}
+
+/* emit passing of the arguments on top of the sp stack slots to call, as the interpreter passes them; return -1 on error */
+static int
+passargs(Jit *j, TraceCall *call, int sp)
+{
+	U2 local[256];
+	U1 wide[256];
+	char *s;
+	int i, n;
+	U2 l;
+
+	n = 0;
+	l = 0;
+	if (!(call->flags & ACC_STATIC)) {
+		local[n] = l++;
+		wide[n++] = 0;
+	}
+	for (s = call->descriptor + 1; *s && *s != ')' && n < 256; s++) {
+		local[n] = l;
+		wide[n] = (*s == 'J' || *s == 'D');
+		l += wide[n++] ? 2 : 1;
+		while (*s == '[')
+			s++;
+		if (*s == 'L') {
+			while (*s && *s != ';') {
+				s++;
+			}
+		}
+	}
+	if (n != sp - call->sp || l > call->frame.code->max_locals)
+		return -1;
+	byte(j, 0x48);                          /* mov rcx, imm64 */
+	byte(j, 0xB9);
+	imm(j, (uintptr_t)call->frame.local, 8);
+	for (i = 0; i < n; i++) {
+		mem(j, 0, 1, OP_LOAD, RAX, STACK(call->sp + i));
+		mem(j, 0, 1, OP_STORE, RAX, RCX, 8 * (int32_t)local[i]);
+		if (wide[i]) {
+			mem(j, 0, 1, OP_STORE, RAX, RCX, 8 * ((int32_t)local[i] + 1));
+		}
+	}
+	return 0;
+}
+
+/* emit guard jumping if cc to the side exit resuming the interpreter at pc of the method of call */
+static void
+guard(Jit *j, int cc, TraceCall *call, U4 pc, int sp)
+{
+	Exit *p;
+
+	if (j->nexits == j->exitcap) {
+		j->exitcap = j->exitcap ? 2 * j->exitcap : 16;
+		if ((p = realloc(j->exits, j->exitcap * sizeof *p)) == NULL)
+			err(EXIT_FAILURE, "realloc");
+		j->exits = p;
+	}
+	j->exits[j->nexits].at = jump(j, cc);
+	j->exits[j->nexits].call = call;
+	j->exits[j->nexits].pc = pc;
+	j->exits[j->nexits++].sp = sp;
+}
+
+/* emit instruction of step of trace, followed by step next; return -1 if it cannot be compiled */
+static int
+follow(Jit *j, TraceStep *step, TraceStep *next)
+{
+	TraceCall *call = step->call;
+	U1 *code = j->code->code;
+	U1 op = code[step->pc];
+	U4 target, fall;
+	int sp, cc;
+
+	if ((sp = refmap_depth(j->class, j->code, step->pc)) == -1)
+		return -1;
+	switch (op) {
+	case IFEQ: case IFNE: case IFLT: case IFGE: case IFGT: case IFLE:
+	case IF_ICMPEQ: case IF_ICMPNE: case IF_ICMPLT: case IF_ICMPGE: case IF_ICMPGT: case IF_ICMPLE:
+	case IF_ACMPEQ: case IF_ACMPNE: case IFNULL: case IFNONNULL:
+		target = step->pc + class_get16(&code[step->pc + 1]);
+		fall = step->pc + 3;
+		if (next->call != call || target >= j->code->code_length)
+			return -1;
+		if (target == fall)
+			break;
+		cc = condition(j, op, sp);
+		if (next->pc == target)
+			guard(j, cc ^ 1, call, fall, refmap_depth(j->class, j->code, fall));
+		else if (next->pc == fall)
+			guard(j, cc, call, target, refmap_depth(j->class, j->code, target));
+		else
+			return -1;
+		break;
+	case GOTO: case GOTO_W:
+		break;
+	case INVOKESTATIC: case INVOKEVIRTUAL:
+		if (next->call == call || next->call == NULL || next->call->caller != call)
+			return instruction(j, step->pc, sp);
+		if (passargs(j, next->call, sp) == -1)
+			return -1;
+		enter(j, next->call);
+		break;
+	case IRETURN: case LRETURN: case FRETURN: case DRETURN: case ARETURN: case RETURN:
+		if (call == NULL || next->call != call->caller || next->pc != call->pc + 3)
+			return -1;
+		if (op != RETURN)
+			mem(j, 0, 1, OP_LOAD, RAX, STACK(sp - 1));
+		enter(j, call->caller);
+		if (op != RETURN)
+			mem(j, 0, 1, OP_STORE, RAX, STACK(call->sp));
+		break;
+	case TABLESWITCH: case LOOKUPSWITCH: case JSR: case JSR_W: case RET: case ATHROW:
+		return -1;
+	default:
+		return instruction(j, step->pc, sp);
+	}
+	return 0;
+}
+
+/*
+ * Compile trace into machine code running its path over and over.
+ * The instructions of the calls it followed work on frames of their
+ * own, which are swapped into the registers as the path enters and
+ * leaves the calls.  Branches become guards, whose side exits store
+ * the state of the current frame and return the number of the exit;
+ * the interpreter resumes from there, rebuilding the frames of calls
+ * left in the middle.  The loop polls for a safepoint at its head,
+ * where no call is under way.  Return NULL if the trace cannot be
+ * compiled.
+ */
+JitCode *
+jit_trace(Trace *trace, Handler **handlers)
+{
+	Jit j;
+	JitCode *fn = NULL;
+	Trace *root;
+	TraceStep end;
+	TraceExit *exits;
+	TraceCall *call;
+	size_t i, top, *done;
+	int32_t d;
+	int error = 0;
+
+	root = (trace->root != NULL) ? trace->root : trace;
+	memset(&j, 0, sizeof j);
+	j.handlers = handlers;
+	top = 0;
+	if (trace->root == NULL) {
+		byte(&j, 0x53);                 /* push rbx */
+		byte(&j, 0x41);                 /* push r12 */
+		byte(&j, 0x54);
+		byte(&j, 0x41);                 /* push r13 */
+		byte(&j, 0x55);
+		byte(&j, 0x57);                 /* push rdi, twice to keep the stack aligned */
+		byte(&j, 0x57);
+		reg(&j, 0, 1, OP_STORE, RDI, RBX);
+		mem(&j, 0, 1, OP_LOAD, R12, FRAME(local));
+		mem(&j, 0, 1, OP_LOAD, R13, FRAME(stack));
+		top = j.len;
+		byte(&j, 0x48);                 /* mov rax, imm64 */
+		byte(&j, 0xB8);
+		imm(&j, (uintptr_t)&trace->iterations, 8);
+		mem(&j, 0, 1, OP_GRP8, 0, RAX, 0);      /* add qword [rax], 1 */
+		byte(&j, 1);
+		poll(&j, trace->head, refmap_depth(trace->class, trace->code, trace->head));
+	}
+	end.call = NULL;
+	end.pc = trace->head;
+	for (i = 0; !error && i < trace->nsteps; i++) {
+		call = trace->steps[i].call;
+		j.class = (call != NULL) ? call->frame.class : trace->class;
+		j.code = (call != NULL) ? call->frame.code : trace->code;
+		if (follow(&j, &trace->steps[i], (i + 1 < trace->nsteps) ? &trace->steps[i + 1] : &end) == -1) {
+			error = 1;
+		}
+	}
+	if (trace->root == NULL) {
+		d = top - (j.len + 5);
+		byte(&j, 0xE9);                 /* jmp top */
+		imm(&j, d, 4);
+	} else {
+		/* a side trace is entered by a guard of compiled code of its root, whose machine stack it shares */
+		byte(&j, 0x48);                 /* mov rax, imm64 */
+		byte(&j, 0xB8);
+		imm(&j, (uintptr_t)root->loop, 8);
+		byte(&j, 0xFF);                 /* jmp rax */
+		byte(&j, 0xE0);
+	}
+	done = ecalloc(j.nexits + 1, sizeof *done);
+	for (i = 0; !error && i < j.nexits; i++) {
+		land(&j, j.exits[i].at);
+		if (j.exits[i].sp == -1)
+			error = 1;
+		saveframe(&j, j.exits[i].pc, j.exits[i].sp);
+		byte(&j, 0xB8);                 /* mov eax, imm32 */
+		imm(&j, root->nexits + i, 4);
+		done[i] = jump(&j, CC_ALWAYS);
+	}
+	/* interpreter routines return from a method only at instructions compiled here */
+	for (i = 0; i < j.nfixups; i++)
+		land(&j, j.fixups[i].at);
+	byte(&j, 0xB8);                         /* mov eax, -1 */
+	imm(&j, -1, 4);
+	for (i = 0; i < j.nexits; i++)
+		land(&j, done[i]);
+	reg(&j, 0, 1, OP_GRP8, 0, RSP);         /* add rsp, 16 */
+	byte(&j, 16);
+	byte(&j, 0x41);                         /* pop r13 */
+	byte(&j, 0x5D);
+	byte(&j, 0x41);                         /* pop r12 */
+	byte(&j, 0x5C);
+	byte(&j, 0x5B);                         /* pop rbx */
+	byte(&j, 0xC3);                         /* ret */
+	if (!error && (fn = (JitCode *)install(j.buf, j.len)) != NULL) {
+		if ((exits = realloc(root->exits, (root->nexits + j.nexits + 1) * sizeof *exits)) == NULL)
+			err(EXIT_FAILURE, "realloc");
+		root->exits = exits;
+		for (i = 0; i < j.nexits; i++) {
+			exits[root->nexits].call = j.exits[i].call;
+			exits[root->nexits].jump = (U1 *)fn + j.exits[i].at;
+			exits[root->nexits++].taken = 0;
+		}
+		if (trace->root == NULL)
+			trace->loop = (U1 *)fn + top;
+		else
+			patch(root->exits[trace->exit].jump, (void *)fn);
+		report(trace->class, trace->code, trace->head, (void *)fn, j.len);
+	}
+	free(done);
+	free(j.buf);
+	free(j.fixups);
+	free(j.exits);
+	return fn;
+}
+
+#else
+
+/* there is no code generator for this machine */
+JitCode *
+jit_compile(ClassFile *class, Code_attribute *code, Handler **handlers)
+{
+	(void)class;
+	(void)code;
+	(void)handlers;
+	return NULL;
+}
+
+/* there is no code generator for this machine */
+JitCode *
+jit_trace(Trace *trace, Handler **handlers)
+{
+	(void)trace;
+	(void)handlers;
+	return NULL;
+}
+
+#endif
+
+/* set routine called by compiled code at backward branches, where the collector may run */
+void
+jit_init(void (*fn)(void))
+{
+	safepoint = fn;
+}
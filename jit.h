@@ -0,0 +1,15 @@
+#define JIT_THRESHOLD   1000                    /* default invocations of a method before it is compiled */
+#define JIT_BACKEDGES   10000                   /* default backward branches taken in a method before it is compiled */
+#define JIT_CACHESIZE   (64 * 1024 * 1024)      /* size of reserved code memory */
+
+/* interpreter routine of an instruction; returns NO_RETURN or how the method returned */
+typedef int Handler(Frame *frame);
+
+/* compiled method; runs a frame of the method from its pc and returns how the method returned */
+typedef int JitCode(Frame *frame);
+
+struct Trace;
+
+void jit_init(void (*safepoint)(void));
+JitCode *jit_compile(ClassFile *class, Code_attribute *code, Handler **handlers);
+JitCode *jit_trace(struct Trace *trace, Handler **handlers);
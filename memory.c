@@ -0,0 +1,1500 @@
+#define _DEFAULT_SOURCE         /* for MAP_ANONYMOUS and MAP_NORESERVE */
+#include <sys/mman.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "util.h"
+#include "class.h"
+#include "memory.h"
+
+static size_t elemsize[T_LAST] = {
+	[T_REFERENCE] = sizeof (Heap *),
+	[T_BOOLEAN]   = sizeof (int8_t),
+	[T_CHAR]      = sizeof (U2),
+	[T_FLOAT]     = sizeof (float),
+	[T_DOUBLE]    = sizeof (double),
+	[T_BYTE]      = sizeof (int8_t),
+	[T_SHORT]     = sizeof (int16_t),
+	[T_INT]       = sizeof (int32_t),
+	[T_LONG]      = sizeof (int64_t),
+};
+char *heap_oopbase = NULL;              /* base of compressed references, NULL if not compressed */
+static char *heapbase = NULL;           /* start of reserved heap; the nursery comes first */
+static char *heapend = NULL;            /* end of reserved heap */
+static struct Space {
+	char   *base;
+	char   *top;                    /* end of the part in use */
+	char   *end;
+} eden, from, to;                       /* nursery: allocation space and survivor spaces */
+static char *oldbase = NULL;            /* start of old generation */
+static char *oldtop = NULL;             /* end of the part of old generation handed out */
+static char *oldcommit = NULL;          /* end of the committed (accessible) part of it */
+static unsigned char *cards = NULL;     /* whether each card of old generation is dirty */
+static unsigned char *firstobj = NULL;  /* offset of first object starting in each card */
+static size_t tlabsize = HEAP_TLABSIZE;
+static size_t pagesize = 4096;
+static size_t largesize = HEAP_LARGESIZE;   /* smallest payload of primitive array allocated outside the heap */
+static Heap **large = NULL;             /* arrays allocated outside the heap, each in its own mapping */
+static size_t nlarge = 0;
+static size_t largecap = 0;
+static size_t largebytes = 0;           /* bytes mapped for arrays allocated outside the heap */
+static int tenure = HEAP_TENURE;        /* collections survived before promotion */
+static Tlab tlab = {NULL, NULL};        /* allocation buffer of the interpreter thread */
+static struct Chunk {
+	char   *p;
+	size_t  size;
+} *chunks = NULL;                       /* free chunks of old generation found by the last sweep */
+static size_t nchunks = 0;
+static size_t chunkcap = 0;
+static enum {
+	EDEN_FREE,                      /* eden has room for allocation buffers */
+	EDEN_FULL,                      /* eden is exhausted, a young collection is due */
+	EDEN_SKIPPED,                   /* young collection was not possible, eden stays exhausted */
+} edenstate = EDEN_FREE;
+static size_t allocated = 0;            /* bytes allocated in old generation since the last sweep */
+static size_t live = 0;                 /* bytes in live objects of old generation after the last sweep */
+static size_t trigger = SIZE_MAX;       /* bytes in old generation at which a full collection is due */
+static Heap **markstack = NULL;         /* objects promoted but not yet scanned */
+static size_t nmark = 0;
+static size_t markcap = 0;
+static unsigned char *startmap = NULL;  /* bitmap of object starts, during a full collection */
+static struct Worker {
+	pthread_t       thread;
+	pthread_mutex_t lock;           /* guards the deque against thieves */
+	Heap          **deque;          /* objects marked but not yet scanned */
+	size_t          head;           /* index of the oldest object, taken by thieves */
+	size_t          tail;           /* index past the newest object, taken by the owner */
+	size_t          cap;
+} *workers = NULL;                      /* collector workers; the first is the interpreter thread */
+static int nworkers = 1;
+static size_t nroots = 0;               /* objects marked from the roots so far */
+static int nidle = 0;                   /* workers out of marking work */
+static struct Region {
+	char           *begin;          /* first object of region */
+	char           *end;
+	struct Chunk   *chunks;         /* free chunks found in region */
+	size_t          nchunks;
+	size_t          chunkcap;
+	size_t          live;           /* bytes in live objects of region */
+} *regions = NULL;                      /* parts of old generation swept in parallel */
+static size_t nregions = 0;
+static size_t regioncap = 0;
+static size_t nextregion = 0;           /* next region to be swept */
+static enum {
+	JOB_MARK,
+	JOB_SWEEP,
+	JOB_EXIT,
+} job;                                  /* job of the workers */
+static unsigned long jobgen = 0;        /* number of jobs given to the workers */
+static int nbusy = 0;                   /* workers yet to finish the job */
+static pthread_mutex_t poollock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t poolwake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pooldone = PTHREAD_COND_INITIALIZER;
+static Heap **interntab = NULL;         /* open-addressing hash set of interned strings */
+static size_t internsize = 0;           /* capacity of interntab, a power of two */
+static size_t interncount = 0;          /* number of interned strings */
+
+/* round n up to a multiple of a, which is a power of two */
+static size_t
+roundup(size_t n, size_t a)
+{
+	return (n + a - 1) & ~(a - 1);
+}
+
+/* grow array *p of *cap members of given size to hold at least n members */
+static void
+grow(void *p, size_t *cap, size_t n, size_t size)
+{
+	void *q;
+
+	if (n <= *cap)
+		return;
+	*cap = *cap ? 2 * *cap : 256;
+	if ((q = realloc(*(void **)p, *cap * size)) == NULL)
+		err(EXIT_FAILURE, "realloc");
+	*(void **)p = q;
+}
+
+/*
+ * Reserve address space for a heap of maxsize bytes.  The first newsize
+ * bytes are the nursery, committed now and split into eden and two
+ * survivor spaces; the rest is the old generation, committed as it is
+ * used.  Objects are promoted after surviving age collections.
+ */
+void
+heap_init(size_t maxsize, size_t newsize, size_t size, int age, size_t largemin, int compressed)
+{
+	size_t survivor;
+	void *p;
+
+	if (heapbase != NULL)
+		return;
+	if (sysconf(_SC_PAGESIZE) > 0)
+		pagesize = sysconf(_SC_PAGESIZE);
+	maxsize = roundup(maxsize, HEAP_COMMITSIZE);
+	if (newsize > maxsize / 2)
+		newsize = maxsize / 2;
+	newsize = roundup(newsize, HEAP_COMMITSIZE);
+	p = mmap(NULL, maxsize + newsize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (p == MAP_FAILED)
+		err(EXIT_FAILURE, "mmap");
+	if (mprotect(p, newsize, PROT_READ | PROT_WRITE) == -1)
+		err(EXIT_FAILURE, "mprotect");
+	heapbase = p;
+	heapend = heapbase + maxsize + newsize;
+	survivor = roundup(newsize / 10, HEAP_ALIGN);
+	eden.base = eden.top = heapbase;
+	eden.end = from.base = from.top = heapbase + newsize - 2 * survivor;
+	from.end = to.base = to.top = from.base + survivor;
+	to.end = to.base + survivor;
+	oldbase = oldtop = oldcommit = heapbase + newsize;
+	cards = ecalloc(maxsize / HEAP_CARDSIZE, 1);
+	firstobj = emalloc(maxsize / HEAP_CARDSIZE);
+	memset(firstobj, HEAP_NOFIRST, maxsize / HEAP_CARDSIZE);
+	tlabsize = roundup(size < 2 * sizeof (Heap) ? 2 * sizeof (Heap) : size, HEAP_ALIGN);
+	tenure = age;
+	largesize = largemin;
+	/*
+	 * References in arrays are stored as 32-bit offsets from just below the
+	 * heap, scaled by the object alignment, so no object encodes to null.
+	 */
+	if (compressed && maxsize + newsize > HEAP_OOPMAX - HEAP_ALIGN) {
+		warnx("heap too large for compressed references");
+	} else if (compressed) {
+		heap_oopbase = heapbase - HEAP_ALIGN;
+		elemsize[T_REFERENCE] = sizeof (U4);
+	}
+}
+
+/* record that an object (or free space) starts at p, in old generation */
+static void
+setstart(char *p)
+{
+	size_t off, card;
+
+	off = p - oldbase;
+	card = off / HEAP_CARDSIZE;
+	off = off % HEAP_CARDSIZE / HEAP_ALIGN;
+	if (firstobj[card] == HEAP_NOFIRST || off < firstobj[card]) {
+		firstobj[card] = off;
+	}
+}
+
+/* take size bytes from the end of the used part of old generation; return NULL if heap is exhausted */
+static char *
+heapgrab(size_t size)
+{
+	char *p;
+	size_t n;
+
+	if (size > (size_t)(heapend - oldtop))
+		return NULL;
+	if (size > (size_t)(oldcommit - oldtop)) {
+		n = roundup(size - (oldcommit - oldtop), HEAP_COMMITSIZE);
+		if (mprotect(oldcommit, n, PROT_READ | PROT_WRITE) == -1)
+			return NULL;
+		oldcommit += n;
+	}
+	p = oldtop;
+	oldtop += size;
+	return p;
+}
+
+/* fill unused space from p to end with a dead object, so the heap can be walked */
+static void
+heapfill(char *p, char *end)
+{
+	Heap *h;
+
+	if (p == end)
+		return;
+	/* a filler may be as small as the first word of a header, which is all the heap walk reads */
+	h = (Heap *)p;
+	h->size = (end - p) / HEAP_ALIGN;
+	h->kind = K_FILLER;
+	h->type = T_NONE;
+	h->mark = 0;
+	h->age = 0;
+	if ((size_t)(end - p) >= sizeof *h) {
+		h->nmemb = 0;
+		h->hash = 0;
+	}
+	if (p >= oldbase) {
+		setstart(p);
+	}
+}
+
+/*
+ * Zero n bytes at p.  The whole pages of a large range are given back to
+ * the kernel instead, which maps them to zero pages until written, so
+ * huge arrays are not touched at allocation.
+ */
+static void
+zero(char *p, size_t n)
+{
+	char *begin, *end;
+
+	if (n >= HEAP_LAZYZERO) {
+		begin = (char *)roundup((uintptr_t)p, pagesize);
+		end = (char *)((uintptr_t)(p + n) & ~(uintptr_t)(pagesize - 1));
+		if (madvise(begin, end - begin, MADV_DONTNEED) == 0) {
+			memset(p, 0, begin - p);
+			memset(end, 0, p + n - end);
+			return;
+		}
+	}
+	memset(p, 0, n);
+}
+
+/*
+ * Take at least min and up to max bytes of zeroed memory from old
+ * generation, from the first free chunk large enough or else from its
+ * end; store the number of bytes taken into *got.  Return NULL if heap
+ * is exhausted.
+ */
+static char *
+heaptake(size_t min, size_t max, size_t *got)
+{
+	struct Chunk *c;
+	size_t i, n;
+	char *p;
+
+	for (i = 0; i < nchunks; i++) {
+		c = &chunks[i];
+		if (c->size < min)
+			continue;
+		n = (c->size > max && c->size - max >= sizeof (Heap)) ? max : c->size;
+		p = c->p;
+		c->p += n;
+		c->size -= n;
+		if (c->size == 0)
+			*c = chunks[--nchunks];
+		else
+			heapfill(c->p, c->p + c->size);
+		zero(p, n);
+		*got = n;
+		return p;
+	}
+	if ((p = heapgrab(max)) == NULL)
+		return NULL;
+	*got = max;
+	return p;
+}
+
+/* retire allocation buffer and take a new one from eden with room for size bytes; return -1 if eden is exhausted */
+static int
+tlabrefill(Tlab *t, size_t size)
+{
+	size_t n;
+
+	if (t->top != NULL)
+		heapfill(t->top, t->end + sizeof (Heap));
+	t->top = t->end = NULL;
+	n = eden.end - eden.top;
+	if (n < size + sizeof (Heap)) {
+		if (edenstate == EDEN_FREE)
+			edenstate = EDEN_FULL;
+		return -1;
+	}
+	if (n > tlabsize)
+		n = tlabsize;
+	memset(eden.top, 0, n);
+	t->top = eden.top;
+	t->end = eden.top + n - sizeof (Heap);
+	eden.top += n;
+	return 0;
+}
+
+/*
+ * Allocate size bytes for objects, by bumping the top pointer of the
+ * allocation buffer, which is carved out of eden.  Blocks too large for a
+ * buffer, and blocks allocated once eden is exhausted, go directly to the
+ * old generation.  Store the number of bytes taken, which may be a little
+ * more than size, into *got.  The memory is zero.
+ */
+static char *
+heapraw(size_t size, size_t *got)
+{
+	char *p;
+
+	if (heapbase == NULL)
+		heap_init(HEAP_MAXSIZE, HEAP_NEWSIZE, HEAP_TLABSIZE, HEAP_TENURE, HEAP_LARGESIZE, 0);
+	if (size <= (size_t)(tlab.end - tlab.top) ||
+	    (size <= tlabsize / 2 && edenstate == EDEN_FREE && tlabrefill(&tlab, size) == 0)) {
+		p = tlab.top;
+		tlab.top += size;
+		*got = size;
+		return p;
+	}
+	if ((p = heaptake(size, size, got)) == NULL)
+		return NULL;
+	allocated += *got;
+	return p;
+}
+
+/* write header of object of given kind and size in bytes at p */
+static Heap *
+heapinit(char *p, size_t size, U1 kind)
+{
+	Heap *h;
+
+	h = (Heap *)p;
+	h->size = size / HEAP_ALIGN;
+	h->kind = kind;
+	h->type = T_NONE;
+	h->mark = 0;
+	h->age = 0;
+	h->nmemb = 0;
+	h->hash = 0;
+	if (p >= oldbase && p < heapend)
+		setstart(p);
+	return h;
+}
+
+/* get size in bytes of object with a payload of size bytes, or 0 if it is too large */
+static size_t
+objsize(size_t size)
+{
+	size_t total;
+
+	if (size < sizeof (Heap *))
+		size = sizeof (Heap *);
+	if (size > SIZE_MAX - sizeof (Heap) - HEAP_ALIGN)
+		return 0;
+	total = roundup(sizeof (Heap) + size, HEAP_ALIGN);
+	return (total / HEAP_ALIGN > UINT32_MAX) ? 0 : total;
+}
+
+/* check whether array of elements of given type with a payload of size bytes gets an aligned payload */
+static int
+isvector(U1 type, size_t size)
+{
+	return type != T_NONE && type != T_REFERENCE && size >= HEAP_VECMIN;
+}
+
+/*
+ * Skip the start of the *got bytes at p, filling it with a dead object,
+ * so that the byte at offset from the returned address is aligned for
+ * vector instructions; subtract the bytes skipped from *got.  There must
+ * be HEAP_VECALIGN - HEAP_ALIGN bytes to spare.
+ */
+static char *
+vecalign(char *p, size_t offset, size_t *got)
+{
+	size_t pad;
+
+	pad = -(uintptr_t)(p + offset) & (HEAP_VECALIGN - 1);
+	heapfill(p, p + pad);
+	*got -= pad;
+	return p + pad;
+}
+
+/*
+ * Allocate heap object of given kind with a payload of size bytes.  The
+ * header and the payload are allocated together.  The payload is zero,
+ * and has room for a forwarding pointer.
+ */
+Heap *
+heap_alloc(U1 kind, size_t size)
+{
+	size_t total;
+	char *p;
+
+	if ((total = objsize(size)) == 0 || (p = heapraw(total, &total)) == NULL)
+		return NULL;
+	return heapinit(p, total, kind);
+}
+
+/* get identity hash code of object, choosing it on first call */
+int32_t
+heap_hash(Heap *h)
+{
+	static uint32_t seed = 2463534242;
+
+	while (h->hash == 0) {
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		h->hash = seed & INT32_MAX;
+	}
+	return h->hash;
+}
+
+/*
+ * Allocate array with a payload of size bytes in an anonymous mapping of
+ * its own, which the kernel fills with zero pages on demand.  Such an
+ * array is never moved; it counts as allocated in old generation and is
+ * unmapped when a full collection finds it dead.  The header is placed
+ * so that the payload is aligned for vector instructions.
+ */
+static Heap *
+largenew(size_t size)
+{
+	size_t total;
+	char *p;
+
+	if ((total = objsize(size)) == 0 || total > heap_maxsize() - heap_old())
+		return NULL;
+	p = mmap(NULL, total + HEAP_VECALIGN - sizeof (Heap), PROT_READ | PROT_WRITE,
+	         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (p == MAP_FAILED)
+		return NULL;
+	grow(&large, &largecap, nlarge + 1, sizeof *large);
+	large[nlarge++] = heapinit(p + HEAP_VECALIGN - sizeof (Heap), total, K_ARRAY);
+	allocated += total;
+	largebytes += total;
+	return large[nlarge - 1];
+}
+
+/* unmap array allocated outside the heap */
+static void
+largefree(Heap *h)
+{
+	largebytes -= HEAP_SIZE(h);
+	(void)munmap((char *)h - (HEAP_VECALIGN - sizeof (Heap)), HEAP_SIZE(h) + HEAP_VECALIGN - sizeof (Heap));
+}
+
+/* record a store of a reference into object h; cheap enough for every store */
+void
+heap_barrier(Heap *h)
+{
+	if ((char *)h >= oldbase && (char *)h < heapend) {
+		cards[((char *)h - oldbase) / HEAP_CARDSIZE] = 1;
+	}
+}
+
+/* check whether a collection is due */
+int
+heap_needcollect(void)
+{
+	return edenstate == EDEN_FULL || heap_needfull();
+}
+
+/* check whether eden is exhausted, so a young collection should be done */
+int
+heap_youngpending(void)
+{
+	return edenstate != EDEN_FREE;
+}
+
+/* leave eden exhausted without a young collection; allocation goes on in old generation */
+void
+heap_youngskip(void)
+{
+	edenstate = EDEN_SKIPPED;
+}
+
+/* check whether a full collection is due */
+int
+heap_needfull(void)
+{
+	return live + allocated >= trigger;
+}
+
+/* set number of bytes in old generation at which a full collection is due */
+void
+heap_settrigger(size_t size)
+{
+	trigger = size;
+}
+
+/* get number of bytes in use in the nursery */
+size_t
+heap_young(void)
+{
+	return (eden.top - eden.base) + (from.top - from.base);
+}
+
+/* get number of bytes in use in old generation: live after the last sweep, plus allocated since */
+size_t
+heap_old(void)
+{
+	return live + allocated;
+}
+
+/* get size of reserved old generation */
+size_t
+heap_maxsize(void)
+{
+	if (heapbase == NULL)
+		heap_init(HEAP_MAXSIZE, HEAP_NEWSIZE, HEAP_TLABSIZE, HEAP_TENURE, HEAP_LARGESIZE, 0);
+	return heapend - oldbase;
+}
+
+/* get number of bytes of heap committed so far, large arrays included */
+size_t
+heap_committed(void)
+{
+	return oldcommit - heapbase + largebytes;
+}
+
+/* retire allocation buffer, so the nursery can be walked */
+static void
+retire(void)
+{
+	if (tlab.top != NULL)
+		heapfill(tlab.top, tlab.end + sizeof (Heap));
+	tlab.top = tlab.end = NULL;
+}
+
+/* check whether h is in eden or in the survivor space being evacuated */
+static int
+isyoung(Heap *h)
+{
+	return ((char *)h >= eden.base && (char *)h < eden.top) ||
+	       ((char *)h >= from.base && (char *)h < from.top);
+}
+
+/* start a young collection */
+void
+heap_youngbegin(void)
+{
+	retire();
+	to.top = to.base;
+	nmark = 0;
+}
+
+/* copy young object to the survivor space, or promote it when old or when the space is full */
+static Heap *
+evacuate(Heap *h)
+{
+	Heap *new;
+	size_t size, got, spare;
+	char *p;
+
+	if (h->mark == HEAP_FORWARDED)
+		return *(Heap **)HEAP_OBJ(h);
+	size = HEAP_SIZE(h);
+	spare = 0;
+	if (h->kind == K_ARRAY && isvector(h->type, (size_t)h->nmemb * elemsize[h->type])) {
+		size = objsize((size_t)h->nmemb * elemsize[h->type]);
+		spare = HEAP_VECALIGN - HEAP_ALIGN;
+	}
+	if (h->age + 1 < tenure && size + spare <= (size_t)(to.end - to.top)) {
+		p = to.top;
+		got = size + spare;
+		if (spare > 0)
+			p = vecalign(p, sizeof *h, &got);
+		to.top = p + size;
+		got = size;
+		new = (Heap *)p;
+	} else {
+		if ((p = heaptake(size + spare, size + spare, &got)) == NULL)
+			errx(EXIT_FAILURE, "out of memory");
+		allocated += got;
+		if (spare > 0)
+			p = vecalign(p, sizeof *h, &got);
+		new = (Heap *)p;
+		grow(&markstack, &markcap, nmark + 1, sizeof *markstack);
+		markstack[nmark++] = new;
+	}
+	memcpy(new, h, size);
+	new->size = got / HEAP_ALIGN;
+	new->age = h->age + 1;
+	if ((char *)new >= oldbase)
+		setstart((char *)new);
+	h->mark = HEAP_FORWARDED;
+	*(Heap **)HEAP_OBJ(h) = new;
+	return new;
+}
+
+/* update reference at p to young object to the object's new location, copying it if needed */
+void
+heap_evacuate(Heap **p)
+{
+	if (*p != NULL && isyoung(*p)) {
+		*p = evacuate(*p);
+	}
+}
+
+/* evacuate objects referenced by h; return whether h still references the nursery */
+static int
+scanobject(Heap *h)
+{
+	Heap *p;
+	int32_t i;
+	int young = 0;
+
+	if (h->type != T_REFERENCE)
+		return 0;
+	for (i = 0; i < h->nmemb; i++) {
+		p = ARRAY_GETREF(h, i);
+		heap_evacuate(&p);
+		ARRAY_SETREF(h, i, p);
+		if (p != NULL && (char *)p < oldbase) {
+			young = 1;
+		}
+	}
+	return young;
+}
+
+/* evacuate objects referenced from old objects whose card is dirty */
+static void
+scancards(void)
+{
+	Heap *h;
+	char *p, *end;
+	size_t i, n;
+
+	n = (oldtop - oldbase + HEAP_CARDSIZE - 1) / HEAP_CARDSIZE;
+	for (i = 0; i < n; i++) {
+		if (!cards[i] || firstobj[i] == HEAP_NOFIRST)
+			continue;
+		cards[i] = 0;
+		p = oldbase + i * HEAP_CARDSIZE + firstobj[i] * HEAP_ALIGN;
+		end = oldbase + (i + 1) * HEAP_CARDSIZE;
+		for (; p < end && p < oldtop; p += HEAP_SIZE(h)) {
+			h = (Heap *)p;
+			if (scanobject(h)) {
+				cards[i] = 1;
+			}
+		}
+	}
+}
+
+/*
+ * Finish a young collection, after the roots were evacuated: evacuate
+ * what is referenced from dirty cards and, transitively, from evacuated
+ * objects; then empty eden and swap the survivor spaces.  Promoted
+ * objects still referencing the nursery get their card dirtied.
+ */
+void
+heap_youngend(void)
+{
+	struct Space tmp;
+	Heap *h;
+	char *scan;
+
+	scancards();
+	scan = to.base;
+	while (scan < to.top || nmark > 0) {
+		if (scan < to.top) {
+			h = (Heap *)scan;
+			scan += HEAP_SIZE(h);
+			(void)scanobject(h);
+		} else {
+			h = markstack[--nmark];
+			if (scanobject(h)) {
+				heap_barrier(h);
+			}
+		}
+	}
+	eden.top = eden.base;
+	edenstate = EDEN_FREE;
+	tmp = from;
+	from = to;
+	to = tmp;
+	to.top = to.base;
+}
+
+/* check whether h is an array allocated outside the heap */
+static int
+islarge(Heap *h)
+{
+	size_t i;
+
+	for (i = 0; i < nlarge; i++)
+		if (large[i] == h)
+			return 1;
+	return 0;
+}
+
+/* check whether h is the start of an object, using the bitmap built by heap_markbegin */
+static int
+isobject(Heap *h)
+{
+	size_t off;
+
+	if (startmap == NULL)
+		return 0;
+	if ((char *)h < heapbase || (char *)h >= oldtop)
+		return islarge(h);
+	off = (char *)h - heapbase;
+	if (off % HEAP_ALIGN != 0)
+		return 0;
+	off /= HEAP_ALIGN;
+	return startmap[off / CHAR_BIT] & (1 << off % CHAR_BIT);
+}
+
+/* record object starts from p to end in the bitmap */
+static void
+mapstarts(char *p, char *end)
+{
+	Heap *h;
+	size_t off;
+
+	for (; p < end; p += HEAP_SIZE(h)) {
+		h = (Heap *)p;
+		if (h->kind != K_FILLER) {
+			off = (p - heapbase) / HEAP_ALIGN;
+			startmap[off / CHAR_BIT] |= 1 << off % CHAR_BIT;
+		}
+	}
+}
+
+/* start a full collection: retire allocation buffer and record where objects start */
+void
+heap_markbegin(void)
+{
+	retire();
+	free(startmap);
+	startmap = ecalloc((oldtop - heapbase) / HEAP_ALIGN / CHAR_BIT + 1, 1);
+	mapstarts(eden.base, eden.top);
+	mapstarts(from.base, from.top);
+	mapstarts(oldbase, oldtop);
+}
+
+/* push h onto the mark deque of worker w */
+static void
+push(struct Worker *w, Heap *h)
+{
+	(void)pthread_mutex_lock(&w->lock);
+	if (w->tail == w->cap && w->head > 0) {
+		memmove(w->deque, w->deque + w->head, (w->tail - w->head) * sizeof *w->deque);
+		__atomic_store_n(&w->tail, w->tail - w->head, __ATOMIC_RELAXED);
+		w->head = 0;
+	}
+	grow(&w->deque, &w->cap, w->tail + 1, sizeof *w->deque);
+	w->deque[w->tail] = h;
+	__atomic_store_n(&w->tail, w->tail + 1, __ATOMIC_RELAXED);
+	(void)pthread_mutex_unlock(&w->lock);
+}
+
+/* take object i from the mark deque of worker w, which is locked; the deque is reset once empty */
+static Heap *
+take(struct Worker *w, size_t i)
+{
+	Heap *h;
+
+	h = w->deque[i];
+	if (i == w->head)
+		w->head++;
+	else
+		__atomic_store_n(&w->tail, w->tail - 1, __ATOMIC_RELAXED);
+	if (w->head == w->tail) {
+		w->head = 0;
+		__atomic_store_n(&w->tail, 0, __ATOMIC_RELAXED);
+	}
+	return h;
+}
+
+/* take the newest object from the mark deque of worker w; return NULL if it is empty */
+static Heap *
+pop(struct Worker *w)
+{
+	Heap *h = NULL;
+
+	(void)pthread_mutex_lock(&w->lock);
+	if (w->tail > w->head)
+		h = take(w, w->tail - 1);
+	(void)pthread_mutex_unlock(&w->lock);
+	return h;
+}
+
+/* take the oldest object from the mark deque of some worker other than w; return NULL if all are empty */
+static Heap *
+steal(struct Worker *w)
+{
+	struct Worker *v;
+	Heap *h = NULL;
+	int i;
+
+	for (i = 1; h == NULL && i < nworkers; i++) {
+		v = &workers[(w - workers + i) % nworkers];
+		if (__atomic_load_n(&v->tail, __ATOMIC_RELAXED) == 0)
+			continue;
+		(void)pthread_mutex_lock(&v->lock);
+		if (v->tail > v->head)
+			h = take(v, v->head);
+		(void)pthread_mutex_unlock(&v->lock);
+	}
+	return h;
+}
+
+/* check whether some mark deque is not empty */
+static int
+haswork(void)
+{
+	int i;
+
+	for (i = 0; i < nworkers; i++)
+		if (__atomic_load_n(&workers[i].tail, __ATOMIC_RELAXED) > 0)
+			return 1;
+	return 0;
+}
+
+/* set mark of h; return whether it was clear, so h is to be scanned by the caller */
+static int
+setmark(Heap *h)
+{
+	return __atomic_load_n(&h->mark, __ATOMIC_RELAXED) == 0 &&
+	       __atomic_exchange_n(&h->mark, 1, __ATOMIC_RELAXED) == 0;
+}
+
+/*
+ * Mark objects reachable from the deques, as worker w.  Each worker
+ * scans objects from its own deque and steals from the others when it
+ * runs dry; marking is over when every worker is out of work, for then
+ * no deque can be refilled.
+ */
+static void
+markwork(struct Worker *w)
+{
+	Heap *h, *child;
+	int32_t i;
+
+	for (;;) {
+		while ((h = pop(w)) != NULL || (h = steal(w)) != NULL) {
+			if (h->type != T_REFERENCE)
+				continue;
+			for (i = 0; i < h->nmemb; i++) {
+				child = ARRAY_GETREF(h, i);
+				if (child != NULL && setmark(child)) {
+					push(w, child);
+				}
+			}
+		}
+		__atomic_add_fetch(&nidle, 1, __ATOMIC_SEQ_CST);
+		for (;;) {
+			if (__atomic_load_n(&nidle, __ATOMIC_SEQ_CST) == nworkers)
+				return;
+			if (haswork()) {
+				__atomic_sub_fetch(&nidle, 1, __ATOMIC_SEQ_CST);
+				break;
+			}
+			(void)sched_yield();
+		}
+	}
+}
+
+/* make the dead space from p to end into a free chunk of region r */
+static void
+addchunk(struct Region *r, char *p, char *end)
+{
+	heapfill(p, end);
+	if ((size_t)(end - p) < HEAP_MINCHUNK)
+		return;
+	grow(&r->chunks, &r->chunkcap, r->nchunks + 1, sizeof *r->chunks);
+	r->chunks[r->nchunks].p = p;
+	r->chunks[r->nchunks].size = end - p;
+	r->nchunks++;
+}
+
+/* free unmarked objects of region r, coalescing each run of them, and clear marks */
+static void
+sweepregion(struct Region *r)
+{
+	Heap *h;
+	char *p, *run;
+
+	r->nchunks = 0;
+	r->live = 0;
+	run = NULL;
+	for (p = r->begin; p < r->end; p += HEAP_SIZE(h)) {
+		h = (Heap *)p;
+		if (h->mark) {
+			h->mark = 0;
+			r->live += HEAP_SIZE(h);
+			setstart(p);
+			if (run != NULL)
+				addchunk(r, run, p);
+			run = NULL;
+		} else if (run == NULL) {
+			run = p;
+		}
+	}
+	if (run != NULL) {
+		addchunk(r, run, r->end);
+	}
+}
+
+/* sweep regions until none is left */
+static void
+sweepwork(void)
+{
+	size_t i;
+
+	while ((i = __atomic_fetch_add(&nextregion, 1, __ATOMIC_RELAXED)) < nregions)
+		sweepregion(&regions[i]);
+}
+
+/* do job as worker w */
+static void
+work(struct Worker *w, int job)
+{
+	switch (job) {
+	case JOB_MARK:
+		markwork(w);
+		break;
+	case JOB_SWEEP:
+		sweepwork();
+		break;
+	}
+}
+
+/* run jobs given by the interpreter thread, as worker arg */
+static void *
+workermain(void *arg)
+{
+	unsigned long gen = 0;
+	int j;
+
+	for (;;) {
+		(void)pthread_mutex_lock(&poollock);
+		while (jobgen == gen)
+			(void)pthread_cond_wait(&poolwake, &poollock);
+		gen = jobgen;
+		j = job;
+		(void)pthread_mutex_unlock(&poollock);
+		if (j == JOB_EXIT)
+			return NULL;
+		work(arg, j);
+		(void)pthread_mutex_lock(&poollock);
+		if (--nbusy == 0)
+			(void)pthread_cond_signal(&pooldone);
+		(void)pthread_mutex_unlock(&poollock);
+	}
+}
+
+/* run job on every worker, the interpreter thread being the first one, and wait for them */
+static void
+runjob(int j)
+{
+	nidle = 0;
+	if (nworkers == 1) {
+		work(&workers[0], j);
+		return;
+	}
+	(void)pthread_mutex_lock(&poollock);
+	job = j;
+	jobgen++;
+	nbusy = nworkers - 1;
+	(void)pthread_cond_broadcast(&poolwake);
+	(void)pthread_mutex_unlock(&poollock);
+	work(&workers[0], j);
+	(void)pthread_mutex_lock(&poollock);
+	while (nbusy > 0)
+		(void)pthread_cond_wait(&pooldone, &poollock);
+	(void)pthread_mutex_unlock(&poollock);
+}
+
+/* start n collector workers, the interpreter thread included */
+void
+heap_setworkers(int n)
+{
+	int i, e;
+
+	if (workers != NULL || n < 1)
+		return;
+	workers = ecalloc(n, sizeof *workers);
+	nworkers = n;
+	for (i = 0; i < n; i++) {
+		if ((e = pthread_mutex_init(&workers[i].lock, NULL)) != 0)
+			errx(EXIT_FAILURE, "pthread_mutex_init: %s", strerror(e));
+		if (i > 0 && (e = pthread_create(&workers[i].thread, NULL, workermain, &workers[i])) != 0) {
+			errx(EXIT_FAILURE, "pthread_create: %s", strerror(e));
+		}
+	}
+}
+
+/* mark h, if it is an object; objects reachable from it are marked by heap_marktrace */
+void
+heap_mark(Heap *h)
+{
+	if (!isobject(h) || !setmark(h))
+		return;
+	if (workers == NULL)
+		heap_setworkers(1);
+	push(&workers[nroots++ % nworkers], h);
+}
+
+/* mark every object reachable from the objects marked so far, in parallel */
+void
+heap_marktrace(void)
+{
+	if (workers != NULL)
+		runjob(JOB_MARK);
+	nroots = 0;
+}
+
+/* clear marks of objects from p to end */
+static void
+unmark(char *p, char *end)
+{
+	Heap *h;
+
+	for (; p < end; p += HEAP_SIZE(h)) {
+		h = (Heap *)p;
+		h->mark = 0;
+	}
+}
+
+/*
+ * Finish a full collection: free unmarked objects of old generation and
+ * clear marks.  Old generation is split into regions at object starts,
+ * which the workers sweep in parallel; free chunks are not coalesced
+ * across regions.  The nursery is left to young collections.  Return
+ * number of bytes live in old generation.
+ */
+size_t
+heap_sweep(void)
+{
+	struct Region *r;
+	size_t i, j, c, n, ncards;
+
+	if (workers == NULL)
+		heap_setworkers(1);
+	ncards = (oldtop - oldbase + HEAP_CARDSIZE - 1) / HEAP_CARDSIZE;
+	nregions = (nworkers > 1) ? (size_t)nworkers * HEAP_REGIONS : 1;
+	if (nregions > ncards)
+		nregions = ncards;
+	n = regioncap;
+	grow(&regions, &regioncap, nregions, sizeof *regions);
+	memset(regions + n, 0, (regioncap - n) * sizeof *regions);
+	for (i = 0; i < nregions; i++) {
+		for (c = i * ncards / nregions; c < ncards && firstobj[c] == HEAP_NOFIRST; c++)
+			;
+		regions[i].begin = (c < ncards) ? oldbase + c * HEAP_CARDSIZE + firstobj[c] * HEAP_ALIGN : oldtop;
+		if (i > 0)
+			regions[i - 1].end = regions[i].begin;
+	}
+	if (nregions > 0)
+		regions[nregions - 1].end = oldtop;
+	memset(firstobj, HEAP_NOFIRST, ncards);
+	nextregion = 0;
+	runjob(JOB_SWEEP);
+	nchunks = 0;
+	live = 0;
+	for (i = 0; i < nregions; i++) {
+		r = &regions[i];
+		live += r->live;
+		grow(&chunks, &chunkcap, nchunks + r->nchunks, sizeof *chunks);
+		for (j = 0; j < r->nchunks; j++) {
+			chunks[nchunks++] = r->chunks[j];
+		}
+	}
+	for (i = 0; i < nlarge; ) {
+		if (large[i]->mark) {
+			large[i]->mark = 0;
+			live += HEAP_SIZE(large[i]);
+			i++;
+		} else {
+			largefree(large[i]);
+			large[i] = large[--nlarge];
+		}
+	}
+	unmark(eden.base, eden.top);
+	unmark(from.base, from.top);
+	allocated = 0;
+	free(startmap);
+	startmap = NULL;
+	return live;
+}
+
+/* stop collector workers and release their deques */
+static void
+stopworkers(void)
+{
+	size_t r;
+	int i;
+
+	if (workers == NULL)
+		return;
+	(void)pthread_mutex_lock(&poollock);
+	job = JOB_EXIT;
+	jobgen++;
+	(void)pthread_cond_broadcast(&poolwake);
+	(void)pthread_mutex_unlock(&poollock);
+	for (i = 0; i < nworkers; i++) {
+		if (i > 0)
+			(void)pthread_join(workers[i].thread, NULL);
+		(void)pthread_mutex_destroy(&workers[i].lock);
+		free(workers[i].deque);
+	}
+	free(workers);
+	workers = NULL;
+	nworkers = 1;
+	for (r = 0; r < regioncap; r++)
+		free(regions[r].chunks);
+	free(regions);
+	regions = NULL;
+	nregions = regioncap = 0;
+}
+
+/* release the heap and all objects in it */
+void
+heap_del(void)
+{
+	if (heapbase != NULL)
+		(void)munmap(heapbase, heapend - heapbase);
+	heapbase = heapend = oldbase = oldtop = oldcommit = NULL;
+	tlab.top = tlab.end = NULL;
+	free(cards);
+	free(firstobj);
+	cards = firstobj = NULL;
+	free(chunks);
+	chunks = NULL;
+	nchunks = chunkcap = 0;
+	free(markstack);
+	markstack = NULL;
+	nmark = markcap = 0;
+	stopworkers();
+	while (nlarge > 0)
+		largefree(large[--nlarge]);
+	free(large);
+	large = NULL;
+	largecap = 0;
+	free(interntab);
+	interntab = NULL;
+	internsize = interncount = 0;
+}
+
+/* get size of array element of given type */
+size_t
+array_elemsize(U1 type)
+{
+	return elemsize[type];
+}
+
+/* get size of payload of array; arrays of references end with the name of their component class */
+static size_t
+arraysize(int32_t nmemb, U1 type)
+{
+	size_t size;
+
+	size = (size_t)(nmemb > 0 ? nmemb : 0) * elemsize[type];
+	if (type == T_REFERENCE)
+		size = roundup(size, sizeof (char *)) + sizeof (char *);
+	return size;
+}
+
+/* get storage of the name of the component class of array of references */
+static char **
+arrayclass(Heap *h)
+{
+	return (char **)((char *)HEAP_OBJ(h) + roundup((size_t)h->nmemb * elemsize[T_REFERENCE], sizeof (char *)));
+}
+
+/* get name or descriptor of component class of array of references, or NULL if unknown */
+char *
+array_getclass(Heap *h)
+{
+	return *arrayclass(h);
+}
+
+/* set name or descriptor of component class of array of references; it must outlive the array */
+void
+array_setclass(Heap *h, char *class)
+{
+	*arrayclass(h) = class;
+}
+
+/* allocate one-dimensional array of elements of given type */
+Heap *
+array_new(int32_t nmemb, U1 type)
+{
+	Heap *h;
+	size_t size, total;
+	char *p;
+
+	size = arraysize(nmemb, type);
+	if (isvector(type, size) && size >= largesize && heap_oopbase == NULL) {
+		h = largenew(size);
+	} else if (!isvector(type, size)) {
+		h = heap_alloc(K_ARRAY, size);
+	} else if ((total = objsize(size)) == 0 ||
+	           (p = heapraw(total + HEAP_VECALIGN - HEAP_ALIGN, &total)) == NULL) {
+		h = NULL;
+	} else {
+		p = vecalign(p, sizeof *h, &total);
+		h = heapinit(p, total, K_ARRAY);
+	}
+	if (h == NULL)
+		return NULL;
+	h->type = type;
+	h->nmemb = nmemb;
+	return h;
+}
+
+/*
+ * Make array of nmemb elements of given type in storage p outside the
+ * heap, of at least sizeof (Heap) + nmemb * array_elemsize(type) bytes.
+ * The collector ignores such arrays, so they must hold no references.
+ */
+Heap *
+array_local(void *p, int32_t nmemb, U1 type)
+{
+	Heap *h = p;
+	size_t size;
+
+	size = (size_t)nmemb * elemsize[type];
+	memset(h, 0, sizeof *h + size);
+	h->size = roundup(sizeof *h + size, HEAP_ALIGN) / HEAP_ALIGN;
+	h->kind = K_ARRAY;
+	h->type = type;
+	h->nmemb = nmemb;
+	return h;
+}
+
+/*
+ * Allocate array of n arrays of nmemb elements of given type, of class
+ * with given descriptor, as a single block: the outer array is followed
+ * by the rows, each a complete array with its own header.  Rows replaced
+ * later are just dead objects in the block, which the collector reclaims
+ * or moves like any other.  Return NULL if the block cannot be allocated.
+ */
+static Heap *
+matrixnew(int32_t n, int32_t nmemb, U1 type, char *class)
+{
+	Heap *h, *row;
+	size_t outer, size, rowsize, total, spare;
+	int32_t i;
+	char *p;
+
+	size = arraysize(nmemb, type);
+	if ((outer = objsize(arraysize(n, T_REFERENCE))) == 0 ||
+	    (rowsize = objsize(size)) == 0 ||
+	    (isvector(type, size) && size >= largesize && heap_oopbase == NULL))
+		return NULL;
+	/* aligned rows are padded so that each payload is aligned when the first one is */
+	spare = isvector(type, size) ? HEAP_VECALIGN - HEAP_ALIGN : 0;
+	if (spare > 0)
+		rowsize = roundup(rowsize, HEAP_VECALIGN);
+	if (rowsize > (SIZE_MAX - outer - spare) / n)
+		return NULL;
+	if ((p = heapraw(outer + n * rowsize + spare, &total)) == NULL)
+		return NULL;
+	if (spare > 0)
+		p = vecalign(p, outer + sizeof *h, &total);
+	h = heapinit(p, outer, K_ARRAY);
+	h->type = T_REFERENCE;
+	h->nmemb = n;
+	array_setclass(h, class + 1);
+	p += outer;
+	for (i = 0; i < n; i++) {
+		/* the last row takes any slack left by the allocator */
+		row = heapinit(p, (i < n - 1) ? rowsize : total - outer - (size_t)i * rowsize, K_ARRAY);
+		row->type = type;
+		row->nmemb = nmemb;
+		if (type == T_REFERENCE)
+			array_setclass(row, class + 2);
+		ARRAY_SETREF(h, i, row);
+		p += rowsize;
+	}
+	return h;
+}
+
+/*
+ * Allocate multidimensional array of class with given descriptor; the
+ * innermost dimension has elements of given type.  Each two-dimensional
+ * part is allocated contiguously when possible, so rows of a matrix are
+ * adjacent in memory.
+ */
+Heap *
+array_multinew(int32_t *nmemb, U1 dimension, U1 type, char *class)
+{
+	Heap *h, *row;
+	int32_t i;
+
+	if (dimension == 1) {
+		if ((h = array_new(*nmemb, type)) != NULL && type == T_REFERENCE)
+			array_setclass(h, class + 1);
+		return h;
+	}
+	if (dimension == 2 && nmemb[0] > 0 && (h = matrixnew(nmemb[0], nmemb[1], type, class)) != NULL)
+		return h;
+	if ((h = array_new(*nmemb, T_REFERENCE)) == NULL)
+		return NULL;
+	array_setclass(h, class + 1);
+	for (i = 0; i < *nmemb; i++) {
+		if ((row = array_multinew(nmemb + 1, dimension - 1, type, class + 1)) == NULL)
+			return NULL;
+		ARRAY_SETREF(h, i, row);
+	}
+	heap_barrier(h);
+	return h;
+}
+
+/* allocate string of given coder and length; its characters are zero */
+Heap *
+string_new(U1 coder, int32_t length)
+{
+	String *s;
+	Heap *h;
+
+	h = heap_alloc(K_STRING, sizeof (String) + (size_t)length * (coder == STRING_UTF16 ? sizeof (U2) : 1));
+	if (h == NULL)
+		return NULL;
+	s = HEAP_OBJ(h);
+	s->length = length;
+	s->hash = 0;
+	s->hashed = 0;
+	s->coder = coder;
+	return h;
+}
+
+/* decode next UTF-16 code unit from modified UTF-8 string; advance *s */
+static U2
+utf8decode(unsigned char **s)
+{
+	unsigned char *p = *s;
+	U2 c;
+
+	if (p[0] < 0x80) {
+		c = p[0];
+		p += 1;
+	} else if ((p[0] & 0xE0) == 0xC0 && p[1]) {
+		c = ((p[0] & 0x1F) << 6) | (p[1] & 0x3F);
+		p += 2;
+	} else if ((p[0] & 0xF0) == 0xE0 && p[1] && p[2]) {
+		c = ((p[0] & 0x0F) << 12) | ((p[1] & 0x3F) << 6) | (p[2] & 0x3F);
+		p += 3;
+	} else {
+		c = 0xFFFD;
+		p += 1;
+	}
+	*s = p;
+	return c;
+}
+
+/* allocate string from modified UTF-8 (as in the constant pool); use latin1 if possible */
+Heap *
+string_fromutf8(char *str)
+{
+	unsigned char *p;
+	String *s;
+	Heap *h;
+	int32_t i, length;
+	U1 coder;
+	U2 c;
+
+	coder = STRING_LATIN1;
+	length = 0;
+	for (p = (unsigned char *)str; *p; length++)
+		if (utf8decode(&p) > 0xFF)
+			coder = STRING_UTF16;
+	if ((h = string_new(coder, length)) == NULL)
+		return NULL;
+	s = HEAP_OBJ(h);
+	p = (unsigned char *)str;
+	for (i = 0; i < length; i++) {
+		c = utf8decode(&p);
+		if (coder == STRING_LATIN1) {
+			s->value[i] = c;
+		} else {
+			((U2 *)s->value)[i] = c;
+		}
+	}
+	return h;
+}
+
+/* get i-th character of string */
+U2
+string_charat(String *s, int32_t i)
+{
+	if (s->coder == STRING_LATIN1)
+		return s->value[i];
+	return ((U2 *)s->value)[i];
+}
+
+/* get hashCode() of string, computing it on first call */
+int32_t
+string_hash(String *s)
+{
+	uint32_t h = 0;
+	int32_t i;
+
+	if (s->hashed)
+		return s->hash;
+	if (s->coder == STRING_LATIN1)
+		for (i = 0; i < s->length; i++)
+			h = 31 * h + s->value[i];
+	else
+		for (i = 0; i < s->length; i++)
+			h = 31 * h + ((U2 *)s->value)[i];
+	s->hash = (int32_t)h;
+	s->hashed = 1;
+	return s->hash;
+}
+
+/* check whether two strings have the same characters */
+int
+string_equals(String *a, String *b)
+{
+	int32_t i;
+
+	if (a == b)
+		return 1;
+	if (a->length != b->length)
+		return 0;
+	if (a->hashed && b->hashed && a->hash != b->hash)
+		return 0;
+	if (a->coder == b->coder)
+		return memcmp(a->value, b->value, (size_t)a->length * (a->coder == STRING_UTF16 ? sizeof (U2) : 1)) == 0;
+	for (i = 0; i < a->length; i++)
+		if (string_charat(a, i) != string_charat(b, i))
+			return 0;
+	return 1;
+}
+
+/* get canonical representation of string from intern table, adding it if absent */
+Heap *
+string_intern(Heap *h)
+{
+	Heap **old;
+	size_t i, j, oldsize, mask;
+
+	if (2 * (interncount + 1) > internsize) {
+		old = interntab;
+		oldsize = internsize;
+		internsize = internsize ? 2 * internsize : 256;
+		if ((interntab = calloc(internsize, sizeof *interntab)) == NULL)
+			return NULL;
+		mask = internsize - 1;
+		for (j = 0; j < oldsize; j++) {
+			if (old[j] == NULL)
+				continue;
+			for (i = string_hash(HEAP_OBJ(old[j])) & mask; interntab[i]; i = (i + 1) & mask)
+				;
+			interntab[i] = old[j];
+		}
+		free(old);
+	}
+	mask = internsize - 1;
+	for (i = string_hash(HEAP_OBJ(h)) & mask; interntab[i]; i = (i + 1) & mask)
+		if (string_equals(HEAP_OBJ(interntab[i]), HEAP_OBJ(h)))
+			return interntab[i];
+	interntab[i] = h;
+	interncount++;
+	return h;
+}
+
+/* mark interned strings */
+void
+string_markinterned(void)
+{
+	size_t i;
+
+	for (i = 0; i < internsize; i++) {
+		if (interntab[i] != NULL) {
+			heap_mark(interntab[i]);
+		}
+	}
+}
+
+/* update interned strings that were moved by a young collection */
+void
+string_evacuateinterned(void)
+{
+	size_t i;
+
+	for (i = 0; i < internsize; i++) {
+		if (interntab[i] != NULL) {
+			heap_evacuate(&interntab[i]);
+		}
+	}
+}
@@ -0,0 +1,97 @@
+#define HEAP_MAXSIZE    ((size_t)1024 * 1024 * 1024)   /* default size of reserved heap */
+#define HEAP_TLABSIZE   (256 * 1024)                    /* default size of allocation buffers */
+#define HEAP_COMMITSIZE (4 * 1024 * 1024)               /* granularity of heap commits */
+#define HEAP_INITSIZE   (16 * 1024 * 1024)              /* default bytes in use before first collection */
+#define HEAP_VECALIGN   32                              /* alignment of payloads of large primitive arrays */
+#define HEAP_VECMIN     256                             /* smallest payload of primitive array that is aligned */
+#define HEAP_LAZYZERO   (1024 * 1024)                   /* smallest reused memory zeroed by the kernel */
+#define HEAP_LARGESIZE  (4 * 1024 * 1024)               /* default smallest array allocated outside the heap */
+#define HEAP_LOCALMAX   4096                            /* largest payload of array allocated in its frame */
+#define HEAP_MINCHUNK   256                             /* smallest free chunk reused for allocation */
+#define HEAP_ALIGN      8                               /* alignment of heap objects */
+#define HEAP_NEWSIZE    (8 * 1024 * 1024)               /* default size of the nursery */
+#define HEAP_TENURE     6                               /* default collections survived before promotion */
+#define HEAP_MAXTENURE  15                              /* largest collections survived before promotion */
+#define HEAP_CARDSIZE   512                             /* bytes of old generation per card */
+#define HEAP_NOFIRST    0xFF                            /* no object starts in card */
+#define HEAP_REGIONS    4                               /* regions of old generation swept per worker */
+#define HEAP_FORWARDED  2                               /* mark of young object copied elsewhere */
+#define HEAP_OOPSHIFT   3                               /* shift of compressed references, log2 of HEAP_ALIGN */
+#define HEAP_OOPMAX     ((size_t)1 << (32 + HEAP_OOPSHIFT)) /* largest heap addressed by compressed references */
+
+#define HEAP_OBJ(h)     ((void *)((Heap *)(h) + 1))             /* payload of heap object */
+#define HEAP_SIZE(h)    ((size_t)(h)->size * HEAP_ALIGN)        /* size of heap object, header included */
+#define ARRAY_LENGTH(h) ((h)->nmemb)                            /* number of elements of array */
+#define ARRAY_TYPE(h)   ((h)->type)                             /* element type of array */
+#define ARRAY_ELEM(h, t, i) (((t *)HEAP_OBJ(h))[i])             /* element i of array of C type t */
+#define STRING_OBJ(h)   ((String *)HEAP_OBJ(h))                 /* characters of string */
+#define NATIVE_OBJ(h)   (*(void **)HEAP_OBJ(h))                 /* native object held by heap object */
+
+/* compressed reference of object r, or object of compressed reference n; 0 is null */
+#define HEAP_ENCODE(r)  ((r) != NULL ? (U4)(((char *)(r) - heap_oopbase) >> HEAP_OOPSHIFT) : 0)
+#define HEAP_DECODE(n)  ((n) != 0 ? (Heap *)(heap_oopbase + ((size_t)(n) << HEAP_OOPSHIFT)) : NULL)
+
+/* element i of reference array, stored compressed if heap_oopbase is set */
+#define ARRAY_GETREF(h, i) (heap_oopbase != NULL ? HEAP_DECODE(ARRAY_ELEM(h, U4, i)) : ARRAY_ELEM(h, Heap *, i))
+#define ARRAY_SETREF(h, i, r) (heap_oopbase != NULL ? (void)(ARRAY_ELEM(h, U4, i) = HEAP_ENCODE(r)) \
+                                                    : (void)(ARRAY_ELEM(h, Heap *, i) = (r)))
+
+/* thread-local allocation buffer, a chunk of the heap allocated by bumping top */
+typedef struct Tlab {
+	char   *top;            /* next free byte */
+	char   *end;            /* end of buffer, minus room for a filler header */
+} Tlab;
+
+/* coder of string payload */
+enum {
+	STRING_LATIN1,          /* one byte per character */
+	STRING_UTF16,           /* one UTF-16 code unit per character */
+};
+
+/* java.lang.String object */
+typedef struct String {
+	int32_t length;         /* number of characters */
+	int32_t hash;           /* cached hashCode(), valid if hashed is set */
+	U1      hashed;
+	U1      coder;
+	U1      value[];        /* latin1 bytes or UTF-16 code units */
+} String;
+
+extern char *heap_oopbase;
+
+void heap_init(size_t maxsize, size_t newsize, size_t tlabsize, int tenure, size_t largesize, int compressed);
+Heap *heap_alloc(U1 kind, size_t size);
+int32_t heap_hash(Heap *h);
+void heap_barrier(Heap *h);
+int heap_needcollect(void);
+int heap_needfull(void);
+int heap_youngpending(void);
+void heap_youngskip(void);
+void heap_settrigger(size_t size);
+size_t heap_young(void);
+size_t heap_old(void);
+size_t heap_maxsize(void);
+size_t heap_committed(void);
+void heap_youngbegin(void);
+void heap_evacuate(Heap **p);
+void heap_youngend(void);
+void heap_markbegin(void);
+void heap_setworkers(int n);
+void heap_mark(Heap *h);
+void heap_marktrace(void);
+size_t heap_sweep(void);
+void heap_del(void);
+size_t array_elemsize(U1 type);
+Heap *array_new(int32_t nmemb, U1 type);
+Heap *array_local(void *p, int32_t nmemb, U1 type);
+Heap *array_multinew(int32_t *nmemb, U1 dimension, U1 type, char *class);
+char *array_getclass(Heap *h);
+void array_setclass(Heap *h, char *class);
+Heap *string_new(U1 coder, int32_t length);
+Heap *string_fromutf8(char *s);
+Heap *string_intern(Heap *h);
+U2 string_charat(String *s, int32_t i);
+int32_t string_hash(String *s);
+int string_equals(String *a, String *b);
+void string_markinterned(void);
+void string_evacuateinterned(void);
@@ -1,9 +1,94 @@
+#include <math.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include "util.h"
 #include "class.h"
+#include "frame.h"
 #include "memory.h"
 #include "native.h"
+#include "output.h"
+#include "simd.h"
+
+#define NBUCKETS 64     /* must be a power of two */
+
+static void natarraycopy(Frame *frame);
+static void natarrayscopyof(Frame *frame);
+static void natarraysequals(Frame *frame);
+static void natarraysfill(Frame *frame);
+static void natarraysfillrange(Frame *frame);
+static void natflush(Frame *frame);
+static void natidentityhashcode(Frame *frame);
+static void natprintstring(Frame *frame);
+static void natprintbool(Frame *frame);
+static void natprintchar(Frame *frame);
+static void natprintint(Frame *frame);
+static void natprintlong(Frame *frame);
+static void natprintfloat(Frame *frame);
+static void natprintdouble(Frame *frame);
+static void natprintlnvoid(Frame *frame);
+static void natprintlnstring(Frame *frame);
+static void natprintlnbool(Frame *frame);
+static void natprintlnchar(Frame *frame);
+static void natprintlnint(Frame *frame);
+static void natprintlnlong(Frame *frame);
+static void natprintlnfloat(Frame *frame);
+static void natprintlndouble(Frame *frame);
+static void natstringcharat(Frame *frame);
+static void natstringhashcode(Frame *frame);
+static void natstringintern(Frame *frame);
+static void natstringisempty(Frame *frame);
+static void natstringlength(Frame *frame);
+static void natsimdsum(Frame *frame);
+static void natsimddot(Frame *frame);
+static void natsimdadd(Frame *frame);
+static void natsimdsub(Frame *frame);
+static void natsimdmul(Frame *frame);
+static void natsimddiv(Frame *frame);
+static void natsimdmismatch(Frame *frame);
+static void natmathsqrt(Frame *frame);
+static void natmathabsint(Frame *frame);
+static void natmathabslong(Frame *frame);
+static void natmathabsfloat(Frame *frame);
+static void natmathabsdouble(Frame *frame);
+static void natmathminint(Frame *frame);
+static void natmathminlong(Frame *frame);
+static void natmathminfloat(Frame *frame);
+static void natmathmindouble(Frame *frame);
+static void natmathmaxint(Frame *frame);
+static void natmathmaxlong(Frame *frame);
+static void natmathmaxfloat(Frame *frame);
+static void natmathmaxdouble(Frame *frame);
+static void natmathfloor(Frame *frame);
+static void natmathceil(Frame *frame);
+static void natmathrint(Frame *frame);
+static void natmathfmafloat(Frame *frame);
+static void natmathfmadouble(Frame *frame);
+static void natmathsin(Frame *frame);
+static void natmathcos(Frame *frame);
+static void natmathexp(Frame *frame);
+static void natmathlog(Frame *frame);
+static void natmathpow(Frame *frame);
+static void natintegerbitcount(Frame *frame);
+static void natintegernlz(Frame *frame);
+static void natlongbitcount(Frame *frame);
+static void natlongnlz(Frame *frame);
+static int32_t absint(int32_t a);
+static int64_t abslong(int64_t a);
+static int32_t minint(int32_t a, int32_t b);
+static int64_t minlong(int64_t a, int64_t b);
+static float minfloat(float a, float b);
+static double mindouble(double a, double b);
+static int32_t maxint(int32_t a, int32_t b);
+static int64_t maxlong(int64_t a, int64_t b);
+static float maxfloat(float a, float b);
+static double maxdouble(double a, double b);
+static double powdouble(double a, double b);
+static int32_t bitcountint(int32_t a);
+static int32_t bitcountlong(int64_t a);
+static int32_t nlzint(int32_t a);
+static int32_t nlzlong(int64_t a);
 
 static struct {
 	char *name;
@@ -11,34 +96,1293 @@ static struct {
 } jclasstab[] = {
 	{"java/lang/System",    LANG_SYSTEM},
 	{"java/io/PrintStream", IO_PRINTSTREAM},
+	{"java/lang/String",    LANG_STRING},
+	{"java/util/Arrays",    UTIL_ARRAYS},
+	{"jvm/Simd",            JVM_SIMD},
+	{"java/lang/Math",      LANG_MATH},
+	{"java/lang/StrictMath", LANG_STRICTMATH},
+	{"java/lang/Integer",   LANG_INTEGER},
+	{"java/lang/Long",      LANG_LONG},
 	{NULL,                  NONE_CLASS},
 };
 
-void
-natprintln(Frame *frame, char *type)
-{
-	Value vfp, v;
-
-	v = frame_stackpop(frame);
-	vfp = frame_stackpop(frame);
-	if (strcmp(type, "(Ljava/lang/String;)V") == 0)
-		fprintf((FILE *)vfp.v->obj, "%s\n", (char *)v.v->obj);
-	else if (strcmp(type, "(B)V") == 0)
-		fprintf((FILE *)vfp.v->obj, "%d\n", v.i);
-	else if (strcmp(type, "(C)V") == 0)
-		fprintf((FILE *)vfp.v->obj, "%c\n", v.i);
-	else if (strcmp(type, "(D)V") == 0)
-		fprintf((FILE *)vfp.v->obj, "%.16g\n", v.d);
-	else if (strcmp(type, "(F)V") == 0)
-		fprintf((FILE *)vfp.v->obj, "%.16g\n", v.f);
-	else if (strcmp(type, "(I)V") == 0)
-		fprintf((FILE *)vfp.v->obj, "%d\n", v.i);
-	else if (strcmp(type, "(J)V") == 0)
-		fprintf((FILE *)vfp.v->obj, "%lld\n", v.l);
-	else if (strcmp(type, "(S)V") == 0)
-		fprintf((FILE *)vfp.v->obj, "%d\n", v.i);
-	else if (strcmp(type, "(Z)V") == 0)
-		fprintf((FILE *)vfp.v->obj, "%d\n", v.i);
+static Native nativetab[] = {
+	NATIVE("java/lang/System",    "arraycopy", "(Ljava/lang/Object;ILjava/lang/Object;II)V", natarraycopy),
+	NATIVE("java/lang/System",    "identityHashCode", "(Ljava/lang/Object;)I", natidentityhashcode),
+	NATIVE("java/util/Arrays",    "copyOf",  "([ZI)[Z",                  natarrayscopyof),
+	NATIVE("java/util/Arrays",    "copyOf",  "([CI)[C",                  natarrayscopyof),
+	NATIVE("java/util/Arrays",    "copyOf",  "([BI)[B",                  natarrayscopyof),
+	NATIVE("java/util/Arrays",    "copyOf",  "([SI)[S",                  natarrayscopyof),
+	NATIVE("java/util/Arrays",    "copyOf",  "([II)[I",                  natarrayscopyof),
+	NATIVE("java/util/Arrays",    "copyOf",  "([JI)[J",                  natarrayscopyof),
+	NATIVE("java/util/Arrays",    "copyOf",  "([FI)[F",                  natarrayscopyof),
+	NATIVE("java/util/Arrays",    "copyOf",  "([DI)[D",                  natarrayscopyof),
+	NATIVE("java/util/Arrays",    "copyOf",  "([Ljava/lang/Object;I)[Ljava/lang/Object;", natarrayscopyof),
+	NATIVE("java/util/Arrays",    "equals",  "([Z[Z)Z",                  natarraysequals),
+	NATIVE("java/util/Arrays",    "equals",  "([C[C)Z",                  natarraysequals),
+	NATIVE("java/util/Arrays",    "equals",  "([B[B)Z",                  natarraysequals),
+	NATIVE("java/util/Arrays",    "equals",  "([S[S)Z",                  natarraysequals),
+	NATIVE("java/util/Arrays",    "equals",  "([I[I)Z",                  natarraysequals),
+	NATIVE("java/util/Arrays",    "equals",  "([J[J)Z",                  natarraysequals),
+	NATIVE("java/util/Arrays",    "equals",  "([F[F)Z",                  natarraysequals),
+	NATIVE("java/util/Arrays",    "equals",  "([D[D)Z",                  natarraysequals),
+	NATIVE("java/util/Arrays",    "fill",    "([ZZ)V",                   natarraysfill),
+	NATIVE("java/util/Arrays",    "fill",    "([CC)V",                   natarraysfill),
+	NATIVE("java/util/Arrays",    "fill",    "([BB)V",                   natarraysfill),
+	NATIVE("java/util/Arrays",    "fill",    "([SS)V",                   natarraysfill),
+	NATIVE("java/util/Arrays",    "fill",    "([II)V",                   natarraysfill),
+	NATIVE("java/util/Arrays",    "fill",    "([JJ)V",                   natarraysfill),
+	NATIVE("java/util/Arrays",    "fill",    "([FF)V",                   natarraysfill),
+	NATIVE("java/util/Arrays",    "fill",    "([DD)V",                   natarraysfill),
+	NATIVE("java/util/Arrays",    "fill",    "([Ljava/lang/Object;Ljava/lang/Object;)V", natarraysfill),
+	NATIVE("java/util/Arrays",    "fill",    "([ZIIZ)V",                 natarraysfillrange),
+	NATIVE("java/util/Arrays",    "fill",    "([CIIC)V",                 natarraysfillrange),
+	NATIVE("java/util/Arrays",    "fill",    "([BIIB)V",                 natarraysfillrange),
+	NATIVE("java/util/Arrays",    "fill",    "([SIIS)V",                 natarraysfillrange),
+	NATIVE("java/util/Arrays",    "fill",    "([IIII)V",                 natarraysfillrange),
+	NATIVE("java/util/Arrays",    "fill",    "([JIIJ)V",                 natarraysfillrange),
+	NATIVE("java/util/Arrays",    "fill",    "([FIIF)V",                 natarraysfillrange),
+	NATIVE("java/util/Arrays",    "fill",    "([DIID)V",                 natarraysfillrange),
+	NATIVE("java/util/Arrays",    "fill",    "([Ljava/lang/Object;IILjava/lang/Object;)V", natarraysfillrange),
+	NATIVE("java/io/PrintStream", "flush",   "()V",                    natflush),
+	NATIVE("java/io/PrintStream", "print",   "(Ljava/lang/String;)V",  natprintstring),
+	NATIVE("java/io/PrintStream", "print",   "(B)V",                   natprintint),
+	NATIVE("java/io/PrintStream", "print",   "(C)V",                   natprintchar),
+	NATIVE("java/io/PrintStream", "print",   "(D)V",                   natprintdouble),
+	NATIVE("java/io/PrintStream", "print",   "(F)V",                   natprintfloat),
+	NATIVE("java/io/PrintStream", "print",   "(I)V",                   natprintint),
+	NATIVE("java/io/PrintStream", "print",   "(J)V",                   natprintlong),
+	NATIVE("java/io/PrintStream", "print",   "(S)V",                   natprintint),
+	NATIVE("java/io/PrintStream", "print",   "(Z)V",                   natprintbool),
+	NATIVE("java/io/PrintStream", "println", "()V",                    natprintlnvoid),
+	NATIVE("java/io/PrintStream", "println", "(Ljava/lang/String;)V",  natprintlnstring),
+	NATIVE("java/io/PrintStream", "println", "(B)V",                   natprintlnint),
+	NATIVE("java/io/PrintStream", "println", "(C)V",                   natprintlnchar),
+	NATIVE("java/io/PrintStream", "println", "(D)V",                   natprintlndouble),
+	NATIVE("java/io/PrintStream", "println", "(F)V",                   natprintlnfloat),
+	NATIVE("java/io/PrintStream", "println", "(I)V",                   natprintlnint),
+	NATIVE("java/io/PrintStream", "println", "(J)V",                   natprintlnlong),
+	NATIVE("java/io/PrintStream", "println", "(S)V",                   natprintlnint),
+	NATIVE("java/io/PrintStream", "println", "(Z)V",                   natprintlnbool),
+	NATIVE("java/lang/String",    "charAt",   "(I)C",                  natstringcharat),
+	NATIVE("java/lang/String",    "hashCode", "()I",                   natstringhashcode),
+	NATIVE("java/lang/String",    "intern",   "()Ljava/lang/String;",  natstringintern),
+	NATIVE("java/lang/String",    "isEmpty",  "()Z",                   natstringisempty),
+	NATIVE("java/lang/String",    "length",   "()I",                   natstringlength),
+	NATIVE("jvm/Simd",            "sum",      "([IIII)I",              natsimdsum),
+	NATIVE("jvm/Simd",            "sum",      "([JIIJ)J",              natsimdsum),
+	NATIVE("jvm/Simd",            "dot",      "([I[IIII)I",            natsimddot),
+	NATIVE("jvm/Simd",            "dot",      "([J[JIIJ)J",            natsimddot),
+	NATIVE("jvm/Simd",            "add",      "([I[I[III)V",           natsimdadd),
+	NATIVE("jvm/Simd",            "add",      "([J[J[JII)V",           natsimdadd),
+	NATIVE("jvm/Simd",            "add",      "([D[D[DII)V",           natsimdadd),
+	NATIVE("jvm/Simd",            "sub",      "([I[I[III)V",           natsimdsub),
+	NATIVE("jvm/Simd",            "sub",      "([J[J[JII)V",           natsimdsub),
+	NATIVE("jvm/Simd",            "sub",      "([D[D[DII)V",           natsimdsub),
+	NATIVE("jvm/Simd",            "mul",      "([I[I[III)V",           natsimdmul),
+	NATIVE("jvm/Simd",            "mul",      "([J[J[JII)V",           natsimdmul),
+	NATIVE("jvm/Simd",            "mul",      "([D[D[DII)V",           natsimdmul),
+	NATIVE("jvm/Simd",            "div",      "([D[D[DII)V",           natsimddiv),
+	NATIVE("jvm/Simd",            "mismatch", "([B[BII)I",             natsimdmismatch),
+	INTRINSIC("java/lang/Math",       "sqrt",  "(D)D",   natmathsqrt,        INTRINSIC_SQRT, sqrt),
+	INTRINSIC("java/lang/Math",       "abs",   "(I)I",   natmathabsint,      INTRINSIC_ABS, absint),
+	INTRINSIC("java/lang/Math",       "abs",   "(J)J",   natmathabslong,     INTRINSIC_ABS, abslong),
+	INTRINSIC("java/lang/Math",       "abs",   "(F)F",   natmathabsfloat,    INTRINSIC_ABS, fabsf),
+	INTRINSIC("java/lang/Math",       "abs",   "(D)D",   natmathabsdouble,   INTRINSIC_ABS, fabs),
+	INTRINSIC("java/lang/Math",       "min",   "(II)I",  natmathminint,      INTRINSIC_MIN, minint),
+	INTRINSIC("java/lang/Math",       "min",   "(JJ)J",  natmathminlong,     INTRINSIC_MIN, minlong),
+	INTRINSIC("java/lang/Math",       "min",   "(FF)F",  natmathminfloat,    INTRINSIC_CALL, minfloat),
+	INTRINSIC("java/lang/Math",       "min",   "(DD)D",  natmathmindouble,   INTRINSIC_CALL, mindouble),
+	INTRINSIC("java/lang/Math",       "max",   "(II)I",  natmathmaxint,      INTRINSIC_MAX, maxint),
+	INTRINSIC("java/lang/Math",       "max",   "(JJ)J",  natmathmaxlong,     INTRINSIC_MAX, maxlong),
+	INTRINSIC("java/lang/Math",       "max",   "(FF)F",  natmathmaxfloat,    INTRINSIC_CALL, maxfloat),
+	INTRINSIC("java/lang/Math",       "max",   "(DD)D",  natmathmaxdouble,   INTRINSIC_CALL, maxdouble),
+	INTRINSIC("java/lang/Math",       "floor", "(D)D",   natmathfloor,       INTRINSIC_FLOOR, floor),
+	INTRINSIC("java/lang/Math",       "ceil",  "(D)D",   natmathceil,        INTRINSIC_CEIL, ceil),
+	INTRINSIC("java/lang/Math",       "rint",  "(D)D",   natmathrint,        INTRINSIC_RINT, rint),
+	INTRINSIC("java/lang/Math",       "fma",   "(FFF)F", natmathfmafloat,    INTRINSIC_FMA, fmaf),
+	INTRINSIC("java/lang/Math",       "fma",   "(DDD)D", natmathfmadouble,   INTRINSIC_FMA, fma),
+	INTRINSIC("java/lang/Math",       "sin",   "(D)D",   natmathsin,         INTRINSIC_CALL, sin),
+	INTRINSIC("java/lang/Math",       "cos",   "(D)D",   natmathcos,         INTRINSIC_CALL, cos),
+	INTRINSIC("java/lang/Math",       "exp",   "(D)D",   natmathexp,         INTRINSIC_CALL, exp),
+	INTRINSIC("java/lang/Math",       "log",   "(D)D",   natmathlog,         INTRINSIC_CALL, log),
+	INTRINSIC("java/lang/Math",       "pow",   "(DD)D",  natmathpow,         INTRINSIC_CALL, powdouble),
+	INTRINSIC("java/lang/StrictMath", "sqrt",  "(D)D",   natmathsqrt,        INTRINSIC_SQRT, sqrt),
+	INTRINSIC("java/lang/StrictMath", "abs",   "(I)I",   natmathabsint,      INTRINSIC_ABS, absint),
+	INTRINSIC("java/lang/StrictMath", "abs",   "(J)J",   natmathabslong,     INTRINSIC_ABS, abslong),
+	INTRINSIC("java/lang/StrictMath", "abs",   "(F)F",   natmathabsfloat,    INTRINSIC_ABS, fabsf),
+	INTRINSIC("java/lang/StrictMath", "abs",   "(D)D",   natmathabsdouble,   INTRINSIC_ABS, fabs),
+	INTRINSIC("java/lang/StrictMath", "min",   "(II)I",  natmathminint,      INTRINSIC_MIN, minint),
+	INTRINSIC("java/lang/StrictMath", "min",   "(JJ)J",  natmathminlong,     INTRINSIC_MIN, minlong),
+	INTRINSIC("java/lang/StrictMath", "min",   "(FF)F",  natmathminfloat,    INTRINSIC_CALL, minfloat),
+	INTRINSIC("java/lang/StrictMath", "min",   "(DD)D",  natmathmindouble,   INTRINSIC_CALL, mindouble),
+	INTRINSIC("java/lang/StrictMath", "max",   "(II)I",  natmathmaxint,      INTRINSIC_MAX, maxint),
+	INTRINSIC("java/lang/StrictMath", "max",   "(JJ)J",  natmathmaxlong,     INTRINSIC_MAX, maxlong),
+	INTRINSIC("java/lang/StrictMath", "max",   "(FF)F",  natmathmaxfloat,    INTRINSIC_CALL, maxfloat),
+	INTRINSIC("java/lang/StrictMath", "max",   "(DD)D",  natmathmaxdouble,   INTRINSIC_CALL, maxdouble),
+	INTRINSIC("java/lang/StrictMath", "floor", "(D)D",   natmathfloor,       INTRINSIC_FLOOR, floor),
+	INTRINSIC("java/lang/StrictMath", "ceil",  "(D)D",   natmathceil,        INTRINSIC_CEIL, ceil),
+	INTRINSIC("java/lang/StrictMath", "rint",  "(D)D",   natmathrint,        INTRINSIC_RINT, rint),
+	INTRINSIC("java/lang/StrictMath", "fma",   "(FFF)F", natmathfmafloat,    INTRINSIC_FMA, fmaf),
+	INTRINSIC("java/lang/StrictMath", "fma",   "(DDD)D", natmathfmadouble,   INTRINSIC_FMA, fma),
+	INTRINSIC("java/lang/StrictMath", "sin",   "(D)D",   natmathsin,         INTRINSIC_CALL, sin),
+	INTRINSIC("java/lang/StrictMath", "cos",   "(D)D",   natmathcos,         INTRINSIC_CALL, cos),
+	INTRINSIC("java/lang/StrictMath", "exp",   "(D)D",   natmathexp,         INTRINSIC_CALL, exp),
+	INTRINSIC("java/lang/StrictMath", "log",   "(D)D",   natmathlog,         INTRINSIC_CALL, log),
+	INTRINSIC("java/lang/StrictMath", "pow",   "(DD)D",  natmathpow,         INTRINSIC_CALL, powdouble),
+	INTRINSIC("java/lang/Integer",    "bitCount", "(I)I",   natintegerbitcount, INTRINSIC_BITCOUNT, bitcountint),
+	INTRINSIC("java/lang/Integer",    "numberOfLeadingZeros", "(I)I",   natintegernlz,      INTRINSIC_NLZ, nlzint),
+	INTRINSIC("java/lang/Long",       "bitCount", "(J)I",   natlongbitcount,    INTRINSIC_BITCOUNT, bitcountlong),
+	INTRINSIC("java/lang/Long",       "numberOfLeadingZeros", "(J)I",   natlongnlz,         INTRINSIC_NLZ, nlzlong),
+	NATIVE("jvm/Simd",            "mismatch", "([C[CII)I",             natsimdmismatch),
+	NATIVE("jvm/Simd",            "mismatch", "([S[SII)I",             natsimdmismatch),
+	NATIVE("jvm/Simd",            "mismatch", "([I[III)I",             natsimdmismatch),
+};
+
+static Native *buckets[NBUCKETS];
+
+/* exit on java exception; natives cannot throw exceptions yet */
+static void
+natthrow(char *exception)
+{
+	// TODO: throw exception
+	errx(EXIT_FAILURE, "%s", exception);
+}
+
+/* store value as array element of given type at elem */
+static void
+setelem(void *elem, U1 type, Value v)
+{
+	switch (type) {
+	case T_BOOLEAN: case T_BYTE:
+		*(int8_t *)elem = v.i;
+		break;
+	case T_CHAR: case T_SHORT:
+		*(int16_t *)elem = v.i;
+		break;
+	case T_INT:
+		*(int32_t *)elem = v.i;
+		break;
+	case T_FLOAT:
+		*(float *)elem = v.f;
+		break;
+	case T_LONG:
+		*(int64_t *)elem = v.l;
+		break;
+	case T_DOUBLE:
+		*(double *)elem = v.d;
+		break;
+	default:
+		if (heap_oopbase != NULL)
+			*(U4 *)elem = HEAP_ENCODE(v.v);
+		else
+			*(Heap **)elem = v.v;
+		break;
+	}
+}
+
+/* fill nmemb elements of array from index i with value */
+static void
+fill(Heap *h, int32_t i, int32_t nmemb, Value v)
+{
+	union {
+		int64_t l;
+		double  d;
+		void   *p;
+	} elem;         /* aligned storage for any element */
+	size_t size;
+
+	size = array_elemsize(ARRAY_TYPE(h));
+	setelem(&elem, ARRAY_TYPE(h), v);
+	simd_fill((char *)HEAP_OBJ(h) + (size_t)i * size, &elem, size, nmemb);
+	if (ARRAY_TYPE(h) == T_REFERENCE)
+		heap_barrier(h);
+}
+
+/* get class name given by class name or field descriptor s, and its length */
+static char *
+classname(char *s, size_t *len)
+{
+	*len = strlen(s);
+	if (s[0] == 'L' && s[*len - 1] == ';') {
+		*len -= 2;
+		return s + 1;
+	}
+	return s;
+}
+
+/* check whether class names or field descriptors a and b name the same class */
+static int
+sameclass(char *a, char *b)
+{
+	size_t alen, blen;
+
+	a = classname(a, &alen);
+	b = classname(b, &blen);
+	return alen == blen && strncmp(a, b, alen) == 0;
+}
+
+static int isassignable(char *a, char *b);
+
+/* check whether array of components of class comp is assignable to class b; NULL names an unknown class */
+static int
+isarrayassignable(char *comp, char *b)
+{
+	if (b == NULL || sameclass(b, "java/lang/Object") ||
+	    sameclass(b, "java/lang/Cloneable") || sameclass(b, "java/io/Serializable"))
+		return 1;
+	return b[0] == '[' && isassignable(comp, b + 1);
+}
+
+/*
+ * Check whether class a is assignable to class b, each given by class
+ * name or field descriptor.  NULL names an unknown class, to which
+ * anything is assignable and which is assignable only to Object.
+ */
+static int
+isassignable(char *a, char *b)
+{
+	if (b == NULL)
+		return 1;
+	if (a != NULL && a[0] != '\0' && a[1] == '\0')       /* primitive type */
+		return strcmp(a, b) == 0;
+	if (sameclass(b, "java/lang/Object"))
+		return 1;
+	if (a == NULL)
+		return 0;
+	if (a[0] == '[')
+		return isarrayassignable(a + 1, b);
+	if (sameclass(a, "java/lang/String") &&
+	    (sameclass(b, "java/lang/CharSequence") || sameclass(b, "java/lang/Comparable") ||
+	     sameclass(b, "java/io/Serializable")))
+		return 1;
+	return sameclass(a, b);
+}
+
+/* check whether object h can be stored in array of components of class b */
+static int
+isinstance(Heap *h, char *b)
+{
+	static char *types[T_LAST] = {
+		[T_BOOLEAN] = "Z", [T_CHAR]  = "C", [T_FLOAT] = "F", [T_DOUBLE] = "D",
+		[T_BYTE]    = "B", [T_SHORT] = "S", [T_INT]   = "I", [T_LONG]   = "J",
+	};
+
+	if (h == NULL)
+		return 1;
+	switch (h->kind) {
+	case K_STRING:
+		return isassignable("java/lang/String", b);
+	case K_ARRAY:
+		if (ARRAY_TYPE(h) == T_REFERENCE)
+			return isarrayassignable(array_getclass(h), b);
+		return isarrayassignable(types[ARRAY_TYPE(h)], b);
+	default:
+		/* the class of native objects is not recorded */
+		return isassignable(NULL, b);
+	}
+}
+
+/* System.arraycopy(Object, int, Object, int, int): copy range of array, which may overlap */
+static void
+natarraycopy(Frame *frame)
+{
+	Value vsrc, vsrcpos, vdst, vdstpos, vlen;
+	size_t size;
+	int32_t i;
+
+	vlen = frame_stackpop(frame);
+	vdstpos = frame_stackpop(frame);
+	vdst = frame_stackpop(frame);
+	vsrcpos = frame_stackpop(frame);
+	vsrc = frame_stackpop(frame);
+	if (vsrc.v == NULL || vdst.v == NULL)
+		natthrow("java.lang.NullPointerException");
+	if (ARRAY_TYPE(vsrc.v) == T_NONE || ARRAY_TYPE(vsrc.v) != ARRAY_TYPE(vdst.v))
+		natthrow("java.lang.ArrayStoreException");
+	if (vsrcpos.i < 0 || vdstpos.i < 0 || vlen.i < 0 ||
+	    vlen.i > ARRAY_LENGTH(vsrc.v) - vsrcpos.i ||
+	    vlen.i > ARRAY_LENGTH(vdst.v) - vdstpos.i)
+		natthrow("java.lang.ArrayIndexOutOfBoundsException");
+	/* elements of arrays of unrelated components must each be assignable to the destination's */
+	if (ARRAY_TYPE(vdst.v) == T_REFERENCE && !isassignable(array_getclass(vsrc.v), array_getclass(vdst.v)))
+		for (i = 0; i < vlen.i; i++)
+			if (!isinstance(ARRAY_GETREF(vsrc.v, vsrcpos.i + i), array_getclass(vdst.v)))
+				natthrow("java.lang.ArrayStoreException");
+	size = array_elemsize(ARRAY_TYPE(vsrc.v));
+	memmove((char *)HEAP_OBJ(vdst.v) + (size_t)vdstpos.i * size,
+	        (char *)HEAP_OBJ(vsrc.v) + (size_t)vsrcpos.i * size,
+	        (size_t)vlen.i * size);
+	if (ARRAY_TYPE(vdst.v) == T_REFERENCE)
+		heap_barrier(vdst.v);
+}
+
+/* System.identityHashCode(Object): get hash code kept in the object header */
+static void
+natidentityhashcode(Frame *frame)
+{
+	Value v;
+
+	v = frame_stackpop(frame);
+	v.i = (v.v == NULL) ? 0 : heap_hash(v.v);
+	frame_stackpush(frame, v);
+}
+
+/* Arrays.copyOf(T[], int): copy array, truncating or padding it with zeros */
+static void
+natarrayscopyof(Frame *frame)
+{
+	Value va, vlen;
+	Heap *h;
+	int32_t n;
+
+	vlen = frame_stackpop(frame);
+	va = frame_stackpop(frame);
+	if (va.v == NULL)
+		natthrow("java.lang.NullPointerException");
+	if (vlen.i < 0)
+		natthrow("java.lang.NegativeArraySizeException");
+	if ((h = array_new(vlen.i, ARRAY_TYPE(va.v))) == NULL)
+		natthrow("java.lang.OutOfMemoryError");
+	if (ARRAY_TYPE(h) == T_REFERENCE)
+		array_setclass(h, array_getclass(va.v));
+	n = (vlen.i < ARRAY_LENGTH(va.v)) ? vlen.i : ARRAY_LENGTH(va.v);
+	memcpy(HEAP_OBJ(h), HEAP_OBJ(va.v), (size_t)n * array_elemsize(ARRAY_TYPE(va.v)));
+	if (ARRAY_TYPE(h) == T_REFERENCE)
+		heap_barrier(h);
+	va.v = h;
+	frame_stackpush(frame, va);
+}
+
+/* Arrays.equals(T[], T[]): check whether arrays have the same elements */
+static void
+natarraysequals(Frame *frame)
+{
+	Value va, vb, v;
+	int32_t i;
+	size_t size;
+
+	vb = frame_stackpop(frame);
+	va = frame_stackpop(frame);
+	if (va.v == vb.v) {
+		v.i = 1;
+	} else if (va.v == NULL || vb.v == NULL || ARRAY_LENGTH(va.v) != ARRAY_LENGTH(vb.v)) {
+		v.i = 0;
+	} else {
+		size = array_elemsize(ARRAY_TYPE(va.v));
+		v.i = memcmp(HEAP_OBJ(va.v), HEAP_OBJ(vb.v), (size_t)ARRAY_LENGTH(va.v) * size) == 0;
+		/* floats compare as floatToIntBits/doubleToLongBits, so all NaNs are equal */
+		if (!v.i && ARRAY_TYPE(va.v) == T_FLOAT) {
+			for (v.i = 1, i = 0; v.i && i < ARRAY_LENGTH(va.v); i++) {
+				v.i = memcmp(&ARRAY_ELEM(va.v, float, i), &ARRAY_ELEM(vb.v, float, i), size) == 0 ||
+				      (isnan(ARRAY_ELEM(va.v, float, i)) && isnan(ARRAY_ELEM(vb.v, float, i)));
+			}
+		} else if (!v.i && ARRAY_TYPE(va.v) == T_DOUBLE) {
+			for (v.i = 1, i = 0; v.i && i < ARRAY_LENGTH(va.v); i++) {
+				v.i = memcmp(&ARRAY_ELEM(va.v, double, i), &ARRAY_ELEM(vb.v, double, i), size) == 0 ||
+				      (isnan(ARRAY_ELEM(va.v, double, i)) && isnan(ARRAY_ELEM(vb.v, double, i)));
+			}
+		}
+	}
+	frame_stackpush(frame, v);
+}
+
+/* Arrays.fill(T[], T): set every element of array to value */
+static void
+natarraysfill(Frame *frame)
+{
+	Value va, v;
+
+	v = frame_stackpop(frame);
+	va = frame_stackpop(frame);
+	if (va.v == NULL)
+		natthrow("java.lang.NullPointerException");
+	fill(va.v, 0, ARRAY_LENGTH(va.v), v);
+}
+
+/* Arrays.fill(T[], int, int, T): set elements of array from an index to another to value */
+static void
+natarraysfillrange(Frame *frame)
+{
+	Value va, vfrom, vto, v;
+
+	v = frame_stackpop(frame);
+	vto = frame_stackpop(frame);
+	vfrom = frame_stackpop(frame);
+	va = frame_stackpop(frame);
+	if (va.v == NULL)
+		natthrow("java.lang.NullPointerException");
+	if (vfrom.i > vto.i)
+		natthrow("java.lang.IllegalArgumentException");
+	if (vfrom.i < 0 || vto.i > ARRAY_LENGTH(va.v))
+		natthrow("java.lang.ArrayIndexOutOfBoundsException");
+	fill(va.v, vfrom.i, vto.i - vfrom.i, v);
+}
+
+/*
+ * The jvm/Simd natives run the simple array loops the optimizer of
+ * bytecode finds with vector kernels.  The code it puts in front of a
+ * loop calls them only for ranges of the arrays it checked, so they run
+ * just as many iterations of the loop as it would.
+ */
+
+/* check that elements of array from an index to another exist */
+static void
+checkrange(Heap *h, int32_t from, int32_t to)
+{
+	if (h == NULL)
+		natthrow("java.lang.NullPointerException");
+	if (from < 0 || from > to || to > ARRAY_LENGTH(h))
+		natthrow("java.lang.ArrayIndexOutOfBoundsException");
+}
+
+/* Simd.sum(T[], int, int, T): add elements of int or long array from an index to another to a sum */
+static void
+natsimdsum(Frame *frame)
+{
+	Value va, vfrom, vto, v;
+
+	v = frame_stackpop(frame);
+	vto = frame_stackpop(frame);
+	vfrom = frame_stackpop(frame);
+	va = frame_stackpop(frame);
+	checkrange(va.v, vfrom.i, vto.i);
+	if (ARRAY_TYPE(va.v) == T_LONG)
+		v.l = (int64_t)((uint64_t)v.l + (uint64_t)simd_sumlong(&ARRAY_ELEM(va.v, int64_t, vfrom.i), vto.i - vfrom.i));
+	else
+		v.i = (int32_t)((uint32_t)v.i + (uint32_t)simd_sumint(&ARRAY_ELEM(va.v, int32_t, vfrom.i), vto.i - vfrom.i));
+	frame_stackpush(frame, v);
+}
+
+/* Simd.dot(T[], T[], int, int, T): add products of elements of int or long arrays from an index to another to a sum */
+static void
+natsimddot(Frame *frame)
+{
+	Value va, vb, vfrom, vto, v;
+
+	v = frame_stackpop(frame);
+	vto = frame_stackpop(frame);
+	vfrom = frame_stackpop(frame);
+	vb = frame_stackpop(frame);
+	va = frame_stackpop(frame);
+	checkrange(va.v, vfrom.i, vto.i);
+	checkrange(vb.v, vfrom.i, vto.i);
+	if (ARRAY_TYPE(va.v) == T_LONG)
+		v.l = (int64_t)((uint64_t)v.l + (uint64_t)simd_dotlong(&ARRAY_ELEM(va.v, int64_t, vfrom.i),
+		                                                       &ARRAY_ELEM(vb.v, int64_t, vfrom.i), vto.i - vfrom.i));
+	else
+		v.i = (int32_t)((uint32_t)v.i + (uint32_t)simd_dotint(&ARRAY_ELEM(va.v, int32_t, vfrom.i),
+		                                                      &ARRAY_ELEM(vb.v, int32_t, vfrom.i), vto.i - vfrom.i));
+	frame_stackpush(frame, v);
+}
+
+/* set elements of int, long or double array c from an index to another to the operation on those of a and b */
+static void
+simdmap(Frame *frame, SimdOp op)
+{
+	Value vc, va, vb, vfrom, vto;
+	int32_t i, n;
+
+	vto = frame_stackpop(frame);
+	vfrom = frame_stackpop(frame);
+	vb = frame_stackpop(frame);
+	va = frame_stackpop(frame);
+	vc = frame_stackpop(frame);
+	checkrange(vc.v, vfrom.i, vto.i);
+	checkrange(va.v, vfrom.i, vto.i);
+	checkrange(vb.v, vfrom.i, vto.i);
+	i = vfrom.i;
+	n = vto.i - vfrom.i;
+	switch (ARRAY_TYPE(vc.v)) {
+	case T_LONG:
+		simd_maplong(op, &ARRAY_ELEM(vc.v, int64_t, i), &ARRAY_ELEM(va.v, int64_t, i), &ARRAY_ELEM(vb.v, int64_t, i), n);
+		break;
+	case T_DOUBLE:
+		simd_mapdouble(op, &ARRAY_ELEM(vc.v, double, i), &ARRAY_ELEM(va.v, double, i), &ARRAY_ELEM(vb.v, double, i), n);
+		break;
+	default:
+		simd_mapint(op, &ARRAY_ELEM(vc.v, int32_t, i), &ARRAY_ELEM(va.v, int32_t, i), &ARRAY_ELEM(vb.v, int32_t, i), n);
+		break;
+	}
+}
+
+/* Simd.add(T[], T[], T[], int, int): add elements of arrays from an index to another */
+static void
+natsimdadd(Frame *frame)
+{
+	simdmap(frame, SIMD_ADD);
+}
+
+/* Simd.sub(T[], T[], T[], int, int): subtract elements of arrays from an index to another */
+static void
+natsimdsub(Frame *frame)
+{
+	simdmap(frame, SIMD_SUB);
+}
+
+/* Simd.mul(T[], T[], T[], int, int): multiply elements of arrays from an index to another */
+static void
+natsimdmul(Frame *frame)
+{
+	simdmap(frame, SIMD_MUL);
+}
+
+/* Simd.div(double[], double[], double[], int, int): divide elements of arrays from an index to another */
+static void
+natsimddiv(Frame *frame)
+{
+	simdmap(frame, SIMD_DIV);
+}
+
+/* Simd.mismatch(T[], T[], int, int): get first index from one to another where arrays differ, or the last */
+static void
+natsimdmismatch(Frame *frame)
+{
+	Value va, vb, vfrom, vto, v;
+	size_t size;
+
+	vto = frame_stackpop(frame);
+	vfrom = frame_stackpop(frame);
+	vb = frame_stackpop(frame);
+	va = frame_stackpop(frame);
+	checkrange(va.v, vfrom.i, vto.i);
+	checkrange(vb.v, vfrom.i, vto.i);
+	size = array_elemsize(ARRAY_TYPE(va.v));
+	v.i = vfrom.i + simd_mismatch((char *)HEAP_OBJ(va.v) + (size_t)vfrom.i * size,
+	                              (char *)HEAP_OBJ(vb.v) + (size_t)vfrom.i * size,
+	                              (size_t)(vto.i - vfrom.i) * size) / size;
+	frame_stackpush(frame, v);
+}
+
+/* Math.abs(int); the most negative value is its own absolute value */
+static int32_t
+absint(int32_t a)
+{
+	return (a < 0) ? (int32_t)(0 - (uint32_t)a) : a;
+}
+
+/* Math.abs(long) */
+static int64_t
+abslong(int64_t a)
+{
+	return (a < 0) ? (int64_t)(0 - (uint64_t)a) : a;
+}
+
+/* Math.min(int, int) */
+static int32_t
+minint(int32_t a, int32_t b)
+{
+	return (a <= b) ? a : b;
+}
+
+/* Math.min(long, long) */
+static int64_t
+minlong(int64_t a, int64_t b)
+{
+	return (a <= b) ? a : b;
+}
+
+/* Math.min(float, float): NaN if either value is, and -0.0 is less than 0.0 */
+static float
+minfloat(float a, float b)
+{
+	if (a != a)
+		return a;
+	if (a == 0.0f && b == 0.0f)
+		return signbit(a) ? a : b;
+	return (a <= b) ? a : b;
+}
+
+/* Math.min(double, double) */
+static double
+mindouble(double a, double b)
+{
+	if (a != a)
+		return a;
+	if (a == 0.0 && b == 0.0)
+		return signbit(a) ? a : b;
+	return (a <= b) ? a : b;
+}
+
+/* Math.max(int, int) */
+static int32_t
+maxint(int32_t a, int32_t b)
+{
+	return (a >= b) ? a : b;
+}
+
+/* Math.max(long, long) */
+static int64_t
+maxlong(int64_t a, int64_t b)
+{
+	return (a >= b) ? a : b;
+}
+
+/* Math.max(float, float): NaN if either value is, and 0.0 is greater than -0.0 */
+static float
+maxfloat(float a, float b)
+{
+	if (a != a)
+		return a;
+	if (a == 0.0f && b == 0.0f)
+		return signbit(a) ? b : a;
+	return (a >= b) ? a : b;
+}
+
+/* Math.max(double, double) */
+static double
+maxdouble(double a, double b)
+{
+	if (a != a)
+		return a;
+	if (a == 0.0 && b == 0.0)
+		return signbit(a) ? b : a;
+	return (a >= b) ? a : b;
+}
+
+/* Math.pow(double, double); unlike C, a NaN exponent, or 1 or -1 to an infinite one, gives NaN */
+static double
+powdouble(double a, double b)
+{
+	if (b != b || (isinf(b) && fabs(a) == 1.0))
+		return NAN;
+	return pow(a, b);
+}
+
+/* Integer.bitCount(int) */
+static int32_t
+bitcountint(int32_t a)
+{
+	uint32_t u = a;
+
+	u = u - ((u >> 1) & 0x55555555u);
+	u = (u & 0x33333333u) + ((u >> 2) & 0x33333333u);
+	u = (u + (u >> 4)) & 0x0F0F0F0Fu;
+	return (u * 0x01010101u) >> 24;
+}
+
+/* Long.bitCount(long) */
+static int32_t
+bitcountlong(int64_t a)
+{
+	return bitcountint((int32_t)(uint32_t)a) + bitcountint((int32_t)(uint32_t)((uint64_t)a >> 32));
+}
+
+/* Integer.numberOfLeadingZeros(int) */
+static int32_t
+nlzint(int32_t a)
+{
+	uint32_t u = a;
+	int32_t n;
+
+	for (n = 32; u != 0; u >>= 1)
+		n--;
+	return n;
+}
+
+/* Long.numberOfLeadingZeros(long) */
+static int32_t
+nlzlong(int64_t a)
+{
+	uint64_t u = a;
+
+	return (u >> 32) ? nlzint((int32_t)(uint32_t)(u >> 32)) : 32 + nlzint((int32_t)(uint32_t)u);
+}
+
+/* call fn on the double on the operand stack, replacing it with the result */
+static void
+mathdouble(Frame *frame, double (*fn)(double))
+{
+	Value v;
+
+	v = frame_stackpop(frame);
+	v.d = (*fn)(v.d);
+	frame_stackpush(frame, v);
+}
+
+/* call fn on the two doubles on the operand stack, replacing them with the result */
+static void
+mathdouble2(Frame *frame, double (*fn)(double, double))
+{
+	Value va, vb;
+
+	vb = frame_stackpop(frame);
+	va = frame_stackpop(frame);
+	va.d = (*fn)(va.d, vb.d);
+	frame_stackpush(frame, va);
+}
+
+/* call fn on the two floats on the operand stack, replacing them with the result */
+static void
+mathfloat2(Frame *frame, float (*fn)(float, float))
+{
+	Value va, vb;
+
+	vb = frame_stackpop(frame);
+	va = frame_stackpop(frame);
+	va.f = (*fn)(va.f, vb.f);
+	frame_stackpush(frame, va);
+}
+
+/* call fn on the two ints on the operand stack, replacing them with the result */
+static void
+mathint2(Frame *frame, int32_t (*fn)(int32_t, int32_t))
+{
+	Value va, vb;
+
+	vb = frame_stackpop(frame);
+	va = frame_stackpop(frame);
+	va.i = (*fn)(va.i, vb.i);
+	frame_stackpush(frame, va);
+}
+
+/* call fn on the two longs on the operand stack, replacing them with the result */
+static void
+mathlong2(Frame *frame, int64_t (*fn)(int64_t, int64_t))
+{
+	Value va, vb;
+
+	vb = frame_stackpop(frame);
+	va = frame_stackpop(frame);
+	va.l = (*fn)(va.l, vb.l);
+	frame_stackpush(frame, va);
+}
+
+/* Math.sqrt(double): get square root */
+static void
+natmathsqrt(Frame *frame)
+{
+	mathdouble(frame, sqrt);
+}
+
+/* Math.abs(int): get absolute value */
+static void
+natmathabsint(Frame *frame)
+{
+	Value v;
+
+	v = frame_stackpop(frame);
+	v.i = absint(v.i);
+	frame_stackpush(frame, v);
+}
+
+/* Math.abs(long): get absolute value */
+static void
+natmathabslong(Frame *frame)
+{
+	Value v;
+
+	v = frame_stackpop(frame);
+	v.l = abslong(v.l);
+	frame_stackpush(frame, v);
+}
+
+/* Math.abs(float): get absolute value */
+static void
+natmathabsfloat(Frame *frame)
+{
+	Value v;
+
+	v = frame_stackpop(frame);
+	v.f = fabsf(v.f);
+	frame_stackpush(frame, v);
+}
+
+/* Math.abs(double): get absolute value */
+static void
+natmathabsdouble(Frame *frame)
+{
+	mathdouble(frame, fabs);
+}
+
+/* Math.min(int, int): get the smaller value */
+static void
+natmathminint(Frame *frame)
+{
+	mathint2(frame, minint);
+}
+
+/* Math.min(long, long): get the smaller value */
+static void
+natmathminlong(Frame *frame)
+{
+	mathlong2(frame, minlong);
+}
+
+/* Math.min(float, float): get the smaller value */
+static void
+natmathminfloat(Frame *frame)
+{
+	mathfloat2(frame, minfloat);
+}
+
+/* Math.min(double, double): get the smaller value */
+static void
+natmathmindouble(Frame *frame)
+{
+	mathdouble2(frame, mindouble);
+}
+
+/* Math.max(int, int): get the greater value */
+static void
+natmathmaxint(Frame *frame)
+{
+	mathint2(frame, maxint);
+}
+
+/* Math.max(long, long): get the greater value */
+static void
+natmathmaxlong(Frame *frame)
+{
+	mathlong2(frame, maxlong);
+}
+
+/* Math.max(float, float): get the greater value */
+static void
+natmathmaxfloat(Frame *frame)
+{
+	mathfloat2(frame, maxfloat);
+}
+
+/* Math.max(double, double): get the greater value */
+static void
+natmathmaxdouble(Frame *frame)
+{
+	mathdouble2(frame, maxdouble);
+}
+
+/* Math.floor(double): round toward negative infinity */
+static void
+natmathfloor(Frame *frame)
+{
+	mathdouble(frame, floor);
+}
+
+/* Math.ceil(double): round toward positive infinity */
+static void
+natmathceil(Frame *frame)
+{
+	mathdouble(frame, ceil);
+}
+
+/* Math.rint(double): round to the nearest integer, ties to even */
+static void
+natmathrint(Frame *frame)
+{
+	mathdouble(frame, rint);
+}
+
+/* Math.fma(float, float, float): multiply and add, rounding once */
+static void
+natmathfmafloat(Frame *frame)
+{
+	Value va, vb, vc;
+
+	vc = frame_stackpop(frame);
+	vb = frame_stackpop(frame);
+	va = frame_stackpop(frame);
+	va.f = fmaf(va.f, vb.f, vc.f);
+	frame_stackpush(frame, va);
+}
+
+/* Math.fma(double, double, double): multiply and add, rounding once */
+static void
+natmathfmadouble(Frame *frame)
+{
+	Value va, vb, vc;
+
+	vc = frame_stackpop(frame);
+	vb = frame_stackpop(frame);
+	va = frame_stackpop(frame);
+	va.d = fma(va.d, vb.d, vc.d);
+	frame_stackpush(frame, va);
+}
+
+/* Math.sin(double): get sine */
+static void
+natmathsin(Frame *frame)
+{
+	mathdouble(frame, sin);
+}
+
+/* Math.cos(double): get cosine */
+static void
+natmathcos(Frame *frame)
+{
+	mathdouble(frame, cos);
+}
+
+/* Math.exp(double): get e raised to the value */
+static void
+natmathexp(Frame *frame)
+{
+	mathdouble(frame, exp);
+}
+
+/* Math.log(double): get natural logarithm */
+static void
+natmathlog(Frame *frame)
+{
+	mathdouble(frame, log);
+}
+
+/* Math.pow(double, double): raise the first value to the second */
+static void
+natmathpow(Frame *frame)
+{
+	mathdouble2(frame, powdouble);
+}
+
+/* Integer.bitCount(int): count one bits */
+static void
+natintegerbitcount(Frame *frame)
+{
+	Value v;
+
+	v = frame_stackpop(frame);
+	v.i = bitcountint(v.i);
+	frame_stackpush(frame, v);
+}
+
+/* Integer.numberOfLeadingZeros(int): count zero bits above the highest one bit */
+static void
+natintegernlz(Frame *frame)
+{
+	Value v;
+
+	v = frame_stackpop(frame);
+	v.i = nlzint(v.i);
+	frame_stackpush(frame, v);
+}
+
+/* Long.bitCount(long): count one bits */
+static void
+natlongbitcount(Frame *frame)
+{
+	Value v;
+
+	v = frame_stackpop(frame);
+	v.i = bitcountlong(v.l);
+	frame_stackpush(frame, v);
+}
+
+/* Long.numberOfLeadingZeros(long): count zero bits above the highest one bit */
+static void
+natlongnlz(Frame *frame)
+{
+	Value v;
+
+	v = frame_stackpop(frame);
+	v.i = nlzlong(v.l);
+	frame_stackpush(frame, v);
+}
+
+/* write string object, or "null" */
+static void
+printstring(Output *out, Heap *h)
+{
+	String *s;
+
+	if (h == NULL) {
+		output_string(out, "null");
+		return;
+	}
+	s = STRING_OBJ(h);
+	if (s->coder == STRING_LATIN1)
+		output_latin1(out, s->value, s->length);
+	else
+		output_utf16(out, (U2 *)s->value, s->length);
+}
+
+/* flush(): write buffered output */
+static void
+natflush(Frame *frame)
+{
+	Value vout;
+
+	vout = frame_stackpop(frame);
+	output_flush(NATIVE_OBJ(vout.v));
+}
+
+/* print(String): print string */
+static void
+natprintstring(Frame *frame)
+{
+	Value vout, v;
+
+	v = frame_stackpop(frame);
+	vout = frame_stackpop(frame);
+	printstring(NATIVE_OBJ(vout.v), v.v);
+}
+
+/* print(boolean): print "true" or "false" */
+static void
+natprintbool(Frame *frame)
+{
+	Value vout, v;
+
+	v = frame_stackpop(frame);
+	vout = frame_stackpop(frame);
+	output_string(NATIVE_OBJ(vout.v), v.i ? "true" : "false");
+}
+
+/* print(char): print character */
+static void
+natprintchar(Frame *frame)
+{
+	Value vout, v;
+
+	v = frame_stackpop(frame);
+	vout = frame_stackpop(frame);
+	output_char(NATIVE_OBJ(vout.v), v.i);
+}
+
+/* print(int), print(byte), print(short): print integer */
+static void
+natprintint(Frame *frame)
+{
+	Value vout, v;
+
+	v = frame_stackpop(frame);
+	vout = frame_stackpop(frame);
+	output_int(NATIVE_OBJ(vout.v), v.i);
+}
+
+/* print(long): print long */
+static void
+natprintlong(Frame *frame)
+{
+	Value vout, v;
+
+	v = frame_stackpop(frame);
+	vout = frame_stackpop(frame);
+	output_long(NATIVE_OBJ(vout.v), v.l);
+}
+
+/* print(float): print float */
+static void
+natprintfloat(Frame *frame)
+{
+	Value vout, v;
+
+	v = frame_stackpop(frame);
+	vout = frame_stackpop(frame);
+	output_float(NATIVE_OBJ(vout.v), v.f);
+}
+
+/* print(double): print double */
+static void
+natprintdouble(Frame *frame)
+{
+	Value vout, v;
+
+	v = frame_stackpop(frame);
+	vout = frame_stackpop(frame);
+	output_double(NATIVE_OBJ(vout.v), v.d);
+}
+
+/* println(): print line separator */
+static void
+natprintlnvoid(Frame *frame)
+{
+	Value vout;
+
+	vout = frame_stackpop(frame);
+	output_newline(NATIVE_OBJ(vout.v));
+}
+
+/* println(String): print string and line separator */
+static void
+natprintlnstring(Frame *frame)
+{
+	Value vout, v;
+
+	v = frame_stackpop(frame);
+	vout = frame_stackpop(frame);
+	printstring(NATIVE_OBJ(vout.v), v.v);
+	output_newline(NATIVE_OBJ(vout.v));
+}
+
+/* println(boolean): print "true" or "false" and line separator */
+static void
+natprintlnbool(Frame *frame)
+{
+	Value vout, v;
+
+	v = frame_stackpop(frame);
+	vout = frame_stackpop(frame);
+	output_string(NATIVE_OBJ(vout.v), v.i ? "true" : "false");
+	output_newline(NATIVE_OBJ(vout.v));
+}
+
+/* println(char): print character and line separator */
+static void
+natprintlnchar(Frame *frame)
+{
+	Value vout, v;
+
+	v = frame_stackpop(frame);
+	vout = frame_stackpop(frame);
+	output_char(NATIVE_OBJ(vout.v), v.i);
+	output_newline(NATIVE_OBJ(vout.v));
+}
+
+/* println(int), println(byte), println(short): print integer and line separator */
+static void
+natprintlnint(Frame *frame)
+{
+	Value vout, v;
+
+	v = frame_stackpop(frame);
+	vout = frame_stackpop(frame);
+	output_int(NATIVE_OBJ(vout.v), v.i);
+	output_newline(NATIVE_OBJ(vout.v));
+}
+
+/* println(long): print long and line separator */
+static void
+natprintlnlong(Frame *frame)
+{
+	Value vout, v;
+
+	v = frame_stackpop(frame);
+	vout = frame_stackpop(frame);
+	output_long(NATIVE_OBJ(vout.v), v.l);
+	output_newline(NATIVE_OBJ(vout.v));
+}
+
+/* println(float): print float and line separator */
+static void
+natprintlnfloat(Frame *frame)
+{
+	Value vout, v;
+
+	v = frame_stackpop(frame);
+	vout = frame_stackpop(frame);
+	output_float(NATIVE_OBJ(vout.v), v.f);
+	output_newline(NATIVE_OBJ(vout.v));
+}
+
+/* println(double): print double and line separator */
+static void
+natprintlndouble(Frame *frame)
+{
+	Value vout, v;
+
+	v = frame_stackpop(frame);
+	vout = frame_stackpop(frame);
+	output_double(NATIVE_OBJ(vout.v), v.d);
+	output_newline(NATIVE_OBJ(vout.v));
+}
+
+/* String.charAt(int): get character at index */
+static void
+natstringcharat(Frame *frame)
+{
+	Value vs, vi, v;
+
+	vi = frame_stackpop(frame);
+	vs = frame_stackpop(frame);
+	if (vs.v == NULL)
+		natthrow("java.lang.NullPointerException");
+	if (vi.i < 0 || vi.i >= STRING_OBJ(vs.v)->length)
+		errx(EXIT_FAILURE, "java.lang.StringIndexOutOfBoundsException: Index %ld out of bounds for length %ld",
+		     (long)vi.i, (long)STRING_OBJ(vs.v)->length);
+	v.i = string_charat(STRING_OBJ(vs.v), vi.i);
+	frame_stackpush(frame, v);
+}
+
+/* String.hashCode(): get (cached) hash code */
+static void
+natstringhashcode(Frame *frame)
+{
+	Value v;
+
+	v = frame_stackpop(frame);
+	if (v.v == NULL)
+		natthrow("java.lang.NullPointerException");
+	v.i = string_hash(STRING_OBJ(v.v));
+	frame_stackpush(frame, v);
+}
+
+/* String.intern(): get canonical representation of string */
+static void
+natstringintern(Frame *frame)
+{
+	Value v;
+
+	v = frame_stackpop(frame);
+	if (v.v == NULL)
+		natthrow("java.lang.NullPointerException");
+	v.v = string_intern(v.v);
+	frame_stackpush(frame, v);
+}
+
+/* String.isEmpty(): check whether length is zero */
+static void
+natstringisempty(Frame *frame)
+{
+	Value v;
+
+	v = frame_stackpop(frame);
+	if (v.v == NULL)
+		natthrow("java.lang.NullPointerException");
+	v.i = STRING_OBJ(v.v)->length == 0;
+	frame_stackpush(frame, v);
+}
+
+/* String.length(): get number of characters */
+static void
+natstringlength(Frame *frame)
+{
+	Value v;
+
+	v = frame_stackpop(frame);
+	if (v.v == NULL)
+		natthrow("java.lang.NullPointerException");
+	v.i = STRING_OBJ(v.v)->length;
+	frame_stackpush(frame, v);
+}
+
+/* hash string s into h (FNV-1a) */
+static uint32_t
+hashstr(uint32_t h, char *s)
+{
+	while (*s) {
+		h ^= (unsigned char)*s++;
+		h *= 16777619u;
+	}
+	return h;
+}
+
+/* hash native method key */
+static uint32_t
+hashkey(char *classname, char *name, char *descr)
+{
+	uint32_t h = 2166136261u;
+
+	h = hashstr(h, classname);
+	h = hashstr(h, name);
+	h = hashstr(h, descr);
+	return h & (NBUCKETS - 1);
+}
+
+/* insert entries of native method table into hash buckets */
+static void
+nativeinit(void)
+{
+	static int init = 0;
+	uint32_t h;
+	size_t i;
+
+	if (init)
+		return;
+	init = 1;
+	for (i = 0; i < LEN(nativetab); i++) {
+		h = hashkey(nativetab[i].classname, nativetab[i].name, nativetab[i].descr);
+		nativetab[i].next = buckets[h];
+		buckets[h] = &nativetab[i];
+	}
 }
 
 JavaClass
@@ -61,9 +1405,9 @@ native_javaobj(JavaClass jclass, char *objname, char *objtype)
 	case LANG_SYSTEM:
 		if (strcmp(objtype, "Ljava/io/PrintStream;") == 0) {
 			if (strcmp(objname, "out") == 0) {
-				return stdout;
+				return output_get(1);
 			} else if (strcmp(objname, "err") == 0) {
-				return stderr;
+				return output_get(2);
 			} else if (strcmp(objname, "in") == 0) {
 				return stdin;
 			}
@@ -73,17 +1417,17 @@ native_javaobj(JavaClass jclass, char *objname, char *objtype)
 	return NULL;
 }
 
-int
-native_javamethod(Frame *frame, JavaClass jclass, char *name, char *type)
+/* get native method implementing classname.name with descriptor descr; return NULL if there is none */
+Native *
+native_getmethod(char *classname, char *name, char *descr)
 {
-	switch (jclass) {
-	default:
-		break;
-	case IO_PRINTSTREAM:
-		if (strcmp(name, "println") == 0) {
-			natprintln(frame, type);
-			return 0;
-		}
-	}
-	return -1;
+	Native *n;
+
+	nativeinit();
+	for (n = buckets[hashkey(classname, name, descr)]; n; n = n->next)
+		if (strcmp(classname, n->classname) == 0 &&
+		    strcmp(name, n->name) == 0 &&
+		    strcmp(descr, n->descr) == 0)
+			return n;
+	return NULL;
 }
@@ -2,8 +2,51 @@ typedef enum JavaClass {
 	NONE_CLASS = 0,
 	LANG_SYSTEM,
 	IO_PRINTSTREAM,
+	LANG_STRING,
+	UTIL_ARRAYS,
+	JVM_SIMD,
+	LANG_MATH,
+	LANG_STRICTMATH,
+	LANG_INTEGER,
+	LANG_LONG,
 } JavaClass;
 
+/* native method compiled code may do in place, without calling its implementation */
+typedef enum Intrinsic {
+	INTRINSIC_NONE = 0,
+	INTRINSIC_SQRT,                 /* sqrt(double) */
+	INTRINSIC_ABS,
+	INTRINSIC_MIN,
+	INTRINSIC_MAX,
+	INTRINSIC_FLOOR,
+	INTRINSIC_CEIL,
+	INTRINSIC_RINT,
+	INTRINSIC_FMA,
+	INTRINSIC_CALL,                 /* no instruction; compiled code calls fn */
+	INTRINSIC_BITCOUNT,
+	INTRINSIC_NLZ,                  /* numberOfLeadingZeros */
+} Intrinsic;
+
+/* native method implementation; takes its arguments from the caller's operand stack */
+typedef void NativeMethod(Frame *frame);
+
+/* native method registry entry */
+typedef struct Native {
+	struct Native *next;            /* next entry in hash bucket */
+	char          *classname;
+	char          *name;
+	char          *descr;
+	NativeMethod  *method;
+	Intrinsic      intrinsic;
+	void          *fn;              /* C function of an intrinsic, taking and returning the values of the method */
+} Native;
+
+/* register native method implementing classname.name with descriptor descr */
+#define NATIVE(classname, name, descr, method) {NULL, (classname), (name), (descr), (method), INTRINSIC_NONE, NULL}
+
+/* register intrinsic native method, also computed by C function fn */
+#define INTRINSIC(classname, name, descr, method, intrinsic, fn) {NULL, (classname), (name), (descr), (method), (intrinsic), (void *)(fn)}
+
 JavaClass native_javaclass(char *classname);
 void *native_javaobj(JavaClass jclass, char *objname, char *objtype);
-int native_javamethod(Frame *frame, JavaClass jclass, char *name, char *type);
+Native *native_getmethod(char *classname, char *name, char *descr);
@@ -0,0 +1,3188 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "util.h"
+#include "class.h"
+#include "opt.h"
+
+#define OPT_MAXPASSES   64              /* passes of constant propagation before a method is left alone */
+#define OPT_MAXSLOTS    (1 << 22)       /* slots of all instructions of the largest method optimized */
+#define OPT_MAXLOCALS   256             /* local variables the interpreter reaches, as it has no wide */
+#define NOVAL           -1              /* no value, as in a local variable never set */
+
+/* lattice of values of the constant propagation */
+enum {
+	LAT_TOP,                        /* not computed on any executable path yet */
+	LAT_CONST,                      /* the same constant on every executable path */
+	LAT_BOTTOM                      /* varies */
+};
+
+/* type of a value, in the order of the typed load and store instructions */
+enum {
+	TYPE_NONE,
+	TYPE_INT,
+	TYPE_LONG,
+	TYPE_FLOAT,
+	TYPE_DOUBLE,
+	TYPE_REF
+};
+
+/* value of the SSA form: an argument, the result of an instruction, or a phi at the entry of a block */
+typedef struct Val {
+	U1      type;
+	U1      lat;
+	int64_t c;                      /* the constant, if lat is LAT_CONST */
+} Val;
+
+/* instruction of the optimized code */
+typedef struct Ins {
+	U1      op;                     /* NOP for none */
+	int32_t pc;                     /* instruction of the original code it copies, or -1 */
+	int64_t arg;                    /* constant, local variable, target pc, or number of values popped */
+	U2      index;                  /* constant pool entry of a constant loaded by ldc, or of a method called */
+	int     npop;                   /* operand stack slots popped */
+	int     npush;                  /* and pushed */
+	int     pure;                   /* operands that replace it if its result is unused; -1 if it must stay */
+	int     elide;                  /* whether it is a goto to the next instruction, left out */
+	U4      pos;                    /* pc in the optimized code */
+} Ins;
+
+/* sequence of instructions of the optimized code */
+typedef struct List {
+	Ins    *ins;
+	size_t  n;
+	size_t  cap;
+} List;
+
+/* rewrite of an instruction of the original code */
+typedef struct Edit {
+	List    pre;                    /* instructions before it, which branches to it reach */
+	List    repl;                   /* instructions that replace it */
+	List    post;                   /* instructions after it */
+	int     replaced;
+	int     claimed;                /* whether an optimization rewrote it or an expression it is part of */
+	U1      op;                     /* instruction it is copied as, if not its own */
+} Edit;
+
+/* basic block */
+typedef struct Block {
+	U4      start;                  /* pc of first instruction */
+	U4      last;                   /* pc of last instruction */
+	int    *succ;                   /* successors: fall through or default first, then branch targets */
+	U1     *exec;                   /* whether the edge to each successor is executable */
+	int     nsucc;
+	int    *pred;                   /* predecessors, and index of the edge in their successors */
+	int    *predk;
+	int     npred;
+	int     reached;                /* whether the block is executable */
+	int    *in;                     /* values of local variables and operand stack at entry */
+	int    *out;                    /* and at exit */
+	int     sp;                     /* operand stack depth at entry */
+	int     outsp;                  /* and at exit */
+	int     rpo;                    /* number in reverse postorder of executable blocks */
+	int     idom;                   /* immediate dominator */
+	U1     *livein;                 /* whether each local variable is live at entry */
+	U1     *liveout;                /* and at exit */
+	List    ins;                    /* instructions of the optimized code */
+} Block;
+
+/* simple loop over arrays run by a kernel */
+enum {
+	LOOP_SUM,                       /* s += a[i] */
+	LOOP_DOT,                       /* s += a[i] * b[i] */
+	LOOP_MAP,                       /* c[i] = a[i] op b[i] */
+	LOOP_FILL,                      /* a[i] = v */
+	LOOP_MISMATCH                   /* if (a[i] != b[i]) break */
+};
+
+/* counted loop for (; i < end; i++) whose body is a simple statement over arrays */
+typedef struct Kernel {
+	int     kind;
+	U1      access;                 /* array load or store of the elements */
+	U1      arith;                  /* arithmetic of a map */
+	U4      i;                      /* local variable of the counter */
+	U4      acc;                    /* of the sum of a reduction, or of the value a fill stores */
+	int     acctype;
+	U4      array[3];               /* of the arrays, the one a map stores into first */
+	int     narrays;
+	U4      bound;                  /* pc of the bound the counter is compared with */
+	int     boundtype;              /* TYPE_INT for a local variable, TYPE_REF for the length of an array */
+	U4      boundvar;               /* and that local variable */
+	U4      value;                  /* pc of the value a fill stores */
+	int     pre;                    /* block entering the loop */
+	int     exit;                   /* block the loop exits to at the bound */
+	int     differ;                 /* and a mismatch exits to where elements differ */
+} Kernel;
+
+/* state of the optimization of a method */
+typedef struct Opt {
+	ClassFile      *class;
+	Method         *method;
+	Code_attribute *code;
+	U1             *bc;             /* original code */
+	U4              len;
+	size_t          nlocals;
+	size_t          nslots;         /* max_locals + max_stack */
+	int            *insno;          /* number of the instruction at each pc, -1 inside instructions */
+	int            *blockof;        /* block of the instruction at each pc */
+	int            *first;          /* first instruction of the optimized code of each instruction */
+	Block          *blocks;
+	int             nblocks;
+	Val            *vals;
+	size_t          insbase;        /* value of the result of the instruction at pc is insbase + pc */
+	size_t          phibase;        /* value of phi of slot s of block b is phibase + b * nslots + s */
+	int            *entry;          /* values of the slots at method entry */
+	int            *state;          /* values of the slots before each instruction */
+	int            *depth;          /* operand stack depth before each instruction */
+	int            *npop;           /* operand stack slots popped by each instruction */
+	int            *npush;          /* and pushed */
+	int            *kids;           /* instructions of its block that pushed the operands of each instruction */
+	int            *parent;         /* instruction of its block whose operand each instruction pushed */
+	int            *cur;            /* slots of instruction being simulated */
+	int            *prod;           /* instruction of the current block that pushed each stack slot */
+	int             sp;             /* operand stack depth of instruction being simulated */
+	int             pushes;         /* slots it pushed */
+	int             pick;           /* its only executable successor; -1 for all, -2 for none */
+	int             changed;        /* whether the pass changed anything */
+	Edit           *edit;
+	U4             *newpc;          /* pc of each instruction in the optimized code */
+	U2              maxlocals;      /* of the optimized code */
+	U2              maxstack;
+} Opt;
+
+/* code of a method spliced into the code of a caller, or the code of the caller itself */
+typedef struct Splice {
+	Method         *method;
+	Code_attribute *code;
+	U4             *pos;            /* pc in the expanded code of each instruction, and of the end of the code */
+	U4              base;           /* local variable of the caller its local variable 0 becomes */
+	int             parent;         /* splice of the caller, -1 for none */
+	U4              call;           /* pc of the call in the code of the caller */
+} Splice;
+
+/* method being spliced, linked to the methods its call is spliced into */
+typedef struct Link {
+	Method         *method;
+	struct Link    *up;
+} Link;
+
+/* state of the expansion of calls in the code of a method */
+typedef struct Expand {
+	ClassFile      *class;
+	Splice         *splices;        /* in the order of the expanded code, the caller first */
+	int             nsplices;
+	int             next;           /* splice the emitting pass reaches next */
+	U1             *out;            /* expanded code; NULL while laying it out */
+	U4              len;
+	U4              maxlocals;
+	int             fail;           /* whether a branch offset does not fit */
+} Expand;
+
+static long maxinlinesize = OPT_INLINESIZE;
+static long maxinlinelevel = OPT_INLINELEVEL;
+
+/* put 16-bit operand at p */
+static void
+put16(U1 *p, int32_t v)
+{
+	p[0] = (v >> 8) & 0xFF;
+	p[1] = v & 0xFF;
+}
+
+/* put 32-bit operand at p */
+static void
+put32(U1 *p, int32_t v)
+{
+	put16(p, (int32_t)((uint32_t)v >> 16));
+	put16(p + 2, v);
+}
+
+/* check whether op is a conditional branch */
+static int
+isif(U1 op)
+{
+	return (op >= IFEQ && op <= IF_ACMPNE) || op == IFNULL || op == IFNONNULL;
+}
+
+/* check whether op ends a basic block */
+static int
+isend(U1 op)
+{
+	return isif(op) || op == GOTO || op == GOTO_W || op == TABLESWITCH || op == LOOKUPSWITCH ||
+	       (op >= IRETURN && op <= RETURN) || op == ATHROW;
+}
+
+/* check whether op pushes a numeric constant */
+static int
+isconst(ClassFile *class, U1 *code, U4 pc)
+{
+	U1 tag;
+
+	switch (code[pc]) {
+	case LDC:
+		tag = class->constant_pool[code[pc + 1]].tag;
+		break;
+	case LDC_W: case LDC2_W:
+		tag = class->constant_pool[class_get16(&code[pc + 1]) & 0xFFFF].tag;
+		break;
+	default:
+		return code[pc] >= ICONST_M1 && code[pc] <= SIPUSH;
+	}
+	return tag == CONSTANT_Integer || tag == CONSTANT_Float || tag == CONSTANT_Long || tag == CONSTANT_Double;
+}
+
+/* check whether op loads a local variable without wide */
+static int
+isload(U1 op)
+{
+	return op >= ILOAD && op <= ALOAD_3;
+}
+
+/*
+ * Get number of operands of an instruction that computes its result
+ * from them alone and cannot fail, so that it may be left out when its
+ * result is unused.  Arraylength counts among them: the only arrays it
+ * is moved away from are ones it was already computed on.  Return -1 for
+ * other instructions.
+ */
+static int
+operands(U1 op)
+{
+	switch (op) {
+	case IDIV: case LDIV: case IREM: case LREM: case IINC:
+		return -1;
+	case ARRAYLENGTH:
+		return 1;
+	}
+	if ((op >= INEG && op <= DNEG) || (op >= I2L && op <= I2S))
+		return 1;
+	if ((op >= IADD && op <= DREM) || (op >= ISHL && op <= LXOR) || (op >= LCMP && op <= DCMPG))
+		return 2;
+	return -1;
+}
+
+/* get type of value of field descriptor */
+static int
+fieldtype(char *descr)
+{
+	switch (*descr) {
+	case 'J':
+		return TYPE_LONG;
+	case 'F':
+		return TYPE_FLOAT;
+	case 'D':
+		return TYPE_DOUBLE;
+	case 'L': case '[':
+		return TYPE_REF;
+	case 'V':
+		return TYPE_NONE;
+	default:
+		return TYPE_INT;
+	}
+}
+
+/* count arguments in method descriptor; return type of its return value */
+static int
+methodtype(char *descr, int *nargs)
+{
+	char *s;
+
+	*nargs = 0;
+	for (s = descr + 1; *s && *s != ')'; s++) {
+		while (*s == '[')
+			s++;
+		if (*s == 'L')
+			while (*s && *s != ';')
+				s++;
+		(*nargs)++;
+	}
+	if (*s == ')')
+		s++;
+	return fieldtype(s);
+}
+
+/* get type of result of arithmetic, conversion or comparison op */
+static int
+optype(U1 op)
+{
+	static const U1 conv[] = {
+		[I2L - I2L] = TYPE_LONG,   [I2F - I2L] = TYPE_FLOAT,  [I2D - I2L] = TYPE_DOUBLE,
+		[L2I - I2L] = TYPE_INT,    [L2F - I2L] = TYPE_FLOAT,  [L2D - I2L] = TYPE_DOUBLE,
+		[F2I - I2L] = TYPE_INT,    [F2L - I2L] = TYPE_LONG,   [F2D - I2L] = TYPE_DOUBLE,
+		[D2I - I2L] = TYPE_INT,    [D2L - I2L] = TYPE_LONG,   [D2F - I2L] = TYPE_FLOAT,
+		[I2B - I2L] = TYPE_INT,    [I2C - I2L] = TYPE_INT,    [I2S - I2L] = TYPE_INT,
+	};
+
+	if (op >= IADD && op <= DNEG)
+		return TYPE_INT + (op - IADD) % 4;
+	if (op >= ISHL && op <= LXOR)
+		return TYPE_INT + (op - ISHL) % 2;
+	if (op >= I2L && op <= I2S)
+		return conv[op - I2L];
+	return TYPE_INT;
+}
+
+/* get local variable loaded or stored by instruction at pc and its type; return 0 if it uses none */
+static int
+localvar(U1 *code, U4 pc, U4 *n, int *type, int *store)
+{
+	U1 op = code[pc];
+
+	if (op == WIDE) {
+		op = code[pc + 1];
+		*n = class_get16(&code[pc + 2]) & 0xFFFF;
+	} else if (op == IINC || (op >= ILOAD && op <= ALOAD) || (op >= ISTORE && op <= ASTORE)) {
+		*n = code[pc + 1];
+	} else if (op >= ILOAD_0 && op <= ALOAD_3) {
+		*n = (op - ILOAD_0) % 4;
+		op = ILOAD + (op - ILOAD_0) / 4;
+	} else if (op >= ISTORE_0 && op <= ASTORE_3) {
+		*n = (op - ISTORE_0) % 4;
+		op = ISTORE + (op - ISTORE_0) / 4;
+	} else {
+		return 0;
+	}
+	if (op == IINC) {
+		*type = TYPE_INT;
+		*store = 1;
+		return 1;
+	}
+	*store = (op >= ISTORE);
+	*type = TYPE_INT + (*store ? op - ISTORE : op - ILOAD);
+	return 1;
+}
+
+/* append instruction to sequence */
+static Ins *
+add(List *l, U1 op, int32_t pc, int64_t arg, int npop, int npush, int pure)
+{
+	Ins *p;
+
+	if (l->n == l->cap) {
+		l->cap = l->cap ? 2 * l->cap : 8;
+		if ((p = realloc(l->ins, l->cap * sizeof *p)) == NULL)
+			err(EXIT_FAILURE, "realloc");
+		l->ins = p;
+	}
+	p = &l->ins[l->n++];
+	memset(p, 0, sizeof *p);
+	p->op = op;
+	p->pc = pc;
+	p->arg = arg;
+	p->npop = npop;
+	p->npush = npush;
+	p->pure = pure;
+	return p;
+}
+
+/* make instruction pop n slots, or nothing */
+static void
+setpop(Ins *p, int n)
+{
+	p->op = n ? POP : NOP;
+	p->pc = -1;
+	p->arg = n;
+	p->npop = n;
+	p->npush = 0;
+	p->pure = -1;
+}
+
+/* append pop of n slots */
+static void
+addpop(List *l, int n)
+{
+	if (n > 0) {
+		add(l, POP, -1, n, n, 0, -1);
+	}
+}
+
+/* append load or store of local variable n of type */
+static void
+addlocal(List *l, int type, U4 n, int store)
+{
+	if (store)
+		add(l, ISTORE + type - TYPE_INT, -1, n, 1, 0, -1);
+	else
+		add(l, ILOAD + type - TYPE_INT, -1, n, 0, 1, 0);
+}
+
+/* append copy of instruction of the original code */
+static void
+addcopy(Opt *o, List *l, U4 pc)
+{
+	int pure = -1;
+
+	if (o->npush[pc] == 1) {
+		if (isconst(o->class, o->bc, pc) || isload(o->bc[pc]))
+			pure = 0;
+		else
+			pure = operands(o->bc[pc]);
+	}
+	add(l, o->edit[pc].op ? o->edit[pc].op : o->bc[pc], pc, 0, o->npop[pc], o->npush[pc], pure);
+}
+
+/*
+ * Get constant pool entry to push int or long constant c from.  Values
+ * out of the range of the short instructions need one; return 0 if there
+ * is none, and 1 for values that need none.
+ */
+static U2
+constindex(Opt *o, int type, int64_t c)
+{
+	CP *cp = o->class->constant_pool;
+	U2 i, index = 0;
+
+	if (type == TYPE_INT && (c < INT16_MIN || c > INT16_MAX)) {
+		for (i = 1; i < o->class->constant_pool_count && index == 0; i++)
+			if (cp[i].tag == CONSTANT_Integer && class_getinteger(o->class, i) == c)
+				index = i;
+	} else if (type == TYPE_LONG && c != 0 && c != 1) {
+		for (i = 1; i < o->class->constant_pool_count && index == 0; i++)
+			if (cp[i].tag == CONSTANT_Long && class_getlong(o->class, i) == c)
+				index = i;
+	} else if (type == TYPE_INT || type == TYPE_LONG) {
+		index = 1;
+	}
+	return index;
+}
+
+/* append push of int or long constant c */
+static void
+addconst(Opt *o, List *l, int type, int64_t c)
+{
+	add(l, (type == TYPE_INT) ? LDC : LDC2_W, -1, c, 0, 1, 0)->index = constindex(o, type, c);
+}
+
+/* append entry to the constant pool; return its index, or 0 if the pool is full */
+static U2
+addentry(ClassFile *class, U1 tag)
+{
+	CP *cp;
+
+	if (class->constant_pool_count == UINT16_MAX)
+		return 0;
+	if ((cp = realloc(class->constant_pool, (class->constant_pool_count + 1) * sizeof *cp)) == NULL)
+		err(EXIT_FAILURE, "realloc");
+	class->constant_pool = cp;
+	memset(&cp[class->constant_pool_count], 0, sizeof *cp);
+	cp[class->constant_pool_count].tag = tag;
+	return class->constant_pool_count++;
+}
+
+/* get constant pool entry of string s, adding it if there is none; return 0 if the pool is full */
+static U2
+utf8index(ClassFile *class, char *s)
+{
+	CONSTANT_Utf8_info *utf8;
+	U2 i;
+
+	for (i = 1; i < class->constant_pool_count; i++)
+		if (class->constant_pool[i].tag == CONSTANT_Utf8 && strcmp(class_getutf8(class, i), s) == 0)
+			return i;
+	if ((i = addentry(class, CONSTANT_Utf8)) == 0)
+		return 0;
+	utf8 = &class->constant_pool[i].info.utf8_info;
+	utf8->length = strlen(s);
+	utf8->bytes = emalloc(utf8->length + 1);
+	memcpy(utf8->bytes, s, utf8->length + 1);
+	return i;
+}
+
+/*
+ * Get constant pool entry of a reference to static method of another
+ * class that optimized code calls, adding it and the entries it refers
+ * to if there is none; return 0 if the pool is full.
+ */
+static U2
+methodindex(ClassFile *class, char *classname, char *name, char *descr)
+{
+	CP *cp;
+	U2 i, nclass, nname, ndescr, cls, nat;
+	char *n, *t;
+
+	for (i = 1; i < class->constant_pool_count; i++) {
+		if (class->constant_pool[i].tag != CONSTANT_Methodref)
+			continue;
+		class_getnameandtype(class, class->constant_pool[i].info.methodref_info.name_and_type_index, &n, &t);
+		if (strcmp(class_getclassname(class, class->constant_pool[i].info.methodref_info.class_index), classname) == 0 &&
+		    strcmp(n, name) == 0 && strcmp(t, descr) == 0)
+			return i;
+	}
+	if ((nclass = utf8index(class, classname)) == 0 || (nname = utf8index(class, name)) == 0 ||
+	    (ndescr = utf8index(class, descr)) == 0)
+		return 0;
+	cp = class->constant_pool;
+	for (cls = 1; cls < class->constant_pool_count; cls++)
+		if (cp[cls].tag == CONSTANT_Class && cp[cls].info.class_info.name_index == nclass)
+			break;
+	if (cls == class->constant_pool_count) {
+		if ((cls = addentry(class, CONSTANT_Class)) == 0)
+			return 0;
+		class->constant_pool[cls].info.class_info.name_index = nclass;
+	}
+	cp = class->constant_pool;
+	for (nat = 1; nat < class->constant_pool_count; nat++)
+		if (cp[nat].tag == CONSTANT_NameAndType && cp[nat].info.nameandtype_info.name_index == nname &&
+		    cp[nat].info.nameandtype_info.descriptor_index == ndescr)
+			break;
+	if (nat == class->constant_pool_count) {
+		if ((nat = addentry(class, CONSTANT_NameAndType)) == 0)
+			return 0;
+		class->constant_pool[nat].info.nameandtype_info.name_index = nname;
+		class->constant_pool[nat].info.nameandtype_info.descriptor_index = ndescr;
+	}
+	if ((i = addentry(class, CONSTANT_Methodref)) == 0)
+		return 0;
+	class->constant_pool[i].info.methodref_info.class_index = cls;
+	class->constant_pool[i].info.methodref_info.name_and_type_index = nat;
+	return i;
+}
+
+/* append instructions of another sequence */
+static void
+append(List *l, List *from)
+{
+	size_t k;
+
+	for (k = 0; k < from->n; k++) {
+		*add(l, NOP, -1, 0, 0, 0, -1) = from->ins[k];
+	}
+}
+
+/* get lattice of value */
+static int
+lattice(Opt *o, int v)
+{
+	return (v == NOVAL) ? LAT_BOTTOM : o->vals[v].lat;
+}
+
+/* set value; note whether it changed */
+static void
+setval(Opt *o, size_t v, int type, int lat, int64_t c)
+{
+	Val *p = &o->vals[v];
+
+	if (lat != LAT_CONST)
+		c = 0;
+	if (p->type != type || p->lat != lat || p->c != c)
+		o->changed = 1;
+	p->type = type;
+	p->lat = lat;
+	p->c = c;
+}
+
+/* compute int or long operation on constants; return its lattice */
+static int
+fold(U1 op, int64_t x, int64_t y, int64_t *r)
+{
+	int32_t a = x, b = y;
+
+	switch (op) {
+	case IADD: *r = (int32_t)((uint32_t)a + (uint32_t)b); break;
+	case ISUB: *r = (int32_t)((uint32_t)a - (uint32_t)b); break;
+	case IMUL: *r = (int32_t)((uint32_t)a * (uint32_t)b); break;
+	case INEG: *r = (int32_t)(0u - (uint32_t)a); break;
+	case ISHL: *r = (int32_t)((uint32_t)a << (b & 31)); break;
+	case ISHR: *r = a >> (b & 31); break;
+	case IUSHR: *r = (int32_t)((uint32_t)a >> (b & 31)); break;
+	case IAND: *r = a & b; break;
+	case IOR: *r = a | b; break;
+	case IXOR: *r = a ^ b; break;
+	case LADD: *r = (int64_t)((uint64_t)x + (uint64_t)y); break;
+	case LSUB: *r = (int64_t)((uint64_t)x - (uint64_t)y); break;
+	case LMUL: *r = (int64_t)((uint64_t)x * (uint64_t)y); break;
+	case LNEG: *r = (int64_t)(0u - (uint64_t)x); break;
+	case LSHL: *r = (int64_t)((uint64_t)x << (b & 63)); break;
+	case LSHR: *r = x >> (b & 63); break;
+	case LUSHR: *r = (int64_t)((uint64_t)x >> (b & 63)); break;
+	case LAND: *r = x & y; break;
+	case LOR: *r = x | y; break;
+	case LXOR: *r = x ^ y; break;
+	case I2L: *r = a; break;
+	case L2I: *r = (int32_t)x; break;
+	case I2B: *r = (int8_t)a; break;
+	case I2C: *r = (uint16_t)a; break;
+	case I2S: *r = (int16_t)a; break;
+	case LCMP: *r = (x < y) ? -1 : (x > y); break;
+	case IDIV: case IREM:
+		if (b == 0)
+			return LAT_BOTTOM;
+		if (b == -1)
+			*r = (op == IDIV) ? (int32_t)(0u - (uint32_t)a) : 0;
+		else
+			*r = (op == IDIV) ? a / b : a % b;
+		break;
+	case LDIV: case LREM:
+		if (y == 0)
+			return LAT_BOTTOM;
+		if (y == -1)
+			*r = (op == LDIV) ? (int64_t)(0u - (uint64_t)x) : 0;
+		else
+			*r = (op == LDIV) ? x / y : x % y;
+		break;
+	default:
+		return LAT_BOTTOM;
+	}
+	return LAT_CONST;
+}
+
+/* check condition of conditional branch op on constants */
+static int
+cond(U1 op, int64_t x, int64_t y)
+{
+	switch (op) {
+	case IFEQ: case IF_ICMPEQ: return x == y;
+	case IFNE: case IF_ICMPNE: return x != y;
+	case IFLT: case IF_ICMPLT: return x < y;
+	case IFGE: case IF_ICMPGE: return x >= y;
+	case IFGT: case IF_ICMPGT: return x > y;
+	default:                   return x <= y;
+	}
+}
+
+/* push value pushed by instruction at pc onto the operand stack; return -1 on overflow */
+static int
+push(Opt *o, int v, U4 pc)
+{
+	if ((U4)o->sp >= o->code->max_stack)
+		return -1;
+	o->cur[o->nlocals + o->sp] = v;
+	o->prod[o->sp++] = pc;
+	o->pushes++;
+	return 0;
+}
+
+/* pop n slots from the operand stack; return -1 on underflow */
+static int
+pop(Opt *o, int n)
+{
+	if (o->sp < n)
+		return -1;
+	while (n-- > 0)
+		o->cur[o->nlocals + --o->sp] = NOVAL;
+	return 0;
+}
+
+/* get value i slots below the top of the operand stack */
+static int
+top(Opt *o, int i)
+{
+	return (o->sp > i) ? o->cur[o->nlocals + o->sp - 1 - i] : NOVAL;
+}
+
+/* push result of instruction at pc */
+static int
+result(Opt *o, U4 pc, int type, int lat, int64_t c)
+{
+	setval(o, o->insbase + pc, type, lat, c);
+	return push(o, o->insbase + pc, pc);
+}
+
+/* pop n slots and push them back in the order given by perm (1 is the top) */
+static int
+shuffle(Opt *o, U4 pc, int n, const char *perm)
+{
+	int v[4];
+	int i;
+
+	for (i = 0; i < n; i++)
+		v[i] = top(o, i);
+	if (pop(o, n) == -1)
+		return -1;
+	for (; *perm; perm++)
+		if (push(o, v[*perm - '1'], pc) == -1)
+			return -1;
+	return 0;
+}
+
+/* simulate load, store or increment of local variable n by instruction at pc */
+static int
+local(Opt *o, U4 pc, U4 n, int type, int store)
+{
+	int64_t c = 0;
+	int v, lat;
+
+	if (n >= o->nlocals || ((type == TYPE_LONG || type == TYPE_DOUBLE) && n + 1 >= o->nlocals))
+		return -1;
+	if (o->bc[pc] == IINC || (o->bc[pc] == WIDE && o->bc[pc + 1] == IINC)) {
+		v = o->cur[n];
+		lat = lattice(o, v);
+		if (lat == LAT_CONST)
+			fold(IADD, o->vals[v].c, (o->bc[pc] == IINC) ? (int8_t)o->bc[pc + 2] : class_get16(&o->bc[pc + 4]), &c);
+		setval(o, o->insbase + pc, TYPE_INT, lat, c);
+		o->cur[n] = o->insbase + pc;
+		return 0;
+	}
+	if (!store)
+		return push(o, o->cur[n], pc);
+	v = top(o, 0);
+	if (pop(o, 1) == -1)
+		return -1;
+	o->cur[n] = v;
+	/* the interpreter keeps a long or double in both of its local variables */
+	if (type == TYPE_LONG || type == TYPE_DOUBLE)
+		o->cur[n + 1] = v;
+	return 0;
+}
+
+/*
+ * Simulate instruction at pc on the values of the current slots, after
+ * saving them as the state before it.  Results of instructions are
+ * values of their own, whose lattice is folded from the lattices of the
+ * operands; loads, stores and stack shuffles just move values around.
+ */
+static int
+step(Opt *o, U4 pc)
+{
+	U1 *code = o->bc;
+	U1 op = class_getchecked(code[pc]);
+	U4 n, p;
+	U2 index;
+	char *name, *type;
+	int32_t i, low, high;
+	int64_t c = 0;
+	int v, w, k, lat, t, nargs, store;
+
+	memcpy(&o->state[pc * o->nslots], o->cur, o->nslots * sizeof *o->cur);
+	o->depth[pc] = o->sp;
+	o->kids[2 * pc] = o->kids[2 * pc + 1] = -1;
+	o->pushes = 0;
+	o->pick = -1;
+	if (localvar(code, pc, &n, &t, &store)) {
+		if (local(o, pc, n, t, store) == -1)
+			return -1;
+		goto done;
+	}
+	switch (op) {
+	case NOP:
+		break;
+	case ACONST_NULL:
+		if (result(o, pc, TYPE_REF, LAT_BOTTOM, 0) == -1)
+			return -1;
+		break;
+	case ICONST_M1: case ICONST_0: case ICONST_1: case ICONST_2:
+	case ICONST_3: case ICONST_4: case ICONST_5:
+		if (result(o, pc, TYPE_INT, LAT_CONST, op - ICONST_0) == -1)
+			return -1;
+		break;
+	case LCONST_0: case LCONST_1:
+		if (result(o, pc, TYPE_LONG, LAT_CONST, op - LCONST_0) == -1)
+			return -1;
+		break;
+	case FCONST_0: case FCONST_1: case FCONST_2:
+		if (result(o, pc, TYPE_FLOAT, LAT_BOTTOM, 0) == -1)
+			return -1;
+		break;
+	case DCONST_0: case DCONST_1:
+		if (result(o, pc, TYPE_DOUBLE, LAT_BOTTOM, 0) == -1)
+			return -1;
+		break;
+	case BIPUSH:
+		if (result(o, pc, TYPE_INT, LAT_CONST, (int8_t)code[pc + 1]) == -1)
+			return -1;
+		break;
+	case SIPUSH:
+		if (result(o, pc, TYPE_INT, LAT_CONST, class_get16(&code[pc + 1])) == -1)
+			return -1;
+		break;
+	case LDC: case LDC_W: case LDC2_W:
+		index = (op == LDC) ? code[pc + 1] : class_get16(&code[pc + 1]) & 0xFFFF;
+		switch (o->class->constant_pool[index].tag) {
+		case CONSTANT_Integer:
+			v = result(o, pc, TYPE_INT, LAT_CONST, class_getinteger(o->class, index));
+			break;
+		case CONSTANT_Long:
+			v = result(o, pc, TYPE_LONG, LAT_CONST, class_getlong(o->class, index));
+			break;
+		case CONSTANT_Float:
+			v = result(o, pc, TYPE_FLOAT, LAT_BOTTOM, 0);
+			break;
+		case CONSTANT_Double:
+			v = result(o, pc, TYPE_DOUBLE, LAT_BOTTOM, 0);
+			break;
+		default:
+			v = result(o, pc, TYPE_REF, LAT_BOTTOM, 0);
+			break;
+		}
+		if (v == -1)
+			return -1;
+		break;
+	case IALOAD: case LALOAD: case FALOAD: case DALOAD: case AALOAD:
+	case BALOAD: case CALOAD: case SALOAD:
+		t = (op == AALOAD) ? TYPE_REF : (op >= BALOAD) ? TYPE_INT : TYPE_INT + op - IALOAD;
+		if (pop(o, 2) == -1 || result(o, pc, t, LAT_BOTTOM, 0) == -1)
+			return -1;
+		break;
+	case IASTORE: case LASTORE: case FASTORE: case DASTORE: case AASTORE:
+	case BASTORE: case CASTORE: case SASTORE:
+		if (pop(o, 3) == -1)
+			return -1;
+		break;
+	/* the interpreter keeps long and double operands in one slot, so these never look at types */
+	case POP: case MONITORENTER: case MONITOREXIT: case PUTSTATIC:
+	case IRETURN: case LRETURN: case FRETURN: case DRETURN: case ARETURN: case ATHROW:
+		if (pop(o, 1) == -1)
+			return -1;
+		break;
+	case POP2: case PUTFIELD:
+		if (pop(o, 2) == -1)
+			return -1;
+		break;
+	case RETURN:
+		break;
+	case DUP:
+		if (shuffle(o, pc, 1, "11") == -1)
+			return -1;
+		break;
+	case DUP_X1:
+		if (shuffle(o, pc, 2, "121") == -1)
+			return -1;
+		break;
+	case DUP_X2:
+		if (shuffle(o, pc, 3, "1321") == -1)
+			return -1;
+		break;
+	case DUP2:
+		if (shuffle(o, pc, 2, "2121") == -1)
+			return -1;
+		break;
+	case DUP2_X1:
+		if (shuffle(o, pc, 3, "21321") == -1)
+			return -1;
+		break;
+	case DUP2_X2:
+		if (shuffle(o, pc, 4, "214321") == -1)
+			return -1;
+		break;
+	case SWAP:
+		if (shuffle(o, pc, 2, "12") == -1)
+			return -1;
+		break;
+	case IFEQ: case IFNE: case IFLT: case IFGE: case IFGT: case IFLE:
+		if ((lat = lattice(o, v = top(o, 0))) != LAT_BOTTOM)
+			o->pick = (lat == LAT_TOP) ? -2 : cond(op, o->vals[v].c, 0);
+		if (pop(o, 1) == -1)
+			return -1;
+		break;
+	case IF_ICMPEQ: case IF_ICMPNE: case IF_ICMPLT: case IF_ICMPGE: case IF_ICMPGT: case IF_ICMPLE:
+		v = top(o, 1);
+		w = top(o, 0);
+		if (lattice(o, v) == LAT_TOP || lattice(o, w) == LAT_TOP)
+			o->pick = -2;
+		else if (lattice(o, v) == LAT_CONST && lattice(o, w) == LAT_CONST)
+			o->pick = cond(op, o->vals[v].c, o->vals[w].c);
+		if (pop(o, 2) == -1)
+			return -1;
+		break;
+	case IF_ACMPEQ: case IF_ACMPNE:
+		if (pop(o, 2) == -1)
+			return -1;
+		break;
+	case IFNULL: case IFNONNULL:
+		if (pop(o, 1) == -1)
+			return -1;
+		break;
+	case GOTO: case GOTO_W:
+		break;
+	case TABLESWITCH: case LOOKUPSWITCH:
+		if ((lat = lattice(o, v = top(o, 0))) == LAT_TOP) {
+			o->pick = -2;
+		} else if (lat == LAT_CONST) {
+			p = pc + 1 + (3 - pc % 4);
+			o->pick = 0;
+			if (op == TABLESWITCH) {
+				low = class_get32(&code[p + 4]);
+				high = class_get32(&code[p + 8]);
+				if (o->vals[v].c >= low && o->vals[v].c <= high)
+					o->pick = 1 + o->vals[v].c - low;
+			} else {
+				for (i = 0; i < class_get32(&code[p + 4]); i++) {
+					if (class_get32(&code[p + 8 + 8 * i]) == o->vals[v].c) {
+						o->pick = 1 + i;
+					}
+				}
+			}
+		}
+		if (pop(o, 1) == -1)
+			return -1;
+		break;
+	case GETSTATIC: case GETFIELD:
+		index = class_get16(&code[pc + 1]) & 0xFFFF;
+		class_getnameandtype(o->class, o->class->constant_pool[index].info.fieldref_info.name_and_type_index, &name, &type);
+		if ((op == GETFIELD && pop(o, 1) == -1) || result(o, pc, fieldtype(type), LAT_BOTTOM, 0) == -1)
+			return -1;
+		break;
+	case INVOKEVIRTUAL: case INVOKESPECIAL: case INVOKESTATIC:
+	case INVOKEINTERFACE: case INVOKEDYNAMIC:
+		index = class_get16(&code[pc + 1]) & 0xFFFF;
+		class_getnameandtype(o->class, class_getnameandtypeindex(o->class, index), &name, &type);
+		t = methodtype(type, &nargs);
+		if (op != INVOKESTATIC && op != INVOKEDYNAMIC)
+			nargs++;
+		if (pop(o, nargs) == -1 || (t != TYPE_NONE && result(o, pc, t, LAT_BOTTOM, 0) == -1))
+			return -1;
+		break;
+	case NEW:
+		if (result(o, pc, TYPE_REF, LAT_BOTTOM, 0) == -1)
+			return -1;
+		break;
+	case NEWARRAY: case ANEWARRAY:
+		if (pop(o, 1) == -1 || result(o, pc, TYPE_REF, LAT_BOTTOM, 0) == -1)
+			return -1;
+		break;
+	case CHECKCAST:
+		if (shuffle(o, pc, 1, "1") == -1)
+			return -1;
+		break;
+	case INSTANCEOF:
+		if (pop(o, 1) == -1 || result(o, pc, TYPE_INT, LAT_BOTTOM, 0) == -1)
+			return -1;
+		break;
+	case MULTIANEWARRAY:
+		if (pop(o, code[pc + 3]) == -1 || result(o, pc, TYPE_REF, LAT_BOTTOM, 0) == -1)
+			return -1;
+		break;
+	default:
+		if ((k = (op == IDIV || op == LDIV || op == IREM || op == LREM) ? 2 : operands(op)) == -1 || o->sp < k)
+			return -1;
+		n = k;
+		o->kids[2 * pc] = o->prod[o->sp - n];
+		if (n == 2)
+			o->kids[2 * pc + 1] = o->prod[o->sp - 1];
+		v = top(o, n - 1);
+		w = (n == 2) ? top(o, 0) : v;
+		lat = LAT_BOTTOM;
+		if (lattice(o, v) == LAT_TOP || lattice(o, w) == LAT_TOP)
+			lat = LAT_TOP;
+		else if (lattice(o, v) == LAT_CONST && lattice(o, w) == LAT_CONST)
+			lat = fold(op, o->vals[v].c, o->vals[w].c, &c);
+		if (pop(o, n) == -1 || result(o, pc, (op == ARRAYLENGTH) ? TYPE_INT : optype(op), lat, c) == -1)
+			return -1;
+		break;
+	}
+done:
+	o->npop[pc] = o->depth[pc] - o->sp + o->pushes;
+	o->npush[pc] = o->pushes;
+	return 0;
+}
+
+/*
+ * Compute values of the slots at entry of block b from its executable
+ * incoming edges.  A slot holding the same value on every edge keeps
+ * it; otherwise it gets the phi of the block for the slot, unless some
+ * edge leaves it unset, which makes it unusable.
+ */
+static int
+merge(Opt *o, int b, int **inc, int *incsp)
+{
+	Block *bl = &o->blocks[b];
+	Block *p;
+	size_t s, phi;
+	int i, j, n = 0, v, lat, same, unset;
+	int64_t c;
+
+	if (b == 0) {
+		inc[n] = o->entry;
+		incsp[n++] = 0;
+	}
+	for (i = 0; i < bl->npred; i++) {
+		p = &o->blocks[bl->pred[i]];
+		if (p->exec[bl->predk[i]]) {
+			inc[n] = p->out;
+			incsp[n++] = p->outsp;
+		}
+	}
+	if (n == 0)
+		return 0;
+	for (j = 1; j < n; j++)
+		if (incsp[j] != incsp[0])
+			return -1;
+	if (bl->sp != incsp[0])
+		o->changed = 1;
+	bl->sp = incsp[0];
+	for (s = 0; s < o->nslots; s++) {
+		if (s >= o->nlocals + bl->sp) {
+			v = NOVAL;
+		} else {
+			v = inc[0][s];
+			same = 1;
+			unset = (v == NOVAL);
+			for (j = 1; j < n; j++) {
+				same &= (inc[j][s] == v);
+				unset |= (inc[j][s] == NOVAL);
+			}
+			if (!same && unset) {
+				v = NOVAL;
+			} else if (!same) {
+				phi = o->phibase + b * o->nslots + s;
+				lat = LAT_TOP;
+				c = 0;
+				for (j = 0; j < n; j++) {
+					if (lattice(o, inc[j][s]) == LAT_TOP)
+						continue;
+					if (lattice(o, inc[j][s]) == LAT_BOTTOM ||
+					    (lat == LAT_CONST && o->vals[inc[j][s]].c != c)) {
+						lat = LAT_BOTTOM;
+					} else if (lat == LAT_TOP) {
+						lat = LAT_CONST;
+						c = o->vals[inc[j][s]].c;
+					}
+				}
+				setval(o, phi, o->vals[v].type, lat, c);
+				v = phi;
+			}
+		}
+		if (bl->in[s] != v)
+			o->changed = 1;
+		bl->in[s] = v;
+	}
+	return 0;
+}
+
+/* simulate block b from the values at its entry, and mark the edges it may take executable */
+static int
+simulate(Opt *o, int b, int **inc, int *incsp)
+{
+	Block *bl = &o->blocks[b];
+	U4 pc;
+	int k;
+
+	if (merge(o, b, inc, incsp) == -1)
+		return -1;
+	memcpy(o->cur, bl->in, o->nslots * sizeof *o->cur);
+	o->sp = bl->sp;
+	for (k = 0; k < o->code->max_stack; k++)
+		o->prod[k] = -1;
+	for (pc = bl->start; pc <= bl->last; pc += class_getinslen(o->bc, pc))
+		if (step(o, pc) == -1)
+			return -1;
+	if (bl->outsp != o->sp || memcmp(bl->out, o->cur, o->nslots * sizeof *o->cur) != 0)
+		o->changed = 1;
+	memcpy(bl->out, o->cur, o->nslots * sizeof *o->cur);
+	bl->outsp = o->sp;
+	for (k = 0; k < bl->nsucc; k++) {
+		if (bl->exec[k] || (o->pick != -1 && o->pick != k))
+			continue;
+		bl->exec[k] = 1;
+		o->blocks[bl->succ[k]].reached = 1;
+		o->changed = 1;
+	}
+	return 0;
+}
+
+/*
+ * Lift the method into SSA form and propagate constants through it, by
+ * sparse conditional constant propagation: blocks are simulated from
+ * the entry until nothing changes, following only edges that may be
+ * taken given the constants known so far.  Values start unknown and
+ * only ever fall to a constant and then to varying, so this ends.
+ */
+static int
+propagate(Opt *o)
+{
+	int **inc;
+	int *incsp;
+	int b, n, pass, ret = 0;
+
+	for (n = 0, b = 0; b < o->nblocks; b++)
+		if (o->blocks[b].npred > n)
+			n = o->blocks[b].npred;
+	inc = ecalloc(n + 1, sizeof *inc);
+	incsp = ecalloc(n + 1, sizeof *incsp);
+	o->blocks[0].reached = 1;
+	for (pass = 0, o->changed = 1; o->changed && ret == 0; pass++) {
+		o->changed = 0;
+		if (pass == OPT_MAXPASSES)
+			ret = -1;
+		for (b = 0; b < o->nblocks && ret == 0; b++)
+			if (o->blocks[b].reached && simulate(o, b, inc, incsp) == -1)
+				ret = -1;
+	}
+	free(inc);
+	free(incsp);
+	return ret;
+}
+
+/* link the instructions pushing operands of pure operations to them */
+static void
+parents(Opt *o)
+{
+	U4 pc;
+	int b, i;
+
+	for (pc = 0; pc < o->len; pc++)
+		o->parent[pc] = -1;
+	for (b = 0; b < o->nblocks; b++) {
+		if (!o->blocks[b].reached)
+			continue;
+		for (pc = o->blocks[b].start; pc <= o->blocks[b].last; pc += class_getinslen(o->bc, pc)) {
+			for (i = 0; i < 2; i++) {
+				if (o->kids[2 * pc + i] >= 0) {
+					o->parent[o->kids[2 * pc + i]] = pc;
+				}
+			}
+		}
+	}
+}
+
+/* check whether the value pushed at pc is popped by a rewritten instruction, so dead code elimination takes it */
+static int
+doomed(Opt *o, U4 pc)
+{
+	int p;
+
+	while ((p = o->parent[pc]) >= 0) {
+		if (o->edit[p].replaced)
+			return 1;
+		if (operands(o->bc[p]) == -1)
+			return 0;
+		pc = p;
+	}
+	return 0;
+}
+
+/* check whether instruction at pc loads a local variable that the optimized code still reads */
+static int
+reads(Opt *o, U4 pc, U4 *n, int *width)
+{
+	int type, store;
+
+	if (!localvar(o->bc, pc, n, &type, &store))
+		return 0;
+	if (store && o->bc[pc] != IINC && !(o->bc[pc] == WIDE && o->bc[pc + 1] == IINC))
+		return 0;
+	if (o->edit[pc].replaced || (!store && doomed(o, pc)))
+		return 0;
+	*width = (type == TYPE_LONG || type == TYPE_DOUBLE) ? 2 : 1;
+	return 1;
+}
+
+/* check whether instruction at pc stores a local variable */
+static int
+writes(Opt *o, U4 pc, U4 *n, int *width)
+{
+	int type, store;
+
+	if (!localvar(o->bc, pc, n, &type, &store) || !store)
+		return 0;
+	if (o->bc[pc] == IINC || (o->bc[pc] == WIDE && o->bc[pc + 1] == IINC))
+		return 0;
+	*width = (type == TYPE_LONG || type == TYPE_DOUBLE) ? 2 : 1;
+	return 1;
+}
+
+/* compute liveness of local variables at entry of block from liveness at its exit */
+static void
+transfer(Opt *o, Block *bl, U1 *live)
+{
+	U4 pc, n;
+	int *pcs, npcs, i, w;
+
+	memcpy(live, bl->liveout, o->nlocals);
+	npcs = o->insno[bl->last] - o->insno[bl->start] + 1;
+	pcs = ecalloc(npcs, sizeof *pcs);
+	for (i = 0, pc = bl->start; i < npcs; i++, pc += class_getinslen(o->bc, pc))
+		pcs[i] = pc;
+	while (i-- > 0) {
+		if (writes(o, pcs[i], &n, &w))
+			memset(&live[n], 0, w);
+		if (reads(o, pcs[i], &n, &w))
+			memset(&live[n], 1, w);
+	}
+	free(pcs);
+}
+
+/* compute which local variables are live at entry and exit of each executable block */
+static void
+liveness(Opt *o)
+{
+	Block *bl;
+	U1 *live;
+	size_t i;
+	int b, k, changed;
+
+	live = ecalloc(o->nlocals + 1, 1);
+	do {
+		changed = 0;
+		for (b = o->nblocks - 1; b >= 0; b--) {
+			bl = &o->blocks[b];
+			if (!bl->reached)
+				continue;
+			for (k = 0; k < bl->nsucc; k++)
+				if (bl->exec[k])
+					for (i = 0; i < o->nlocals; i++)
+						bl->liveout[i] |= o->blocks[bl->succ[k]].livein[i];
+			transfer(o, bl, live);
+			if (memcmp(live, bl->livein, o->nlocals) != 0) {
+				memcpy(bl->livein, live, o->nlocals);
+				changed = 1;
+			}
+		}
+	} while (changed);
+	free(live);
+}
+
+/* replace instruction at pc with popping its operands */
+static List *
+replace(Opt *o, U4 pc)
+{
+	Edit *e = &o->edit[pc];
+
+	e->replaced = e->claimed = 1;
+	addpop(&e->repl, o->npop[pc]);
+	return &e->repl;
+}
+
+/*
+ * Replace instructions whose result is a constant with a push of the
+ * constant, and loads of local variables holding a constant as well.
+ * Their operands are popped, and elimination of dead code removes the
+ * instructions that computed them.
+ */
+static void
+foldconstants(Opt *o)
+{
+	U4 pc, n;
+	U1 op;
+	int b, v, t, store;
+
+	for (b = 0; b < o->nblocks; b++) {
+		if (!o->blocks[b].reached)
+			continue;
+		for (pc = o->blocks[b].start; pc <= o->blocks[b].last; pc += class_getinslen(o->bc, pc)) {
+			op = o->bc[pc];
+			if (isload(op) && localvar(o->bc, pc, &n, &t, &store))
+				v = o->state[pc * o->nslots + n];
+			else if (op >= IADD && op <= DCMPG && op != IINC)
+				v = o->insbase + pc;
+			else
+				continue;
+			if (v == NOVAL || o->vals[v].lat != LAT_CONST)
+				continue;
+			if (constindex(o, o->vals[v].type, o->vals[v].c) == 0)
+				continue;
+			addconst(o, replace(o, pc), o->vals[v].type, o->vals[v].c);
+		}
+	}
+}
+
+/*
+ * Replace conditional branches and switches that take only one of
+ * their edges with a goto, or with nothing if that is the next block.
+ * Blocks that no executable edge reaches are left out of the optimized
+ * code altogether.
+ */
+static int
+foldbranches(Opt *o)
+{
+	Block *bl;
+	List *l;
+	int b, k, t;
+
+	for (b = 0; b < o->nblocks; b++) {
+		bl = &o->blocks[b];
+		if (!bl->reached || !(isif(o->bc[bl->last]) || o->bc[bl->last] == TABLESWITCH || o->bc[bl->last] == LOOKUPSWITCH))
+			continue;
+		t = -1;
+		for (k = 0; k < bl->nsucc; k++) {
+			if (!bl->exec[k])
+				continue;
+			if (t != -1 && t != bl->succ[k])
+				break;
+			t = bl->succ[k];
+		}
+		if (t == -1)
+			return -1;
+		if (k < bl->nsucc)
+			continue;
+		l = replace(o, bl->last);
+		if (b + 1 >= o->nblocks || t != b + 1)
+			add(l, GOTO, -1, o->blocks[t].start, 0, 0, -1);
+	}
+	return 0;
+}
+
+/* replace stores into local variables that are not read afterwards with pops */
+static void
+deadstores(Opt *o)
+{
+	Block *bl;
+	U4 pc, n;
+	U1 *live;
+	int *pcs, npcs, i, b, w;
+
+	live = ecalloc(o->nlocals + 1, 1);
+	for (b = 0; b < o->nblocks; b++) {
+		bl = &o->blocks[b];
+		if (!bl->reached)
+			continue;
+		memcpy(live, bl->liveout, o->nlocals);
+		npcs = o->insno[bl->last] - o->insno[bl->start] + 1;
+		pcs = ecalloc(npcs, sizeof *pcs);
+		for (i = 0, pc = bl->start; i < npcs; i++, pc += class_getinslen(o->bc, pc))
+			pcs[i] = pc;
+		while (i-- > 0) {
+			if (writes(o, pcs[i], &n, &w)) {
+				if (!live[n] && !live[n + w - 1] && !o->edit[pcs[i]].claimed)
+					replace(o, pcs[i]);
+				memset(&live[n], 0, w);
+			}
+			if (reads(o, pcs[i], &n, &w)) {
+				memset(&live[n], 1, w);
+			}
+		}
+		free(pcs);
+	}
+	free(live);
+}
+
+/*
+ * Get number of instructions of the expression whose value instruction
+ * at pc pushes, if it is made of constants, loads of local variables
+ * and pure operations on values pushed in the same block, none of them
+ * rewritten yet; return -1 otherwise.  Set *lo to its first pc.
+ */
+static int
+expression(Opt *o, U4 pc, U4 *lo)
+{
+	U4 kidlo;
+	int i, n, size, kid;
+
+	if (o->edit[pc].claimed)
+		return -1;
+	*lo = pc;
+	if (isconst(o->class, o->bc, pc) || isload(o->bc[pc]))
+		return 1;
+	if ((n = operands(o->bc[pc])) == -1)
+		return -1;
+	for (size = 1, i = 0; i < n; i++) {
+		if ((kid = o->kids[2 * pc + i]) < 0 || (kid = expression(o, kid, &kidlo)) == -1)
+			return -1;
+		size += kid;
+		if (kidlo < *lo)
+			*lo = kidlo;
+	}
+	return size;
+}
+
+/* mark the instructions of the expression whose value instruction at pc pushes as rewritten */
+static void
+claim(Opt *o, U4 pc)
+{
+	int i, n;
+
+	o->edit[pc].claimed = 1;
+	if ((n = operands(o->bc[pc])) > 0)
+		for (i = 0; i < n; i++)
+			claim(o, o->kids[2 * pc + i]);
+}
+
+/* allocate local variable for a value of type; return -1 if there is no room */
+static int
+temporary(Opt *o, int type)
+{
+	int n, w;
+
+	w = (type == TYPE_LONG || type == TYPE_DOUBLE) ? 2 : 1;
+	if (type < TYPE_INT || type > TYPE_DOUBLE || o->maxlocals + w > OPT_MAXLOCALS)
+		return -1;
+	n = o->maxlocals;
+	o->maxlocals += w;
+	return n;
+}
+
+/* make room for n more slots on the operand stack at depth sp */
+static void
+stackroom(Opt *o, int sp, int n)
+{
+	if (sp + n > o->maxstack) {
+		o->maxstack = sp + n;
+	}
+}
+
+/* get value of the slot i slots below the top of the operand stack before the instruction at pc */
+static int
+operand(Opt *o, U4 pc, int i)
+{
+	return o->state[pc * o->nslots + o->nlocals + o->depth[pc] - i];
+}
+
+static int same(Opt *o, U4 a, U4 b);
+
+/* check whether values a and b are equal: the same value or constant, or the same operation on equal values */
+static int
+equal(Opt *o, int a, int b)
+{
+	if (a == NOVAL || b == NOVAL)
+		return 0;
+	if (a == b)
+		return 1;
+	if (o->vals[a].lat == LAT_CONST && o->vals[b].lat == LAT_CONST)
+		return o->vals[a].type == o->vals[b].type && o->vals[a].c == o->vals[b].c;
+	if ((size_t)a < o->insbase || (size_t)a >= o->phibase || (size_t)b < o->insbase || (size_t)b >= o->phibase)
+		return 0;
+	return same(o, a - o->insbase, b - o->insbase);
+}
+
+/* check whether instructions at a and b compute the same pure operation on equal values */
+static int
+same(Opt *o, U4 a, U4 b)
+{
+	int i, n;
+
+	if (o->bc[a] != o->bc[b] || (n = operands(o->bc[a])) == -1 || o->depth[a] < n || o->depth[b] < n)
+		return 0;
+	for (i = 1; i <= n; i++) {
+		if (!equal(o, operand(o, a, i), operand(o, b, i))) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/*
+ * Eliminate common subexpressions in each block: when a pure operation
+ * is computed again on the same values, the first result is kept in a
+ * new local variable and the later expressions load it instead.  This
+ * pays only if the expressions left out outweigh the dup and store.
+ */
+static void
+commonexpressions(Opt *o)
+{
+	Block *bl;
+	U4 pc, q, lo;
+	int b, n, gain, size, t, type;
+
+	for (b = 0; b < o->nblocks; b++) {
+		bl = &o->blocks[b];
+		if (!bl->reached)
+			continue;
+		for (pc = bl->start; pc <= bl->last; pc += class_getinslen(o->bc, pc)) {
+			if (o->edit[pc].claimed || operands(o->bc[pc]) == -1)
+				continue;
+			gain = -2;
+			for (q = pc + class_getinslen(o->bc, pc); q <= bl->last; q += class_getinslen(o->bc, q))
+				if (same(o, pc, q) && (size = expression(o, q, &lo)) > 0)
+					gain += size - 1;
+			type = o->vals[o->insbase + pc].type;
+			if (gain <= 0 || (t = temporary(o, type)) == -1)
+				continue;
+			o->edit[pc].claimed = 1;
+			add(&o->edit[pc].post, DUP, -1, 0, 1, 2, -1);
+			addlocal(&o->edit[pc].post, type, t, 1);
+			n = o->depth[pc] - o->npop[pc] + o->npush[pc];
+			stackroom(o, n, 1);
+			for (q = pc + class_getinslen(o->bc, pc); q <= bl->last; q += class_getinslen(o->bc, q)) {
+				if (same(o, pc, q) && expression(o, q, &lo) > 0) {
+					claim(o, q);
+					addlocal(replace(o, q), type, t, 0);
+				}
+			}
+		}
+	}
+}
+
+/* compute reverse postorder and immediate dominators of the executable blocks */
+static void
+dominators(Opt *o)
+{
+	Block *bl;
+	int *order, *work, *next;
+	int i, b, k, nwork, norder, d, p, changed;
+
+	order = ecalloc(o->nblocks, sizeof *order);
+	work = ecalloc(o->nblocks, sizeof *work);
+	next = ecalloc(o->nblocks, sizeof *next);
+	for (b = 0; b < o->nblocks; b++)
+		o->blocks[b].rpo = o->blocks[b].idom = -1;
+	/* depth-first search; a block is numbered after all its successors */
+	norder = 0;
+	nwork = 0;
+	work[nwork++] = 0;
+	o->blocks[0].rpo = 0;
+	while (nwork > 0) {
+		bl = &o->blocks[b = work[nwork - 1]];
+		for (k = next[b]; k < bl->nsucc; k++)
+			if (bl->exec[k] && o->blocks[bl->succ[k]].rpo == -1)
+				break;
+		next[b] = k + 1;
+		if (k < bl->nsucc) {
+			o->blocks[bl->succ[k]].rpo = 0;
+			work[nwork++] = bl->succ[k];
+		} else {
+			order[norder++] = b;
+			nwork--;
+		}
+	}
+	for (i = 0; i < norder; i++)
+		o->blocks[order[i]].rpo = norder - 1 - i;
+	/* iterate on reverse postorder, intersecting dominators of the predecessors processed */
+	o->blocks[0].idom = 0;
+	do {
+		changed = 0;
+		for (i = norder - 2; i >= 0; i--) {
+			bl = &o->blocks[b = order[i]];
+			d = -1;
+			for (k = 0; k < bl->npred; k++) {
+				if (!o->blocks[p = bl->pred[k]].exec[bl->predk[k]] || o->blocks[p].idom == -1)
+					continue;
+				while (d != -1 && p != d) {
+					while (o->blocks[p].rpo > o->blocks[d].rpo)
+						p = o->blocks[p].idom;
+					while (o->blocks[d].rpo > o->blocks[p].rpo)
+						d = o->blocks[d].idom;
+				}
+				d = p;
+			}
+			if (d != bl->idom) {
+				bl->idom = d;
+				changed = 1;
+			}
+		}
+	} while (changed);
+	free(order);
+	free(work);
+	free(next);
+}
+
+/* check whether block a dominates block b */
+static int
+dominates(Opt *o, int a, int b)
+{
+	while (b != a && b > 0)
+		b = o->blocks[b].idom;
+	return b == a;
+}
+
+/* check whether value v is computed outside the blocks of loop, or is a constant */
+static int
+invariant(Opt *o, U1 *loop, int v)
+{
+	if (v == NOVAL)
+		return 0;
+	if ((size_t)v < o->insbase || o->vals[v].lat == LAT_CONST)
+		return 1;
+	if ((size_t)v < o->phibase)
+		return !loop[o->blockof[v - o->insbase]];
+	return !loop[(v - o->phibase) / o->nslots];
+}
+
+/* check whether the leaves of expression at pc read values computed outside loop and available at exit of block p */
+static int
+hoistable(Opt *o, U1 *loop, Block *p, U4 pc, int *throws)
+{
+	U4 n;
+	int i, k, t, store, v;
+
+	if (isconst(o->class, o->bc, pc))
+		return 1;
+	if (isload(o->bc[pc])) {
+		localvar(o->bc, pc, &n, &t, &store);
+		v = o->state[pc * o->nslots + n];
+		return invariant(o, loop, v) && p->out[n] == v;
+	}
+	if (o->bc[pc] == ARRAYLENGTH)
+		*throws = 1;
+	for (i = 0; i < operands(o->bc[pc]); i++)
+		if ((k = o->kids[2 * pc + i]) < 0 || !hoistable(o, loop, p, k, throws))
+			return 0;
+	return 1;
+}
+
+/*
+ * Move expressions computing the same value on every iteration of loop
+ * with header h into a new local variable set in its preheader, the one
+ * block outside the loop that enters it.  Expressions that may fail on
+ * a null array must be computed at the header, where every entry into
+ * the loop computes them anyway.
+ */
+static void
+hoistloop(Opt *o, U1 *loop, int h)
+{
+	Block *p, *bl;
+	List *l;
+	U4 pc, lo, ins;
+	int b, k, pre, size, t, type, throws, sp;
+
+	pre = -1;
+	for (k = 0; k < o->blocks[h].npred; k++) {
+		b = o->blocks[h].pred[k];
+		if (loop[b] || !o->blocks[b].exec[o->blocks[h].predk[k]])
+			continue;
+		if (pre != -1 && pre != b)
+			return;
+		pre = b;
+	}
+	if (pre == -1 || h == 0)
+		return;
+	p = &o->blocks[pre];
+	for (b = 0; b < o->nblocks; b++) {
+		bl = &o->blocks[b];
+		if (!loop[b])
+			continue;
+		for (pc = bl->last + 1; pc-- > bl->start; ) {
+			if (o->insno[pc] < 0 || operands(o->bc[pc]) == -1)
+				continue;
+			if ((size = expression(o, pc, &lo)) < 2 || size != o->insno[pc] - o->insno[lo] + 1)
+				continue;
+			throws = 0;
+			if (!hoistable(o, loop, p, pc, &throws))
+				continue;
+			if (throws && (b != h || p->nsucc != 1))
+				continue;
+			type = o->vals[o->insbase + pc].type;
+			if ((t = temporary(o, type)) == -1)
+				return;
+			/* computed at the end of the preheader, before the branch that ends it if any */
+			if (isend(o->bc[p->last])) {
+				l = &o->edit[p->last].pre;
+				sp = o->depth[p->last];
+			} else {
+				l = &o->edit[p->last].post;
+				sp = p->outsp;
+			}
+			for (ins = lo; ins <= pc; ins += class_getinslen(o->bc, ins))
+				addcopy(o, l, ins);
+			addlocal(l, type, t, 1);
+			stackroom(o, sp, size);
+			claim(o, pc);
+			addlocal(replace(o, pc), type, t, 0);
+		}
+	}
+}
+
+/* find natural loops, outermost first, and hoist their invariant expressions */
+static void
+hoistinvariants(Opt *o)
+{
+	Block *bl, *q;
+	U1 *loop;
+	int *work, *size, *order;
+	int b, h, k, p, nwork, i, j, t;
+
+	if ((size_t)o->nblocks * o->nblocks > OPT_MAXSLOTS)
+		return;
+	dominators(o);
+	loop = ecalloc((size_t)o->nblocks * o->nblocks, 1);
+	work = ecalloc(o->nblocks, sizeof *work);
+	size = ecalloc(o->nblocks, sizeof *size);
+	order = ecalloc(o->nblocks, sizeof *order);
+	/* a loop is the blocks reaching the source of a back edge without going through its header */
+	for (b = 0; b < o->nblocks; b++) {
+		bl = &o->blocks[b];
+		if (!bl->reached)
+			continue;
+		for (k = 0; k < bl->nsucc; k++) {
+			h = bl->succ[k];
+			if (!bl->exec[k] || !dominates(o, h, b))
+				continue;
+			loop[h * o->nblocks + h] = 1;
+			nwork = 0;
+			if (!loop[h * o->nblocks + b]) {
+				loop[h * o->nblocks + b] = 1;
+				work[nwork++] = b;
+			}
+			while (nwork > 0) {
+				q = &o->blocks[work[--nwork]];
+				for (i = 0; i < q->npred; i++) {
+					p = q->pred[i];
+					if (!o->blocks[p].exec[q->predk[i]] || loop[h * o->nblocks + p])
+						continue;
+					loop[h * o->nblocks + p] = 1;
+					work[nwork++] = p;
+				}
+			}
+		}
+	}
+	for (h = 0; h < o->nblocks; h++) {
+		order[h] = h;
+		for (b = 0; b < o->nblocks; b++) {
+			size[h] += loop[h * o->nblocks + b];
+		}
+	}
+	for (i = 1; i < o->nblocks; i++) {
+		for (j = i; j > 0 && size[order[j - 1]] < size[order[j]]; j--) {
+			t = order[j];
+			order[j] = order[j - 1];
+			order[j - 1] = t;
+		}
+	}
+	for (i = 0; i < o->nblocks && size[order[i]] > 0; i++)
+		hoistloop(o, &loop[order[i] * o->nblocks], order[i]);
+	free(loop);
+	free(work);
+	free(size);
+	free(order);
+}
+
+/*
+ * Eliminate dead code in the optimized instructions of a block: a pop
+ * of a value pushed in the block by a constant, a load or a pure
+ * operation is left out together with it, and the operation pops its
+ * own operands instead, which may make their instructions dead in turn.
+ */
+static void
+deadcode(Block *bl, int *stack)
+{
+	Ins *in, *p;
+	size_t k;
+	int sp, i, j;
+
+again:
+	for (sp = 0; sp < bl->sp; sp++)
+		stack[sp] = -1;
+	for (k = 0; k < bl->ins.n; k++) {
+		in = &bl->ins.ins[k];
+		if (in->op == POP || in->op == POP2) {
+			for (j = 0; j < in->npop && j < sp; j++) {
+				if ((i = stack[sp - 1 - j]) < 0 || (p = &bl->ins.ins[i])->pure < 0)
+					continue;
+				setpop(p, p->pure);
+				setpop(in, in->npop - 1);
+				goto again;
+			}
+		}
+		sp -= in->npop;
+		for (j = 0; j < in->npush; j++)
+			stack[sp++] = k;
+	}
+}
+
+/* build the optimized instructions of each executable block and eliminate dead code in them */
+static void
+build(Opt *o)
+{
+	Block *bl;
+	Edit *e;
+	U4 pc;
+	int b, *stack;
+
+	stack = ecalloc((size_t)o->maxstack + 1, sizeof *stack);
+	for (b = 0; b < o->nblocks; b++) {
+		bl = &o->blocks[b];
+		if (!bl->reached)
+			continue;
+		for (pc = bl->start; pc <= bl->last; pc += class_getinslen(o->bc, pc)) {
+			e = &o->edit[pc];
+			o->first[pc] = bl->ins.n;
+			append(&bl->ins, &e->pre);
+			if (!e->replaced && o->bc[pc] != NOP)
+				addcopy(o, &bl->ins, pc);
+			append(&bl->ins, &e->repl);
+			append(&bl->ins, &e->post);
+		}
+		deadcode(bl, stack);
+	}
+	free(stack);
+}
+
+/* get target pc in the original code of goto or branch instruction */
+static U4
+target(Opt *o, Ins *in)
+{
+	if (in->pc < 0)
+		return in->arg;
+	if (o->bc[in->pc] == GOTO_W)
+		return in->pc + class_get32(&o->bc[in->pc + 1]);
+	return in->pc + class_get16(&o->bc[in->pc + 1]);
+}
+
+/* get size of optimized instruction at pos */
+static U4
+size(Opt *o, Ins *in, U4 pos)
+{
+	U4 pc = in->pc;
+
+	if (in->elide)
+		return 0;
+	if (in->pc >= 0) {
+		if (o->bc[pc] == TABLESWITCH || o->bc[pc] == LOOKUPSWITCH)
+			return class_getinslen(o->bc, pc) - (3 - pc % 4) + (3 - pos % 4);
+		return class_getinslen(o->bc, pc);
+	}
+	if (isif(in->op))
+		return 3;
+	switch (in->op) {
+	case NOP:
+		return 0;
+	case POP:
+		return in->arg;
+	case DUP: case ARRAYLENGTH:
+		return 1;
+	case GOTO: case INVOKESTATIC:
+		return 3;
+	case LDC:
+		if (in->arg >= -1 && in->arg <= 5)
+			return 1;
+		if (in->arg >= INT8_MIN && in->arg <= INT8_MAX)
+			return 2;
+		if (in->arg >= INT16_MIN && in->arg <= INT16_MAX)
+			return 3;
+		return (in->index < 256) ? 2 : 3;
+	case LDC2_W:
+		return (in->arg == 0 || in->arg == 1) ? 1 : 3;
+	default:
+		return (in->arg <= 3) ? 1 : 2;
+	}
+}
+
+/* lay out the optimized code; return its length */
+static U4
+layout(Opt *o)
+{
+	Block *bl;
+	U4 pc, pos = 0;
+	size_t k, end;
+	int b;
+
+	for (b = 0; b < o->nblocks; b++) {
+		bl = &o->blocks[b];
+		for (pc = bl->start; pc <= bl->last; pc += class_getinslen(o->bc, pc)) {
+			o->newpc[pc] = pos;
+			if (!bl->reached)
+				continue;
+			end = (pc + class_getinslen(o->bc, pc) <= bl->last) ? (size_t)o->first[pc + class_getinslen(o->bc, pc)] : bl->ins.n;
+			for (k = o->first[pc]; k < end; k++) {
+				bl->ins.ins[k].pos = pos;
+				pos += size(o, &bl->ins.ins[k], pos);
+			}
+		}
+	}
+	o->newpc[o->len] = pos;
+	return pos;
+}
+
+/* write branch offset from pos to the optimized pc of target; return -1 if it does not fit */
+static int
+offset(Opt *o, U1 *p, U4 pos, U4 target, int wide)
+{
+	int64_t off;
+
+	off = (int64_t)o->newpc[target] - pos;
+	if (wide) {
+		put32(p, off);
+	} else {
+		if (off < INT16_MIN || off > INT16_MAX)
+			return -1;
+		put16(p, off);
+	}
+	return 0;
+}
+
+/* write optimized instruction into code; return -1 if a branch offset does not fit */
+static int
+emit(Opt *o, Ins *in, U1 *code)
+{
+	U1 *p = &code[in->pos];
+	U4 pc = in->pc, q, r, n, i;
+
+	if (in->elide)
+		return 0;
+	if (in->pc >= 0) {
+		if (o->bc[pc] == GOTO_W || o->bc[pc] == GOTO || isif(o->bc[pc])) {
+			p[0] = o->bc[pc];
+			return offset(o, p + 1, in->pos, target(o, in), o->bc[pc] == GOTO_W);
+		}
+		if (o->bc[pc] != TABLESWITCH && o->bc[pc] != LOOKUPSWITCH) {
+			memcpy(p, &o->bc[pc], class_getinslen(o->bc, pc));
+			p[0] = in->op;
+			return 0;
+		}
+		/* switches: realign the table and relocate its targets */
+		p[0] = o->bc[pc];
+		q = pc + 1 + (3 - pc % 4);
+		r = 1 + (3 - in->pos % 4);
+		memset(p + 1, 0, r - 1);
+		memcpy(p + r, &o->bc[q], class_getinslen(o->bc, pc) - (q - pc));
+		offset(o, p + r, in->pos, pc + class_get32(&o->bc[q]), 1);
+		if (o->bc[pc] == TABLESWITCH) {
+			n = class_get32(&o->bc[q + 8]) - class_get32(&o->bc[q + 4]) + 1;
+			for (i = 0; i < n; i++)
+				offset(o, p + r + 12 + 4 * i, in->pos, pc + class_get32(&o->bc[q + 12 + 4 * i]), 1);
+		} else {
+			n = class_get32(&o->bc[q + 4]);
+			for (i = 0; i < n; i++)
+				offset(o, p + r + 12 + 8 * i, in->pos, pc + class_get32(&o->bc[q + 12 + 8 * i]), 1);
+		}
+		return 0;
+	}
+	if (isif(in->op)) {
+		p[0] = in->op;
+		return offset(o, p + 1, in->pos, in->arg, 0);
+	}
+	switch (in->op) {
+	case NOP:
+		break;
+	case POP:
+		memset(p, POP, in->arg);
+		break;
+	case DUP: case ARRAYLENGTH:
+		p[0] = in->op;
+		break;
+	case GOTO:
+		p[0] = GOTO;
+		return offset(o, p + 1, in->pos, in->arg, 0);
+	case INVOKESTATIC:
+		p[0] = INVOKESTATIC;
+		put16(p + 1, in->index);
+		break;
+	case LDC:
+		if (in->arg >= -1 && in->arg <= 5) {
+			p[0] = ICONST_0 + in->arg;
+		} else if (in->arg >= INT8_MIN && in->arg <= INT8_MAX) {
+			p[0] = BIPUSH;
+			p[1] = in->arg & 0xFF;
+		} else if (in->arg >= INT16_MIN && in->arg <= INT16_MAX) {
+			p[0] = SIPUSH;
+			put16(p + 1, in->arg);
+		} else if (in->index < 256) {
+			p[0] = LDC;
+			p[1] = in->index;
+		} else {
+			p[0] = LDC_W;
+			put16(p + 1, in->index);
+		}
+		break;
+	case LDC2_W:
+		if (in->arg == 0 || in->arg == 1) {
+			p[0] = LCONST_0 + in->arg;
+		} else {
+			p[0] = LDC2_W;
+			put16(p + 1, in->index);
+		}
+		break;
+	default:
+		/* loads and stores of temporaries */
+		if (in->arg <= 3) {
+			p[0] = ((in->op >= ISTORE) ? ISTORE_0 + 4 * (in->op - ISTORE) : ILOAD_0 + 4 * (in->op - ILOAD)) + in->arg;
+		} else {
+			p[0] = in->op;
+			p[1] = in->arg;
+		}
+		break;
+	}
+	return 0;
+}
+
+/* move pc in a table of the original code to the optimized code */
+static U2
+relocate(Opt *o, U4 pc)
+{
+	if (pc >= o->len)
+		return o->newpc[o->len];
+	while (o->insno[pc] < 0)
+		pc--;
+	return o->newpc[pc];
+}
+
+/* check whether value v is at most the length of array a: its length, or a constant no greater than that it was created with */
+static int
+islength(Opt *o, int v, int a)
+{
+	int n;
+
+	if (v == NOVAL || a == NOVAL)
+		return 0;
+	if (o->vals[v].lat == LAT_CONST) {
+		if ((size_t)a < o->insbase || (size_t)a >= o->phibase || o->bc[a - o->insbase] != NEWARRAY)
+			return 0;
+		n = operand(o, a - o->insbase, 1);
+		return n != NOVAL && o->vals[n].lat == LAT_CONST && o->vals[v].c <= o->vals[n].c;
+	}
+	if ((size_t)v < o->insbase || (size_t)v >= o->phibase || o->bc[v - o->insbase] != ARRAYLENGTH)
+		return 0;
+	return equal(o, operand(o, v - o->insbase, 1), a);
+}
+
+/*
+ * Check whether int value v is less than the length of array a, or
+ * than some value if a is NOVAL, where block b runs: a block dominating
+ * b is only entered by the edge of a compare on which that holds.
+ */
+static int
+below(Opt *o, int b, int v, int a)
+{
+	Block *bl, *t;
+	int k, e, taken, x, y;
+
+	for (; b > 0; b = o->blocks[b].idom) {
+		bl = &o->blocks[b];
+		for (k = 0, e = -1; k < bl->npred; k++) {
+			if (o->blocks[bl->pred[k]].exec[bl->predk[k]]) {
+				e = (e == -1) ? k : -2;
+			}
+		}
+		if (e < 0)
+			continue;
+		t = &o->blocks[bl->pred[e]];
+		if (o->bc[t->last] < IF_ICMPLT || o->bc[t->last] > IF_ICMPLE || t->nsucc != 2 || t->succ[0] == t->succ[1])
+			continue;
+		taken = (bl->predk[e] == 1);
+		x = operand(o, t->last, 2);
+		y = operand(o, t->last, 1);
+		if ((o->bc[t->last] == IF_ICMPGT && taken) || (o->bc[t->last] == IF_ICMPLE && !taken)) {
+			k = x;
+			x = y;
+			y = k;
+		} else if (!(o->bc[t->last] == IF_ICMPLT && taken) && !(o->bc[t->last] == IF_ICMPGE && !taken)) {
+			continue;
+		}
+		if (equal(o, x, v) && (a == NOVAL || islength(o, y, a)))
+			return 1;
+	}
+	return 0;
+}
+
+/* check whether value w is phi v of a counter plus one, computed where v is below some value so that it cannot overflow */
+static int
+increment(Opt *o, int w, int v)
+{
+	U4 pc;
+
+	if ((size_t)w < o->insbase || (size_t)w >= o->phibase)
+		return 0;
+	pc = w - o->insbase;
+	if (o->bc[pc] == IINC) {
+		if ((int8_t)o->bc[pc + 2] != 1 || o->state[pc * o->nslots + o->bc[pc + 1]] != v)
+			return 0;
+	} else if (o->bc[pc] == IADD) {
+		if (!(operand(o, pc, 2) == v && o->vals[operand(o, pc, 1)].lat == LAT_CONST && o->vals[operand(o, pc, 1)].c == 1) &&
+		    !(operand(o, pc, 1) == v && o->vals[operand(o, pc, 2)].lat == LAT_CONST && o->vals[operand(o, pc, 2)].c == 1))
+			return 0;
+	} else {
+		return 0;
+	}
+	return below(o, o->blockof[pc], v, NOVAL);
+}
+
+/* check whether int value v is never negative: a constant or array length, or a counter from such counting up by one */
+static int
+nonnegative(Opt *o, int v)
+{
+	Block *bl;
+	int b, s, k, w;
+
+	if (v == NOVAL)
+		return 0;
+	if (o->vals[v].lat == LAT_CONST)
+		return o->vals[v].c >= 0;
+	if ((size_t)v < o->phibase)
+		return (size_t)v >= o->insbase && o->bc[v - o->insbase] == ARRAYLENGTH;
+	b = (v - o->phibase) / o->nslots;
+	s = (v - o->phibase) % o->nslots;
+	bl = &o->blocks[b];
+	for (k = 0; k < bl->npred; k++) {
+		if (!o->blocks[bl->pred[k]].exec[bl->predk[k]])
+			continue;
+		w = o->blocks[bl->pred[k]].out[s];
+		if (w == v || increment(o, w, v))
+			continue;
+		if (w == NOVAL || (o->vals[w].lat == LAT_CONST ? o->vals[w].c < 0 :
+		    (size_t)w < o->insbase || (size_t)w >= o->phibase || o->bc[w - o->insbase] != ARRAYLENGTH))
+			return 0;
+	}
+	return 1;
+}
+
+/*
+ * Select the quick array accesses, which check neither null nor index,
+ * where the index is proven in the bounds of the array.  That is so in
+ * counted loops like for (i = 0; i < a.length; i++) a[i]: the index is
+ * below the length of the array on the edge of the loop test, which
+ * also found the array not null, and never negative as it starts at
+ * zero and only counts up by one where it is below a bound.
+ */
+static void
+checkbounds(Opt *o)
+{
+	U4 pc;
+	U1 op;
+	int b, n;
+
+	dominators(o);
+	for (b = 0; b < o->nblocks; b++) {
+		if (!o->blocks[b].reached)
+			continue;
+		for (pc = o->blocks[b].start; pc <= o->blocks[b].last; pc += class_getinslen(o->bc, pc)) {
+			op = o->bc[pc];
+			if (o->edit[pc].replaced || !((op >= IALOAD && op <= SALOAD) || (op >= IASTORE && op <= SASTORE)))
+				continue;
+			n = (op >= IASTORE) ? 1 : 0;
+			if (nonnegative(o, operand(o, pc, n + 1)) &&
+			    below(o, b, operand(o, pc, n + 1), operand(o, pc, n + 2))) {
+				o->edit[pc].op = (op >= IASTORE) ? IASTORE_QUICK + (op - IASTORE) : IALOAD_QUICK + (op - IALOAD);
+			}
+		}
+	}
+}
+
+/* get type of the values loaded from or stored into array by op */
+static int
+elemtype(U1 op)
+{
+	if (op >= IASTORE)
+		op -= IASTORE - IALOAD;
+	return (op >= IALOAD && op <= AALOAD) ? TYPE_INT + (op - IALOAD) : TYPE_INT;
+}
+
+/* check whether instruction at pc loads local variable of type; set *n to it */
+static int
+loadof(Opt *o, U4 pc, int type, U4 *n)
+{
+	int t, store;
+
+	return isload(o->bc[pc]) && localvar(o->bc, pc, n, &t, &store) && t == type;
+}
+
+/* check whether local variable n is neither the counter nor the accumulator of the loop, which it writes */
+static int
+untouched(Kernel *k, U4 n)
+{
+	int w;
+
+	if (k->kind != LOOP_SUM && k->kind != LOOP_DOT)
+		return n != k->i;
+	w = (k->acctype == TYPE_LONG) ? 2 : 1;
+	return n != k->i && (n < k->acc || n >= k->acc + w);
+}
+
+/* check whether instructions at pcs push element i of an array loaded with op; note the array */
+static int
+elemof(Opt *o, U4 *pcs, Kernel *k, U1 op)
+{
+	U4 n;
+
+	if (!loadof(o, pcs[0], TYPE_REF, &k->array[k->narrays]) || !loadof(o, pcs[1], TYPE_INT, &n) || n != k->i)
+		return 0;
+	k->narrays++;
+	return o->bc[pcs[2]] == op;
+}
+
+/* match a[i] = v, with v a constant or a local variable */
+static int
+matchfill(Opt *o, U4 *pcs, Kernel *k)
+{
+	U4 n;
+
+	k->kind = LOOP_FILL;
+	k->access = o->bc[pcs[3]];
+	if (k->access < IASTORE || k->access > SASTORE || k->access == AASTORE)
+		return 0;
+	if (!loadof(o, pcs[0], TYPE_REF, &k->array[0]) || !loadof(o, pcs[1], TYPE_INT, &n) || n != k->i)
+		return 0;
+	k->narrays = 1;
+	k->value = pcs[2];
+	if (isconst(o->class, o->bc, pcs[2]))
+		return 1;
+	return loadof(o, pcs[2], elemtype(k->access), &k->acc) && untouched(k, k->acc);
+}
+
+/* match c[i] = a[i] op b[i] on int, long or double arrays */
+static int
+matchmap(Opt *o, U4 *pcs, Kernel *k)
+{
+	U4 n;
+	int t;
+
+	k->kind = LOOP_MAP;
+	k->access = o->bc[pcs[4]];
+	if ((k->access != IALOAD && k->access != LALOAD && k->access != DALOAD) ||
+	    o->bc[pcs[9]] != k->access + (IASTORE - IALOAD))
+		return 0;
+	if (!loadof(o, pcs[0], TYPE_REF, &k->array[0]) || !loadof(o, pcs[1], TYPE_INT, &n) || n != k->i)
+		return 0;
+	k->narrays = 1;
+	if (!elemof(o, &pcs[2], k, k->access) || !elemof(o, &pcs[5], k, k->access))
+		return 0;
+	/* add, sub and mul, and div of doubles only, as that of ints and longs throws */
+	t = elemtype(k->access) - TYPE_INT;
+	k->arith = o->bc[pcs[8]];
+	return k->arith == IADD + t || k->arith == ISUB + t || k->arith == IMUL + t || (k->arith == DDIV && k->access == DALOAD);
+}
+
+/* match s = s + a[i] or s = a[i] + s on int or long arrays, and the same with a[i] * b[i] for m of 10 */
+static int
+matchreduction(Opt *o, U4 *pcs, int m, Kernel *k)
+{
+	U1 add;
+	U4 n;
+	int t, store, j;
+
+	k->kind = (m == 6) ? LOOP_SUM : LOOP_DOT;
+	if (o->bc[pcs[m - 1]] == IINC || !localvar(o->bc, pcs[m - 1], &k->acc, &t, &store) || !store)
+		return 0;
+	if ((t != TYPE_INT && t != TYPE_LONG) || k->acc == k->i)
+		return 0;
+	k->acctype = t;
+	k->access = (t == TYPE_INT) ? IALOAD : LALOAD;
+	add = (t == TYPE_INT) ? IADD : LADD;
+	if (o->bc[pcs[m - 2]] != add)
+		return 0;
+	if (loadof(o, pcs[0], t, &n) && n == k->acc)
+		j = 1;
+	else if (loadof(o, pcs[m - 3], t, &n) && n == k->acc)
+		j = 0;
+	else
+		return 0;
+	if (!elemof(o, &pcs[j], k, k->access))
+		return 0;
+	if (m == 10 && (!elemof(o, &pcs[j + 3], k, k->access) || o->bc[pcs[j + 6]] != add + (IMUL - IADD)))
+		return 0;
+	for (j = 0; j < k->narrays; j++)
+		if (!untouched(k, k->array[j]))
+			return 0;
+	return 1;
+}
+
+/*
+ * Match a counted loop whose header h is for (; i < end; ...) with end
+ * a local variable, a constant or the length of an array, and whose
+ * body is the m instructions at pcs of a statement, or for a mismatch
+ * a compare of elements in a block of its own, before i++ and the goto
+ * back to the header.  Reductions of floats and doubles are left out,
+ * as vector lanes would round their partial sums in another order.
+ */
+static int
+countedloop(Opt *o, int h, Kernel *k)
+{
+	Block *bl, *body, *next;
+	U4 pc, pcs[12];
+	int m, back, ok;
+
+	bl = &o->blocks[h];
+	if (o->bc[bl->last] != IF_ICMPGE || bl->nsucc != 2 || !bl->exec[0] || !bl->exec[1] || bl->sp != 0)
+		return 0;
+	if (!loadof(o, bl->start, TYPE_INT, &k->i))
+		return 0;
+	pc = k->bound = bl->start + class_getinslen(o->bc, bl->start);
+	if (loadof(o, pc, TYPE_REF, &k->boundvar) && o->bc[pc + class_getinslen(o->bc, pc)] == ARRAYLENGTH) {
+		k->boundtype = TYPE_REF;
+		pc += class_getinslen(o->bc, pc);
+	} else if (loadof(o, pc, TYPE_INT, &k->boundvar)) {
+		k->boundtype = TYPE_INT;
+	} else if (!isconst(o->class, o->bc, pc)) {
+		return 0;
+	}
+	if (pc + class_getinslen(o->bc, pc) != bl->last)
+		return 0;
+	k->exit = bl->succ[1];
+	body = &o->blocks[bl->succ[0]];
+	if (body->npred != 1 || body == bl)
+		return 0;
+	for (m = 0, pc = body->start; pc <= body->last && m < 12; pc += class_getinslen(o->bc, pc))
+		pcs[m++] = pc;
+	if (pc <= body->last)
+		return 0;
+	next = body;
+	if (o->bc[body->last] == IF_ICMPNE) {
+		/* if (a[i] != b[i]) break; */
+		k->kind = LOOP_MISMATCH;
+		k->access = o->bc[pcs[2]];
+		if (m != 7 || (k->access != IALOAD && (k->access < BALOAD || k->access > SALOAD)) ||
+		    !elemof(o, &pcs[0], k, k->access) || !elemof(o, &pcs[3], k, k->access))
+			return 0;
+		if (body->nsucc != 2 || !body->exec[0] || !body->exec[1])
+			return 0;
+		k->differ = body->succ[1];
+		next = &o->blocks[body->succ[0]];
+		if (next->npred != 1 || next == bl)
+			return 0;
+		pc = next->start;
+	} else if (m >= 2) {
+		pc = pcs[m - 2];
+	} else {
+		return 0;
+	}
+	/* i++ and the back edge */
+	if (o->bc[pc] != IINC || o->bc[pc + 1] != k->i || (int8_t)o->bc[pc + 2] != 1 ||
+	    o->bc[pc + 3] != GOTO || pc + 3 != next->last || pc + 3 + class_get16(&o->bc[pc + 4]) != bl->start)
+		return 0;
+	back = next - o->blocks;
+	if (bl->npred != 2 || (bl->pred[0] != back && bl->pred[1] != back) || bl->pred[0] == bl->pred[1])
+		return 0;
+	k->pre = bl->pred[(bl->pred[0] == back) ? 1 : 0];
+	switch (k->kind == LOOP_MISMATCH ? -1 : m - 2) {
+	case -1:
+		ok = 1;
+		break;
+	case 4:
+		ok = matchfill(o, pcs, k);
+		break;
+	case 6:
+		ok = matchreduction(o, pcs, 6, k);
+		break;
+	case 10:
+		if (o->bc[pcs[9]] >= IASTORE && o->bc[pcs[9]] <= SASTORE)
+			ok = matchmap(o, pcs, k);
+		else
+			ok = matchreduction(o, pcs, 10, k);
+		break;
+	default:
+		ok = 0;
+		break;
+	}
+	return ok && (k->boundtype == TYPE_NONE || untouched(k, k->boundvar));
+}
+
+/* append value of local variable n of type at exit of block p: the constant loads of it were replaced with, if any */
+static void
+addvalue(Opt *o, List *l, Block *p, int type, U4 n)
+{
+	int v = p->out[n];
+
+	if (v != NOVAL && o->vals[v].lat == LAT_CONST && constindex(o, o->vals[v].type, o->vals[v].c) != 0)
+		addconst(o, l, o->vals[v].type, o->vals[v].c);
+	else
+		addlocal(l, type, n, 0);
+}
+
+/* append the bound of loop at exit of block p */
+static void
+addbound(Opt *o, List *l, Block *p, Kernel *k)
+{
+	int v;
+
+	switch (k->boundtype) {
+	case TYPE_REF:
+		v = o->insbase + k->bound + class_getinslen(o->bc, k->bound);
+		if (o->vals[v].lat == LAT_CONST && constindex(o, TYPE_INT, o->vals[v].c) != 0) {
+			addconst(o, l, TYPE_INT, o->vals[v].c);
+		} else {
+			addvalue(o, l, p, TYPE_REF, k->boundvar);
+			add(l, ARRAYLENGTH, -1, 0, 1, 1, -1);
+		}
+		break;
+	case TYPE_INT:
+		addvalue(o, l, p, TYPE_INT, k->boundvar);
+		break;
+	default:
+		addcopy(o, l, k->bound);
+		break;
+	}
+}
+
+/* append call of static method of a class of the runtime; return -1 if the constant pool has no room for it */
+static int
+addcall(Opt *o, List *l, char *classname, char *name, char *descr, int npop, int npush)
+{
+	U2 index;
+
+	if ((index = methodindex(o->class, classname, name, descr)) == 0)
+		return -1;
+	add(l, INVOKESTATIC, -1, 0, npop, npush, -1)->index = index;
+	return 0;
+}
+
+/*
+ * Put code in front of a loop, at the end of its preheader p, that runs
+ * it with a kernel if the counter starts below the bound and not below
+ * zero, and the arrays exist with at least as many elements as the
+ * bound.  Otherwise it enters the loop, which runs as before, so that
+ * an exception comes from the iteration that throws it.
+ */
+static int
+kernel(Opt *o, Block *p, Kernel *k)
+{
+	static char *maps[] = {"add", "sub", "mul", "div"};
+	static char *mapdescrs[] = {"([I[I[III)V", "([J[J[JII)V", NULL, "([D[D[DII)V"};
+	static char *fills[] = {"([IIII)V", "([JIIJ)V", "([FIIF)V", "([DIID)V", NULL, "([BIIB)V", "([CIIC)V", "([SIIS)V"};
+	static char *mismatches[] = {"([I[III)I", NULL, NULL, NULL, NULL, "([B[BII)I", "([C[CII)I", "([S[SII)I"};
+	List l;
+	U4 loop;
+	int j, t, v, ret;
+
+	memset(&l, 0, sizeof l);
+	loop = o->blocks[p->succ[0]].start;
+	addvalue(o, &l, p, TYPE_INT, k->i);
+	addbound(o, &l, p, k);
+	add(&l, IF_ICMPGE, -1, loop, 2, 0, -1);
+	v = p->out[k->i];
+	if (v == NOVAL || o->vals[v].lat != LAT_CONST || o->vals[v].c < 0) {
+		addlocal(&l, TYPE_INT, k->i, 0);
+		add(&l, IFLT, -1, loop, 1, 0, -1);
+	}
+	for (j = 0; j < k->narrays; j++) {
+		if ((j > 0 && k->array[j] == k->array[j - 1]) || (j > 1 && k->array[j] == k->array[0]))
+			continue;
+		if (k->boundtype == TYPE_REF && k->boundvar == k->array[j])
+			continue;
+		addvalue(o, &l, p, TYPE_REF, k->array[j]);
+		add(&l, IFNULL, -1, loop, 1, 0, -1);
+		addbound(o, &l, p, k);
+		addvalue(o, &l, p, TYPE_REF, k->array[j]);
+		add(&l, ARRAYLENGTH, -1, 0, 1, 1, -1);
+		add(&l, IF_ICMPGT, -1, loop, 2, 0, -1);
+	}
+	for (j = 0; j < k->narrays; j++)
+		addvalue(o, &l, p, TYPE_REF, k->array[j]);
+	addvalue(o, &l, p, TYPE_INT, k->i);
+	addbound(o, &l, p, k);
+	t = elemtype(k->access) - TYPE_INT;
+	switch (k->kind) {
+	case LOOP_SUM:
+		addvalue(o, &l, p, k->acctype, k->acc);
+		ret = addcall(o, &l, "jvm/Simd", "sum", (t == 0) ? "([IIII)I" : "([JIIJ)J", 4, 1);
+		addlocal(&l, k->acctype, k->acc, 1);
+		break;
+	case LOOP_DOT:
+		addvalue(o, &l, p, k->acctype, k->acc);
+		ret = addcall(o, &l, "jvm/Simd", "dot", (t == 0) ? "([I[IIII)I" : "([J[JIIJ)J", 5, 1);
+		addlocal(&l, k->acctype, k->acc, 1);
+		break;
+	case LOOP_MAP:
+		ret = addcall(o, &l, "jvm/Simd", maps[(k->arith - IADD) / 4], mapdescrs[t], 5, 0);
+		break;
+	case LOOP_FILL:
+		if (isconst(o->class, o->bc, k->value))
+			addcopy(o, &l, k->value);
+		else
+			addvalue(o, &l, p, elemtype(k->access), k->acc);
+		ret = addcall(o, &l, "java/util/Arrays", "fill", fills[k->access - IASTORE], 4, 0);
+		break;
+	default:
+		/* the counter stops at the first elements that differ */
+		ret = addcall(o, &l, "jvm/Simd", "mismatch", mismatches[k->access - IALOAD], 4, 1);
+		addlocal(&l, TYPE_INT, k->i, 1);
+		addlocal(&l, TYPE_INT, k->i, 0);
+		addbound(o, &l, p, k);
+		add(&l, IF_ICMPLT, -1, o->blocks[k->differ].start, 2, 0, -1);
+		break;
+	}
+	if (k->kind != LOOP_MISMATCH) {
+		addbound(o, &l, p, k);
+		addlocal(&l, TYPE_INT, k->i, 1);
+	}
+	add(&l, GOTO, -1, o->blocks[k->exit].start, 0, 0, -1);
+	if (ret == 0) {
+		append(isend(o->bc[p->last]) ? &o->edit[p->last].pre : &o->edit[p->last].post, &l);
+		stackroom(o, 0, 6);
+	}
+	free(l.ins);
+	return ret;
+}
+
+/*
+ * Run simple counted loops over primitive arrays with the vector kernels
+ * of the runtime: sums and dot products, element-wise arithmetic, fills
+ * and searches for the first elements that differ.  The loop stays for
+ * the cases the code in front of it leaves to it.  Its preheader must
+ * only go to it, with nothing on the operand stack.
+ */
+static void
+vectorize(Opt *o)
+{
+	Block *p;
+	Kernel k;
+	int h;
+
+	for (h = 1; h < o->nblocks; h++) {
+		if (!o->blocks[h].reached)
+			continue;
+		memset(&k, 0, sizeof k);
+		if (!countedloop(o, h, &k))
+			continue;
+		p = &o->blocks[k.pre];
+		if (!p->reached || p->nsucc != 1 || !p->exec[0] || p->outsp != 0 ||
+		    (isend(o->bc[p->last]) && o->bc[p->last] != GOTO && o->bc[p->last] != GOTO_W))
+			continue;
+		kernel(o, p, &k);
+	}
+}
+
+/*
+ * Lower the optimized instructions of the blocks back into bytecode in
+ * place of the code of the method.  Gotos to the instruction after them
+ * are left out, which may bring others next to their target, until the
+ * layout settles.  Line number and local variable tables follow the
+ * instructions they describe.
+ */
+static int
+lower(Opt *o)
+{
+	Attribute *attr;
+	Block *bl;
+	Ins *in;
+	U1 *code;
+	U4 len, start, end;
+	size_t k;
+	U2 i, j;
+	int b, changed;
+
+	do {
+		len = layout(o);
+		changed = 0;
+		for (b = 0; b < o->nblocks; b++) {
+			bl = &o->blocks[b];
+			for (k = 0; bl->reached && k < bl->ins.n; k++) {
+				in = &bl->ins.ins[k];
+				if (in->elide || (in->pc < 0 ? in->op != GOTO : o->bc[in->pc] != GOTO))
+					continue;
+				if (o->newpc[target(o, in)] == in->pos + 3) {
+					in->elide = 1;
+					changed = 1;
+				}
+			}
+		}
+	} while (changed);
+	if (len == 0 || len > UINT16_MAX)
+		return -1;
+	code = ecalloc(len, 1);
+	for (b = 0; b < o->nblocks; b++) {
+		bl = &o->blocks[b];
+		for (k = 0; bl->reached && k < bl->ins.n; k++) {
+			if (emit(o, &bl->ins.ins[k], code) == -1) {
+				free(code);
+				return -1;
+			}
+		}
+	}
+	for (i = 0; i < o->code->attributes_count; i++) {
+		attr = &o->code->attributes[i];
+		if (attr->tag == LineNumberTable) {
+			for (j = 0; j < attr->info.linenumbertable.line_number_table_length; j++) {
+				start = attr->info.linenumbertable.line_number_table[j].start_pc;
+				attr->info.linenumbertable.line_number_table[j].start_pc = relocate(o, start);
+			}
+		} else if (attr->tag == LocalVariableTable) {
+			for (j = 0; j < attr->info.localvariabletable.local_variable_table_length; j++) {
+				start = attr->info.localvariabletable.local_variable_table[j].start_pc;
+				end = start + attr->info.localvariabletable.local_variable_table[j].length;
+				attr->info.localvariabletable.local_variable_table[j].start_pc = relocate(o, start);
+				attr->info.localvariabletable.local_variable_table[j].length = relocate(o, end) - relocate(o, start);
+			}
+		}
+	}
+	free(o->code->code);
+	o->code->code = code;
+	o->code->code_length = len;
+	o->code->max_locals = o->maxlocals;
+	o->code->max_stack = o->maxstack;
+	return 0;
+}
+
+/* add edge from block a to block b */
+static void
+edge(Opt *o, int a, int b)
+{
+	Block *p = &o->blocks[a];
+
+	p->succ[p->nsucc] = b;
+	o->blocks[b].pred[o->blocks[b].npred] = a;
+	o->blocks[b].predk[o->blocks[b].npred++] = p->nsucc++;
+}
+
+/* get successor pcs of the last instruction of a block at pc; return their number, or -1 if one is invalid */
+static int
+successors(Opt *o, U4 pc, U4 *succ)
+{
+	U1 *code = o->bc;
+	U4 p;
+	int64_t t;
+	int32_t i, n;
+	int ns = 0;
+
+	p = pc + 1 + (3 - pc % 4);
+	switch (code[pc]) {
+	case GOTO:
+		succ[ns++] = pc + class_get16(&code[pc + 1]);
+		break;
+	case GOTO_W:
+		succ[ns++] = pc + class_get32(&code[pc + 1]);
+		break;
+	case TABLESWITCH: case LOOKUPSWITCH:
+		succ[ns++] = pc + class_get32(&code[p]);
+		n = (code[pc] == TABLESWITCH) ? class_get32(&code[p + 8]) - class_get32(&code[p + 4]) + 1 : class_get32(&code[p + 4]);
+		for (i = 0; i < n; i++)
+			succ[ns++] = pc + class_get32(&code[(code[pc] == TABLESWITCH) ? p + 12 + 4 * i : p + 12 + 8 * i]);
+		break;
+	case IRETURN: case LRETURN: case FRETURN: case DRETURN: case ARETURN: case RETURN: case ATHROW:
+		break;
+	default:
+		succ[ns++] = pc + class_getinslen(code, pc);
+		if (isif(code[pc]))
+			succ[ns++] = pc + class_get16(&code[pc + 1]);
+		break;
+	}
+	for (i = 0; i < ns; i++) {
+		t = (int32_t)succ[i];
+		if (t < 0 || t >= o->len || o->insno[t] < 0)
+			return -1;
+	}
+	return ns;
+}
+
+/*
+ * Split the code into basic blocks and allocate the state of the
+ * optimization.  Methods with exception handlers or subroutines are
+ * left alone, as are ones too big to track the slots of every
+ * instruction.
+ */
+static int
+init(Opt *o, ClassFile *class, Method *method, Code_attribute *code)
+{
+	Block *bl;
+	U4 pc, next, *succ;
+	U1 *leader;
+	size_t nvals;
+	int b, i, n, *nedges, *slots;
+	char *s;
+
+	o->class = class;
+	o->method = method;
+	o->code = code;
+	o->bc = code->code;
+	o->len = code->code_length;
+	o->nlocals = code->max_locals;
+	o->nslots = o->nlocals + code->max_stack;
+	o->maxlocals = code->max_locals;
+	o->maxstack = code->max_stack;
+	if (o->len == 0 || o->len > UINT16_MAX || code->exception_table_length > 0 ||
+	    (size_t)o->len * (o->nslots + 1) > OPT_MAXSLOTS)
+		return -1;
+	o->insno = ecalloc(o->len + 1, sizeof *o->insno);
+	leader = ecalloc(o->len + 1, 1);
+	for (pc = 0; pc < o->len; pc++)
+		o->insno[pc] = -1;
+	leader[0] = 1;
+	for (pc = 0, n = 0; pc < o->len; pc = next) {
+		switch (o->bc[pc]) {
+		case JSR: case JSR_W: case RET:
+			free(leader);
+			return -1;
+		case WIDE:
+			if (pc + 1 >= o->len || o->bc[pc + 1] == RET) {
+				free(leader);
+				return -1;
+			}
+			break;
+		}
+		if (class_getchecked(o->bc[pc]) > JSR_W || (next = pc + class_getinslen(o->bc, pc)) > o->len) {
+			free(leader);
+			return -1;
+		}
+		o->insno[pc] = n++;
+		if (isend(o->bc[pc]))
+			leader[next] = 1;
+	}
+	/* every branch target starts a block */
+	succ = ecalloc(o->len + 1, sizeof *succ);
+	for (pc = 0; pc < o->len; pc += class_getinslen(o->bc, pc)) {
+		if (!isend(o->bc[pc]))
+			continue;
+		if ((n = successors(o, pc, succ)) == -1) {
+			free(leader);
+			free(succ);
+			return -1;
+		}
+		for (i = 0; i < n; i++) {
+			leader[succ[i]] = 1;
+		}
+	}
+	o->nblocks = 0;
+	for (pc = 0; pc < o->len; pc += class_getinslen(o->bc, pc))
+		o->nblocks += leader[pc];
+	o->blocks = ecalloc(o->nblocks, sizeof *o->blocks);
+	o->blockof = ecalloc(o->len + 1, sizeof *o->blockof);
+	for (pc = 0, b = -1; pc < o->len; pc = next) {
+		next = pc + class_getinslen(o->bc, pc);
+		if (leader[pc])
+			o->blocks[++b].start = pc;
+		o->blocks[b].last = pc;
+		o->blockof[pc] = b;
+		if (next == o->len && !isend(o->bc[pc])) {
+			/* falls off the end of the code */
+			free(leader);
+			free(succ);
+			return -1;
+		}
+	}
+	free(leader);
+	/* edges; count them first */
+	nedges = ecalloc(o->nblocks, sizeof *nedges);
+	for (b = 0; b < o->nblocks; b++) {
+		bl = &o->blocks[b];
+		n = isend(o->bc[bl->last]) ? successors(o, bl->last, succ) : 1;
+		bl->succ = ecalloc(n + 1, sizeof *bl->succ);
+		bl->exec = ecalloc(n + 1, 1);
+		nedges[b] = n;
+		if (!isend(o->bc[bl->last]))
+			succ[0] = bl->last + class_getinslen(o->bc, bl->last);
+		for (i = 0; i < n; i++)
+			o->blocks[o->blockof[succ[i]]].npred++;
+	}
+	for (b = 0; b < o->nblocks; b++) {
+		bl = &o->blocks[b];
+		bl->pred = ecalloc(bl->npred + 1, sizeof *bl->pred);
+		bl->predk = ecalloc(bl->npred + 1, sizeof *bl->predk);
+		bl->npred = 0;
+	}
+	for (b = 0; b < o->nblocks; b++) {
+		bl = &o->blocks[b];
+		if (isend(o->bc[bl->last]))
+			successors(o, bl->last, succ);
+		else
+			succ[0] = bl->last + class_getinslen(o->bc, bl->last);
+		for (i = 0; i < nedges[b]; i++) {
+			edge(o, b, o->blockof[succ[i]]);
+		}
+	}
+	free(nedges);
+	free(succ);
+	/* values: arguments, results of instructions, then phis */
+	o->insbase = o->nlocals;
+	o->phibase = o->insbase + o->len;
+	nvals = o->phibase + (size_t)o->nblocks * o->nslots;
+	o->vals = ecalloc(nvals, sizeof *o->vals);
+	slots = ecalloc((size_t)o->nblocks * 2 * o->nslots + 1, sizeof *slots);
+	for (b = 0; b < o->nblocks; b++) {
+		o->blocks[b].in = &slots[(size_t)b * 2 * o->nslots];
+		o->blocks[b].out = &slots[(size_t)b * 2 * o->nslots + o->nslots];
+		o->blocks[b].livein = ecalloc(2 * o->nlocals + 1, 1);
+		o->blocks[b].liveout = o->blocks[b].livein + o->nlocals;
+	}
+	o->entry = ecalloc(o->nslots + 1, sizeof *o->entry);
+	for (i = 0; (size_t)i < o->nslots; i++)
+		o->entry[i] = NOVAL;
+	i = 0;
+	if (!(method->access_flags & ACC_STATIC)) {
+		if (o->nlocals < 1)
+			return -1;
+		o->entry[i] = i;
+		setval(o, i++, TYPE_REF, LAT_BOTTOM, 0);
+	}
+	for (s = class_getutf8(class, method->descriptor_index) + 1; *s && *s != ')'; s++) {
+		n = fieldtype(s);
+		if ((size_t)i + ((n == TYPE_LONG || n == TYPE_DOUBLE) ? 2 : 1) > o->nlocals)
+			return -1;
+		o->entry[i] = i;
+		setval(o, i, n, LAT_BOTTOM, 0);
+		if (n == TYPE_LONG || n == TYPE_DOUBLE) {
+			o->entry[i + 1] = i;
+			i++;
+		}
+		i++;
+		while (*s == '[')
+			s++;
+		if (*s == 'L')
+			while (*s && *s != ';')
+				s++;
+	}
+	o->state = ecalloc((size_t)o->len * o->nslots + 1, sizeof *o->state);
+	o->depth = ecalloc(o->len + 1, sizeof *o->depth);
+	o->npop = ecalloc(o->len + 1, sizeof *o->npop);
+	o->npush = ecalloc(o->len + 1, sizeof *o->npush);
+	o->kids = ecalloc(2 * (size_t)o->len + 1, sizeof *o->kids);
+	o->parent = ecalloc(o->len + 1, sizeof *o->parent);
+	o->cur = ecalloc(o->nslots + 1, sizeof *o->cur);
+	o->prod = ecalloc((size_t)code->max_stack + 1, sizeof *o->prod);
+	o->edit = ecalloc(o->len + 1, sizeof *o->edit);
+	o->first = ecalloc(o->len + 1, sizeof *o->first);
+	o->newpc = ecalloc(o->len + 1, sizeof *o->newpc);
+	return 0;
+}
+
+/* free state of the optimization */
+static void
+cleanup(Opt *o)
+{
+	U4 pc;
+	int b;
+
+	for (b = 0; o->blocks != NULL && b < o->nblocks; b++) {
+		free(o->blocks[b].succ);
+		free(o->blocks[b].exec);
+		free(o->blocks[b].pred);
+		free(o->blocks[b].predk);
+		free(o->blocks[b].livein);
+		free(o->blocks[b].ins.ins);
+	}
+	for (pc = 0; o->edit != NULL && pc < o->len; pc++) {
+		free(o->edit[pc].pre.ins);
+		free(o->edit[pc].repl.ins);
+		free(o->edit[pc].post.ins);
+	}
+	if (o->blocks != NULL)
+		free(o->blocks[0].in);
+	free(o->blocks);
+	free(o->insno);
+	free(o->blockof);
+	free(o->first);
+	free(o->vals);
+	free(o->entry);
+	free(o->state);
+	free(o->depth);
+	free(o->npop);
+	free(o->npush);
+	free(o->kids);
+	free(o->parent);
+	free(o->cur);
+	free(o->prod);
+	free(o->edit);
+	free(o->newpc);
+}
+
+/* check whether code can be spliced into a caller: every return leaves only its value on the operand stack */
+static int
+splicable(ClassFile *class, Method *method, Code_attribute *code)
+{
+	Opt o;
+	U4 pc;
+	int ok;
+
+	memset(&o, 0, sizeof o);
+	ok = init(&o, class, method, code) == 0 && propagate(&o) == 0;
+	for (pc = 0; ok && pc < o.len; pc += class_getinslen(o.bc, pc)) {
+		if (o.bc[pc] == WIDE)
+			ok = 0;
+		else if (o.bc[pc] >= IRETURN && o.bc[pc] <= RETURN)
+			ok = o.blocks[o.blockof[pc]].reached && o.depth[pc] == (o.bc[pc] != RETURN);
+	}
+	cleanup(&o);
+	return ok;
+}
+
+/* get method of the class that invokestatic at pc calls, if its code is small enough to be spliced there */
+static Method *
+inlinable(Expand *x, U1 *bc, U4 pc, Link *chain, int level)
+{
+	Attribute *cattr;
+	Code_attribute *code;
+	Method *method;
+	Link *l;
+	char *classname, *name, *type;
+	U2 i;
+
+	if (bc[pc] != INVOKESTATIC || level >= maxinlinelevel)
+		return NULL;
+	i = class_get16(&bc[pc + 1]) & 0xFFFF;
+	classname = class_getclassname(x->class, x->class->constant_pool[i].info.methodref_info.class_index);
+	if (strcmp(classname, class_getclassname(x->class, x->class->this_class)) != 0)
+		return NULL;
+	class_getnameandtype(x->class, class_getnameandtypeindex(x->class, i), &name, &type);
+	if ((method = class_getmethod(x->class, name, type)) == NULL || !(method->access_flags & ACC_STATIC) ||
+	    (method->access_flags & (ACC_NATIVE | ACC_ABSTRACT | ACC_SYNCHRONIZED)))
+		return NULL;
+	for (l = chain; l != NULL; l = l->up)
+		if (l->method == method)
+			return NULL;
+	if ((cattr = class_getattr(method->attributes, method->attributes_count, Code)) == NULL)
+		return NULL;
+	code = &cattr->info.code;
+	if (code->code_length > (U4)maxinlinesize || code->exception_table_length > 0 ||
+	    x->maxlocals + code->max_locals > OPT_MAXLOCALS || !splicable(x->class, method, code))
+		return NULL;
+	return method;
+}
+
+/* write load, store or iinc of local variable n into the expanded code, or count its size */
+static void
+putlocal(Expand *x, U1 op, U4 n, U1 inc)
+{
+	if (op == IINC) {
+		if (x->out != NULL) {
+			x->out[x->len] = IINC;
+			x->out[x->len + 1] = n;
+			x->out[x->len + 2] = inc;
+		}
+		x->len += 3;
+	} else if (n <= 3) {
+		if (x->out != NULL)
+			x->out[x->len] = ((op >= ISTORE) ? ISTORE_0 + 4 * (op - ISTORE) : ILOAD_0 + 4 * (op - ILOAD)) + n;
+		x->len += 1;
+	} else {
+		if (x->out != NULL) {
+			x->out[x->len] = op;
+			x->out[x->len + 1] = n;
+		}
+		x->len += 2;
+	}
+}
+
+/* write branch offset from pc at p to target in the expanded code */
+static void
+putoffset(Expand *x, U4 p, U4 pc, U4 target, int wide)
+{
+	int64_t off;
+
+	if (x->out == NULL)
+		return;
+	off = (int64_t)target - pc;
+	if (wide)
+		put32(&x->out[p], off);
+	else if (off < INT16_MIN || off > INT16_MAX)
+		x->fail = 1;
+	else
+		put16(&x->out[p], off);
+}
+
+/* write the stores of the arguments of a call into the local variables of the spliced method */
+static void
+putargs(Expand *x, Splice *sp)
+{
+	U4 slot[256];
+	int type[256], n = 0;
+	U4 i = 0;
+	char *s;
+
+	if (!(sp->method->access_flags & ACC_STATIC))
+		i++;
+	for (s = class_getutf8(x->class, sp->method->descriptor_index) + 1; *s && *s != ')' && n < 256; s++) {
+		type[n] = fieldtype(s);
+		slot[n++] = i;
+		i += (type[n - 1] == TYPE_LONG || type[n - 1] == TYPE_DOUBLE) ? 2 : 1;
+		while (*s == '[')
+			s++;
+		if (*s == 'L')
+			while (*s && *s != ';')
+				s++;
+	}
+	while (n-- > 0) {
+		putlocal(x, ISTORE + type[n] - TYPE_INT, sp->base + slot[n], 0);
+	}
+}
+
+/*
+ * Lay out the code of a splice into the expanded code, adding splices
+ * for the calls expanded in it, or emit it once laid out.  Locals of
+ * a spliced method move past those of its caller, and its returns
+ * jump to the end of its code, where its value is left as the result
+ * of the call.  Return the operand stack slots the splices of its calls
+ * add to its own.
+ */
+static int
+expand(Expand *x, int s, Link *chain, int level)
+{
+	Splice *sp;
+	Method *method;
+	Code_attribute *code;
+	Link link;
+	U1 *bc;
+	U4 pc, q, r, len, n, i;
+	int type, store, extra = 0, k;
+
+	code = x->splices[s].code;
+	bc = code->code;
+	len = code->code_length;
+	link.method = x->splices[s].method;
+	link.up = chain;
+	for (pc = 0; pc < len; pc += class_getinslen(bc, pc)) {
+		if (x->out == NULL)
+			x->splices[s].pos[pc] = x->len;
+		if (x->out == NULL && (method = inlinable(x, bc, pc, &link, level)) != NULL) {
+			if ((sp = realloc(x->splices, (x->nsplices + 1) * sizeof *sp)) == NULL)
+				err(EXIT_FAILURE, "realloc");
+			x->splices = sp;
+			sp = &x->splices[k = x->nsplices++];
+			sp->method = method;
+			sp->code = &class_getattr(method->attributes, method->attributes_count, Code)->info.code;
+			sp->pos = ecalloc(sp->code->code_length + 1, sizeof *sp->pos);
+			sp->base = x->maxlocals;
+			sp->parent = s;
+			sp->call = pc;
+			x->maxlocals += sp->code->max_locals;
+			putargs(x, sp);
+			n = x->splices[k].code->max_stack + expand(x, k, &link, level + 1);
+			if (n > (U4)extra)
+				extra = n;
+			continue;
+		}
+		if (x->out != NULL && x->next < x->nsplices && x->splices[x->next].parent == s && x->splices[x->next].call == pc) {
+			putargs(x, &x->splices[k = x->next++]);
+			expand(x, k, &link, level + 1);
+			continue;
+		}
+		sp = &x->splices[s];
+		if (s > 0 && localvar(bc, pc, &n, &type, &store)) {
+			if (bc[pc] == IINC)
+				putlocal(x, IINC, sp->base + n, bc[pc + 2]);
+			else
+				putlocal(x, (store ? ISTORE : ILOAD) + type - TYPE_INT, sp->base + n, 0);
+		} else if (s > 0 && bc[pc] >= IRETURN && bc[pc] <= RETURN) {
+			if (pc + 1 < len) {
+				if (x->out != NULL)
+					x->out[x->len] = GOTO;
+				putoffset(x, x->len + 1, x->len, sp->pos[len], 0);
+				x->len += 3;
+			}
+		} else if (bc[pc] == GOTO || bc[pc] == JSR || isif(bc[pc])) {
+			if (x->out != NULL)
+				x->out[x->len] = bc[pc];
+			putoffset(x, x->len + 1, x->len, sp->pos[pc + class_get16(&bc[pc + 1])], 0);
+			x->len += 3;
+		} else if (bc[pc] == GOTO_W || bc[pc] == JSR_W) {
+			if (x->out != NULL)
+				x->out[x->len] = bc[pc];
+			putoffset(x, x->len + 1, x->len, sp->pos[pc + class_get32(&bc[pc + 1])], 1);
+			x->len += 5;
+		} else if (bc[pc] == TABLESWITCH || bc[pc] == LOOKUPSWITCH) {
+			/* realign the table and relocate its targets */
+			q = pc + 1 + (3 - pc % 4);
+			r = 1 + (3 - x->len % 4);
+			if (x->out != NULL) {
+				x->out[x->len] = bc[pc];
+				memset(&x->out[x->len + 1], 0, r - 1);
+				memcpy(&x->out[x->len + r], &bc[q], class_getinslen(bc, pc) - (q - pc));
+			}
+			putoffset(x, x->len + r, x->len, sp->pos[pc + class_get32(&bc[q])], 1);
+			if (bc[pc] == TABLESWITCH) {
+				n = class_get32(&bc[q + 8]) - class_get32(&bc[q + 4]) + 1;
+				for (i = 0; i < n; i++)
+					putoffset(x, x->len + r + 12 + 4 * i, x->len, sp->pos[pc + class_get32(&bc[q + 12 + 4 * i])], 1);
+			} else {
+				n = class_get32(&bc[q + 4]);
+				for (i = 0; i < n; i++)
+					putoffset(x, x->len + r + 12 + 8 * i, x->len, sp->pos[pc + class_get32(&bc[q + 12 + 8 * i])], 1);
+			}
+			x->len += r + class_getinslen(bc, pc) - (q - pc);
+		} else {
+			if (x->out != NULL)
+				memcpy(&x->out[x->len], &bc[pc], class_getinslen(bc, pc));
+			x->len += class_getinslen(bc, pc);
+		}
+	}
+	if (x->out == NULL)
+		x->splices[s].pos[len] = x->len;
+	return extra;
+}
+
+/* move pc in a table of the code of a method to its expanded code */
+static U2
+expanded(Splice *sp, U4 pc)
+{
+	if (pc >= sp->code->code_length)
+		return sp->pos[sp->code->code_length];
+	return sp->pos[pc];
+}
+
+/*
+ * Inline calls of a method to small static methods of its class, which
+ * need no lookup, into its code.  The code of a callee is spliced
+ * after stores of the arguments into local variables past those of the
+ * caller, so that the optimization that follows propagates them into
+ * its body.  Callees are limited in size and in the nesting of calls
+ * spliced into them; a method is not spliced into itself.  The inlined
+ * code keeps the line of its call in the line number table.
+ */
+static void
+inlinecalls(ClassFile *class, Method *method, Code_attribute *code)
+{
+	Attribute *attr;
+	Expand x;
+	U4 pc, start, end;
+	U2 i, j;
+	int extra, k;
+
+	if (maxinlinelevel <= 0 || code->code_length == 0)
+		return;
+	for (pc = 0; pc < code->code_length; pc += class_getinslen(code->code, pc)) {
+		if (code->code[pc] == JSR || code->code[pc] == JSR_W || code->code[pc] == RET ||
+		    class_getchecked(code->code[pc]) > JSR_W || pc + class_getinslen(code->code, pc) > code->code_length)
+			return;
+	}
+	memset(&x, 0, sizeof x);
+	x.class = class;
+	x.maxlocals = code->max_locals;
+	x.splices = ecalloc(1, sizeof *x.splices);
+	x.splices[0].method = method;
+	x.splices[0].code = code;
+	x.splices[0].pos = ecalloc(code->code_length + 1, sizeof *x.splices[0].pos);
+	x.splices[0].parent = -1;
+	x.nsplices = 1;
+	extra = expand(&x, 0, NULL, 0);
+	if (x.nsplices > 1 && x.len <= UINT16_MAX && code->max_stack + extra <= UINT16_MAX) {
+		x.out = ecalloc(x.len, 1);
+		x.len = 0;
+		x.next = 1;
+		expand(&x, 0, NULL, 0);
+	}
+	if (x.out != NULL && !x.fail) {
+		for (i = 0; i < code->exception_table_length; i++) {
+			code->exception_table[i].start_pc = expanded(&x.splices[0], code->exception_table[i].start_pc);
+			code->exception_table[i].end_pc = expanded(&x.splices[0], code->exception_table[i].end_pc);
+			code->exception_table[i].handler_pc = expanded(&x.splices[0], code->exception_table[i].handler_pc);
+		}
+		for (i = 0; i < code->attributes_count; i++) {
+			attr = &code->attributes[i];
+			if (attr->tag == LineNumberTable) {
+				for (j = 0; j < attr->info.linenumbertable.line_number_table_length; j++) {
+					start = attr->info.linenumbertable.line_number_table[j].start_pc;
+					attr->info.linenumbertable.line_number_table[j].start_pc = expanded(&x.splices[0], start);
+				}
+			} else if (attr->tag == LocalVariableTable) {
+				for (j = 0; j < attr->info.localvariabletable.local_variable_table_length; j++) {
+					start = attr->info.localvariabletable.local_variable_table[j].start_pc;
+					end = start + attr->info.localvariabletable.local_variable_table[j].length;
+					attr->info.localvariabletable.local_variable_table[j].start_pc = expanded(&x.splices[0], start);
+					attr->info.localvariabletable.local_variable_table[j].length = expanded(&x.splices[0], end) - expanded(&x.splices[0], start);
+				}
+			}
+		}
+		free(code->code);
+		code->code = x.out;
+		code->code_length = x.len;
+		code->max_locals = x.maxlocals;
+		code->max_stack += extra;
+	} else {
+		free(x.out);
+	}
+	for (k = 0; k < x.nsplices; k++)
+		free(x.splices[k].pos);
+	free(x.splices);
+}
+
+/*
+ * Optimize the code of a method.  Its bytecode is lifted into SSA form
+ * over the control flow graph, where constants are propagated and
+ * folded, branches on constants resolved and unreachable blocks
+ * dropped; stores to dead local variables, redundant computations in a
+ * block and computations invariant in a loop are then rewritten, and
+ * dead code eliminated.  The result is lowered back into bytecode in
+ * the form the interpreter runs, with long and double values in one
+ * operand stack slot.  Code that cannot be analyzed is left as it is.
+ */
+static void
+optimize(ClassFile *class, Method *method, Code_attribute *code)
+{
+	Opt o;
+
+	memset(&o, 0, sizeof o);
+	if (init(&o, class, method, code) == 0 && propagate(&o) == 0) {
+		foldconstants(&o);
+		if (foldbranches(&o) == 0) {
+			checkbounds(&o);
+			parents(&o);
+			liveness(&o);
+			deadstores(&o);
+			hoistinvariants(&o);
+			vectorize(&o);
+			commonexpressions(&o);
+			build(&o);
+			lower(&o);
+		}
+	}
+	cleanup(&o);
+}
+
+/* set limits of the methods inlined into their callers */
+void
+opt_init(long maxsize, long maxlevel)
+{
+	maxinlinesize = maxsize;
+	maxinlinelevel = maxlevel;
+}
+
+/* inline calls in and optimize the code of the methods of a class */
+void
+opt_class(ClassFile *class)
+{
+	Attribute *cattr;
+	U2 i;
+
+	for (i = 0; i < class->methods_count; i++) {
+		cattr = class_getattr(class->methods[i].attributes, class->methods[i].attributes_count, Code);
+		if (cattr != NULL) {
+			inlinecalls(class, &class->methods[i], &cattr->info.code);
+			optimize(class, &class->methods[i], &cattr->info.code);
+		}
+	}
+}
@@ -0,0 +1,5 @@
+#define OPT_INLINESIZE  35      /* default bytes of code of a method inlined into its callers */
+#define OPT_INLINELEVEL 9       /* default nesting of inlined calls */
+
+void opt_init(long maxinlinesize, long maxinlinelevel);
+void opt_class(ClassFile *class);
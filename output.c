@@ -0,0 +1,445 @@
+#include <errno.h>
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <io.h>
+#define write  _write
+#define isatty _isatty
+#else
+#include <unistd.h>
+#endif
+#include "util.h"
+#include "output.h"
+
+static const char digitpairs[] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+static Output outputs[2];       /* System.out and System.err */
+static int init = 0;
+
+/* write buffered bytes to file descriptor */
+static void
+drain(Output *out)
+{
+	ssize_t n;
+	size_t i;
+
+	for (i = 0; i < out->len; i += n) {
+		if ((n = write(out->fd, out->buf + i, out->len - i)) < 0) {
+			if (errno == EINTR) {
+				n = 0;
+				continue;
+			}
+			break;          /* like PrintStream, silently drop output on error */
+		}
+	}
+	out->len = 0;
+}
+
+/* flush all output streams */
+static void
+flushall(void)
+{
+	drain(&outputs[0]);
+	drain(&outputs[1]);
+}
+
+/* make room for n more bytes in buffer; return pointer to free space */
+static char *
+reserve(Output *out, size_t n)
+{
+	if (out->size - out->len >= n)
+		return out->buf + out->len;
+	if (out->grow) {
+		while (out->size - out->len < n)
+			out->size *= 2;
+		if ((out->buf = realloc(out->buf, out->size)) == NULL)
+			err(EXIT_FAILURE, "realloc");
+	} else {
+		drain(out);
+	}
+	return out->buf + out->len;
+}
+
+/* format u into decimal digits ending at end; return pointer to first digit */
+static char *
+fmtuint(char *end, uint32_t u)
+{
+	char *p = end;
+
+	while (u >= 100) {
+		p -= 2;
+		memcpy(p, &digitpairs[(u % 100) * 2], 2);
+		u /= 100;
+	}
+	if (u >= 10) {
+		p -= 2;
+		memcpy(p, &digitpairs[u * 2], 2);
+	} else {
+		*--p = '0' + u;
+	}
+	return p;
+}
+
+/* format u into decimal digits ending at end; return pointer to first digit */
+static char *
+fmtulong(char *end, uint64_t u)
+{
+	char *p = end;
+
+	while (u > UINT32_MAX) {
+		p -= 2;
+		memcpy(p, &digitpairs[(u % 100) * 2], 2);
+		u /= 100;
+	}
+	return fmtuint(p, (uint32_t)u);
+}
+
+/*
+ * Get the shortest decimal digit string, from mindig up to maxdig digits,
+ * that reads back as d (as a float if isfloat is set).  Digits are written
+ * without trailing zeros into digits, and their count into *ndigits.
+ * Return the decimal exponent of the first digit.
+ */
+static int
+shortest(double d, int isfloat, char *digits, int *ndigits)
+{
+	char tmp[OUTPUT_NUMSIZE];
+	char *s;
+	int mindig, maxdig, prec, n;
+
+	/* fewer digits than FLT_DIG/DBL_DIG always round trip, except for subnormals */
+	if (isfloat)
+		mindig = (d < FLT_MIN) ? 2 : FLT_DIG;
+	else
+		mindig = (d < DBL_MIN) ? 2 : DBL_DIG;
+	maxdig = isfloat ? 9 : 17;
+	for (prec = mindig; prec < maxdig; prec++) {
+		(void)snprintf(tmp, sizeof tmp, "%.*e", prec - 1, d);
+		if (isfloat ? strtof(tmp, NULL) == (float)d : strtod(tmp, NULL) == d) {
+			break;
+		}
+	}
+	if (prec == maxdig)
+		(void)snprintf(tmp, sizeof tmp, "%.*e", prec - 1, d);
+	n = 0;
+	for (s = tmp; *s != 'e'; s++)
+		if (*s != '.')
+			digits[n++] = *s;
+	while (n > 1 && digits[n - 1] == '0')
+		n--;
+	*ndigits = n;
+	return atoi(s + 1);
+}
+
+/* format floating-point value as Double.toString/Float.toString do; return length */
+static size_t
+fmtdouble(char *buf, double d, int isfloat)
+{
+	char digits[OUTPUT_NUMSIZE];
+	char *p, *q;
+	int exp, n, i;
+
+	p = buf;
+	if (isnan(d)) {
+		memcpy(p, "NaN", 3);
+		return 3;
+	}
+	if (signbit(d)) {
+		*p++ = '-';
+		d = -d;
+	}
+	if (isinf(d)) {
+		memcpy(p, "Infinity", 8);
+		return p - buf + 8;
+	}
+	if (d == 0.0) {
+		memcpy(p, "0.0", 3);
+		return p - buf + 3;
+	}
+	if (d < 1e7 && d == (double)(int32_t)d) {
+		/* integral values in plain notation need no digit search */
+		q = fmtuint(digits + sizeof digits, (uint32_t)d);
+		n = digits + sizeof digits - q;
+		memcpy(p, q, n);
+		memcpy(p + n, ".0", 2);
+		return p - buf + n + 2;
+	}
+	exp = shortest(d, isfloat, digits, &n);
+	if (exp >= -3 && exp < 7) {
+		if (exp < 0) {
+			*p++ = '0';
+			*p++ = '.';
+			for (i = -1; i > exp; i--)
+				*p++ = '0';
+			memcpy(p, digits, n);
+			p += n;
+		} else {
+			for (i = 0; i <= exp; i++)
+				*p++ = (i < n) ? digits[i] : '0';
+			*p++ = '.';
+			if (n > exp + 1) {
+				memcpy(p, digits + exp + 1, n - exp - 1);
+				p += n - exp - 1;
+			} else {
+				*p++ = '0';
+			}
+		}
+	} else {
+		*p++ = digits[0];
+		*p++ = '.';
+		if (n > 1) {
+			memcpy(p, digits + 1, n - 1);
+			p += n - 1;
+		} else {
+			*p++ = '0';
+		}
+		*p++ = 'E';
+		if (exp < 0) {
+			*p++ = '-';
+			exp = -exp;
+		}
+		q = fmtuint(digits + sizeof digits, exp);
+		n = digits + sizeof digits - q;
+		memcpy(p, q, n);
+		p += n;
+	}
+	return p - buf;
+}
+
+/* set flush policy and buffer size of output streams; flush them on exit */
+void
+output_init(FlushMode mode, size_t bufsize)
+{
+	int i;
+
+	if (init)
+		return;
+	init = 1;
+	if (bufsize < OUTPUT_NUMSIZE)
+		bufsize = OUTPUT_NUMSIZE;
+	for (i = 0; i < 2; i++) {
+		outputs[i].fd = i + 1;
+		outputs[i].flushline = (mode == FLUSH_LINE && isatty(i + 1));
+		outputs[i].grow = (mode == FLUSH_EXIT);
+		outputs[i].buf = emalloc(bufsize);
+		outputs[i].len = 0;
+		outputs[i].size = bufsize;
+	}
+	atexit(flushall);
+}
+
+/* get output stream writing to file descriptor 1 (System.out) or 2 (System.err) */
+Output *
+output_get(int fd)
+{
+	output_init(FLUSH_LINE, OUTPUT_BUFSIZE);
+	if (fd < 1 || fd > 2)
+		return NULL;
+	return &outputs[fd - 1];
+}
+
+/* write buffered bytes now */
+void
+output_flush(Output *out)
+{
+	drain(out);
+}
+
+/* write n bytes from s */
+void
+output_write(Output *out, const char *s, size_t n)
+{
+	size_t m;
+
+	while (n > 0) {
+		if (out->grow || out->size - out->len >= n)
+			m = n;
+		else if (out->len == out->size)
+			m = (n < out->size) ? n : out->size;
+		else
+			m = out->size - out->len;
+		memcpy(reserve(out, m), s, m);
+		out->len += m;
+		s += m;
+		n -= m;
+	}
+}
+
+/* write nul-terminated string */
+void
+output_string(Output *out, const char *s)
+{
+	output_write(out, s, strlen(s));
+}
+
+/* write latin1 characters encoded as UTF-8 */
+void
+output_latin1(Output *out, const uint8_t *s, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		if (s[i] >= 0x80)
+			break;
+	output_write(out, (const char *)s, i);
+	for (; i < n; i++) {
+		output_char(out, s[i]);
+	}
+}
+
+/* write UTF-16 code units encoded as UTF-8, combining surrogate pairs */
+void
+output_utf16(Output *out, const uint16_t *s, size_t n)
+{
+	uint32_t c;
+	size_t i;
+	char *p;
+
+	for (i = 0; i < n; i++) {
+		if (s[i] >= 0xD800 && s[i] < 0xDC00 && i + 1 < n && s[i + 1] >= 0xDC00 && s[i + 1] < 0xE000) {
+			c = 0x10000 + ((s[i] - 0xD800) << 10) + (s[i + 1] - 0xDC00);
+			p = reserve(out, 4);
+			p[0] = 0xF0 | (c >> 18);
+			p[1] = 0x80 | ((c >> 12) & 0x3F);
+			p[2] = 0x80 | ((c >> 6) & 0x3F);
+			p[3] = 0x80 | (c & 0x3F);
+			out->len += 4;
+			i++;
+		} else {
+			output_char(out, s[i]);
+		}
+	}
+}
+
+/* write UTF-16 code unit encoded as UTF-8 */
+void
+output_char(Output *out, uint16_t c)
+{
+	char *p;
+
+	p = reserve(out, 3);
+	if (c < 0x80) {
+		p[0] = c;
+		out->len += 1;
+	} else if (c < 0x800) {
+		p[0] = 0xC0 | (c >> 6);
+		p[1] = 0x80 | (c & 0x3F);
+		out->len += 2;
+	} else {
+		p[0] = 0xE0 | (c >> 12);
+		p[1] = 0x80 | ((c >> 6) & 0x3F);
+		p[2] = 0x80 | (c & 0x3F);
+		out->len += 3;
+	}
+}
+
+/* format int in decimal into buf; return length */
+size_t
+output_fmtint(char *buf, int32_t i)
+{
+	char tmp[OUTPUT_NUMSIZE];
+	char *p;
+	uint32_t u;
+	size_t n;
+
+	u = (i < 0) ? -(uint32_t)i : (uint32_t)i;
+	p = fmtuint(tmp + sizeof tmp, u);
+	if (i < 0)
+		*--p = '-';
+	n = tmp + sizeof tmp - p;
+	memcpy(buf, p, n);
+	return n;
+}
+
+/* format long in decimal into buf; return length */
+size_t
+output_fmtlong(char *buf, int64_t l)
+{
+	char tmp[OUTPUT_NUMSIZE];
+	char *p;
+	uint64_t u;
+	size_t n;
+
+	u = (l < 0) ? -(uint64_t)l : (uint64_t)l;
+	p = fmtulong(tmp + sizeof tmp, u);
+	if (l < 0)
+		*--p = '-';
+	n = tmp + sizeof tmp - p;
+	memcpy(buf, p, n);
+	return n;
+}
+
+/* format float into buf as Float.toString does; return length */
+size_t
+output_fmtfloat(char *buf, float f)
+{
+	return fmtdouble(buf, f, 1);
+}
+
+/* format double into buf as Double.toString does; return length */
+size_t
+output_fmtdouble(char *buf, double d)
+{
+	return fmtdouble(buf, d, 0);
+}
+
+/* write int in decimal */
+void
+output_int(Output *out, int32_t i)
+{
+	char buf[OUTPUT_NUMSIZE];
+
+	output_write(out, buf, output_fmtint(buf, i));
+}
+
+/* write long in decimal */
+void
+output_long(Output *out, int64_t l)
+{
+	char buf[OUTPUT_NUMSIZE];
+
+	output_write(out, buf, output_fmtlong(buf, l));
+}
+
+/* write float as Float.toString does */
+void
+output_float(Output *out, float f)
+{
+	char buf[OUTPUT_NUMSIZE];
+
+	output_write(out, buf, output_fmtfloat(buf, f));
+}
+
+/* write double as Double.toString does */
+void
+output_double(Output *out, double d)
+{
+	char buf[OUTPUT_NUMSIZE];
+
+	output_write(out, buf, output_fmtdouble(buf, d));
+}
+
+/* write line separator; flush if stream is line buffered */
+void
+output_newline(Output *out)
+{
+	*reserve(out, 1) = '\n';
+	out->len++;
+	if (out->flushline) {
+		drain(out);
+	}
+}
@@ -0,0 +1,36 @@
+#define OUTPUT_BUFSIZE  (64 * 1024)     /* default size of output buffers */
+#define OUTPUT_NUMSIZE  32              /* enough for any formatted number */
+
+typedef enum FlushMode {
+	FLUSH_LINE,     /* flush on newline when attached to a terminal; otherwise when full */
+	FLUSH_SIZE,     /* flush when buffer is full */
+	FLUSH_EXIT,     /* flush only on exit; buffer grows as needed */
+} FlushMode;
+
+/* buffered output stream (System.out, System.err) */
+typedef struct Output {
+	int     fd;
+	int     flushline;      /* whether to flush on newline */
+	int     grow;           /* whether to grow rather than flush when full */
+	char   *buf;
+	size_t  len;            /* number of bytes in buffer */
+	size_t  size;           /* capacity of buffer */
+} Output;
+
+size_t output_fmtint(char *buf, int32_t i);
+size_t output_fmtlong(char *buf, int64_t l);
+size_t output_fmtfloat(char *buf, float f);
+size_t output_fmtdouble(char *buf, double d);
+void output_init(FlushMode mode, size_t bufsize);
+Output *output_get(int fd);
+void output_flush(Output *out);
+void output_write(Output *out, const char *s, size_t n);
+void output_string(Output *out, const char *s);
+void output_latin1(Output *out, const uint8_t *s, size_t n);
+void output_utf16(Output *out, const uint16_t *s, size_t n);
+void output_char(Output *out, uint16_t c);
+void output_int(Output *out, int32_t i);
+void output_long(Output *out, int64_t l);
+void output_float(Output *out, float f);
+void output_double(Output *out, double d);
+void output_newline(Output *out);
@@ -0,0 +1,188 @@
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#include "util.h"
+#include "perf.h"
+
+#define JITDUMP_MAGIC   0x4A695444      /* "JiTD" */
+#define JITDUMP_VERSION 1
+#define JIT_CODE_LOAD   0               /* record of code loaded at an address */
+#define JIT_CODE_CLOSE  3               /* record ending the file */
+#define EM_X86_64       62
+#define EM_AARCH64      183
+
+/* header of jitdump file */
+typedef struct DumpHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size;
+	uint32_t mach;
+	uint32_t pad;
+	uint32_t pid;
+	uint64_t timestamp;
+	uint64_t flags;
+} DumpHeader;
+
+/* header of jitdump record */
+typedef struct DumpRecord {
+	uint32_t id;
+	uint32_t size;
+	uint64_t timestamp;
+} DumpRecord;
+
+/* jitdump record of loaded code, followed by its name and its bytes */
+typedef struct DumpLoad {
+	DumpRecord rec;
+	uint32_t pid;
+	uint32_t tid;
+	uint64_t vma;
+	uint64_t addr;
+	uint64_t size;
+	uint64_t index;
+} DumpLoad;
+
+static FILE *map = NULL;                /* /tmp/perf-<pid>.map */
+static FILE *dump = NULL;               /* /tmp/jit-<pid>.dump */
+static void *marker = NULL;             /* mapping of the dump, which tells perf record of it */
+static uint64_t ncode = 0;
+
+/* get time in the clock perf record -k mono uses */
+static uint64_t
+timestamp(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == -1)
+		return 0;
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* write bytes to the dump; stop dumping if it fails */
+static void
+dumpwrite(void *p, size_t n)
+{
+	if (dump != NULL && fwrite(p, 1, n, dump) != n) {
+		warnx("could not write jitdump");
+		fclose(dump);
+		dump = NULL;
+	}
+}
+
+/* open the dump and map its first page executable, so perf inject finds it among the mappings perf record saw */
+static void
+dumpopen(void)
+{
+	DumpHeader h;
+	char path[64];
+	long pagesize;
+	int fd;
+
+	(void)snprintf(path, sizeof path, "/tmp/jit-%ld.dump", (long)getpid());
+	if ((fd = open(path, O_CREAT | O_TRUNC | O_RDWR, 0666)) == -1) {
+		warn("%s", path);
+		return;
+	}
+	if ((pagesize = sysconf(_SC_PAGESIZE)) <= 0)
+		pagesize = 4096;
+	if ((marker = mmap(NULL, pagesize, PROT_READ | PROT_EXEC, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+		warn("%s", path);
+		marker = NULL;
+		close(fd);
+		return;
+	}
+	if ((dump = fdopen(fd, "w")) == NULL) {
+		warn("%s", path);
+		close(fd);
+		return;
+	}
+	memset(&h, 0, sizeof h);
+	h.magic = JITDUMP_MAGIC;
+	h.version = JITDUMP_VERSION;
+	h.size = sizeof h;
+#if defined(__aarch64__)
+	h.mach = EM_AARCH64;
+#else
+	h.mach = EM_X86_64;
+#endif
+	h.pid = getpid();
+	h.timestamp = timestamp();
+	dumpwrite(&h, sizeof h);
+}
+
+/* start reporting generated code to a perf map, a jitdump file, or both */
+void
+perf_init(int usemap, int usedump)
+{
+	char path[64];
+
+	if (usemap) {
+		(void)snprintf(path, sizeof path, "/tmp/perf-%ld.map", (long)getpid());
+		if ((map = fopen(path, "w")) == NULL)
+			warn("%s", path);
+	}
+	if (usedump) {
+		dumpopen();
+	}
+}
+
+/* report code of size bytes at code generated for the routine of name */
+void
+perf_code(char *name, void *code, size_t size)
+{
+	DumpLoad load;
+	size_t len;
+
+	if (map != NULL) {
+		fprintf(map, "%lx %zx %s\n", (unsigned long)(uintptr_t)code, size, name);
+		fflush(map);
+	}
+	if (dump != NULL) {
+		len = strlen(name) + 1;
+		memset(&load, 0, sizeof load);
+		load.rec.id = JIT_CODE_LOAD;
+		load.rec.size = sizeof load + len + size;
+		load.rec.timestamp = timestamp();
+		load.pid = load.tid = getpid();
+		load.vma = load.addr = (uintptr_t)code;
+		load.size = size;
+		load.index = ncode++;
+		dumpwrite(&load, sizeof load);
+		dumpwrite(name, len);
+		dumpwrite(code, size);
+		if (dump != NULL)
+			fflush(dump);
+	}
+}
+
+/* finish the reports */
+void
+perf_exit(void)
+{
+	DumpRecord rec;
+	long pagesize;
+
+	if (map != NULL) {
+		fclose(map);
+		map = NULL;
+	}
+	if (dump != NULL) {
+		rec.id = JIT_CODE_CLOSE;
+		rec.size = sizeof rec;
+		rec.timestamp = timestamp();
+		dumpwrite(&rec, sizeof rec);
+		if (dump != NULL)
+			fclose(dump);
+		dump = NULL;
+	}
+	if (marker != NULL) {
+		if ((pagesize = sysconf(_SC_PAGESIZE)) <= 0)
+			pagesize = 4096;
+		munmap(marker, pagesize);
+		marker = NULL;
+	}
+}
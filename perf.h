@@ -0,0 +1,4 @@
+/* report generated code to profilers: a perf map, a jitdump file, or both */
+void perf_init(int map, int jitdump);
+void perf_code(char *name, void *code, size_t size);
+void perf_exit(void);
@@ -0,0 +1,683 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "util.h"
+#include "class.h"
+#include "refmap.h"
+
+#define SLOT_VALUE      0               /* primitive value, return address or unusable slot */
+#define SLOT_REF        1               /* reference */
+#define SLOT_SITE       2               /* first of the kinds of arrays allocated by a given newarray */
+#define SLOT_NSITES     253             /* number of such kinds; 255 would read as an underflow */
+#define SLOT_VOID       -1              /* nothing, as pushed by a void method */
+
+/* reference maps of a method; one entry per byte of code */
+typedef struct RefMap {
+	int     invalid;        /* whether the analysis failed; use no maps */
+	size_t  width;          /* size of an entry: reached flag, then locals, then stack */
+	U1     *sites;          /* slot kind of array allocated at each instruction, 0 if it escapes */
+	U2     *depth;          /* operand stack depth at each reached instruction */
+	U1      map[];
+} RefMap;
+
+/* state of the analysis of a method */
+typedef struct Analysis {
+	ClassFile      *class;
+	Code_attribute *code;
+	RefMap         *rm;
+	size_t          nslots;         /* max_locals + max_stack */
+	U2             *depth;          /* operand stack depth at each reached instruction */
+	U4             *work;           /* stack of instructions to visit */
+	U4              nwork;
+	U1             *queued;         /* whether instruction is in work stack */
+	U1             *cur;            /* slots of instruction being visited */
+	U2              sp;             /* operand stack depth of instruction being visited */
+	U1              escaped[256];   /* whether array of each slot kind may escape the method */
+} Analysis;
+
+/* get slot kind of value of field descriptor */
+static int
+fieldkind(char *descr)
+{
+	return (*descr == 'L' || *descr == '[') ? SLOT_REF : SLOT_VALUE;
+}
+
+/* count arguments in method descriptor; return slot kind of its return value */
+static int
+methodkind(char *descr, int *nargs)
+{
+	char *s;
+
+	*nargs = 0;
+	for (s = descr + 1; *s && *s != ')'; s++) {
+		while (*s == '[')
+			s++;
+		if (*s == 'L')
+			while (*s && *s != ';')
+				s++;
+		(*nargs)++;
+	}
+	if (*s == ')')
+		s++;
+	return (*s == 'V') ? SLOT_VOID : fieldkind(s);
+}
+
+/* merge slots with the given operand stack depth into entry of instruction at pc; return -1 on error */
+static int
+merge(Analysis *a, int64_t pc, U1 *slots, U2 sp)
+{
+	U1 *entry;
+	size_t i;
+	int changed;
+
+	if (pc < 0 || pc >= a->code->code_length)
+		return -1;
+	entry = &a->rm->map[pc * a->rm->width];
+	if (!entry[0]) {
+		entry[0] = 1;
+		memcpy(entry + 1, slots, a->nslots);
+		a->depth[pc] = sp;
+		changed = 1;
+	} else {
+		if (a->depth[pc] != sp)
+			return -1;
+		changed = 0;
+		/*
+		 * A slot holds a reference only if it does so on every path, and
+		 * an array from a known allocation site only if it is the same
+		 * site on every path; arrays whose site is forgotten escape.
+		 */
+		for (i = 0; i < a->nslots; i++) {
+			if (entry[1 + i] == slots[i])
+				continue;
+			if (entry[1 + i] && slots[i]) {
+				a->escaped[entry[1 + i]] = a->escaped[slots[i]] = 1;
+				if (entry[1 + i] == SLOT_REF)
+					continue;
+				entry[1 + i] = SLOT_REF;
+			} else {
+				entry[1 + i] = SLOT_VALUE;
+			}
+			changed = 1;
+		}
+	}
+	if (changed && !a->queued[pc]) {
+		a->queued[pc] = 1;
+		a->work[a->nwork++] = pc;
+	}
+	return 0;
+}
+
+/* merge locals of current instruction into the exception handlers covering pc */
+static int
+mergehandlers(Analysis *a, U4 pc, U1 *tmp)
+{
+	Exception *e;
+	U2 i;
+
+	for (i = 0; i < a->code->exception_table_length; i++) {
+		e = &a->code->exception_table[i];
+		if (pc < e->start_pc || pc >= e->end_pc)
+			continue;
+		if (a->code->max_stack < 1)
+			return -1;
+		memcpy(tmp, a->cur, a->code->max_locals);
+		memset(tmp + a->code->max_locals, SLOT_VALUE, a->code->max_stack);
+		tmp[a->code->max_locals] = SLOT_REF;
+		if (merge(a, e->handler_pc, tmp, 1) == -1) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/* push slot of given kind onto the operand stack; return -1 on overflow */
+static int
+push(Analysis *a, int kind)
+{
+	if (kind == SLOT_VOID)
+		return 0;
+	if (a->sp >= a->code->max_stack)
+		return -1;
+	a->cur[a->code->max_locals + a->sp++] = kind;
+	return 0;
+}
+
+/* pop n slots from the operand stack; return kind of the last one popped, or -1 on underflow */
+static int
+pop(Analysis *a, int n)
+{
+	int kind = SLOT_VALUE;
+
+	while (n-- > 0) {
+		if (a->sp == 0)
+			return -1;
+		kind = a->cur[a->code->max_locals + --a->sp];
+		a->cur[a->code->max_locals + a->sp] = SLOT_VALUE;
+	}
+	return kind;
+}
+
+/* pop n slots from the operand stack, whose arrays escape the method; return -1 on underflow */
+static int
+popescape(Analysis *a, int n)
+{
+	int kind;
+
+	while (n-- > 0) {
+		if ((kind = pop(a, 1)) == -1)
+			return -1;
+		a->escaped[kind] = 1;
+	}
+	return 0;
+}
+
+/* set kind of local variable; return -1 if out of range */
+static int
+setlocal(Analysis *a, U4 i, int kind)
+{
+	if (i >= a->code->max_locals)
+		return -1;
+	a->cur[i] = kind;
+	return 0;
+}
+
+/* pop the n top slots and push them back in the order given by perm (1 is the top) */
+static int
+shuffle(Analysis *a, int n, const char *perm)
+{
+	U1 v[4];
+	int i;
+
+	for (i = 0; i < n; i++)
+		if ((v[i] = pop(a, 1)) == (U1)-1)
+			return -1;
+	for (; *perm; perm++)
+		if (push(a, v[*perm - '1']) == -1)
+			return -1;
+	return 0;
+}
+
+/* get slot kind of constant pushed by ldc */
+static int
+ldckind(ClassFile *class, U2 index)
+{
+	switch (class->constant_pool[index].tag) {
+	case CONSTANT_Integer:
+	case CONSTANT_Float:
+	case CONSTANT_Long:
+	case CONSTANT_Double:
+		return SLOT_VALUE;
+	default:
+		return SLOT_REF;
+	}
+}
+
+/* simulate effect of load or store of local variable i by instruction op */
+static int
+local(Analysis *a, U1 op, U4 i)
+{
+	int kind;
+
+	switch (op) {
+	case ILOAD: case LLOAD: case FLOAD: case DLOAD:
+		return push(a, SLOT_VALUE);
+	case ALOAD:
+		if (i >= a->code->max_locals)
+			return -1;
+		return push(a, a->cur[i] ? a->cur[i] : SLOT_REF);
+	case ISTORE: case FSTORE:
+		return (pop(a, 1) == -1) ? -1 : setlocal(a, i, SLOT_VALUE);
+	case LSTORE: case DSTORE:
+		if (pop(a, 1) == -1 || setlocal(a, i, SLOT_VALUE) == -1)
+			return -1;
+		return setlocal(a, i + 1, SLOT_VALUE);
+	case ASTORE:
+		return ((kind = pop(a, 1)) == -1) ? -1 : setlocal(a, i, kind);
+	}
+	return -1;
+}
+
+/* simulate instruction at pc on the current slots and merge them into its successors */
+static int
+visit(Analysis *a, U4 pc, U1 *tmp)
+{
+	U1 *code = a->code->code;
+	U1 op = code[pc];
+	U4 next, p;
+	U2 index;
+	char *name, *type;
+	int32_t i, n, low, high;
+	int kind, nargs;
+
+	next = pc + class_getinslen(code, pc);
+	if (mergehandlers(a, pc, tmp) == -1)
+		return -1;
+	switch (op) {
+	case NOP: case IINC:
+		break;
+	case ACONST_NULL:
+		if (push(a, SLOT_REF) == -1)
+			return -1;
+		break;
+	case ICONST_M1: case ICONST_0: case ICONST_1: case ICONST_2: case ICONST_3:
+	case ICONST_4: case ICONST_5: case LCONST_0: case LCONST_1: case FCONST_0:
+	case FCONST_1: case FCONST_2: case DCONST_0: case DCONST_1: case BIPUSH:
+	case SIPUSH: case LDC2_W:
+		if (push(a, SLOT_VALUE) == -1)
+			return -1;
+		break;
+	case LDC:
+		if (push(a, ldckind(a->class, code[pc + 1])) == -1)
+			return -1;
+		break;
+	case LDC_W:
+		if (push(a, ldckind(a->class, class_get16(&code[pc + 1]) & 0xFFFF)) == -1)
+			return -1;
+		break;
+	case ILOAD: case LLOAD: case FLOAD: case DLOAD: case ALOAD:
+	case ISTORE: case LSTORE: case FSTORE: case DSTORE: case ASTORE:
+		if (local(a, op, code[pc + 1]) == -1)
+			return -1;
+		break;
+	case ILOAD_0: case ILOAD_1: case ILOAD_2: case ILOAD_3:
+		if (local(a, ILOAD, op - ILOAD_0) == -1)
+			return -1;
+		break;
+	case LLOAD_0: case LLOAD_1: case LLOAD_2: case LLOAD_3:
+		if (local(a, LLOAD, op - LLOAD_0) == -1)
+			return -1;
+		break;
+	case FLOAD_0: case FLOAD_1: case FLOAD_2: case FLOAD_3:
+		if (local(a, FLOAD, op - FLOAD_0) == -1)
+			return -1;
+		break;
+	case DLOAD_0: case DLOAD_1: case DLOAD_2: case DLOAD_3:
+		if (local(a, DLOAD, op - DLOAD_0) == -1)
+			return -1;
+		break;
+	case ALOAD_0: case ALOAD_1: case ALOAD_2: case ALOAD_3:
+		if (local(a, ALOAD, op - ALOAD_0) == -1)
+			return -1;
+		break;
+	case ISTORE_0: case ISTORE_1: case ISTORE_2: case ISTORE_3:
+		if (local(a, ISTORE, op - ISTORE_0) == -1)
+			return -1;
+		break;
+	case LSTORE_0: case LSTORE_1: case LSTORE_2: case LSTORE_3:
+		if (local(a, LSTORE, op - LSTORE_0) == -1)
+			return -1;
+		break;
+	case FSTORE_0: case FSTORE_1: case FSTORE_2: case FSTORE_3:
+		if (local(a, FSTORE, op - FSTORE_0) == -1)
+			return -1;
+		break;
+	case DSTORE_0: case DSTORE_1: case DSTORE_2: case DSTORE_3:
+		if (local(a, DSTORE, op - DSTORE_0) == -1)
+			return -1;
+		break;
+	case ASTORE_0: case ASTORE_1: case ASTORE_2: case ASTORE_3:
+		if (local(a, ASTORE, op - ASTORE_0) == -1)
+			return -1;
+		break;
+	case WIDE:
+		if (code[pc + 1] == RET)
+			return 0;
+		if (code[pc + 1] != IINC && local(a, code[pc + 1], class_get16(&code[pc + 2]) & 0xFFFF) == -1)
+			return -1;
+		break;
+	case AALOAD: case AALOAD_QUICK:
+		if (pop(a, 2) == -1 || push(a, SLOT_REF) == -1)
+			return -1;
+		break;
+	case IALOAD: case LALOAD: case FALOAD: case DALOAD: case BALOAD: case CALOAD: case SALOAD:
+	case IALOAD_QUICK: case LALOAD_QUICK: case FALOAD_QUICK: case DALOAD_QUICK:
+	case BALOAD_QUICK: case CALOAD_QUICK: case SALOAD_QUICK:
+		if (pop(a, 2) == -1 || push(a, SLOT_VALUE) == -1)
+			return -1;
+		break;
+	case IASTORE: case LASTORE: case FASTORE: case DASTORE:
+	case BASTORE: case CASTORE: case SASTORE:
+	case IASTORE_QUICK: case LASTORE_QUICK: case FASTORE_QUICK: case DASTORE_QUICK:
+	case BASTORE_QUICK: case CASTORE_QUICK: case SASTORE_QUICK:
+		if (pop(a, 3) == -1)
+			return -1;
+		break;
+	case AASTORE: case AASTORE_QUICK:
+		if (popescape(a, 1) == -1 || pop(a, 2) == -1)
+			return -1;
+		break;
+	/* the interpreter keeps long and double operands in one slot, so these never look at categories */
+	case POP:
+		if (pop(a, 1) == -1)
+			return -1;
+		break;
+	case MONITORENTER: case MONITOREXIT: case PUTSTATIC:
+		if (popescape(a, 1) == -1)
+			return -1;
+		break;
+	case POP2:
+		if (pop(a, 2) == -1)
+			return -1;
+		break;
+	case PUTFIELD:
+		if (popescape(a, 2) == -1)
+			return -1;
+		break;
+	case DUP:
+		if (shuffle(a, 1, "11") == -1)
+			return -1;
+		break;
+	case DUP_X1:
+		if (shuffle(a, 2, "121") == -1)
+			return -1;
+		break;
+	case DUP_X2:
+		if (shuffle(a, 3, "1321") == -1)
+			return -1;
+		break;
+	case DUP2:
+		if (shuffle(a, 2, "2121") == -1)
+			return -1;
+		break;
+	case DUP2_X1:
+		if (shuffle(a, 3, "21321") == -1)
+			return -1;
+		break;
+	case DUP2_X2:
+		if (shuffle(a, 4, "214321") == -1)
+			return -1;
+		break;
+	case SWAP:
+		if (shuffle(a, 2, "12") == -1)
+			return -1;
+		break;
+	case IFEQ: case IFNE: case IFLT: case IFGE: case IFGT: case IFLE:
+	case IFNULL: case IFNONNULL:
+		if (pop(a, 1) == -1 || merge(a, (int64_t)pc + class_get16(&code[pc + 1]), a->cur, a->sp) == -1)
+			return -1;
+		break;
+	case IF_ICMPEQ: case IF_ICMPNE: case IF_ICMPLT: case IF_ICMPGE:
+	case IF_ICMPGT: case IF_ICMPLE: case IF_ACMPEQ: case IF_ACMPNE:
+		if (pop(a, 2) == -1 || merge(a, (int64_t)pc + class_get16(&code[pc + 1]), a->cur, a->sp) == -1)
+			return -1;
+		break;
+	case GOTO:
+		return merge(a, (int64_t)pc + class_get16(&code[pc + 1]), a->cur, a->sp);
+	case GOTO_W:
+		return merge(a, (int64_t)pc + class_get32(&code[pc + 1]), a->cur, a->sp);
+	case JSR: case JSR_W:
+		/* the subroutine returns to the next instruction with the stack as it is now */
+		if (merge(a, next, a->cur, a->sp) == -1 || push(a, SLOT_VALUE) == -1)
+			return -1;
+		n = (op == JSR) ? class_get16(&code[pc + 1]) : class_get32(&code[pc + 1]);
+		return merge(a, (int64_t)pc + n, a->cur, a->sp);
+	case RET: case IRETURN: case LRETURN: case FRETURN: case DRETURN: case RETURN:
+		return 0;
+	case ARETURN: case ATHROW:
+		return popescape(a, 1);
+	case TABLESWITCH: case LOOKUPSWITCH:
+		if (pop(a, 1) == -1)
+			return -1;
+		p = pc + 1 + (3 - pc % 4);
+		if (merge(a, (int64_t)pc + class_get32(&code[p]), a->cur, a->sp) == -1)
+			return -1;
+		if (op == TABLESWITCH) {
+			low = class_get32(&code[p + 4]);
+			high = class_get32(&code[p + 8]);
+			for (i = 0; i <= high - low; i++) {
+				if (merge(a, (int64_t)pc + class_get32(&code[p + 12 + 4 * i]), a->cur, a->sp) == -1) {
+					return -1;
+				}
+			}
+		} else {
+			n = class_get32(&code[p + 4]);
+			for (i = 0; i < n; i++) {
+				if (merge(a, (int64_t)pc + class_get32(&code[p + 12 + 8 * i]), a->cur, a->sp) == -1) {
+					return -1;
+				}
+			}
+		}
+		return 0;
+	case GETSTATIC: case GETFIELD:
+		index = class_get16(&code[pc + 1]) & 0xFFFF;
+		class_getnameandtype(a->class, a->class->constant_pool[index].info.fieldref_info.name_and_type_index, &name, &type);
+		if ((op == GETFIELD && pop(a, 1) == -1) || push(a, fieldkind(type)) == -1)
+			return -1;
+		break;
+	case INVOKEVIRTUAL: case INVOKESPECIAL: case INVOKESTATIC:
+	case INVOKEINTERFACE: case INVOKEDYNAMIC:
+		index = class_get16(&code[pc + 1]) & 0xFFFF;
+		class_getnameandtype(a->class, class_getnameandtypeindex(a->class, index), &name, &type);
+		kind = methodkind(type, &nargs);
+		if (op != INVOKESTATIC && op != INVOKEDYNAMIC)
+			nargs++;
+		if (popescape(a, nargs) == -1 || push(a, kind) == -1)
+			return -1;
+		break;
+	case NEW:
+		if (push(a, SLOT_REF) == -1)
+			return -1;
+		break;
+	case NEWARRAY:
+		/* storage of an array is reused at its site only if the previous array is unreachable */
+		kind = a->rm->sites[pc] ? a->rm->sites[pc] : SLOT_REF;
+		if (memchr(a->cur, kind, a->code->max_locals + a->sp) != NULL)
+			a->escaped[kind] = 1;
+		if (pop(a, 1) == -1 || push(a, kind) == -1)
+			return -1;
+		break;
+	case CHECKCAST:
+		if ((kind = pop(a, 1)) == -1 || push(a, kind) == -1)
+			return -1;
+		break;
+	case ANEWARRAY:
+		if (pop(a, 1) == -1 || push(a, SLOT_REF) == -1)
+			return -1;
+		break;
+	case ARRAYLENGTH: case INSTANCEOF:
+		if (pop(a, 1) == -1 || push(a, SLOT_VALUE) == -1)
+			return -1;
+		break;
+	case MULTIANEWARRAY:
+		if (pop(a, code[pc + 3]) == -1 || push(a, SLOT_REF) == -1)
+			return -1;
+		break;
+	default:
+		if (op >= IADD && op <= DREM) {
+			n = 2;                  /* binary arithmetic */
+		} else if (op >= INEG && op <= DNEG) {
+			n = 1;
+		} else if (op >= ISHL && op <= LXOR) {
+			n = 2;
+		} else if (op >= I2L && op <= I2S) {
+			n = 1;
+		} else if (op >= LCMP && op <= DCMPG) {
+			n = 2;
+		} else {
+			return -1;
+		}
+		if (pop(a, n) == -1 || push(a, SLOT_VALUE) == -1)
+			return -1;
+		break;
+	}
+	if (mergehandlers(a, pc, tmp) == -1)
+		return -1;
+	return merge(a, next, a->cur, a->sp);
+}
+
+/* get method whose code is the given code attribute */
+static Method *
+codemethod(ClassFile *class, Code_attribute *code)
+{
+	Attribute *attr;
+	U2 i;
+
+	for (i = 0; i < class->methods_count; i++) {
+		attr = class_getattr(class->methods[i].attributes, class->methods[i].attributes_count, Code);
+		if (attr != NULL && &attr->info.code == code) {
+			return &class->methods[i];
+		}
+	}
+	return NULL;
+}
+
+/* set slots of method entry from its descriptor; return -1 if they do not fit */
+static int
+entryslots(Analysis *a, Method *method)
+{
+	char *s;
+	U4 i = 0;
+
+	if (!(method->access_flags & ACC_STATIC) && setlocal(a, i++, SLOT_REF) == -1)
+		return -1;
+	for (s = class_getutf8(a->class, method->descriptor_index) + 1; *s && *s != ')'; s++) {
+		if (*s == 'L' || *s == '[') {
+			if (setlocal(a, i++, SLOT_REF) == -1)
+				return -1;
+			while (*s == '[')
+				s++;
+			if (*s == 'L')
+				while (*s && *s != ';')
+					s++;
+		} else {
+			i += (*s == 'J' || *s == 'D') ? 2 : 1;
+		}
+	}
+	return 0;
+}
+
+/* give a slot kind of its own to the arrays allocated by each newarray, as long as kinds last */
+static void
+numbersites(Analysis *a)
+{
+	U4 pc;
+	int n = 0;
+
+	for (pc = 0; pc < a->code->code_length && n < SLOT_NSITES; pc += class_getinslen(a->code->code, pc)) {
+		if (a->code->code[pc] == NEWARRAY) {
+			a->rm->sites[pc] = SLOT_SITE + n++;
+		}
+	}
+}
+
+/*
+ * Compute which local variables and operand stack slots hold references
+ * at each instruction of method code, by abstract interpretation of the
+ * bytecode.  A slot is a reference at an instruction only if it is one
+ * on every path reaching it.
+ *
+ * The same pass is an escape analysis of primitive arrays: references
+ * to the array allocated by each newarray are followed through the
+ * slots, and the array escapes if it is returned, thrown, stored
+ * anywhere but in a slot of the frame, passed to a method, or merged
+ * with another reference.  Arrays that do not escape can live in their
+ * frame.
+ */
+static RefMap *
+analyze(ClassFile *class, Code_attribute *code)
+{
+	Analysis a;
+	Method *method;
+	U1 *tmp;
+	U4 pc;
+	size_t size;
+	int error = 0;
+
+	a.class = class;
+	a.code = code;
+	a.nslots = (size_t)code->max_locals + code->max_stack;
+	/* maps and site kinds, then depths aligned after them */
+	size = (size_t)code->code_length * (2 + a.nslots);
+	size += size % sizeof *a.depth;
+	a.rm = ecalloc(1, sizeof *a.rm + size + (size_t)code->code_length * sizeof *a.depth);
+	a.rm->width = 1 + a.nslots;
+	a.rm->sites = &a.rm->map[(size_t)code->code_length * a.rm->width];
+	a.rm->depth = a.depth = (U2 *)&a.rm->map[size];
+	memset(a.escaped, 0, sizeof a.escaped);
+	a.work = ecalloc(code->code_length, sizeof *a.work);
+	a.queued = ecalloc(code->code_length, sizeof *a.queued);
+	a.cur = ecalloc(a.nslots + 1, 1);
+	tmp = ecalloc(a.nslots + 1, 1);
+	a.nwork = 0;
+	a.sp = 0;
+	if ((method = codemethod(class, code)) == NULL || code->code_length == 0 ||
+	    entryslots(&a, method) == -1 || merge(&a, 0, a.cur, 0) == -1)
+		error = 1;
+	else
+		numbersites(&a);
+	while (!error && a.nwork > 0) {
+		pc = a.work[--a.nwork];
+		a.queued[pc] = 0;
+		memcpy(a.cur, &a.rm->map[pc * a.rm->width + 1], a.nslots);
+		a.sp = a.depth[pc];
+		if (visit(&a, pc, tmp) == -1) {
+			error = 1;
+		}
+	}
+	a.rm->invalid = error;
+	for (pc = 0; pc < code->code_length; pc++)
+		if (error || a.escaped[a.rm->sites[pc]])
+			a.rm->sites[pc] = 0;
+	free(a.work);
+	free(a.queued);
+	free(a.cur);
+	free(tmp);
+	return a.rm;
+}
+
+/*
+ * Get reference map of method code at instruction pc, computing the maps
+ * of the method on first use.  The map has one byte per local variable
+ * followed by one byte per operand stack slot, nonzero for references.
+ * Return NULL if pc is not the start of a reachable instruction or the
+ * method could not be analyzed.
+ */
+U1 *
+refmap_get(ClassFile *class, Code_attribute *code, U2 pc)
+{
+	RefMap *rm;
+
+	if (code->refmap == NULL)
+		code->refmap = analyze(class, code);
+	rm = code->refmap;
+	if (rm->invalid || pc >= code->code_length || !rm->map[pc * rm->width])
+		return NULL;
+	return &rm->map[pc * rm->width + 1];
+}
+
+/*
+ * Get allocation site number of newarray at instruction pc of method
+ * code, from 0 up.  Return -1 if the array it allocates may escape the
+ * method, so it must be allocated in the heap.
+ */
+int
+refmap_site(ClassFile *class, Code_attribute *code, U2 pc)
+{
+	RefMap *rm;
+
+	if (code->refmap == NULL)
+		code->refmap = analyze(class, code);
+	rm = code->refmap;
+	if (pc >= code->code_length || rm->sites[pc] == 0)
+		return -1;
+	return rm->sites[pc] - SLOT_SITE;
+}
+
+/*
+ * Get operand stack depth of method code before instruction pc, in
+ * slots of the interpreter.  Return -1 if pc is not the start of a
+ * reachable instruction or the method could not be analyzed.
+ */
+int
+refmap_depth(ClassFile *class, Code_attribute *code, U2 pc)
+{
+	RefMap *rm;
+
+	if (code->refmap == NULL)
+		code->refmap = analyze(class, code);
+	rm = code->refmap;
+	if (rm->invalid || pc >= code->code_length || !rm->map[pc * rm->width])
+		return -1;
+	return rm->depth[pc];
+}
@@ -0,0 +1,3 @@
+U1 *refmap_get(ClassFile *class, Code_attribute *code, U2 pc);
+int refmap_site(ClassFile *class, Code_attribute *code, U2 pc);
+int refmap_depth(ClassFile *class, Code_attribute *code, U2 pc);
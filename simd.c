@@ -0,0 +1,618 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "simd.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+#define PATSIZE 32      /* size of widest vector, a multiple of every element size */
+
+/* detect vector extensions of the cpu once */
+SimdLevel
+simd_level(void)
+{
+	static int level = -1;
+
+	if (level != -1)
+		return level;
+	level = SIMD_NONE;
+#ifdef SIMD_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		level = SIMD_AVX2;
+	else if (__builtin_cpu_supports("sse2"))
+		level = SIMD_SSE2;
+#endif
+	return level;
+}
+
+/* test whether the cpu has scalar extension ext */
+int
+simd_has(SimdExt ext)
+{
+#ifdef SIMD_X86
+	__builtin_cpu_init();
+	switch (ext) {
+	case SIMD_POPCNT:
+		return __builtin_cpu_supports("popcnt");
+	case SIMD_LZCNT:
+		return __builtin_cpu_supports("lzcnt");
+	case SIMD_SSE41:
+		return __builtin_cpu_supports("sse4.1");
+	case SIMD_FMA:
+		return __builtin_cpu_supports("fma");
+	}
+#else
+	(void)ext;
+#endif
+	return 0;
+}
+
+#ifdef SIMD_X86
+/* store 32-byte pattern over n bytes of dst with AVX2; return number of bytes stored */
+__attribute__((target("avx2")))
+static size_t
+fillavx2(unsigned char *dst, const unsigned char *pat, size_t n)
+{
+	__m256i v;
+	size_t i;
+
+	v = _mm256_loadu_si256((const __m256i *)pat);
+	for (i = 0; i + 128 <= n; i += 128) {
+		_mm256_storeu_si256((__m256i *)(dst + i), v);
+		_mm256_storeu_si256((__m256i *)(dst + i + 32), v);
+		_mm256_storeu_si256((__m256i *)(dst + i + 64), v);
+		_mm256_storeu_si256((__m256i *)(dst + i + 96), v);
+	}
+	for (; i + 32 <= n; i += 32)
+		_mm256_storeu_si256((__m256i *)(dst + i), v);
+	return i;
+}
+
+/* store 16-byte pattern over n bytes of dst with SSE2; return number of bytes stored */
+__attribute__((target("sse2")))
+static size_t
+fillsse2(unsigned char *dst, const unsigned char *pat, size_t n)
+{
+	__m128i v;
+	size_t i;
+
+	v = _mm_loadu_si128((const __m128i *)pat);
+	for (i = 0; i + 64 <= n; i += 64) {
+		_mm_storeu_si128((__m128i *)(dst + i), v);
+		_mm_storeu_si128((__m128i *)(dst + i + 16), v);
+		_mm_storeu_si128((__m128i *)(dst + i + 32), v);
+		_mm_storeu_si128((__m128i *)(dst + i + 48), v);
+	}
+	for (; i + 16 <= n; i += 16)
+		_mm_storeu_si128((__m128i *)(dst + i), v);
+	return i;
+}
+
+/* multiply 32-bit lanes, keeping the low halves of the products, with SSE2, which has no pmulld */
+__attribute__((target("sse2")))
+static __m128i
+mullosse2(__m128i a, __m128i b)
+{
+	__m128i even, odd;
+
+	even = _mm_mul_epu32(a, b);
+	odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+	                          _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+/* add n ints of a to *sum with AVX2; return number of ints added */
+__attribute__((target("avx2")))
+static size_t
+sumintavx2(const int32_t *a, size_t n, uint32_t *sum)
+{
+	__m256i acc0, acc1;
+	uint32_t lane[8];
+	size_t i, k;
+
+	acc0 = acc1 = _mm256_setzero_si256();
+	for (i = 0; i + 16 <= n; i += 16) {
+		acc0 = _mm256_add_epi32(acc0, _mm256_loadu_si256((const __m256i *)(a + i)));
+		acc1 = _mm256_add_epi32(acc1, _mm256_loadu_si256((const __m256i *)(a + i + 8)));
+	}
+	_mm256_storeu_si256((__m256i *)lane, _mm256_add_epi32(acc0, acc1));
+	for (k = 0; k < 8; k++)
+		*sum += lane[k];
+	return i;
+}
+
+/* add n ints of a to *sum with SSE2; return number of ints added */
+__attribute__((target("sse2")))
+static size_t
+sumintsse2(const int32_t *a, size_t n, uint32_t *sum)
+{
+	__m128i acc0, acc1;
+	uint32_t lane[4];
+	size_t i, k;
+
+	acc0 = acc1 = _mm_setzero_si128();
+	for (i = 0; i + 8 <= n; i += 8) {
+		acc0 = _mm_add_epi32(acc0, _mm_loadu_si128((const __m128i *)(a + i)));
+		acc1 = _mm_add_epi32(acc1, _mm_loadu_si128((const __m128i *)(a + i + 4)));
+	}
+	_mm_storeu_si128((__m128i *)lane, _mm_add_epi32(acc0, acc1));
+	for (k = 0; k < 4; k++)
+		*sum += lane[k];
+	return i;
+}
+
+/* add n longs of a to *sum with AVX2; return number of longs added */
+__attribute__((target("avx2")))
+static size_t
+sumlongavx2(const int64_t *a, size_t n, uint64_t *sum)
+{
+	__m256i acc;
+	uint64_t lane[4];
+	size_t i, k;
+
+	acc = _mm256_setzero_si256();
+	for (i = 0; i + 4 <= n; i += 4)
+		acc = _mm256_add_epi64(acc, _mm256_loadu_si256((const __m256i *)(a + i)));
+	_mm256_storeu_si256((__m256i *)lane, acc);
+	for (k = 0; k < 4; k++)
+		*sum += lane[k];
+	return i;
+}
+
+/* add n longs of a to *sum with SSE2; return number of longs added */
+__attribute__((target("sse2")))
+static size_t
+sumlongsse2(const int64_t *a, size_t n, uint64_t *sum)
+{
+	__m128i acc;
+	uint64_t lane[2];
+	size_t i;
+
+	acc = _mm_setzero_si128();
+	for (i = 0; i + 2 <= n; i += 2)
+		acc = _mm_add_epi64(acc, _mm_loadu_si128((const __m128i *)(a + i)));
+	_mm_storeu_si128((__m128i *)lane, acc);
+	*sum += lane[0] + lane[1];
+	return i;
+}
+
+/* add products of n ints of a and b to *sum with AVX2; return number of products added */
+__attribute__((target("avx2")))
+static size_t
+dotintavx2(const int32_t *a, const int32_t *b, size_t n, uint32_t *sum)
+{
+	__m256i acc;
+	uint32_t lane[8];
+	size_t i, k;
+
+	acc = _mm256_setzero_si256();
+	for (i = 0; i + 8 <= n; i += 8)
+		acc = _mm256_add_epi32(acc, _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i *)(a + i)),
+		                                               _mm256_loadu_si256((const __m256i *)(b + i))));
+	_mm256_storeu_si256((__m256i *)lane, acc);
+	for (k = 0; k < 8; k++)
+		*sum += lane[k];
+	return i;
+}
+
+/* add products of n ints of a and b to *sum with SSE2; return number of products added */
+__attribute__((target("sse2")))
+static size_t
+dotintsse2(const int32_t *a, const int32_t *b, size_t n, uint32_t *sum)
+{
+	__m128i acc;
+	uint32_t lane[4];
+	size_t i, k;
+
+	acc = _mm_setzero_si128();
+	for (i = 0; i + 4 <= n; i += 4)
+		acc = _mm_add_epi32(acc, mullosse2(_mm_loadu_si128((const __m128i *)(a + i)),
+		                                   _mm_loadu_si128((const __m128i *)(b + i))));
+	_mm_storeu_si128((__m128i *)lane, acc);
+	for (k = 0; k < 4; k++)
+		*sum += lane[k];
+	return i;
+}
+
+/* compute n ints of c from a and b with AVX2; return number of ints computed */
+__attribute__((target("avx2")))
+static size_t
+mapintavx2(SimdOp op, int32_t *c, const int32_t *a, const int32_t *b, size_t n)
+{
+	__m256i x, y;
+	size_t i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		x = _mm256_loadu_si256((const __m256i *)(a + i));
+		y = _mm256_loadu_si256((const __m256i *)(b + i));
+		switch (op) {
+		case SIMD_ADD: x = _mm256_add_epi32(x, y); break;
+		case SIMD_SUB: x = _mm256_sub_epi32(x, y); break;
+		case SIMD_MUL: x = _mm256_mullo_epi32(x, y); break;
+		default: return i;
+		}
+		_mm256_storeu_si256((__m256i *)(c + i), x);
+	}
+	return i;
+}
+
+/* compute n ints of c from a and b with SSE2; return number of ints computed */
+__attribute__((target("sse2")))
+static size_t
+mapintsse2(SimdOp op, int32_t *c, const int32_t *a, const int32_t *b, size_t n)
+{
+	__m128i x, y;
+	size_t i;
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		x = _mm_loadu_si128((const __m128i *)(a + i));
+		y = _mm_loadu_si128((const __m128i *)(b + i));
+		switch (op) {
+		case SIMD_ADD: x = _mm_add_epi32(x, y); break;
+		case SIMD_SUB: x = _mm_sub_epi32(x, y); break;
+		case SIMD_MUL: x = mullosse2(x, y); break;
+		default: return i;
+		}
+		_mm_storeu_si128((__m128i *)(c + i), x);
+	}
+	return i;
+}
+
+/* compute n longs of c from a and b with AVX2; return number of longs computed, none for a product */
+__attribute__((target("avx2")))
+static size_t
+maplongavx2(SimdOp op, int64_t *c, const int64_t *a, const int64_t *b, size_t n)
+{
+	__m256i x, y;
+	size_t i;
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		x = _mm256_loadu_si256((const __m256i *)(a + i));
+		y = _mm256_loadu_si256((const __m256i *)(b + i));
+		switch (op) {
+		case SIMD_ADD: x = _mm256_add_epi64(x, y); break;
+		case SIMD_SUB: x = _mm256_sub_epi64(x, y); break;
+		default: return i;
+		}
+		_mm256_storeu_si256((__m256i *)(c + i), x);
+	}
+	return i;
+}
+
+/* compute n longs of c from a and b with SSE2; return number of longs computed, none for a product */
+__attribute__((target("sse2")))
+static size_t
+maplongsse2(SimdOp op, int64_t *c, const int64_t *a, const int64_t *b, size_t n)
+{
+	__m128i x, y;
+	size_t i;
+
+	for (i = 0; i + 2 <= n; i += 2) {
+		x = _mm_loadu_si128((const __m128i *)(a + i));
+		y = _mm_loadu_si128((const __m128i *)(b + i));
+		switch (op) {
+		case SIMD_ADD: x = _mm_add_epi64(x, y); break;
+		case SIMD_SUB: x = _mm_sub_epi64(x, y); break;
+		default: return i;
+		}
+		_mm_storeu_si128((__m128i *)(c + i), x);
+	}
+	return i;
+}
+
+/* compute n doubles of c from a and b with AVX2; return number of doubles computed */
+__attribute__((target("avx2")))
+static size_t
+mapdoubleavx2(SimdOp op, double *c, const double *a, const double *b, size_t n)
+{
+	__m256d x, y;
+	size_t i;
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		x = _mm256_loadu_pd(a + i);
+		y = _mm256_loadu_pd(b + i);
+		switch (op) {
+		case SIMD_ADD: x = _mm256_add_pd(x, y); break;
+		case SIMD_SUB: x = _mm256_sub_pd(x, y); break;
+		case SIMD_MUL: x = _mm256_mul_pd(x, y); break;
+		case SIMD_DIV: x = _mm256_div_pd(x, y); break;
+		}
+		_mm256_storeu_pd(c + i, x);
+	}
+	return i;
+}
+
+/* compute n doubles of c from a and b with SSE2; return number of doubles computed */
+__attribute__((target("sse2")))
+static size_t
+mapdoublesse2(SimdOp op, double *c, const double *a, const double *b, size_t n)
+{
+	__m128d x, y;
+	size_t i;
+
+	for (i = 0; i + 2 <= n; i += 2) {
+		x = _mm_loadu_pd(a + i);
+		y = _mm_loadu_pd(b + i);
+		switch (op) {
+		case SIMD_ADD: x = _mm_add_pd(x, y); break;
+		case SIMD_SUB: x = _mm_sub_pd(x, y); break;
+		case SIMD_MUL: x = _mm_mul_pd(x, y); break;
+		case SIMD_DIV: x = _mm_div_pd(x, y); break;
+		}
+		_mm_storeu_pd(c + i, x);
+	}
+	return i;
+}
+
+/* find first of n bytes where a and b differ with AVX2; return its index, or the bytes compared if none */
+__attribute__((target("avx2")))
+static size_t
+mismatchavx2(const unsigned char *a, const unsigned char *b, size_t n)
+{
+	unsigned mask;
+	size_t i;
+
+	for (i = 0; i + 32 <= n; i += 32) {
+		mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(a + i)),
+		                                              _mm256_loadu_si256((const __m256i *)(b + i))));
+		if (mask != 0xFFFFFFFFu)
+			return i + __builtin_ctz(~mask);
+	}
+	return i;
+}
+
+/* find first of n bytes where a and b differ with SSE2; return its index, or the bytes compared if none */
+__attribute__((target("sse2")))
+static size_t
+mismatchsse2(const unsigned char *a, const unsigned char *b, size_t n)
+{
+	unsigned mask;
+	size_t i;
+
+	for (i = 0; i + 16 <= n; i += 16) {
+		mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i)),
+		                                        _mm_loadu_si128((const __m128i *)(b + i))));
+		if (mask != 0xFFFFu)
+			return i + __builtin_ctz(~mask);
+	}
+	return i;
+}
+#endif
+
+/* set each of the nmemb elements of elemsize bytes at dst to the element at elem */
+void
+simd_fill(void *dst, const void *elem, size_t elemsize, size_t nmemb)
+{
+	unsigned char pat[PATSIZE];
+	unsigned char *p = dst;
+	size_t i, n;
+
+	n = nmemb * elemsize;
+	if (elemsize == 1 || n == 0) {
+		memset(p, n ? *(const unsigned char *)elem : 0, n);
+		return;
+	}
+	for (i = 0; i < PATSIZE; i += elemsize)
+		memcpy(pat + i, elem, elemsize);
+	i = 0;
+#ifdef SIMD_X86
+	switch (simd_level()) {
+	case SIMD_AVX2:
+		i = fillavx2(p, pat, n);
+		break;
+	case SIMD_SSE2:
+		i = fillsse2(p, pat, n);
+		break;
+	default:
+		break;
+	}
+#endif
+	/* the tail starts at a multiple of PATSIZE, so it begins with the pattern */
+	for (; i + PATSIZE <= n; i += PATSIZE)
+		memcpy(p + i, pat, PATSIZE);
+	memcpy(p + i, pat, n - i);
+}
+
+/*
+ * The kernels below run simple loops over arrays with the widest vector
+ * extension of the cpu, and finish the elements left over in scalar
+ * code.  Integer arithmetic wraps around as in Java; sums are exact in
+ * any order, so only integer reductions are vectorized, while maps of
+ * doubles compute each element alone as the scalar code does.
+ */
+
+/* add n ints of a, wrapping around */
+int32_t
+simd_sumint(const int32_t *a, size_t n)
+{
+	uint32_t sum = 0;
+	size_t i = 0;
+
+#ifdef SIMD_X86
+	switch (simd_level()) {
+	case SIMD_AVX2:
+		i = sumintavx2(a, n, &sum);
+		break;
+	case SIMD_SSE2:
+		i = sumintsse2(a, n, &sum);
+		break;
+	default:
+		break;
+	}
+#endif
+	for (; i < n; i++)
+		sum += (uint32_t)a[i];
+	return (int32_t)sum;
+}
+
+/* add n longs of a, wrapping around */
+int64_t
+simd_sumlong(const int64_t *a, size_t n)
+{
+	uint64_t sum = 0;
+	size_t i = 0;
+
+#ifdef SIMD_X86
+	switch (simd_level()) {
+	case SIMD_AVX2:
+		i = sumlongavx2(a, n, &sum);
+		break;
+	case SIMD_SSE2:
+		i = sumlongsse2(a, n, &sum);
+		break;
+	default:
+		break;
+	}
+#endif
+	for (; i < n; i++)
+		sum += (uint64_t)a[i];
+	return (int64_t)sum;
+}
+
+/* add products of n ints of a and b, wrapping around */
+int32_t
+simd_dotint(const int32_t *a, const int32_t *b, size_t n)
+{
+	uint32_t sum = 0;
+	size_t i = 0;
+
+#ifdef SIMD_X86
+	switch (simd_level()) {
+	case SIMD_AVX2:
+		i = dotintavx2(a, b, n, &sum);
+		break;
+	case SIMD_SSE2:
+		i = dotintsse2(a, b, n, &sum);
+		break;
+	default:
+		break;
+	}
+#endif
+	for (; i < n; i++)
+		sum += (uint32_t)a[i] * (uint32_t)b[i];
+	return (int32_t)sum;
+}
+
+/* add products of n longs of a and b, wrapping around; neither extension multiplies longs */
+int64_t
+simd_dotlong(const int64_t *a, const int64_t *b, size_t n)
+{
+	uint64_t sum = 0;
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		sum += (uint64_t)a[i] * (uint64_t)b[i];
+	return (int64_t)sum;
+}
+
+/* set n ints of c to the operation on those of a and b, wrapping around */
+void
+simd_mapint(SimdOp op, int32_t *c, const int32_t *a, const int32_t *b, size_t n)
+{
+	size_t i = 0;
+
+#ifdef SIMD_X86
+	switch (simd_level()) {
+	case SIMD_AVX2:
+		i = mapintavx2(op, c, a, b, n);
+		break;
+	case SIMD_SSE2:
+		i = mapintsse2(op, c, a, b, n);
+		break;
+	default:
+		break;
+	}
+#endif
+	for (; i < n; i++) {
+		switch (op) {
+		case SIMD_ADD: c[i] = (int32_t)((uint32_t)a[i] + (uint32_t)b[i]); break;
+		case SIMD_SUB: c[i] = (int32_t)((uint32_t)a[i] - (uint32_t)b[i]); break;
+		case SIMD_MUL: c[i] = (int32_t)((uint32_t)a[i] * (uint32_t)b[i]); break;
+		default: return;
+		}
+	}
+}
+
+/* set n longs of c to the operation on those of a and b, wrapping around */
+void
+simd_maplong(SimdOp op, int64_t *c, const int64_t *a, const int64_t *b, size_t n)
+{
+	size_t i = 0;
+
+#ifdef SIMD_X86
+	switch (simd_level()) {
+	case SIMD_AVX2:
+		i = maplongavx2(op, c, a, b, n);
+		break;
+	case SIMD_SSE2:
+		i = maplongsse2(op, c, a, b, n);
+		break;
+	default:
+		break;
+	}
+#endif
+	for (; i < n; i++) {
+		switch (op) {
+		case SIMD_ADD: c[i] = (int64_t)((uint64_t)a[i] + (uint64_t)b[i]); break;
+		case SIMD_SUB: c[i] = (int64_t)((uint64_t)a[i] - (uint64_t)b[i]); break;
+		case SIMD_MUL: c[i] = (int64_t)((uint64_t)a[i] * (uint64_t)b[i]); break;
+		default: return;
+		}
+	}
+}
+
+/* set n doubles of c to the operation on those of a and b */
+void
+simd_mapdouble(SimdOp op, double *c, const double *a, const double *b, size_t n)
+{
+	size_t i = 0;
+
+#ifdef SIMD_X86
+	switch (simd_level()) {
+	case SIMD_AVX2:
+		i = mapdoubleavx2(op, c, a, b, n);
+		break;
+	case SIMD_SSE2:
+		i = mapdoublesse2(op, c, a, b, n);
+		break;
+	default:
+		break;
+	}
+#endif
+	for (; i < n; i++) {
+		switch (op) {
+		case SIMD_ADD: c[i] = a[i] + b[i]; break;
+		case SIMD_SUB: c[i] = a[i] - b[i]; break;
+		case SIMD_MUL: c[i] = a[i] * b[i]; break;
+		case SIMD_DIV: c[i] = a[i] / b[i]; break;
+		}
+	}
+}
+
+/* find first of n bytes where a and b differ; return its index, or n if they are equal */
+size_t
+simd_mismatch(const void *a, const void *b, size_t n)
+{
+	const unsigned char *p = a, *q = b;
+	size_t i = 0;
+
+#ifdef SIMD_X86
+	switch (simd_level()) {
+	case SIMD_AVX2:
+		i = mismatchavx2(p, q, n);
+		break;
+	case SIMD_SSE2:
+		i = mismatchsse2(p, q, n);
+		break;
+	default:
+		break;
+	}
+#endif
+	while (i < n && p[i] == q[i])
+		i++;
+	return i;
+}
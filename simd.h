@@ -0,0 +1,34 @@
+/* vector instruction set extensions usable on this cpu */
+typedef enum SimdLevel {
+	SIMD_NONE,
+	SIMD_SSE2,
+	SIMD_AVX2,
+} SimdLevel;
+
+/* scalar instruction set extensions, tested by simd_has */
+typedef enum SimdExt {
+	SIMD_POPCNT,
+	SIMD_LZCNT,
+	SIMD_SSE41,                     /* roundsd */
+	SIMD_FMA,
+} SimdExt;
+
+/* element-wise operation of simd_map* */
+typedef enum SimdOp {
+	SIMD_ADD,
+	SIMD_SUB,
+	SIMD_MUL,
+	SIMD_DIV,
+} SimdOp;
+
+SimdLevel simd_level(void);
+int simd_has(SimdExt ext);
+void simd_fill(void *dst, const void *elem, size_t elemsize, size_t nmemb);
+int32_t simd_sumint(const int32_t *a, size_t n);
+int64_t simd_sumlong(const int64_t *a, size_t n);
+int32_t simd_dotint(const int32_t *a, const int32_t *b, size_t n);
+int64_t simd_dotlong(const int64_t *a, const int64_t *b, size_t n);
+void simd_mapint(SimdOp op, int32_t *c, const int32_t *a, const int32_t *b, size_t n);
+void simd_maplong(SimdOp op, int64_t *c, const int64_t *a, const int64_t *b, size_t n);
+void simd_mapdouble(SimdOp op, double *c, const double *a, const double *b, size_t n);
+size_t simd_mismatch(const void *a, const void *b, size_t n);
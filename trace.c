@@ -0,0 +1,265 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "util.h"
+#include "class.h"
+#include "frame.h"
+#include "trace.h"
+
+Trace *trace_recording = NULL;          /* trace being recorded, or NULL */
+
+static Trace *traces = NULL;            /* traces recorded, for trace_del */
+static Frame *frames[TRACE_MAXDEPTH + 1];      /* frame of each call being recorded; a returning one is freed */
+static Frame *callframe = NULL;         /* frame of the instructions being recorded */
+static TraceCall *call = NULL;          /* call of the instructions being recorded, NULL for the loop's method */
+static int depth = 0;                   /* nesting of call */
+
+/* free call of trace and the storage of its frame */
+static void
+callfree(TraceCall *c)
+{
+	while (c->frame.nobj > 0)
+		free(c->frame.obj[--c->frame.nobj].p);
+	free(c->frame.obj);
+	free(c->frame.local);
+	free(c->frame.stack);
+	free(c);
+}
+
+/* free trace */
+static void
+tracefree(Trace *t)
+{
+	size_t i;
+
+	for (i = 0; i < t->ncalls; i++)
+		callfree(t->calls[i]);
+	free(t->calls);
+	free(t->steps);
+	free(t->exits);
+	free(t);
+}
+
+/* start recording the path taken through an iteration of the loop whose head is at the pc of frame */
+void
+trace_begin(Frame *frame)
+{
+	Trace *t;
+
+	t = ecalloc(1, sizeof *t);
+	t->class = frame->class;
+	t->code = frame->code;
+	t->head = frame->pc;
+	t->steps = ecalloc(TRACE_MAXSTEPS, sizeof *t->steps);
+	trace_recording = t;
+	frames[0] = callframe = frame;
+	call = NULL;
+	depth = 0;
+}
+
+/* start recording the path from side exit of root, taken to the pc of frame, back to the loop head */
+void
+trace_beginside(Trace *root, size_t exit, Frame *frame)
+{
+	Trace *t;
+	TraceCall *c;
+	int i;
+
+	t = ecalloc(1, sizeof *t);
+	t->root = root;
+	t->exit = exit;
+	t->class = root->class;
+	t->code = root->code;
+	t->head = root->head;
+	t->steps = ecalloc(TRACE_MAXSTEPS, sizeof *t->steps);
+	trace_recording = t;
+	call = root->exits[exit].call;
+	for (depth = 0, c = call; c != NULL; c = c->caller)
+		depth++;
+	callframe = frame;
+	for (i = depth; i >= 0; i--, frame = frame->next)
+		frames[i] = frame;
+}
+
+/* stop recording; the loop may become hot again, so that it or another loop of its method is recorded anew */
+void
+trace_abort(void)
+{
+	Trace *t;
+
+	if ((t = trace_recording) == NULL)
+		return;
+	trace_recording = NULL;
+	if (t->root == NULL) {
+		t->code->tracefails++;
+		if (t->code->backedges > 0) {
+			t->code->backedges--;
+		}
+	}
+	tracefree(t);
+}
+
+/* record call made by the last instruction recorded, whose first instruction is about to run in frame */
+static int
+callbegin(Trace *t, Frame *frame)
+{
+	TraceCall *c, **p;
+	Method *method;
+	char *name, *type;
+	U1 *code;
+	U2 pc;
+
+	pc = t->steps[t->nsteps - 1].pc;
+	code = callframe->code->code;
+	if ((code[pc] != INVOKESTATIC && code[pc] != INVOKEVIRTUAL) || frame->pc != 0 || depth == TRACE_MAXDEPTH)
+		return -1;
+	if ((method = class_getcodemethod(frame->class, frame->code)) == NULL)
+		return -1;
+	/* the frame may be of a class initializer run by the invocation */
+	class_getnameandtype(callframe->class, callframe->class->constant_pool[code[pc + 1] << 8 | code[pc + 2]].info.methodref_info.name_and_type_index, &name, &type);
+	if (strcmp(name, class_getutf8(frame->class, method->name_index)) != 0 ||
+	    strcmp(type, class_getutf8(frame->class, method->descriptor_index)) != 0)
+		return -1;
+	if ((p = realloc(t->calls, (t->ncalls + 1) * sizeof *p)) == NULL)
+		err(EXIT_FAILURE, "realloc");
+	t->calls = p;
+	c = ecalloc(1, sizeof *c);
+	t->calls[t->ncalls++] = c;
+	c->caller = call;
+	c->pc = pc;
+	c->sp = callframe->nstack;
+	c->flags = method->access_flags;
+	c->descriptor = class_getutf8(frame->class, method->descriptor_index);
+	c->frame.class = frame->class;
+	c->frame.code = frame->code;
+	c->frame.local = ecalloc(frame->code->max_locals + 1, sizeof *c->frame.local);
+	c->frame.stack = ecalloc(frame->code->max_stack + 1, sizeof *c->frame.stack);
+	call = c;
+	frames[++depth] = callframe = frame;
+	return 0;
+}
+
+/*
+ * Record the instruction at the pc of frame, about to be run by the
+ * interpreter.  Calls are followed into the frames they push, and the
+ * recording ends when the loop's method is back at the loop head.
+ * Inner loops, switches, subroutines, exceptions and returns from the
+ * loop's method end it in failure.  Return the trace once the loop is
+ * closed; NULL otherwise.
+ */
+Trace *
+trace_step(Frame *frame)
+{
+	Trace *t = trace_recording;
+	U1 op;
+
+	if (frame == callframe) {
+		if (call == NULL && frame->pc == t->head && (t->nsteps > 0 || t->root != NULL)) {
+			trace_recording = NULL;
+			t->link = traces;
+			traces = t;
+			return t;
+		}
+		if (t->nsteps > 0 && t->steps[t->nsteps - 1].call == call && frame->pc <= t->steps[t->nsteps - 1].pc) {
+			trace_abort();
+			return NULL;
+		}
+	} else if (frame->next == callframe) {
+		if (callbegin(t, frame) == -1) {
+			trace_abort();
+			return NULL;
+		}
+	} else if (depth > 0 && frame == frames[depth - 1] && frame->pc == call->pc + 3) {
+		op = call->frame.code->code[t->steps[t->nsteps - 1].pc];
+		if (op < IRETURN || op > RETURN) {
+			trace_abort();
+			return NULL;
+		}
+		call = call->caller;
+		callframe = frame;
+		depth--;
+	} else {
+		trace_abort();
+		return NULL;
+	}
+	op = frame->code->code[frame->pc];
+	switch (op) {
+	case TABLESWITCH: case LOOKUPSWITCH:
+	case JSR: case JSR_W: case RET: case ATHROW:
+		trace_abort();
+		return NULL;
+	case IRETURN: case LRETURN: case FRETURN: case DRETURN: case ARETURN: case RETURN:
+		if (call == NULL) {
+			trace_abort();
+			return NULL;
+		}
+		break;
+	case WIDE:
+		if (frame->code->code[frame->pc + 1] == RET) {
+			trace_abort();
+			return NULL;
+		}
+		break;
+	}
+	if (t->nsteps == TRACE_MAXSTEPS) {
+		trace_abort();
+		return NULL;
+	}
+	t->steps[t->nsteps].call = call;
+	t->steps[t->nsteps++].pc = frame->pc;
+	return NULL;
+}
+
+/* install compiled trace at the head of its loop */
+void
+trace_add(Trace *trace)
+{
+	trace->next = trace->code->traces;
+	trace->code->traces = trace;
+}
+
+/* stop using trace; it is freed by trace_del, as its calls may still hold arrays of their frames */
+void
+trace_remove(Trace *trace)
+{
+	Trace *t;
+
+	if (trace->code->traces == trace) {
+		trace->code->traces = trace->next;
+		return;
+	}
+	for (t = trace->code->traces; t != NULL; t = t->next) {
+		if (t->next == trace) {
+			t->next = trace->next;
+			return;
+		}
+	}
+}
+
+/* get compiled trace of the loop of code whose head is at pc */
+Trace *
+trace_find(Code_attribute *code, U2 pc)
+{
+	Trace *t;
+
+	for (t = code->traces; t != NULL; t = t->next)
+		if (t->head == pc)
+			return t;
+	return NULL;
+}
+
+/* free traces recorded */
+void
+trace_del(void)
+{
+	Trace *t;
+
+	if (trace_recording != NULL) {
+		tracefree(trace_recording);
+		trace_recording = NULL;
+	}
+	while ((t = traces) != NULL) {
+		traces = t->link;
+		tracefree(t);
+	}
+}
@@ -0,0 +1,67 @@
+#define TRACE_MAXSTEPS  2000    /* most instructions recorded in a trace */
+#define TRACE_MAXDEPTH  8       /* deepest nesting of calls followed by a trace */
+#define TRACE_MAXFAILS  4       /* recordings that may fail before the method of a loop is compiled whole */
+#define TRACE_MINEXITS  64      /* side exits taken before a trace is checked for staying on its path */
+#define TRACE_MINRUN    4       /* iterations per side exit of a trace worth keeping */
+#define TRACE_HOTEXIT   16      /* times a side exit is taken before the path from it is recorded */
+#define TRACE_MAXSIDES  32      /* most side traces of a loop */
+
+/* call followed by a trace; its frame, used by interpreter routines the trace runs, is not on the frame stack */
+typedef struct TraceCall {
+	struct TraceCall       *caller;         /* NULL for a call from the method of the loop */
+	U2                      pc;             /* invocation in caller */
+	int                     sp;             /* operand stack slots of caller, arguments popped */
+	U2                      flags;          /* access flags of the method called */
+	char                   *descriptor;
+	Frame                   frame;
+} TraceCall;
+
+/* instruction of a trace */
+typedef struct TraceStep {
+	TraceCall              *call;           /* NULL for the method of the loop */
+	U2                      pc;
+} TraceStep;
+
+/* side exit of a trace, which returns to the interpreter unless a side trace continues from it */
+typedef struct TraceExit {
+	TraceCall              *call;           /* call left, whose frame holds the state; NULL for the loop's method */
+	U1                     *jump;           /* displacement of the guard taking it, in compiled code */
+	unsigned long           taken;
+} TraceExit;
+
+/*
+ * Path taken through an iteration of a loop, across the methods it
+ * calls.  A side trace continues the path from a side exit of the
+ * trace of a loop, its root, back to the loop head.
+ */
+typedef struct Trace {
+	struct Trace           *next;           /* next trace of the same method */
+	struct Trace           *link;           /* next trace recorded */
+	struct Trace           *root;           /* NULL for the trace of a loop */
+	size_t                  exit;           /* exit of root a side trace continues from */
+	ClassFile              *class;
+	Code_attribute         *code;
+	U2                      head;           /* loop head, where the trace starts and ends */
+	TraceStep              *steps;
+	size_t                  nsteps;
+	TraceCall             **calls;
+	size_t                  ncalls;
+	TraceExit              *exits;          /* exits of the trace and its side traces, by number */
+	size_t                  nexits;
+	size_t                  nsides;
+	void                   *fn;             /* compiled code; runs the loop and returns the exit taken */
+	void                   *loop;           /* loop head in compiled code, where side traces end */
+	unsigned long           iterations;     /* counted by compiled code */
+	unsigned long           exited;         /* exits that returned to the interpreter */
+} Trace;
+
+extern Trace *trace_recording;
+
+void trace_begin(Frame *frame);
+void trace_beginside(Trace *root, size_t exit, Frame *frame);
+Trace *trace_step(Frame *frame);
+void trace_abort(void);
+void trace_add(Trace *trace);
+void trace_remove(Trace *trace);
+Trace *trace_find(Code_attribute *code, U2 pc);
+void trace_del(void);